@@ -24,6 +24,7 @@
 #include "FWCore/Framework/interface/MakerMacros.h"
 
 #include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "FWCore/Framework/interface/ESHandle.h"
 
 #include "RecoMuon/TrackingTools/interface/MuonServiceProxy.h"
 
@@ -51,6 +52,8 @@ namespace edm {
 }
 
 class MuonServiceProxy;
+class Propagator;
+class CSCSegment;
 
 class CSCTimingExtractor {
 
@@ -72,8 +75,18 @@ public:
      float weightInvbeta;
   };
 
+  /// cache the event setup products, to be called once per event before the
+  /// fillTiming with segments; the propagator is only fetched again when its
+  /// record changes
+  void beginEvent(const edm::Event& iEvent, const edm::EventSetup& iSetup);
+
+  /// tmSequence is cleared and filled with the measurements of the track
   void fillTiming(TimeMeasurementSequence &tmSequence, reco::TrackRef muonTrack, const edm::Event& iEvent, const edm::EventSetup& iSetup);
 
+  /// same as above for a given set of segments, e.g. the ones already matched to the muon,
+  /// beginEvent must have been called
+  void fillTiming(TimeMeasurementSequence &tmSequence, reco::TrackRef muonTrack, const std::vector<const CSCSegment*>& segments);
+
 private:
   edm::InputTag CSCSegmentTags_;
   unsigned int theHitsMin_;
@@ -85,10 +98,18 @@ private:
   bool UseWireTime;
   bool UseStripTime;
   bool debug;
+  // straight line distance to the hits instead of the propagation
+  bool useFastDistance_;
   
   MuonServiceProxy* theService;
   
   MuonSegmentMatcher *theMatcher;
+
+  edm::ESHandle<Propagator> thePropagator;
+  unsigned long long thePropagatorCacheId;
+
+  // work buffer of fillTiming, kept to reuse its storage
+  std::vector<TimeMeasurement> theMeasurements;
 };
 
 #endif
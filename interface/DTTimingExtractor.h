@@ -24,6 +24,7 @@
 #include "FWCore/Framework/interface/MakerMacros.h"
 
 #include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "FWCore/Framework/interface/ESHandle.h"
 
 #include "RecoMuon/TrackingTools/interface/MuonServiceProxy.h"
 
@@ -51,6 +52,9 @@ namespace edm {
 }
 
 class MuonServiceProxy;
+class DTGeometry;
+class Propagator;
+class DTRecSegment4D;
 
 class DTTimingExtractor {
 
@@ -74,10 +78,32 @@ public:
      DetId driftCell;
   };
 
+  /// cache the event setup products, to be called once per event before the
+  /// fillTiming with segments; the products are only fetched again when their
+  /// records change
+  void beginEvent(const edm::Event& iEvent, const edm::EventSetup& iSetup);
+
+  /// tmSequence is cleared and filled with the measurements of the track
   void fillTiming(TimeMeasurementSequence &tmSequence, reco::TrackRef muonTrack, const edm::Event& iEvent, const edm::EventSetup& iSetup);
 
+  /// same as above for a given set of segments, e.g. the ones already matched to the muon,
+  /// beginEvent must have been called
+  void fillTiming(TimeMeasurementSequence &tmSequence, reco::TrackRef muonTrack, const std::vector<const DTRecSegment4D*>& segments);
+
 private:
-  double fitT0(double &a, double &b, const std::vector<double>& xl, const std::vector<double>& yl, const std::vector<double>& xr, const std::vector<double>& yr );
+  /// one measurement of a fitted segment
+  struct FittedHit {
+    int index;
+    double distIP;
+    double t0;
+    double weightVertex;
+    double weightInvbeta;
+  };
+  /// segments are indexed by (station-1)*2+isPhi
+  static const unsigned int nSegments = 8;
+
+  /// fit the active hits of one segment and store their measurements
+  void fitSegment(unsigned int segment);
 
   edm::InputTag DTSegmentTags_; 
   unsigned int theHitsMin_;
@@ -89,10 +115,25 @@ private:
   bool dropTheta_;
   bool requireBothProjections_;
   bool debug;
+  // straight line distance to the hits instead of the propagation
+  bool useFastDistance_;
   
   MuonServiceProxy* theService;
   
   MuonSegmentMatcher *theMatcher;
+
+  edm::ESHandle<DTGeometry> theDTGeom;
+  edm::ESHandle<Propagator> thePropagator;
+  unsigned long long theGeometryCacheId;
+  unsigned long long thePropagatorCacheId;
+
+  // work buffers of fillTiming, kept to reuse their storage
+  std::vector<TimeMeasurement> theMeasurements;
+  std::vector<double> theCellZ;
+  std::vector<bool> theActive;
+  std::vector<FittedHit> theFittedHits[nSegments];
+  std::vector<int> theSegmentIndices;
+  std::vector<int> theHitIndices;
 };
 
 #endif
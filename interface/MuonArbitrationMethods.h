@@ -1,7 +1,10 @@
 #ifndef MuonIdentification_MuonArbitrationMethods_h
 #define MuonIdentification_MuonArbitrationMethods_h
 
+#include <cmath>
 #include "DataFormats/MuonDetId/interface/MuonSubdetId.h"
+#include "DataFormats/MuonReco/interface/MuonChamberMatch.h"
+#include "DataFormats/MuonReco/interface/MuonSegmentMatch.h"
 
 // Author: Jake Ribnik (UCSB)
 
@@ -53,4 +56,58 @@ struct SortMuonSegmentMatches {
    unsigned int flag_;
 };
 
+namespace muonid {
+   /// distances used by the arbitration, one comparator per metric
+   enum ArbitrationMetric { ByDX, ByDR, ByDXSlope, ByDRSlope };
+
+   /// distances of a segment match to the track, computed once per segment
+   /// so that the comparators do not recompute them, and the index of the
+   /// segment match in the caller's list. The expressions and types are the
+   /// ones of SortMuonSegmentMatches (float differences, the dR in double),
+   /// so that the keys compare exactly as the distances computed there
+   struct SegmentMatchKeys {
+      SegmentMatchKeys( const reco::MuonChamberMatch& chamber, const reco::MuonSegmentMatch& segment,
+			unsigned int i ) :
+	dx(fabs(segment.x-chamber.x)),
+	dr(sqrt(pow(segment.x-chamber.x,2)+pow(segment.y-chamber.y,2))),
+	dxSlope(fabs(segment.dXdZ-chamber.dXdZ)),
+	drSlope(sqrt(pow(segment.dXdZ-chamber.dXdZ,2)+pow(segment.dYdZ-chamber.dYdZ,2))),
+	hasZed(segment.hasZed()), index(i) {}
+      float dx;
+      double dr;
+      float dxSlope;
+      double drSlope;
+      bool hasZed;
+      unsigned int index;
+   };
+
+   /// same ordering as SortMuonSegmentMatches with a flag of the metric
+   template <ArbitrationMetric metric> struct SortSegmentMatchKeys;
+
+   template <> struct SortSegmentMatchKeys<ByDX> {
+      bool operator() ( const SegmentMatchKeys& k1, const SegmentMatchKeys& k2 ) const {
+	 return k1.dx < k2.dx;
+      }
+   };
+   template <> struct SortSegmentMatchKeys<ByDR> {
+      bool operator() ( const SegmentMatchKeys& k1, const SegmentMatchKeys& k2 ) const {
+	 if( (! k1.hasZed) || (! k2.hasZed) ) // no y information so compare dx
+	    return k1.dx < k2.dx;
+	 return k1.dr < k2.dr;
+      }
+   };
+   template <> struct SortSegmentMatchKeys<ByDXSlope> {
+      bool operator() ( const SegmentMatchKeys& k1, const SegmentMatchKeys& k2 ) const {
+	 return k1.dxSlope < k2.dxSlope;
+      }
+   };
+   template <> struct SortSegmentMatchKeys<ByDRSlope> {
+      bool operator() ( const SegmentMatchKeys& k1, const SegmentMatchKeys& k2 ) const {
+	 if( (! k1.hasZed) || (! k2.hasZed) ) // no y information so compare dx
+	    return k1.dxSlope < k2.dxSlope;
+	 return k1.drSlope < k2.drSlope;
+      }
+   };
+}
+
 #endif
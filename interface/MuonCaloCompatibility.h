@@ -17,70 +17,104 @@
 //
 //
 
-#include "TH2.h"
-#include "TH2D.h"
-#include "TFile.h"
 #include "DataFormats/MuonReco/interface/Muon.h"
 #include "FWCore/ParameterSet/interface/ParameterSet.h"
 #include <string>
+#include <vector>
+#include <boost/shared_ptr.hpp>
 
 class MuonCaloCompatibility {
  public:
-   MuonCaloCompatibility():isConfigured_(false){}
+   MuonCaloCompatibility();
+   /// the templates are taken from BinaryTemplateFileName if it is given,
+   /// from the ROOT files otherwise; instances configured with the same
+   /// files share one read-only copy of the templates
    void configure(const edm::ParameterSet&);
-   double evaluate( const reco::Muon& );
+   /// convert the ROOT templates of the configuration into a binary file
+   /// that can be given as BinaryTemplateFileName
+   static void writeBinaryTemplates( const edm::ParameterSet&, const std::string& fileName );
+   // kinematics of the muon track and the raw calorimeter energies
+   struct Input {
+      double eta;
+      double theta;
+      double p;
+      double em;
+      double had;
+      double ho;
+   };
+   /// throws if the muon has neither a tracker nor a stand-alone track
+   static Input input( const reco::Muon& );
+
+   // does not modify the object and can be called concurrently
+   double evaluate( const reco::Muon& ) const;
+   /// evaluate a batch of candidates, results[i] corresponds to inputs[i]
+   void evaluate( const std::vector<Input>& inputs, std::vector<double>& results ) const;
  private:
-   bool accessing_overflow( TH2D* histo, double x, double y );
+   // owns the memory of all the templates, defined in the .cc
+   class TemplateSet;
+
+   // Template histogram as a flat grid in the memory of a TemplateSet, the
+   // lookup reproduces TAxis::FindBin and TH2D::GetBinContent
+   class Template {
+    public:
+      Template() : contents_(0) {}
+      bool isValid() const { return contents_ != 0; }
+      const std::string& name() const { return name_; }
+      // false if (x,y) is in the underflow or overflow of the histogram
+      bool lookup( double x, double y, double& content ) const;
+    private:
+      friend class TemplateSet;
+      struct Axis {
+	 Axis() : nbins(0), min(0), max(0), edges(0), nedges(0) {}
+	 int nbins;
+	 double min, max;
+	 // null for fixed bin size
+	 const double* edges;
+	 int nedges;
+	 // bin number in 1..nbins, 0 for underflow and nbins+1 for overflow
+	 int findBin( double x ) const;
+      };
+      std::string name_;
+      Axis xAxis_;
+      Axis yAxis_;
+      // in-range bin contents, x changing fastest, null if the histogram is missing
+      const double* contents_;
+   };
+
+   double compatibility( const Input& ) const;
+
    bool isConfigured_;
+   boost::shared_ptr<const TemplateSet> templateSet_;
    
    /*    std::string muon_templateFileName; */
    /*    std::string pion_templateFileName; */
    std::string MuonfileName_;
    std::string PionfileName_;
    
-   boost::shared_ptr<TFile> pion_templates;
-   boost::shared_ptr<TFile> muon_templates;
-   // used input templates for given eta
-   TH2D * pion_template_em ;
-   TH2D * pion_template_had;
-   TH2D * pion_template_ho ;
-   TH2D * muon_template_em ;
-   TH2D * muon_template_had;
-   TH2D * muon_template_ho ;
-   // input template functions by eta
-   TH2D* pion_had_etaEpl ;
-   TH2D* pion_em_etaEpl  ;
-   TH2D* pion_had_etaTpl ;
-   TH2D* pion_em_etaTpl  ;
-   TH2D* pion_ho_etaB    ;
-   TH2D* pion_had_etaB   ;
-   TH2D* pion_em_etaB    ;
-   TH2D* pion_had_etaTmi ;
-   TH2D* pion_em_etaTmi  ;
-   TH2D* pion_had_etaEmi ;
-   TH2D* pion_em_etaEmi  ;
-
-   TH2D* muon_had_etaEpl ;
-   TH2D* muon_em_etaEpl  ;
-   TH2D* muon_had_etaTpl ;
-   TH2D* muon_em_etaTpl  ;
-   TH2D* muon_ho_etaB    ;
-   TH2D* muon_had_etaB   ;
-   TH2D* muon_em_etaB    ;
-   TH2D* muon_had_etaTmi ;
-   TH2D* muon_em_etaTmi  ;
-   TH2D* muon_had_etaEmi ;
-   TH2D* muon_em_etaEmi  ;
-
-   double  pbx;
-   double  pby;
-   double  pbz;
-   
-   double  psx;
-   double  psy;
-   double  psz;
+   // input templates by eta, owned by templateSet_
+   const Template* pion_had_etaEpl ;
+   const Template* pion_em_etaEpl  ;
+   const Template* pion_had_etaTpl ;
+   const Template* pion_em_etaTpl  ;
+   const Template* pion_ho_etaB    ;
+   const Template* pion_had_etaB   ;
+   const Template* pion_em_etaB    ;
+   const Template* pion_had_etaTmi ;
+   const Template* pion_em_etaTmi  ;
+   const Template* pion_had_etaEmi ;
+   const Template* pion_em_etaEmi  ;
 
-   double  muon_compatibility;
+   const Template* muon_had_etaEpl ;
+   const Template* muon_em_etaEpl  ;
+   const Template* muon_had_etaTpl ;
+   const Template* muon_em_etaTpl  ;
+   const Template* muon_ho_etaB    ;
+   const Template* muon_had_etaB   ;
+   const Template* muon_em_etaB    ;
+   const Template* muon_had_etaTmi ;
+   const Template* muon_em_etaTmi  ;
+   const Template* muon_had_etaEmi ;
+   const Template* muon_em_etaEmi  ;
 
    bool use_corrected_hcal;
    bool use_em_special;
@@ -19,14 +19,22 @@
 #include <vector>
 
 #include "FWCore/Framework/interface/Frameworkfwd.h"
+#include "FWCore/Framework/interface/ESHandle.h"
 #include "DataFormats/Common/interface/ValueMap.h"
+#include "DataFormats/Common/interface/Handle.h"
 
 #include "DataFormats/MuonReco/interface/Muon.h"
+#include "DataFormats/MuonReco/interface/MuonFwd.h"
 #include "DataFormats/MuonReco/interface/MuonCosmicCompatibility.h"
+#include "DataFormats/TrackReco/interface/TrackFwd.h"
+#include "DataFormats/VertexReco/interface/VertexFwd.h"
+#include "DataFormats/GeometryVector/interface/LocalPoint.h"
+#include "RecoMuon/MuonIdentification/interface/MuonCosmicsId.h"
 
 namespace edm {class ParameterSet; class Event; class EventSetup;}
 class GlobalMuonRefitter;
 class MuonServiceProxy;
+class GlobalTrackingGeometry;
 
 
 class MuonCosmicCompatibilityFiller {
@@ -36,31 +44,72 @@ class MuonCosmicCompatibilityFiller {
   MuonCosmicCompatibilityFiller(const edm::ParameterSet&);
   ~MuonCosmicCompatibilityFiller();
   
+  /// DetId and local position of a valid cosmic muon hit, ordered by DetId
+  struct HitKey {
+    HitKey(uint32_t i, const LocalPoint& p) : id(i), position(p) {}
+    bool operator<(const HitKey& other) const { return id < other.id; }
+    uint32_t id;
+    LocalPoint position;
+  };
+
+  /// valid hits of a cosmic muon track and their split in the detector hemispheres
+  struct CosmicMuonHits {
+    CosmicMuonHits() : nhitsUp(0), nhitsDown(0) {}
+    /// sorted by DetId for the shared hit search
+    std::vector<HitKey> validHits;
+    int nhitsUp;
+    int nhitsDown;
+  };
+
+  /// event products and quantities shared by the checks of all the muons of an event
+  struct EventContext {
+    EventContext() : goodVertices(0) {}
+    /// the muons of the second input muon collection
+    edm::Handle<reco::MuonCollection> muons;
+    std::vector<const reco::Muon*> globalMuons;
+    std::vector<edm::Handle<reco::TrackCollection> > tracks;
+    /// the back-to-back search in each track collection, set for the valid ones
+    std::vector<muonid::OppositeTrackFinder> oppositeTrackFinders;
+    /// hits of the cosmic muons, in the order of the cosmic muon collection
+    edm::Handle<reco::MuonCollection> cosmicMuons;
+    std::vector<CosmicMuonHits> cosmicMuonHits;
+    edm::Handle<reco::VertexCollection> vertices;
+    /// event activity: number of good vertices, 0 == cosmic-like
+    unsigned int goodVertices;
+    edm::ESHandle<GlobalTrackingGeometry> trackingGeometry;
+  };
+
+  /// collect the products and the event quantities used by the compatibility of all the muons
+  void fillEventContext( EventContext&, const edm::Event&, const edm::EventSetup&);
+
+  /// back-to-back search of the event context in the track collection with
+  /// the given label, 0 if it is not one of the collections of the filler
+  /// or it was not found in the event
+  const muonid::OppositeTrackFinder* oppositeTrackFinder( const EventContext&, const edm::InputTag& ) const;
+
   /// fill cosmic compatibility variables  
+  reco::MuonCosmicCompatibility fillCompatibility( const reco::Muon& muon, const EventContext&) const;
   reco::MuonCosmicCompatibility fillCompatibility( const reco::Muon& muon,edm::Event&, const edm::EventSetup&);
 
  private:
 
   /// check muon time (DT and CSC) information: 0 == prompt-like 
-  float muonTiming(const edm::Event& iEvent, const reco::Muon& muon, bool isLoose) const;
+  float muonTiming(const EventContext&, const reco::Muon& muon, bool isLoose) const;
 
   ///return cosmic-likeness based on presence of a track in opp side: 0 == no matching opp tracks
-  unsigned int backToBack2LegCosmic(const edm::Event&, const reco::Muon&) const;
+  unsigned int backToBack2LegCosmic(const EventContext&, const reco::Muon&) const;
 
   /// return cosmic-likeness based on the 2D impact parameters (dxy, dz wrt to PV). 0 == cosmic-like
-  unsigned int pvMatches(const edm::Event&, const reco::Muon&, bool) const;
+  unsigned int pvMatches(const EventContext&, const reco::Muon&, bool) const;
 
   /// returns cosmic-likeness based on overlap with traversing cosmic muon (only muon/STA hits are used)
-  bool isOverlappingMuon(const edm::Event&, const edm::EventSetup& iSetup, const reco::Muon&) const;
+  bool isOverlappingMuon(const EventContext&, const reco::Muon&) const;
   
-  /// get number of muons in the vent
-  unsigned int nMuons(const edm::Event&) const;
-
   /// returns cosmic-likeness based on the event activity information: tracker track multiplicity and vertex quality. 0 == cosmic-like
-  unsigned int eventActivity(const edm::Event&, const reco::Muon&) const;
+  unsigned int eventActivity(const EventContext&) const;
 
   /// combined cosmic-likeness: 0 == not cosmic-like
-  float combinedCosmicID(const edm::Event&, const edm::EventSetup& iSetup, const reco::Muon&, bool CheckMuonID, bool checkVertex) const;
+  float combinedCosmicID(const EventContext&, const reco::Muon&, bool CheckMuonID, bool checkVertex) const;
 
   /// tag a muon as cosmic based on the muonID information
   bool checkMuonID( const reco::Muon& ) const;
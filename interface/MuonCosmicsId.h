@@ -10,6 +10,7 @@
 //
 #include "DataFormats/TrackReco/interface/TrackFwd.h"
 #include "DataFormats/Common/interface/Handle.h"
+#include <vector>
 namespace muonid
 {
   // returns angle and dPt/Pt
@@ -20,5 +21,48 @@ namespace muonid
 				   const reco::Track& muon,
 				   double angleMatch = 0.01,
 				   double momentumMatch = 0.05);
+
+  // Index of a track collection for repeated findOppositeTrack queries.
+  // The tracks are binned in the direction they are reconstructed
+  // in (the momentum, flipped for outside going tracks), so that only the
+  // bins around the opposite direction of the muon are checked. Within a
+  // bin the tracks are sorted by pt, so that only the tracks in the pt
+  // window of the momentum match are tested. The angle is tested on the
+  // cosine, acos is only called close to the threshold. The result is the
+  // same as the one of findOppositeTrack.
+  class OppositeTrackFinder
+  {
+  public:
+    OppositeTrackFinder();
+    explicit OppositeTrackFinder(const edm::Handle<reco::TrackCollection>& collection);
+    
+    void setTracks(const edm::Handle<reco::TrackCollection>& collection);
+    
+    reco::TrackRef find(const reco::Track& muon,
+			double angleMatch = 0.01,
+			double momentumMatch = 0.05) const;
+    
+  private:
+    static const unsigned int nCosThetaBins = 32;
+    static const unsigned int nPhiBins = 64;
+    static unsigned int cosThetaBin(double cosTheta);
+    static unsigned int phiBin(double phi);
+    
+    // the track quantities used by matchTracks
+    struct Entry {
+      double px, py, pz, p, pt;
+      bool alongMomentum;
+      unsigned int index;
+      bool operator<(const Entry& other) const {
+	return pt < other.pt || ( pt == other.pt && index < other.index );
+      }
+    };
+    
+    edm::Handle<reco::TrackCollection> tracks_;
+    // the tracks of bin i are in [binBegin_[i], binBegin_[i+1]) of
+    // entries_, in increasing pt
+    std::vector<unsigned int> binBegin_;
+    std::vector<Entry> entries_;
+  };
 }
 #endif
@@ -1,25 +1,39 @@
 // -*- C++ -*-
+#ifndef MuonIdentification_MuonHOAcceptance_h
+#define MuonIdentification_MuonHOAcceptance_h
 #include <vector>
 #include <list>
 #include <stdint.h>
+#include <boost/shared_ptr.hpp>
 #include "FWCore/Framework/interface/EventSetup.h"
+#include "FWCore/Framework/interface/ESWatcher.h"
+#include "CondFormats/DataRecord/interface/HcalChannelQualityRcd.h"
+#include "RecoLocalCalo/HcalRecAlgos/interface/HcalSeverityLevelComputerRcd.h"
 
 class TMultiGraph;
 
-class MuonHOAcceptance {
+// HO acceptance for a given HO channel status. The object is immutable
+// once built, so the same instance can be queried from any thread.
+// MuonHOAcceptance below keeps the static interface of the earlier releases.
+class MuonHOAcceptanceMap {
  public:
-  static bool isChannelDead(uint32_t id);
-  static bool isChannelSiPM(uint32_t id);
+  /// without channel status: no dead or SiPM channels
+  MuonHOAcceptanceMap() : inited(false) { }
+  /// dead and SiPM channels from the HO channel status in the setup
+  explicit MuonHOAcceptanceMap(edm::EventSetup const& eSetup);
+
+  bool isChannelDead(uint32_t id) const;
+  bool isChannelSiPM(uint32_t id) const;
+  /// depends only on the HO geometry
   static bool inGeomAccept(double eta, double phi, double delta_eta = 0.,
 			   double delta_phi = 0.);
-  static bool inNotDeadGeom(double eta, double phi, double delta_eta = 0.,
-			    double delta_phi = 0.);
-  static bool inSiPMGeom(double eta, double phi, double delta_eta = 0.,
-			 double delta_phi = 0.);
-  static void initIds(edm::EventSetup const& eSetup);
-  static bool Inited() { return inited; }
-  static TMultiGraph * graphDeadRegions() { return graphRegions(deadRegions); }
-  static TMultiGraph * graphSiPMRegions() { return graphRegions(SiPMRegions); }
+  bool inNotDeadGeom(double eta, double phi, double delta_eta = 0.,
+		     double delta_phi = 0.) const;
+  bool inSiPMGeom(double eta, double phi, double delta_eta = 0.,
+		  double delta_phi = 0.) const;
+  bool Inited() const { return inited; }
+  TMultiGraph * graphDeadRegions() const { return graphRegions(deadRegions); }
+  TMultiGraph * graphSiPMRegions() const { return graphRegions(SiPMRegions); }
 
  private:
 
@@ -71,18 +85,50 @@ class MuonHOAcceptance {
     void merge (deadIdRegion const& other);
   };
 
-  static void buildDeadAreas();
-  static void buildSiPMAreas();
+  // eta-phi grid of the regions overlapping each cell, so a query only tests
+  // the few regions near the point instead of the full list
+  class RegionGrid {
+  public:
+    void build(std::vector<deadRegion> const& regions);
+    // true if any region passes the test, only the regions in the cells
+    // within (deta,dphi) of the point are tested
+    template <class Test>
+    bool any(std::vector<deadRegion> const& regions, double eta, double phi,
+	     double deta, double dphi, Test const& test) const {
+      int const eHigh = etaBin(eta + deta);
+      int const pLow = phiBin(phi - dphi);
+      int const pHigh = phiBin(phi + dphi);
+      for (int ie = etaBin(eta - deta); ie <= eHigh; ++ie)
+	for (int ip = pLow; ip <= pHigh; ++ip) {
+	  std::vector<unsigned int> const& cell = cells[ie][ip];
+	  for (unsigned int i = 0; i < cell.size(); ++i)
+	    if (test(regions[cell[i]])) return true;
+	}
+      return false;
+    }
+  private:
+    static int const etaBins = 30;
+    static int const phiBins = 72;
+    static int etaBin(double eta);
+    static int phiBin(double phi);
+    std::vector<unsigned int> cells[etaBins][phiBins];
+  };
+
+  void initIds(edm::EventSetup const& eSetup);
+  void buildDeadAreas();
+  void buildSiPMAreas();
   static void mergeRegionLists(std::list<deadIdRegion>& didregions);
   static void convertRegions(std::list<deadIdRegion> const& idregions,
 			     std::vector<deadRegion>& regions);
   static TMultiGraph * graphRegions(std::vector<deadRegion> const& regions);
 
-  static std::vector<uint32_t> deadIds;
-  static std::vector<deadRegion> deadRegions;
-  static std::vector<uint32_t> SiPMIds;
-  static std::vector<deadRegion> SiPMRegions;
-  static bool inited;
+  std::vector<uint32_t> deadIds;
+  std::vector<deadRegion> deadRegions;
+  std::vector<uint32_t> SiPMIds;
+  std::vector<deadRegion> SiPMRegions;
+  RegionGrid deadGrid;
+  RegionGrid SiPMGrid;
+  bool inited;
   static int const etaBounds;
   static double const etaMin[];
   static double const etaMax[];
@@ -93,3 +139,47 @@ class MuonHOAcceptance {
   static double const phiMinR12[];
   static double const phiMaxR12[];
 };
+
+// Keeps a MuonHOAcceptanceMap in sync with the HO channel status; a new
+// acceptance is built only when the channel quality or severity IOV changes.
+// Objects handed out before a rebuild stay valid and unchanged.
+class MuonHOAcceptanceCache {
+ public:
+  boost::shared_ptr<const MuonHOAcceptanceMap> get(edm::EventSetup const& eSetup);
+
+ private:
+  edm::ESWatcher<HcalChannelQualityRcd> qualityWatcher_;
+  edm::ESWatcher<HcalSeverityLevelComputerRcd> severityWatcher_;
+  boost::shared_ptr<const MuonHOAcceptanceMap> acceptance_;
+};
+
+// The static interface of the earlier releases, for the callers outside
+// this package: initIds replaces a process-wide acceptance, which the
+// static queries read. As before, initIds must not run concurrently with
+// the queries; new code should hold a MuonHOAcceptanceMap instead.
+class MuonHOAcceptance {
+ public:
+  static void initIds(edm::EventSetup const& eSetup);
+  static bool Inited() { return current().Inited(); }
+  static bool isChannelDead(uint32_t id) { return current().isChannelDead(id); }
+  static bool isChannelSiPM(uint32_t id) { return current().isChannelSiPM(id); }
+  static bool inGeomAccept(double eta, double phi, double delta_eta = 0.,
+			   double delta_phi = 0.) {
+    return MuonHOAcceptanceMap::inGeomAccept(eta, phi, delta_eta, delta_phi);
+  }
+  static bool inNotDeadGeom(double eta, double phi, double delta_eta = 0.,
+			    double delta_phi = 0.) {
+    return current().inNotDeadGeom(eta, phi, delta_eta, delta_phi);
+  }
+  static bool inSiPMGeom(double eta, double phi, double delta_eta = 0.,
+			 double delta_phi = 0.) {
+    return current().inSiPMGeom(eta, phi, delta_eta, delta_phi);
+  }
+  static TMultiGraph * graphDeadRegions() { return current().graphDeadRegions(); }
+  static TMultiGraph * graphSiPMRegions() { return current().graphSiPMRegions(); }
+
+ private:
+  static MuonHOAcceptanceMap const& current();
+  static boost::shared_ptr<const MuonHOAcceptanceMap> current_;
+};
+#endif
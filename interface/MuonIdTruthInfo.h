@@ -14,16 +14,40 @@
 #include "DataFormats/DetId/interface/DetId.h"
 #include "DataFormats/TrackReco/interface/Track.h"
 #include "SimDataFormats/Track/interface/SimTrack.h"
+#include "SimDataFormats/Track/interface/SimTrackContainer.h"
+#include "SimDataFormats/TrackingHit/interface/PSimHitContainer.h"
 #include "Geometry/CommonDetUnit/interface/GlobalTrackingGeometry.h"
 #include "FWCore/Framework/interface/ESHandle.h"
+#include <map>
+#include <vector>
 
 class MuonIdTruthInfo
 {
  public:
+   /// simulated tracks and muon simhits of an event, the hits are grouped
+   /// by track id in the order of the hit containers
+   struct SimHits {
+      typedef std::map<unsigned int, std::vector<const PSimHit*> > HitsByTrack;
+      edm::Handle<edm::SimTrackContainer> simTracks;
+      edm::Handle<edm::PSimHitContainer> dtSimHits;
+      edm::Handle<edm::PSimHitContainer> cscSimHits;
+      HitsByTrack dtHitsByTrack;
+      HitsByTrack cscHitsByTrack;
+   };
+   
+   /// read the simulation products once for all muons of the event
+   static void fillSimHits( const edm::Event& iEvent, SimHits& simHits );
+   
    static void truthMatchMuon( const edm::Event& iEvent,
 			       const edm::EventSetup& iSetup,
 			       reco::Muon& aMuon);
+   
+   static void truthMatchMuon( const SimHits& simHits,
+			       const edm::EventSetup& iSetup,
+			       reco::Muon& aMuon);
  private:
+   static void groupByTrack( const edm::PSimHitContainer& hits, SimHits::HitsByTrack& hitsByTrack );
+   
    static void checkSimHitForBestMatch(reco::MuonSegmentMatch& segmentMatch,
 				       double& distance,
 				       const PSimHit& hit, 
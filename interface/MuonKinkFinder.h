@@ -30,7 +30,11 @@ class MuonKinkFinder {
         // compute chi2 between track states
         double getChi2(const TrajectoryStateOnSurface &start, const TrajectoryStateOnSurface &other) const ;
 
+        // chi2 of the state difference for one configuration, cov is overwritten
+        template<bool usePosition, bool diagonalOnly>
+        static double kinkChi2(const AlgebraicVector5 &diff, AlgebraicSymMatrix55 &cov) ;
+
         // possibly crop matrix or set to zero off-diagonal elements, then invert
-        void cropAndInvert(AlgebraicSymMatrix55 &cov) const ;
+        static void cropAndInvert(AlgebraicSymMatrix55 &cov, bool usePosition, bool diagonalOnly) ;
 };
 #endif
@@ -11,26 +11,44 @@
 #include "FWCore/ParameterSet/interface/ParameterSet.h"
 #include "DataFormats/MuonReco/interface/Muon.h"
 #include "DataFormats/TrackingRecHit/interface/RecSegment.h"
+#include "DataFormats/MuonDetId/interface/CSCDetId.h"
 
 class CSCGeometry;
 
 class MuonMesh {
 
-  typedef std::map<reco::Muon*,
-                   std::vector<std::pair<reco::Muon*,
-                                         std::pair<reco::MuonChamberMatch*,
-                                                   reco::MuonSegmentMatch*
-                                                  >
-                                        >
-                              >
-                  > MeshType;
-
-  typedef std::vector<std::pair<reco::Muon*,
-                                std::pair<reco::MuonChamberMatch*,
-                                          reco::MuonSegmentMatch*
-                                         >
-                               >
-                     > AssociationType;
+  // a tracker muon segment match in the mesh
+  struct MeshEdge {
+    unsigned int muon; // index into nodes_
+    reco::MuonChamberMatch* chamber;
+    reco::MuonSegmentMatch* segment;
+  };
+
+  // segment match with a valid CSC segment reference, see fillMesh
+  struct CSCSegmentEntry {
+    CSCDetId id;
+    reco::MuonChamberMatch* chamber;
+    reco::MuonSegmentMatch* segment;
+  };
+
+  // global position of a segment in the chamber it was matched in
+  struct SegmentGlobalPosition {
+    double phi, theta, z;
+  };
+
+  // local parameters compared in the ME1/a duplicate test
+  struct SegmentLocalParameters {
+    double x, y, dXdZ, dYdZ, xErr2, yErr2, dXdZErr2, dYdZErr2;
+  };
+
+  // a segment followed by its ME1/a duplicates
+  struct ME1aGroup {
+    bool isME11aDuplicate;
+    std::vector<SegmentLocalParameters> segments;
+  };
+
+  typedef std::map<std::pair<CSCDetId,CSCSegmentRef>, SegmentGlobalPosition> GlobalPositionCache;
+  typedef std::map<CSCSegmentRef, ME1aGroup> ME1aGroupCache;
 
  public:
   
@@ -38,7 +56,13 @@ class MuonMesh {
   
   void runMesh(std::vector<reco::Muon>* p) {fillMesh(p); pruneMesh();}
 
-  void clearMesh() { mesh_.clear(); }
+  // The storage is kept to be reused for the next event. This also drops
+  // the segment caches, so it has to be called before the first use of
+  // the mesh in each event.
+  void clearMesh() { 
+    nodes_.clear(); edgeBegin_.clear(); edges_.clear(); 
+    globalPositions_.clear(); me1aGroups_.clear(); 
+  }
 
   void setCSCGeometry(const CSCGeometry* pg) { geometry_ = pg; } 
 
@@ -54,6 +78,11 @@ class MuonMesh {
 
   void pruneMesh();
 
+  // cached per event, see clearMesh
+  const SegmentGlobalPosition& globalPosition(const std::pair<CSCDetId,CSCSegmentRef>&) const;
+  const ME1aGroup& me1aGroup(const CSCSegmentRef&) const;
+  static bool sameLocalParameters(const SegmentLocalParameters&, const SegmentLocalParameters&);
+
   
   // implement to remove cases where two segments in the same
   // chamber overlap within 2 sigma of ALL of their errors
@@ -64,7 +93,20 @@ class MuonMesh {
   
   
 
-  MeshType mesh_;
+  // Mesh in compressed sparse row layout: the edges of node i are
+  // edges_[edgeBegin_[i]] ... edges_[edgeBegin_[i+1]-1]. Nodes are the
+  // tracker muons in collection order.
+  std::vector<reco::Muon*> nodes_;
+  std::vector<unsigned int> edgeBegin_;
+  std::vector<MeshEdge> edges_;
+
+  // per node CSC segment matches, filled in fillMesh
+  std::vector<std::vector<CSCSegmentEntry> > cscSegments_;
+  std::vector<char> edgeAdded_;
+
+  // the same segments are compared many times within an event
+  mutable GlobalPositionCache globalPositions_;
+  mutable ME1aGroupCache me1aGroups_;
 
   // geometry cache for segment arbitration
    const CSCGeometry* geometry_;
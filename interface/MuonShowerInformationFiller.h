@@ -15,6 +15,9 @@
 #define MuonIdentification_MuonShowerInformationFiller_h
 
 #include <vector>
+#include <map>
+#include <algorithm>
+#include <utility>
 
 #include "FWCore/Framework/interface/Frameworkfwd.h"
 #include "DataFormats/Common/interface/ValueMap.h"
@@ -24,6 +27,8 @@
 #include "DataFormats/Common/interface/Handle.h"
 #include "DataFormats/Math/interface/deltaPhi.h"
 #include "DataFormats/Math/interface/deltaR.h"
+#include "DataFormats/GeometryVector/interface/Phi.h"
+#include "DataFormats/GeometryVector/interface/Theta.h"
 #include "DataFormats/CSCRecHit/interface/CSCRecHit2DCollection.h"
 #include "DataFormats/DTRecHit/interface/DTRecHitCollection.h"
 #include "DataFormats/DTRecHit/interface/DTRecSegment4DCollection.h"
@@ -74,14 +79,22 @@ class MuonShowerInformationFiller {
     /// fill muon shower variables  
     reco::MuonShower fillShowerInformation( const reco::Muon& muon, const edm::Event&, const edm::EventSetup&);
 
+    /// fill the shower variables of all muons of an event, the rechits of a
+    /// chamber are built only once for all the muons crossing it; if selected
+    /// is given, the muons flagged false get an empty shower
+    void fillShowerInformation( const reco::MuonCollection& muons, std::vector<reco::MuonShower>& showers,
+                                const edm::Event&, const edm::EventSetup&,
+                                const std::vector<bool>* selected = 0 );
+
     /// pass the Event to the algorithm at each event
     virtual void setEvent(const edm::Event&);
 
     /// set the services needed
     void setServices(const edm::EventSetup&);
 
-    //set the data members
-    void fillHitsByStation(const reco::Muon&);
+    /// fill the station variables of the shower of the muon; the filler
+    /// keeps no state of the muon, only the rechits cached for the event
+    void fillHitsByStation(const reco::Muon&, reco::MuonShower&);
 
   protected:
 
@@ -89,24 +102,53 @@ class MuonShowerInformationFiller {
 
   private:
 
-    std::vector<float> theStationShowerDeltaR;
-    std::vector<float> theStationShowerTSize;
-    std::vector<int>   theAllStationHits;
-    std::vector<int>   theCorrelatedStationHits;
-
     MuonServiceProxy* theService;
 
+    /// muon rechit with the global quantities used by the clustering
+    struct ShowerHit {
+      explicit ShowerHit(const TransientTrackingRecHit& hit) :
+        position(hit.globalPosition()), phi(position.phi()), theta(position.theta()),
+        perp(position.perp()), mag(position.mag()), valid(hit.isValid()) {}
+      GlobalPoint position;
+      Geom::Phi<float> phi;
+      Geom::Theta<float> theta;
+      float perp;
+      float mag;
+      bool valid;
+    };
+
+    /// all rechits and the rechits from segments of a GeomDet
+    struct DetHits {
+      std::vector<ShowerHit> hits;
+      std::vector<ShowerHit> correlatedHits;
+    };
+
+    const DetHits& detHits(const GeomDet*);
+    void fillShower(const reco::Muon&, reco::MuonShower&);
+
     GlobalPoint crossingPoint(const GlobalPoint&, const GlobalPoint&, const BarrelDetLayer* ) const;
     GlobalPoint crossingPoint(const GlobalPoint&, const GlobalPoint&, const Cylinder& ) const;
     GlobalPoint crossingPoint(const GlobalPoint&, const GlobalPoint&, const ForwardDetLayer* ) const;
     GlobalPoint crossingPoint(const GlobalPoint&, const GlobalPoint&, const Disk& ) const;
-    std::vector<const GeomDet*> dtPositionToDets(const GlobalPoint&) const;
-    std::vector<const GeomDet*> cscPositionToDets(const GlobalPoint&) const;
-    MuonRecHitContainer findPerpCluster(MuonRecHitContainer& muonRecHits) const;
-    MuonRecHitContainer findPhiCluster(MuonRecHitContainer&, const GlobalPoint&) const;
-    TransientTrackingRecHit::ConstRecHitContainer findThetaCluster(TransientTrackingRecHit::ConstRecHitContainer&, const GlobalPoint&) const;
+    GlobalPoint barrelCrossingPoint(const GlobalPoint&, const GlobalPoint&, float radius) const;
+    GlobalPoint diskCrossingPoint(const GlobalPoint&, const GlobalPoint&, float diskZ) const;
+    static float diskCrossingZ(const Disk&);
+    /// the GeomDets are appended to the vector
+    void dtPositionToDets(const GlobalPoint&, std::vector<const GeomDet*>&) const;
+    void cscPositionToDets(const GlobalPoint&, std::vector<const GeomDet*>&) const;
+    std::vector<ShowerHit> findPerpCluster(std::vector<ShowerHit>& muonRecHits) const;
+    std::vector<ShowerHit> findPhiCluster(std::vector<ShowerHit>&, const ShowerHit&) const;
+    std::vector<ShowerHit> findThetaCluster(std::vector<ShowerHit>&, const ShowerHit&) const;
     TransientTrackingRecHit::ConstRecHitContainer hitsFromSegments(const GeomDet*,edm::Handle<DTRecSegment4DCollection>, edm::Handle<CSCSegmentCollection>) const;
-    std::vector<const GeomDet*> getCompatibleDets(const reco::Track&) const;
+    void getCompatibleDets(const reco::Track&, std::vector<const GeomDet*>&) const;
+    void fillLayerCache();
+
+    static unsigned int dtChamberIndex(int wheel, int station, int sector) {
+      return ((wheel+2)*4 + station-1)*14 + sector-1;
+    }
+    static unsigned int cscLayerIndex(int endcap, int station, int ring, int chamber, int layer) {
+      return ((((endcap-1)*4 + station-1)*3 + ring-1)*36 + chamber-1)*6 + layer-1;
+    }
 
    struct LessMag {
        LessMag(const GlobalPoint& point) : thePoint(point) {}
@@ -114,71 +156,73 @@ class MuonShowerInformationFiller {
                        const GlobalPoint& rhs) const{ 
             return (lhs - thePoint).mag() < (rhs -thePoint).mag();
         }
-        bool operator()(const MuonTransientTrackingRecHit::MuonRecHitPointer& lhs,
-                       const MuonTransientTrackingRecHit::MuonRecHitPointer& rhs) const{
-           return (lhs->globalPosition() - thePoint).mag() < (rhs->globalPosition() -thePoint).mag();
-        }
       GlobalPoint thePoint;
    };
 
-   struct LessDPhi {
-        LessDPhi(const GlobalPoint& point) : thePoint(point) {}
-        bool operator()(const MuonTransientTrackingRecHit::MuonRecHitPointer& lhs,
-                       const MuonTransientTrackingRecHit::MuonRecHitPointer& rhs) const{
-           return deltaPhi(lhs->globalPosition().phi(), thePoint.phi()) < deltaPhi(rhs->globalPosition().phi(), thePoint.phi());
-        }
-      GlobalPoint thePoint;
-    };
+   // sort keys of the hit clustering, evaluated once per hit by sortByKey
 
-    struct AbsLessDPhi {
-        AbsLessDPhi(const GlobalPoint& point) : thePoint(point) {}
-        bool operator()(const MuonTransientTrackingRecHit::MuonRecHitPointer& lhs,
-                       const MuonTransientTrackingRecHit::MuonRecHitPointer& rhs) const{
-           return ( fabs(deltaPhi(lhs->globalPosition().phi(), thePoint.phi())) < fabs(deltaPhi(rhs->globalPosition().phi(), thePoint.phi())) );
+   struct AbsDPhiKey {
+        AbsDPhiKey(const ShowerHit& point) : thePhi(point.phi) {}
+        float operator()(const ShowerHit& hit) const{
+           return fabs(deltaPhi((float)hit.phi, thePhi));
         }
-      GlobalPoint thePoint;
+      float thePhi;
     };
 
-    struct AbsLessDTheta {
-        AbsLessDTheta(const GlobalPoint& point) : thePoint(point) {}
-        bool operator()(const TransientTrackingRecHit::ConstRecHitPointer& lhs,
-                       const TransientTrackingRecHit::ConstRecHitPointer& rhs) const{
-           return ( fabs(lhs->globalPosition().phi() - thePoint.phi()) < fabs(rhs->globalPosition().phi() - thePoint.phi()) );
+    struct AbsDThetaKey {
+        AbsDThetaKey(const ShowerHit& point) : thePhi(point.phi) {}
+        float operator()(const ShowerHit& hit) const{
+           return fabs(hit.phi - thePhi);
         }
-      GlobalPoint thePoint;
+      Geom::Phi<float> thePhi;
     };
 
-    struct LessPhi {
-        LessPhi() : thePoint(0,0,0) {}
-        bool operator()(const MuonTransientTrackingRecHit::MuonRecHitPointer& lhs,
-                       const MuonTransientTrackingRecHit::MuonRecHitPointer& rhs) const{
-           return (lhs->globalPosition().phi() < rhs->globalPosition().phi());
-        }
-        GlobalPoint thePoint;
+    struct PhiKey {
+        float operator()(const ShowerHit& hit) const{ return hit.phi; }
     };
 
-    struct LessPerp {
-        LessPerp() : thePoint(0,0,0) {}
-        bool operator()(const MuonTransientTrackingRecHit::MuonRecHitPointer& lhs,
-                       const MuonTransientTrackingRecHit::MuonRecHitPointer& rhs) const{
-           return (lhs->globalPosition().perp() < rhs->globalPosition().perp());
-        }
-      GlobalPoint thePoint;
+    struct PerpKey {
+        float operator()(const ShowerHit& hit) const{ return hit.perp; }
     };
 
-    struct LessAbsMag {
-        LessAbsMag() : thePoint(0,0,0) {}
-        bool operator()(const MuonTransientTrackingRecHit::MuonRecHitPointer& lhs,
-                       const MuonTransientTrackingRecHit::MuonRecHitPointer& rhs) const{
-           return (lhs->globalPosition().mag() < rhs->globalPosition().mag());
-        }
-      GlobalPoint thePoint;
+    struct MagKey {
+        float operator()(const ShowerHit& hit) const{ return hit.mag; }
     };
 
+    /// stable sort of the hits by a key computed once per hit
+    template <class Key>
+    void sortByKey(std::vector<ShowerHit>& hits, const Key& key) const {
+      theSortKeys.resize(hits.size());
+      for (unsigned int i = 0; i < hits.size(); ++i) theSortKeys[i] = std::make_pair(key(hits[i]), i);
+      // ties are ordered by the original position, as in a stable sort
+      std::sort(theSortKeys.begin(), theSortKeys.end());
+      theSortBuffer.clear();
+      theSortBuffer.reserve(hits.size());
+      for (unsigned int i = 0; i < theSortKeys.size(); ++i) theSortBuffer.push_back(hits[theSortKeys[i].second]);
+      // copied back in place: the callers iterate over the hits while they are resorted
+      std::copy(theSortBuffer.begin(), theSortBuffer.end(), hits.begin());
+    }
+
+    mutable std::vector<std::pair<float, unsigned int> > theSortKeys;
+    mutable std::vector<ShowerHit> theSortBuffer;
+
     std::string category_;
 
     unsigned long long theCacheId_TRH;
     unsigned long long theCacheId_MT;
+    unsigned long long theCacheId_DLG;
+    unsigned long long theCacheId_GTG;
+
+    // DT layer radii, CSC layer z and the chambers by index, per IOV
+    std::vector<float> theDTLayerRadii;
+    std::vector<float> theCSCLayerZ;
+    std::vector<const GeomDet*> theDTChambers;
+    std::vector<const GeomDet*> theCSCLayers;
+
+    // buffers of getCompatibleDets, reused across muons
+    std::vector<const GeomDet*> theCompatibleDets;
+    mutable std::vector<GlobalPoint> theCrossingPoints;
+    mutable std::vector<int> theSectors;
 
     std::string theTrackerRecHitBuilderName;
     edm::ESHandle<TransientTrackingRecHitBuilder> theTrackerRecHitBuilder;
@@ -195,6 +239,12 @@ class MuonShowerInformationFiller {
     edm::Handle<CSCSegmentCollection> theCSCSegments;
     edm::Handle<DTRecSegment4DCollection> theDT4DRecSegments;
 
+    // hits of the GeomDets requested in this event, by DetId
+    std::map<uint32_t, DetHits> theDetHits;
+
+    // chambers of the CSC segments in this event, by chamber number
+    std::vector<std::vector<CSCDetId> > theCSCSegmentChambers;
+
     // geometry
     edm::ESHandle<GeometricSearchTracker> theTracker;
     edm::ESHandle<GlobalTrackingGeometry> theTrackingGeometry;
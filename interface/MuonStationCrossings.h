@@ -0,0 +1,71 @@
+#ifndef MuonIdentification_MuonStationCrossings_h
+#define MuonIdentification_MuonStationCrossings_h
+//
+// Fast prediction of the muon stations crossed by a set of tracks. All
+// tracks of an event are propagated together, one array per component of
+// the state, with fixed steps of a helix in a parameterized field: 3.8 T in
+// the solenoid, the return field in the barrel yoke and no field outside.
+// The energy loss is a lower bound of the minimum ionizing loss in the
+// calorimeters, so that the reach of the tracks is overestimated rather
+// than underestimated. The stations are approximate cylinders (DT) and
+// disks (CSC).
+//
+// It decides for which tracks the muon system association can be skipped:
+// the tracks that stay away from the first stations by a margin. Tracks
+// which get close to a station or are still curling at the end of the
+// path are uncertain and are left to the general propagator.
+//
+// An object holds the propagation of one set of tracks, it is made per
+// event from the Parameters kept by the producer.
+//
+
+#include <vector>
+#include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "DataFormats/TrackReco/interface/Track.h"
+
+class MuonStationCrossings {
+ public:
+   struct Parameters {
+      Parameters();
+      explicit Parameters(const edm::ParameterSet&);
+      double stepSize;
+      double maxPathLength;
+      double margin;
+      double minMomentum;
+   };
+
+   explicit MuonStationCrossings(const Parameters& parameters) : parameters_(parameters) {}
+
+   /// propagate the tracks from their reference point
+   void propagate( const std::vector<const reco::Track*>& tracks );
+
+   /// bits of the stations crossed by track i, see stationBit
+   unsigned int stations( unsigned int i ) const { return stations_[i]; }
+   /// the prediction of track i is too close to call
+   bool uncertain( unsigned int i ) const { return uncertain_[i]; }
+   /// track i certainly does not reach the muon stations
+   bool missesMuonSystem( unsigned int i ) const { return stations_[i] == 0 && ! uncertain_[i]; }
+
+   /// bit of a station, detector is MuonSubdetId::DT or CSC, station 1-4
+   static unsigned int stationBit( int detector, int station );
+
+ private:
+   static const unsigned int nStations = 4;
+   // cm
+   static const double barrelRadius[nStations];
+   static const double barrelHalfLength;
+   static const double endcapZ[nStations];
+   static const double endcapInnerRadius[nStations];
+   static const double endcapOuterRadius;
+
+   Parameters parameters_;
+
+   // the state of the tracks
+   std::vector<double> x_, y_, z_, px_, py_, pz_, p_, charge_;
+   std::vector<char> active_;
+   // the largest radius and |z| reached
+   std::vector<double> maxR_, maxAbsZ_;
+   std::vector<unsigned int> stations_;
+   std::vector<char> uncertain_;
+};
+#endif
@@ -0,0 +1,50 @@
+#ifndef MuonIdentification_MuonSystemOccupancy_h
+#define MuonIdentification_MuonSystemOccupancy_h
+//
+// Coarse eta-phi map of the muon system occupancy of an event, built from
+// the DT and CSC segments and the RPC hits. It is used to skip the muon
+// system association of tracks whose road does not contain any of them.
+// The road is centered at the track direction at the vertex and is wide
+// enough in phi to contain the bending up to the outer muon stations.
+//
+
+#include <vector>
+#include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "FWCore/Framework/interface/Event.h"
+#include "FWCore/Framework/interface/EventSetup.h"
+#include "FWCore/Utilities/interface/InputTag.h"
+#include "DataFormats/Common/interface/Handle.h"
+#include "DataFormats/RPCRecHit/interface/RPCRecHitCollection.h"
+#include "DataFormats/TrackReco/interface/Track.h"
+
+class MuonSystemOccupancy {
+ public:
+   MuonSystemOccupancy();
+   explicit MuonSystemOccupancy(const edm::ParameterSet&);
+
+   /// fill the map of the event, the map accepts all tracks if one of the
+   /// collections is missing
+   void fill( const edm::Event&, const edm::EventSetup&,
+	      const edm::InputTag& dtSegments, const edm::InputTag& cscSegments,
+	      const edm::Handle<RPCRecHitCollection>& rpcHits );
+
+   /// true if an occupied bin is in the road of the track
+   bool inRoad( const reco::Track& ) const;
+
+ private:
+   static const int nEtaBins = 60;
+   static const int nPhiBins = 72;
+   static const double maxEta;
+   static int etaBin( double eta );
+   static int phiBin( double phi );
+   void add( double eta, double phi ) { occupied_[etaBin(eta)*nPhiBins + phiBin(phi)] = true; }
+
+   // road: |deta| < etaRoad_, |dphi| < phiRoadPt_/pt + phiRoad_
+   double etaRoad_;
+   double phiRoad_;
+   double phiRoadPt_;
+   
+   bool acceptAll_;
+   std::vector<bool> occupied_;
+};
+#endif
@@ -33,6 +33,7 @@
 #include "FWCore/ParameterSet/interface/ParameterSet.h"
 
 #include "DataFormats/MuonReco/interface/MuonTimeExtra.h"
+#include "DataFormats/MuonReco/interface/MuonFwd.h"
 #include "RecoMuon/MuonIdentification/interface/DTTimingExtractor.h"
 #include "RecoMuon/MuonIdentification/interface/CSCTimingExtractor.h"
 
@@ -44,14 +45,23 @@ class MuonTimingFiller {
    public:
       MuonTimingFiller(const edm::ParameterSet&);
       ~MuonTimingFiller();
+      /// cache the per-event setup of the extractors; fillTiming refreshes it
+      /// too, but only fetches the products again if their records changed
+      void beginEvent( const edm::Event& iEvent, const edm::EventSetup& iSetup );
       void fillTiming( const reco::Muon& muon, reco::MuonTimeExtra& dtTime, 
                     reco::MuonTimeExtra& cscTime, reco::MuonTimeExtra& combinedTime, 
                     edm::Event& iEvent, const edm::EventSetup& iSetup );
+      /// timing of all muons of the collection, beginEvent is called internally;
+      /// the output vectors are resized to the number of muons
+      void fillTiming( const reco::MuonCollection& muons, std::vector<reco::MuonTimeExtra>& dtTimes, 
+                    std::vector<reco::MuonTimeExtra>& cscTimes, std::vector<reco::MuonTimeExtra>& combinedTimes, 
+                    edm::Event& iEvent, const edm::EventSetup& iSetup );
 
    private:
+      /// the best matched segment in each DT and CSC chamber of the muon
+      void matchedSegments( const reco::Muon& muon, std::vector<const DTRecSegment4D*>& dtSegments, 
+                            std::vector<const CSCSegment*>& cscSegments );
       void fillTimeFromMeasurements( const TimeMeasurementSequence& tmSeq, reco::MuonTimeExtra &muTime );
-      void rawFit(double &a, double &da, double &b, double &db, 
-                  const std::vector<double>& hitsx, const std::vector<double>& hitsy);
       void addEcalTime( const reco::Muon& muon, TimeMeasurementSequence &cmbSeq );
       void combineTMSequences( const reco::Muon& muon, const TimeMeasurementSequence& dtSeq, 
                                const TimeMeasurementSequence& cscSeq, TimeMeasurementSequence &cmbSeq );
@@ -60,6 +70,12 @@ class MuonTimingFiller {
       CSCTimingExtractor* theCSCTimingExtractor_;
       double errorEB_,errorEE_,ecalEcut_;
       bool useDT_, useCSC_, useECAL_;
+      bool useSegmentsFromMatches_;
+
+      // per muon work buffers, kept to reuse their storage
+      TimeMeasurementSequence dtTmSeq_, cscTmSeq_, combinedTmSeq_;
+      std::vector<const DTRecSegment4D*> dtSegments_;
+      std::vector<const CSCSegment*> cscSegments_;
 
 };
 
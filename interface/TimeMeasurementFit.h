@@ -0,0 +1,91 @@
+#ifndef MuonIdentification_TimeMeasurementFit_h
+#define MuonIdentification_TimeMeasurementFit_h
+
+/** \class TimeMeasurementFit TimeMeasurementFit.h RecoMuon/MuonIdentification/interface/TimeMeasurementFit.h
+ *
+ * Accumulators of the sums used by the straight line fits of the muon timing.
+ * Points are added one at a time and the fit is solved from the sums, so the
+ * callers do not need to keep the points in separate arrays. The sums are
+ * accumulated in the order the points are added, which keeps the results
+ * identical to the former loops over the point vectors.
+ *
+ */
+
+#include <cmath>
+
+/// least squares fit of y = a*x + b with equal weights
+class LinearFitSums {
+   public:
+      LinearFitSums() { clear(); }
+      void clear() { n=0; s=sx=sy=sxx=sxy=0; y0=0; }
+      void add( double x, double y ) {
+	 if (n==0) y0=y;
+	 ++n;
+	 sy += y;
+	 sxy+= x*y;
+	 s += 1.;
+	 sx += x;
+	 sxx += x*x;
+      }
+      unsigned int size() const { return n; }
+      /// a is the slope and b the intercept, the errors are not set for less than two points
+      void fit( double &a, double &da, double &b, double &db ) const {
+	 a=b=0;
+	 if (n==0) return;
+	 if (n==1) {
+	    b=y0;
+	    return;
+	 }
+	 double d = s*sxx - sx*sx;
+	 b = (sxx*sy- sx*sxy)/ d;
+	 a = (s*sxy - sx*sy) / d;
+	 da = std::sqrt(sxx/d);
+	 db = std::sqrt(s/d);
+      }
+   private:
+      unsigned int n;
+      double s,sx,sy,sxx,sxy,y0;
+};
+
+/// fit of the DT hits of a segment with a common t0 shifting the left and
+/// right hits in opposite directions
+class DTT0FitSums {
+   public:
+      DTT0FitSums() { clear(); }
+      void clear() { sx=sy=sxy=sxx=ssx=ssy=s=ss=0; }
+      void addLeft( double x, double y ) {
+	 sx+=x;
+	 sy+=y;
+	 sxy+=x*y;
+	 sxx+=x*x;
+	 s++;
+	 ssx+=x;
+	 ssy+=y;
+	 ss++;
+      }
+      void addRight( double x, double y ) {
+	 sx+=x;
+	 sy+=y;
+	 sxy+=x*y;
+	 sxx+=x*x;
+	 s++;
+	 ssx-=x;
+	 ssy-=y;
+	 ss--;
+      }
+      /// returns the t0 correction in drift distance units, zero if the fit is singular
+      double fit( double &a, double &b ) const {
+	 double delta = ss*ss*sxx+s*sx*sx+s*ssx*ssx-s*s*sxx-2*ss*sx*ssx;
+	 double t0_corr=0.;
+	 if (delta) {
+	    a=(ssy*s*ssx+sxy*ss*ss+sy*sx*s-sy*ss*ssx-ssy*sx*ss-sxy*s*s)/delta;
+	    b=(ssx*sy*ssx+sxx*ssy*ss+sx*sxy*s-sxx*sy*s-ssx*sxy*ss-sx*ssy*ssx)/delta;
+	    t0_corr=(ssx*s*sxy+sxx*ss*sy+sx*sx*ssy-sxx*s*ssy-sx*ss*sxy-ssx*sx*sy)/delta;
+	 }
+	 return t0_corr;
+      }
+   private:
+      double sx,sy,sxy,sxx,ssx,ssy,s,ss;
+};
+
+#endif
@@ -11,6 +11,8 @@
  *
  */
 
+#include <vector>
+
 class TimeMeasurementSequence {
 
     public:
@@ -28,6 +30,31 @@ class TimeMeasurementSequence {
 	totalWeightVertex(0)
 	 {}
 
+      /// remove all measurements, the allocated storage is kept for reuse
+      void clear() {
+	dstnc.clear();
+	local_t0.clear();
+	weightVertex.clear();
+	weightInvbeta.clear();
+	totalWeightInvbeta=0;
+	totalWeightVertex=0;
+      }
+
+      void reserve(unsigned int n) {
+	dstnc.reserve(n);
+	local_t0.reserve(n);
+	weightVertex.reserve(n);
+	weightInvbeta.reserve(n);
+      }
+
+      /// append one measurement, the total weights are not updated
+      void push_back(double dist, double t0, double wVertex, double wInvbeta) {
+	dstnc.push_back(dist);
+	local_t0.push_back(t0);
+	weightVertex.push_back(wVertex);
+	weightInvbeta.push_back(wInvbeta);
+      }
+
 };
 
 
@@ -67,7 +67,7 @@ CaloMuonMerger::produce(edm::Event & iEvent, const edm::EventSetup & iSetup) {
     if(mergeTracks_) iEvent.getByLabel(tracks_, tracks);
 
     std::auto_ptr<std::vector<reco::Muon> >  out(new std::vector<reco::Muon>());
-    out->reserve(muons->size() + (mergeTracks_?tracks->size():0));
+    out->reserve(muons->size() + (mergeCaloMuons_?caloMuons->size():0) + (mergeTracks_?tracks->size():0));
 
     // copy reco::Muons, turning on the CaloCompatibility flag if enabled and possible
     for (std::vector<reco::Muon>::const_iterator it = muons->begin(), ed = muons->end(); it != ed; ++it) {
@@ -103,28 +103,24 @@ CaloMuonMerger::produce(edm::Event & iEvent, const edm::EventSetup & iSetup) {
 
     // merge reco::Track avoiding duplication of innerTracks
     if(mergeTracks_){
+        // flag the tracks already used as inner track of a muon or calomuon;
+        // only refs into the same track collection can match
+        std::vector<bool> isMuonTrack(tracks->size(), false);
+        for(std::vector<reco::Muon>::const_iterator muon = muons->begin(); muon < muons->end(); muon++){
+            const reco::TrackRef & inner = muon->innerTrack();
+            if(inner.id() == tracks.id() && inner.key() < isMuonTrack.size()) isMuonTrack[inner.key()] = true;
+        }
+        if (mergeCaloMuons_) {
+            for(std::vector<reco::CaloMuon>::const_iterator muon = caloMuons->begin(); muon < caloMuons->end(); muon++){
+                reco::TrackRef inner = muon->innerTrack();
+                if(inner.id() == tracks.id() && inner.key() < isMuonTrack.size()) isMuonTrack[inner.key()] = true;
+            }
+        }
         for (size_t i = 0; i < tracks->size(); i++) {
+            // check if it is a muon or calomuon
+            if(isMuonTrack[i]) continue;
             reco::TrackRef track(tracks, i);
             if(!tracksCut_(track)) continue;
-            // check if it is a muon or calomuon
-            bool isMuon = false;
-            for(std::vector<reco::Muon>::const_iterator muon = muons->begin(); muon < muons->end(); muon++){
-                if(muon->innerTrack() == track){
-                    isMuon = true;
-                    break;
-                }
-            }
-            if(isMuon) continue;
-            if (mergeCaloMuons_) {
-                bool isCaloMuon = false;
-                for(std::vector<reco::CaloMuon>::const_iterator muon = caloMuons->begin(); muon < caloMuons->end(); muon++){
-                    if(muon->innerTrack() == track){
-                        isCaloMuon = true;
-                        break;
-                    }
-                }
-                if(isCaloMuon) continue;
-            }
             // make a reco::Muon
             double energy = sqrt(track->p() * track->p() + 0.011163691);
             math::XYZTLorentzVector p4(track->px(), track->py(), track->pz(), energy);
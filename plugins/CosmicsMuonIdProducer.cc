@@ -15,6 +15,7 @@
 #include "FWCore/ParameterSet/interface/ParameterSet.h"
 
 #include "RecoMuon/MuonIdentification/interface/MuonCosmicCompatibilityFiller.h"
+#include "RecoMuon/MuonIdentification/plugins/MuonFillerPreselection.h"
 
 class CosmicsMuonIdProducer : public edm::EDProducer {
 public:
@@ -23,6 +24,7 @@ public:
     inputTrackCollections_(iConfig.getParameter<std::vector<edm::InputTag> >("trackCollections")),
     compatibilityFiller_(iConfig.getParameter<edm::ParameterSet>("CosmicCompFillerParameters"))
   {
+    preselection_.configure(iConfig, "preselection");
     produces<edm::ValueMap<unsigned int> >().setBranchAlias("cosmicsVeto");
     produces<edm::ValueMap<reco::MuonCosmicCompatibility> >().setBranchAlias("cosmicCompatibility");
   }
@@ -30,9 +32,12 @@ public:
 
 private:
   virtual void produce(edm::Event&, const edm::EventSetup&);
+  virtual void endJob() { preselection_.report("CosmicsMuonIdProducer"); }
   edm::InputTag inputMuonCollection_;
   std::vector<edm::InputTag> inputTrackCollections_;
   MuonCosmicCompatibilityFiller compatibilityFiller_;
+  // muons failing the cut get no partner and an empty compatibility
+  MuonFillerPreselection preselection_;
 };
 
 void
@@ -46,17 +51,42 @@ CosmicsMuonIdProducer::produce(edm::Event& iEvent, const edm::EventSetup& iSetup
 
   std::vector<reco::MuonCosmicCompatibility> compValues;
   compValues.reserve(muons->size());
+
+  // the event products are read once for all the muons
+  std::vector<edm::Handle<reco::TrackCollection> > tracks(inputTrackCollections_.size());
+  // the back-to-back search of the filler is shared for the collections it
+  // also reads, the other ones are indexed here
+  std::vector<const muonid::OppositeTrackFinder*> oppositeTrackFinders(inputTrackCollections_.size(), 0);
+  std::vector<muonid::OppositeTrackFinder> ownTrackFinders(inputTrackCollections_.size());
+  MuonCosmicCompatibilityFiller::EventContext context;
+  if ( !muons->empty() ) {
+    compatibilityFiller_.fillEventContext(context, iEvent, iSetup);
+    for ( unsigned int i=0; i<inputTrackCollections_.size(); ++i ) {
+      iEvent.getByLabel(inputTrackCollections_.at(i), tracks[i]);
+      if ( ! tracks[i].isValid() ) continue;
+      oppositeTrackFinders[i] = compatibilityFiller_.oppositeTrackFinder(context, inputTrackCollections_.at(i));
+      if ( oppositeTrackFinders[i] ) continue;
+      ownTrackFinders[i].setTracks(tracks[i]);
+      oppositeTrackFinders[i] = &ownTrackFinders[i];
+    }
+  }
   
   for(reco::MuonCollection::const_iterator muon = muons->begin(); 
       muon != muons->end(); ++muon)
     {
+      if ( ! preselection_(*muon) ) {
+	values.push_back(0);
+	compValues.push_back(reco::MuonCosmicCompatibility());
+	continue;
+      }
       unsigned int foundPartner(0);
       if ( muon->innerTrack().isNonnull() ){
 	for ( unsigned int i=0; i<inputTrackCollections_.size(); ++i )
 	  {
-	    edm::Handle<reco::TrackCollection> tracks;
-	    iEvent.getByLabel(inputTrackCollections_.at(i), tracks);
-	    if ( muonid::findOppositeTrack(tracks,*muon->innerTrack()).isNonnull() ){
+	    // a missing collection fails in findOppositeTrack as it used to
+	    reco::TrackRef partner = oppositeTrackFinders[i] ? oppositeTrackFinders[i]->find(*muon->innerTrack()) :
+	      muonid::findOppositeTrack(tracks[i],*muon->innerTrack());
+	    if ( partner.isNonnull() ){
 	      foundPartner = i+1;
 	      break;
 	    }
@@ -64,7 +94,7 @@ CosmicsMuonIdProducer::produce(edm::Event& iEvent, const edm::EventSetup& iSetup
       }
       values.push_back(foundPartner);
 
-      compValues.push_back(compatibilityFiller_.fillCompatibility(*muon, iEvent, iSetup));
+      compValues.push_back(compatibilityFiller_.fillCompatibility(*muon, context));
     }
 
   // create and fill value map
@@ -77,23 +77,33 @@ void GlobalMuonToMuonProducer::produce(edm::Event& event, const edm::EventSetup&
    }
    
 
+   // the rechits are only walked for the debug print-out
+   const bool printRecHits = edm::isDebugEnabled();
+
    // Global Tracking Geometry
    edm::ESHandle<GlobalTrackingGeometry> trackingGeometry; 
-   eventSetup.get<GlobalTrackingGeometryRecord>().get(trackingGeometry); 
+   if(printRecHits)
+     eventSetup.get<GlobalTrackingGeometryRecord>().get(trackingGeometry); 
    
+   // one muon per link, filled in place
+   muonCollection->reserve(linksCollection->size());
+
    for(reco::MuonTrackLinksCollection::const_iterator links = linksCollection->begin();
        links != linksCollection->end(); ++links){
 
      // some temporary print-out
-     LogTrace(metname) << "trackerTrack";
-     printTrackRecHits(*(links->trackerTrack()),trackingGeometry);
-     LogTrace(metname) << "standAloneTrack";
-     printTrackRecHits(*(links->standAloneTrack()),trackingGeometry);
-     LogTrace(metname) << "globalTrack";
-     printTrackRecHits(*(links->globalTrack()),trackingGeometry);
+     if(printRecHits){
+       LogTrace(metname) << "trackerTrack";
+       printTrackRecHits(*(links->trackerTrack()),trackingGeometry);
+       LogTrace(metname) << "standAloneTrack";
+       printTrackRecHits(*(links->standAloneTrack()),trackingGeometry);
+       LogTrace(metname) << "globalTrack";
+       printTrackRecHits(*(links->globalTrack()),trackingGeometry);
+     }
     
      // Fill the muon 
-     reco::Muon muon;
+     muonCollection->push_back(reco::Muon());
+     reco::Muon& muon = muonCollection->back();
      muon.setStandAlone(links->standAloneTrack());
      muon.setTrack(links->trackerTrack());
      muon.setCombined(links->globalTrack());
@@ -110,9 +120,6 @@ void GlobalMuonToMuonProducer::produce(edm::Event& event, const edm::EventSetup&
 
      muon.setP4(p4);
      muon.setVertex(links->globalTrack()->vertex());
-       
-    muonCollection->push_back(muon);
-     
    }
 
    event.put(muonCollection);
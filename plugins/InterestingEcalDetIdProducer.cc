@@ -22,9 +22,14 @@
 #include "DataFormats/MuonReco/interface/Muon.h"
 #include "DataFormats/MuonReco/interface/MuonFwd.h"
 
+#include <algorithm>
+#include <set>
+#include <vector>
+
 InterestingEcalDetIdProducer::InterestingEcalDetIdProducer(const edm::ParameterSet& iConfig) 
 {
   inputCollection_ = iConfig.getParameter< edm::InputTag >("inputCollection");
+  sortedOutput_ = iConfig.existsAs<bool>("sortedOutput") ? iConfig.getParameter<bool>("sortedOutput") : false;
   produces< DetIdCollection >() ;
 }
 
@@ -48,15 +53,29 @@ InterestingEcalDetIdProducer::produce (edm::Event& iEvent,
   
   std::auto_ptr< DetIdCollection > interestingDetIdCollection( new DetIdCollection() ) ;
 
+  // windows of all muons, duplicates are removed at the end
+  std::vector<DetId> windowIds;
+  windowIds.reserve(25*muons->size());
   for(reco::MuonCollection::const_iterator muon = muons->begin(); muon != muons->end(); ++muon){
     if (! muon->isEnergyValid() ) continue;
     if ( muon->calEnergy().ecal_id.rawId()==0 ) continue;
     const CaloSubdetectorTopology* topology = caloTopology_->getSubdetectorTopology(DetId::Ecal,muon->calEnergy().ecal_id.subdetId());
     const std::vector<DetId>& ids = topology->getWindow(muon->calEnergy().ecal_id, 5, 5); 
-    for ( std::vector<DetId>::const_iterator id = ids.begin(); id != ids.end(); ++id )
-      if(std::find(interestingDetIdCollection->begin(), interestingDetIdCollection->end(), *id) 
-	 == interestingDetIdCollection->end()) 
-	interestingDetIdCollection->push_back(*id);
+    windowIds.insert(windowIds.end(), ids.begin(), ids.end());
+  }
+
+  if ( sortedOutput_ ) {
+    std::sort(windowIds.begin(), windowIds.end());
+    windowIds.erase(std::unique(windowIds.begin(), windowIds.end()), windowIds.end());
+    interestingDetIdCollection->reserve(windowIds.size());
+    for ( std::vector<DetId>::const_iterator id = windowIds.begin(); id != windowIds.end(); ++id )
+      interestingDetIdCollection->push_back(*id);
+  } else {
+    // first occurrence order, as the ids used to be added
+    std::set<DetId> knownIds;
+    interestingDetIdCollection->reserve(windowIds.size());
+    for ( std::vector<DetId>::const_iterator id = windowIds.begin(); id != windowIds.end(); ++id )
+      if ( knownIds.insert(*id).second ) interestingDetIdCollection->push_back(*id);
   }
   iEvent.put(interestingDetIdCollection);
 }
@@ -16,6 +16,8 @@ class InterestingEcalDetIdProducer : public edm::EDProducer {
 
  private:
   edm::InputTag inputCollection_;
+  // sorted output instead of the order of the muon windows
+  bool sortedOutput_;
   const CaloTopology* caloTopology_;
 };
 
@@ -0,0 +1,113 @@
+#ifndef MuonIdentification_MuonAssociationCache_h
+#define MuonIdentification_MuonAssociationCache_h
+
+/** \class MuonAssociationCache
+ *
+ * Results of the track - detector associations of one event, kept so that
+ * the muon identification can be run again with other matching cuts
+ * without propagating the tracks. An association is stored as a muon with
+ * the associated track, the calorimeter energy and the chamber matches with
+ * all the segments found by the associator, before the cuts of the
+ * producer. A parallel vector keeps the code of the association, i.e. the
+ * direction and the detectors included, since the same track can be
+ * associated in more than one way.
+ *
+ */
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "FWCore/Framework/interface/Event.h"
+#include "FWCore/Utilities/interface/InputTag.h"
+#include "FWCore/Utilities/interface/Exception.h"
+#include "DataFormats/Common/interface/Handle.h"
+#include "DataFormats/MuonReco/interface/Muon.h"
+#include "DataFormats/MuonReco/interface/MuonFwd.h"
+#include "DataFormats/TrackReco/interface/Track.h"
+#include "TrackingTools/TrackAssociator/interface/TrackDetectorAssociator.h"
+
+class MuonAssociationCache {
+ public:
+   typedef std::pair<std::pair<edm::ProductID, unsigned int>, int> Key;
+
+   MuonAssociationCache() : associations_(0) {}
+
+   /// key of the association of the track of the muon, the inner track if
+   /// there is one
+   static Key key( const reco::Muon& muon, TrackDetectorAssociator::Direction direction,
+		   bool withEnergy, bool withMuonSystem ) {
+      const reco::TrackRef track = muon.innerTrack().isNonnull() ? muon.innerTrack() : muon.outerTrack();
+      return key( track, code(direction, withEnergy, withMuonSystem) );
+   }
+
+   /// read the associations written by a previous job
+   void read( const edm::Event& iEvent, const edm::InputTag& tag ) {
+      edm::Handle<reco::MuonCollection> associations;
+      edm::Handle<std::vector<int> > codes;
+      iEvent.getByLabel(tag, associations);
+      iEvent.getByLabel(tag, codes);
+      if ( ! associations.isValid() || ! codes.isValid() || associations->size() != codes->size() )
+	throw cms::Exception("FatalError") << "Failed to get the muon association cache with label: " << tag;
+      associations_ = associations.product();
+      for ( unsigned int i = 0; i < associations_->size(); ++i ) {
+	 const reco::Muon& association = associations_->at(i);
+	 const reco::TrackRef track = association.innerTrack().isNonnull() ? association.innerTrack() : association.outerTrack();
+	 index_.insert( std::make_pair(key(track, codes->at(i)), i) );
+      }
+   }
+
+   /// start a new cache to be written at the end of the event
+   void startWriting() {
+      newAssociations_.reset( new reco::MuonCollection );
+      newCodes_.reset( new std::vector<int> );
+   }
+
+   bool reading() const { return associations_ != 0; }
+   bool writing() const { return newAssociations_.get() != 0; }
+
+   /// null if the association is not in the cache
+   const reco::Muon* find( const Key& key ) const {
+      if ( ! associations_ ) return 0;
+      std::map<Key, unsigned int>::const_iterator association = index_.find(key);
+      return association != index_.end() ? &associations_->at(association->second) : 0;
+   }
+
+   /// keep the energy of the muon if it is filled and the matches if given,
+   /// the first association with a key is kept
+   void insert( const Key& key, const reco::Muon& muon, const std::vector<reco::MuonChamberMatch>* matches ) {
+      if ( ! writing() ) return;
+      if ( ! index_.insert( std::make_pair(key, newAssociations_->size()) ).second ) return;
+      newAssociations_->push_back( reco::Muon() );
+      reco::Muon& association = newAssociations_->back();
+      if ( muon.innerTrack().isNonnull() ) association.setInnerTrack( muon.innerTrack() );
+      else association.setOuterTrack( muon.outerTrack() );
+      if ( muon.isEnergyValid() ) association.setCalEnergy( muon.calEnergy() );
+      if ( matches ) association.setMatches( *matches );
+      newCodes_->push_back( key.second );
+   }
+
+   void put( edm::Event& iEvent, const std::string& instance ) {
+      if ( ! writing() ) return;
+      iEvent.put( newAssociations_, instance );
+      iEvent.put( newCodes_, instance );
+   }
+
+ private:
+   static Key key( const reco::TrackRef& track, int code ) {
+      return std::make_pair( std::make_pair(track.id(), static_cast<unsigned int>(track.key())), code );
+   }
+   static int code( TrackDetectorAssociator::Direction direction, bool withEnergy, bool withMuonSystem ) {
+      return 4*int(direction) + ( withEnergy ? 1 : 0 ) + ( withMuonSystem ? 2 : 0 );
+   }
+
+   // read from the event
+   const reco::MuonCollection* associations_;
+   // index of the associations read or written by key
+   std::map<Key, unsigned int> index_;
+   std::auto_ptr<reco::MuonCollection> newAssociations_;
+   std::auto_ptr<std::vector<int> > newCodes_;
+};
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef MuonIdentification_MuonFillerPreselection_h
+#define MuonIdentification_MuonFillerPreselection_h
+
+/** \class MuonFillerPreselection
+ *
+ * Optional preselection of the muons that get the information of one
+ * filler, given as a string cut on reco::Muon. Muons failing the cut keep
+ * the default values of that filler and are counted, so that the number
+ * of skipped muons can be reported at the end of the job. Without a cut
+ * all muons are selected and nothing is evaluated.
+ *
+ */
+
+#include <string>
+#include <boost/shared_ptr.hpp>
+
+#include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "FWCore/MessageLogger/interface/MessageLogger.h"
+#include "DataFormats/MuonReco/interface/Muon.h"
+#include "CommonTools/Utils/interface/StringCutObjectSelector.h"
+
+class MuonFillerPreselection {
+ public:
+   MuonFillerPreselection() : nMuons_(0), nSkipped_(0) {}
+
+   /// read the cut from the string parameter name of the PSet, if it is there
+   void configure( const edm::ParameterSet& iConfig, const std::string& name ) {
+      name_ = name;
+      cut_ = iConfig.existsAs<std::string>(name) ? iConfig.getParameter<std::string>(name) : "";
+      if ( ! cut_.empty() ) selector_.reset( new StringCutObjectSelector<reco::Muon, false>(cut_) );
+      else selector_.reset();
+   }
+
+   bool active() const { return selector_.get() != 0; }
+
+   /// true if the filler has to run for this muon
+   bool operator()( const reco::Muon& muon ) {
+      if ( ! selector_ ) return true;
+      ++nMuons_;
+      if ( (*selector_)(muon) ) return true;
+      ++nSkipped_;
+      return false;
+   }
+
+   unsigned long long skipped() const { return nSkipped_; }
+
+   void report( const std::string& category ) const {
+      if ( ! selector_ ) return;
+      edm::LogInfo(category) << "Preselection " << name_ << " (" << cut_ << ") skipped "
+			     << nSkipped_ << " of " << nMuons_ << " muons";
+   }
+
+ private:
+   std::string name_;
+   std::string cut_;
+   boost::shared_ptr<StringCutObjectSelector<reco::Muon, false> > selector_;
+   unsigned long long nMuons_;
+   unsigned long long nSkipped_;
+};
+
+#endif
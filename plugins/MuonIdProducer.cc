@@ -34,7 +34,6 @@
 #include "DataFormats/RecoCandidate/interface/IsoDepositFwd.h"
 
 #include "TrackingTools/TrackAssociator/interface/TrackDetectorAssociator.h"
-#include "Utilities/Timing/interface/TimerStack.h"
 
 #include <boost/regex.hpp>
 #include "RecoMuon/MuonIdentification/plugins/MuonIdProducer.h"
@@ -46,6 +45,8 @@
 #include "TrackingTools/Records/interface/TrackingComponentsRecord.h"
 
 #include <algorithm>
+#include <map>
+#include <set>
 
 #include "DataFormats/MuonDetId/interface/MuonSubdetId.h"
 #include "DataFormats/MuonDetId/interface/DTChamberId.h"
@@ -61,8 +62,7 @@
 
 #include "RecoMuon/MuonIdentification/interface/MuonKinkFinder.h"
 
-MuonIdProducer::MuonIdProducer(const edm::ParameterSet& iConfig):
-muIsoExtractorCalo_(0),muIsoExtractorTrack_(0),muIsoExtractorJet_(0)
+MuonIdProducer::MuonIdProducer(const edm::ParameterSet& iConfig)
 {
    produces<reco::MuonCollection>();
    produces<reco::CaloMuonCollection>();
@@ -85,6 +85,8 @@ muIsoExtractorCalo_(0),muIsoExtractorTrack_(0),muIsoExtractorJet_(0)
    fillMatching_            = iConfig.getParameter<bool>("fillMatching");
    fillIsolation_           = iConfig.getParameter<bool>("fillIsolation");
    writeIsoDeposits_        = iConfig.getParameter<bool>("writeIsoDeposits");
+   isoDepositMinPt_         = iConfig.existsAs<double>("isoDepositMinPt") ? iConfig.getParameter<double>("isoDepositMinPt") : 0.;
+   isoDepositMinNumberOfMatches_ = iConfig.existsAs<int>("isoDepositMinNumberOfMatches") ? iConfig.getParameter<int>("isoDepositMinNumberOfMatches") : 0;
    fillGlobalTrackQuality_  = iConfig.getParameter<bool>("fillGlobalTrackQuality");
    fillGlobalTrackRefits_   = iConfig.getParameter<bool>("fillGlobalTrackRefits");
    //SK: (maybe temporary) run it only if the global is also run
@@ -100,9 +102,42 @@ muIsoExtractorCalo_(0),muIsoExtractorTrack_(0),muIsoExtractorJet_(0)
    edm::ParameterSet parameters = iConfig.getParameter<edm::ParameterSet>("TrackAssociatorParameters");
    parameters_.loadParameters( parameters );
 
+   // optionally the two legs of split tracks are first associated to the
+   // muon system only, the calorimeters are added for the legs that are used
+   deferSplitTrackEnergy_ = iConfig.existsAs<bool>("deferSplitTrackEnergy") ? iConfig.getParameter<bool>("deferSplitTrackEnergy") : false;
+   muonParameters_ = parameters_;
+   muonParameters_.useEcal = muonParameters_.useHcal = muonParameters_.useHO = muonParameters_.useCalo = false;
+   // the calorimeter crossing is not needed if the energy is not filled,
+   // although skipping it can change the muon propagation at rounding level
+   muonSystemOnlyWithoutEnergy_ = iConfig.existsAs<bool>("muonSystemOnlyWithoutEnergy") ? 
+     iConfig.getParameter<bool>("muonSystemOnlyWithoutEnergy") : false;
+   useMuonOccupancyFilter_ = iConfig.existsAs<bool>("useMuonOccupancyFilter") ? 
+     iConfig.getParameter<bool>("useMuonOccupancyFilter") : false;
+   if ( useMuonOccupancyFilter_ )
+     muonOccupancyRoad_ = MuonSystemOccupancy(iConfig.getParameter<edm::ParameterSet>("muonOccupancyFilterParameters"));
+   useStationCrossingFilter_ = iConfig.existsAs<bool>("useStationCrossingFilter") ? 
+     iConfig.getParameter<bool>("useStationCrossingFilter") : false;
+   validateStationCrossings_ = iConfig.existsAs<bool>("validateStationCrossings") ? 
+     iConfig.getParameter<bool>("validateStationCrossings") : false;
+   if ( useStationCrossingFilter_ || validateStationCrossings_ )
+     stationCrossingParameters_ = MuonStationCrossings::Parameters(iConfig.getParameter<edm::ParameterSet>("stationCrossingParameters"));
+   nCrossingsValidated_ = nCrossingsSameStations_ = nCrossingsMissed_ = nCrossingsMissedWithMatches_ = nCrossingsUncertain_ = 0;
+   writeAssociationCache_ = iConfig.existsAs<bool>("writeAssociationCache") ? 
+     iConfig.getParameter<bool>("writeAssociationCache") : false;
+   if ( iConfig.existsAs<edm::InputTag>("associationCache") )
+     associationCacheTag_ = iConfig.getParameter<edm::InputTag>("associationCache");
+   if ( writeAssociationCache_ && ! associationCacheTag_.label().empty() )
+     throw cms::Exception("ConfigurationError") << "The association cache can either be written or read, not both.";
+   if ( writeAssociationCache_ ) {
+      produces<reco::MuonCollection>("associationCache");
+      produces<std::vector<int> >("associationCache");
+   }
+   caloParameters_ = parameters_;
+   caloParameters_.useMuon = false;
+
    // Load parameters for the TimingFiller
    edm::ParameterSet timingParameters = iConfig.getParameter<edm::ParameterSet>("TimingFillerParameters");
-   theTimingFiller_ = new MuonTimingFiller(timingParameters);
+   theTimingFiller_.reset(new MuonTimingFiller(timingParameters));
    
    if (fillCaloCompatibility_){
       // Load MuonCaloCompatibility parameters
@@ -114,15 +149,15 @@ muIsoExtractorCalo_(0),muIsoExtractorTrack_(0),muIsoExtractorJet_(0)
       // Load MuIsoExtractor parameters
       edm::ParameterSet caloExtractorPSet = iConfig.getParameter<edm::ParameterSet>("CaloExtractorPSet");
       std::string caloExtractorName = caloExtractorPSet.getParameter<std::string>("ComponentName");
-      muIsoExtractorCalo_ = IsoDepositExtractorFactory::get()->create( caloExtractorName, caloExtractorPSet);
+      muIsoExtractorCalo_.reset(IsoDepositExtractorFactory::get()->create( caloExtractorName, caloExtractorPSet));
 
       edm::ParameterSet trackExtractorPSet = iConfig.getParameter<edm::ParameterSet>("TrackExtractorPSet");
       std::string trackExtractorName = trackExtractorPSet.getParameter<std::string>("ComponentName");
-      muIsoExtractorTrack_ = IsoDepositExtractorFactory::get()->create( trackExtractorName, trackExtractorPSet);
+      muIsoExtractorTrack_.reset(IsoDepositExtractorFactory::get()->create( trackExtractorName, trackExtractorPSet));
 
       edm::ParameterSet jetExtractorPSet = iConfig.getParameter<edm::ParameterSet>("JetExtractorPSet");
       std::string jetExtractorName = jetExtractorPSet.getParameter<std::string>("ComponentName");
-      muIsoExtractorJet_ = IsoDepositExtractorFactory::get()->create( jetExtractorName, jetExtractorPSet);
+      muIsoExtractorJet_.reset(IsoDepositExtractorFactory::get()->create( jetExtractorName, jetExtractorPSet));
    }
    if (fillIsolation_ && writeIsoDeposits_){
      trackDepositName_ = iConfig.getParameter<std::string>("trackDepositName");
@@ -144,6 +179,18 @@ muIsoExtractorCalo_(0),muIsoExtractorTrack_(0),muIsoExtractorJet_(0)
      "For each collection label there should be exactly one collection type specified.";
    if (inputCollectionLabels_.size()>7 ||inputCollectionLabels_.empty()) 
      throw cms::Exception("ConfigurationError") << "Number of input collections should be from 1 to 7.";
+   for ( unsigned int i = 0; i < inputCollectionTypes_.size(); ++i ) {
+      const std::string& type = inputCollectionTypes_[i];
+      if      ( type == "inner tracks" ) inputCollectionTypeIds_.push_back( InnerTracks );
+      else if ( type == "outer tracks" ) inputCollectionTypeIds_.push_back( OuterTracks );
+      else if ( type == "links" )        inputCollectionTypeIds_.push_back( Links );
+      else if ( type == "muons" )        inputCollectionTypeIds_.push_back( Muons );
+      else if ( fillGlobalTrackRefits_ && type == "tev firstHit" ) inputCollectionTypeIds_.push_back( TevFirstHit );
+      else if ( fillGlobalTrackRefits_ && type == "tev picky" )    inputCollectionTypeIds_.push_back( TevPicky );
+      else if ( fillGlobalTrackRefits_ && type == "tev dyt" )      inputCollectionTypeIds_.push_back( TevDyt );
+      else throw cms::Exception("FatalError") << "Unknown input collection type: " << type;
+   }
+   rpcHitTag_ = edm::InputTag("rpcRecHits");
    
    debugWithTruthMatching_    = iConfig.getParameter<bool>("debugWithTruthMatching");
    if (debugWithTruthMatching_) edm::LogWarning("MuonIdentification") 
@@ -156,99 +203,148 @@ muIsoExtractorCalo_(0),muIsoExtractorTrack_(0),muIsoExtractorJet_(0)
 
    if (fillTrackerKink_) {
      trackerKinkFinder_.reset(new MuonKinkFinder(iConfig.getParameter<edm::ParameterSet>("TrackerKinkFinderParameters")));
+     if (iConfig.existsAs<edm::InputTag>("trackerKinkTrajectories"))
+       trackerKinkTrajectories_ = iConfig.getParameter<edm::InputTag>("trackerKinkTrajectories");
    }
    
+   // optional per filler preselection of the muons in the dressing loop
+   edm::ParameterSet preselection = iConfig.existsAs<edm::ParameterSet>("fillerPreselection") ? 
+     iConfig.getParameter<edm::ParameterSet>("fillerPreselection") : edm::ParameterSet();
+   muonIdPreselection_.configure(preselection, "muonId");
+   glbQualityPreselection_.configure(preselection, "globalTrackQuality");
+   trackerKinkPreselection_.configure(preselection, "trackerKink");
+   isolationPreselection_.configure(preselection, "isolation");
+   timingPreselection_.configure(preselection, "timing");
+   caloCompatibilityPreselection_.configure(preselection, "caloCompatibility");
+
+   // per stage real and cpu time, reported at the end of the job
+   stageTimers_.setEnabled( iConfig.existsAs<bool>("reportStageTiming") ? 
+			    iConfig.getParameter<bool>("reportStageTiming") : false );
+   // bytes and elements of the products, per event and over the job
+   productSizes_.setEnabled( iConfig.existsAs<bool>("reportProductSizes") ? 
+			     iConfig.getParameter<bool>("reportProductSizes") : false );
+
    //create mesh holder
-   meshAlgo_ = new MuonMesh(iConfig.getParameter<edm::ParameterSet>("arbitrationCleanerOptions"));
+   meshAlgo_.reset(new MuonMesh(iConfig.getParameter<edm::ParameterSet>("arbitrationCleanerOptions")));
 }
 
 
 MuonIdProducer::~MuonIdProducer()
 {
-   if (muIsoExtractorCalo_) delete muIsoExtractorCalo_;
-   if (muIsoExtractorTrack_) delete muIsoExtractorTrack_;
-   if (muIsoExtractorJet_) delete muIsoExtractorJet_;
-   if (theTimingFiller_) delete theTimingFiller_;
-   if (meshAlgo_) delete meshAlgo_;
    // TimingReport::current()->dump(std::cout);
 }
 
-void MuonIdProducer::init(edm::Event& iEvent, const edm::EventSetup& iSetup)
+void MuonIdProducer::endJob()
+{
+   muonIdPreselection_.report("MuonIdentification");
+   glbQualityPreselection_.report("MuonIdentification");
+   trackerKinkPreselection_.report("MuonIdentification");
+   isolationPreselection_.report("MuonIdentification");
+   timingPreselection_.report("MuonIdentification");
+   caloCompatibilityPreselection_.report("MuonIdentification");
+   stageTimers_.report("MuonIdentification");
+   productSizes_.report("MuonIdentification");
+   if ( validateStationCrossings_ )
+     edm::LogInfo("MuonIdentification") << "Station crossing prediction of " << nCrossingsValidated_ << " tracks: "
+					<< nCrossingsSameStations_ << " with the stations of the association, "
+					<< nCrossingsMissed_ << " missing the muon system, "
+					<< nCrossingsMissedWithMatches_ << " of them with chamber matches, "
+					<< nCrossingsUncertain_ << " uncertain";
+}
+
+void MuonIdProducer::init(edm::Event& iEvent, const edm::EventSetup& iSetup, EventData& data)
 {
    // TimerStack timers;
    // timers.push("MuonIdProducer::produce::init");
    
-   innerTrackCollectionHandle_.clear();
-   outerTrackCollectionHandle_.clear();
-   linkCollectionHandle_.clear();
-   muonCollectionHandle_.clear();
-   
-   tpfmsCollectionHandle_.clear();
-   pickyCollectionHandle_.clear();
-   dytCollectionHandle_.clear();
-   
 
    // timers.push("MuonIdProducer::produce::init::getPropagator");
    edm::ESHandle<Propagator> propagator;
    iSetup.get<TrackingComponentsRecord>().get("SteppingHelixPropagatorAny", propagator);
    trackAssociator_.setPropagator(propagator.product());
 
-   if (fillTrackerKink_) trackerKinkFinder_->init(iSetup);
+   if (fillTrackerKink_) {
+      trackerKinkFinder_->init(iSetup);
+      // trajectories of the inner tracks from upstream, the tracks without
+      // one are refitted by the kink finder
+      if ( ! trackerKinkTrajectories_.label().empty() ) {
+	 edm::Handle<TrajTrackAssociationCollection> trajTrackHandle;
+	 iEvent.getByLabel(trackerKinkTrajectories_, trajTrackHandle);
+	 if ( trajTrackHandle.isValid() ) {
+	    for ( TrajTrackAssociationCollection::const_iterator assoc = trajTrackHandle->begin(); 
+		  assoc != trajTrackHandle->end(); ++assoc )
+	      data.kinkTrajectories[assoc->val.get()] = assoc->key.get();
+	 } else 
+	   LogTrace("MuonIdentification") << "No trajectories for the kink finder with label " << trackerKinkTrajectories_ 
+					  << ", the tracks are refitted";
+      }
+   }
    
+   // simulated hits grouped by track once for all tracker muon candidates
+   if ( debugWithTruthMatching_ ) MuonIdTruthInfo::fillSimHits(iEvent, data.truthSimHits);
+
+   // in the matching-only mode the associations are taken from a previous job
+   if ( ! associationCacheTag_.label().empty() ) data.associationCache.read(iEvent, associationCacheTag_);
+   if ( writeAssociationCache_ ) data.associationCache.startWriting();
+
+   // global track quality of all muons, get it once per event
+   if ( fillGlobalTrackQuality_ ) iEvent.getByLabel(globalTrackQualityInputTag_, data.glbQualityHandle);
+
+   // RPC hits are needed for every tracker muon candidate, get them once per event
+   iEvent.getByLabel(rpcHitTag_, data.rpcHitHandle);
+
+   if ( useMuonOccupancyFilter_ ) {
+      data.muonOccupancy = muonOccupancyRoad_;
+      data.muonOccupancy.fill(iEvent, iSetup, parameters_.theDTRecSegment4DCollectionLabel, 
+			      parameters_.theCSCSegmentCollectionLabel, data.rpcHitHandle);
+   }
+
    // timers.pop_and_push("MuonIdProducer::produce::init::getInputCollections");
    for ( unsigned int i = 0; i < inputCollectionLabels_.size(); ++i ) {
-      if ( inputCollectionTypes_[i] == "inner tracks" ) {
-	 iEvent.getByLabel(inputCollectionLabels_[i], innerTrackCollectionHandle_);
-	 if (! innerTrackCollectionHandle_.isValid()) 
+      switch ( inputCollectionTypeIds_[i] ) {
+       case InnerTracks:
+	 iEvent.getByLabel(inputCollectionLabels_[i], data.innerTrackCollectionHandle);
+	 if (! data.innerTrackCollectionHandle.isValid()) 
 	   throw cms::Exception("FatalError") << "Failed to get input track collection with label: " << inputCollectionLabels_[i];
-	 LogTrace("MuonIdentification") << "Number of input inner tracks: " << innerTrackCollectionHandle_->size();
-	 continue;
-      }
-      if ( inputCollectionTypes_[i] == "outer tracks" ) {
-	 iEvent.getByLabel(inputCollectionLabels_[i], outerTrackCollectionHandle_);
-	 if (! outerTrackCollectionHandle_.isValid()) 
+	 LogTrace("MuonIdentification") << "Number of input inner tracks: " << data.innerTrackCollectionHandle->size();
+	 break;
+       case OuterTracks:
+	 iEvent.getByLabel(inputCollectionLabels_[i], data.outerTrackCollectionHandle);
+	 if (! data.outerTrackCollectionHandle.isValid()) 
 	   throw cms::Exception("FatalError") << "Failed to get input track collection with label: " << inputCollectionLabels_[i];
-	 LogTrace("MuonIdentification") << "Number of input outer tracks: " << outerTrackCollectionHandle_->size();
-	 continue;
-      }
-      if ( inputCollectionTypes_[i] == "links" ) {
-	 iEvent.getByLabel(inputCollectionLabels_[i], linkCollectionHandle_);
-	 if (! linkCollectionHandle_.isValid()) 
+	 LogTrace("MuonIdentification") << "Number of input outer tracks: " << data.outerTrackCollectionHandle->size();
+	 break;
+       case Links:
+	 iEvent.getByLabel(inputCollectionLabels_[i], data.linkCollectionHandle);
+	 if (! data.linkCollectionHandle.isValid()) 
 	   throw cms::Exception("FatalError") << "Failed to get input link collection with label: " << inputCollectionLabels_[i];
-	 LogTrace("MuonIdentification") << "Number of input links: " << linkCollectionHandle_->size();
-	 continue;
-      }
-      if ( inputCollectionTypes_[i] == "muons" ) {
-	 iEvent.getByLabel(inputCollectionLabels_[i], muonCollectionHandle_);
-	 if (! muonCollectionHandle_.isValid()) 
+	 LogTrace("MuonIdentification") << "Number of input links: " << data.linkCollectionHandle->size();
+	 break;
+       case Muons:
+	 iEvent.getByLabel(inputCollectionLabels_[i], data.muonCollectionHandle);
+	 if (! data.muonCollectionHandle.isValid()) 
 	   throw cms::Exception("FatalError") << "Failed to get input muon collection with label: " << inputCollectionLabels_[i];
-	 LogTrace("MuonIdentification") << "Number of input muons: " << muonCollectionHandle_->size();
-	 continue;
-      }
-      if ( fillGlobalTrackRefits_  && inputCollectionTypes_[i] == "tev firstHit" ) {
-	 iEvent.getByLabel(inputCollectionLabels_[i], tpfmsCollectionHandle_);
-	 if (! tpfmsCollectionHandle_.isValid()) 
+	 LogTrace("MuonIdentification") << "Number of input muons: " << data.muonCollectionHandle->size();
+	 break;
+       case TevFirstHit:
+	 iEvent.getByLabel(inputCollectionLabels_[i], data.tpfmsCollectionHandle);
+	 if (! data.tpfmsCollectionHandle.isValid()) 
 	   throw cms::Exception("FatalError") << "Failed to get input muon collection with label: " << inputCollectionLabels_[i];
-	 LogTrace("MuonIdentification") << "Number of input muons: " << tpfmsCollectionHandle_->size();
-	 continue;
-      }
-
-      if ( fillGlobalTrackRefits_  && inputCollectionTypes_[i] == "tev picky" ) {
-	 iEvent.getByLabel(inputCollectionLabels_[i], pickyCollectionHandle_);
-	 if (! pickyCollectionHandle_.isValid()) 
+	 LogTrace("MuonIdentification") << "Number of input muons: " << data.tpfmsCollectionHandle->size();
+	 break;
+       case TevPicky:
+	 iEvent.getByLabel(inputCollectionLabels_[i], data.pickyCollectionHandle);
+	 if (! data.pickyCollectionHandle.isValid()) 
 	   throw cms::Exception("FatalError") << "Failed to get input muon collection with label: " << inputCollectionLabels_[i];
-	 LogTrace("MuonIdentification") << "Number of input muons: " << pickyCollectionHandle_->size();
-	 continue;
-      }
-
-      if ( fillGlobalTrackRefits_  && inputCollectionTypes_[i] == "tev dyt" ) {
-	 iEvent.getByLabel(inputCollectionLabels_[i], dytCollectionHandle_);
-	 if (! dytCollectionHandle_.isValid()) 
+	 LogTrace("MuonIdentification") << "Number of input muons: " << data.pickyCollectionHandle->size();
+	 break;
+       case TevDyt:
+	 iEvent.getByLabel(inputCollectionLabels_[i], data.dytCollectionHandle);
+	 if (! data.dytCollectionHandle.isValid()) 
 	   throw cms::Exception("FatalError") << "Failed to get input muon collection with label: " << inputCollectionLabels_[i];
-	 LogTrace("MuonIdentification") << "Number of input muons: " << dytCollectionHandle_->size();
-	 continue;
+	 LogTrace("MuonIdentification") << "Number of input muons: " << data.dytCollectionHandle->size();
+	 break;
       }
-      throw cms::Exception("FatalError") << "Unknown input collection type: " << inputCollectionTypes_[i];
    }
 }
 
@@ -272,13 +368,12 @@ reco::CaloMuon MuonIdProducer::makeCaloMuon( const reco::Muon& muon )
    aMuon.setInnerTrack( muon.innerTrack() );
    
    if (muon.isEnergyValid()) aMuon.setCalEnergy( muon.calEnergy() );
-   // get calo compatibility
-   if (fillCaloCompatibility_) aMuon.setCaloCompatibility( muonCaloCompatibility_.evaluate(muon) );
+   // calo compatibility is set by the caller
    return aMuon;
 }
 
 
-reco::Muon MuonIdProducer::makeMuon( const reco::MuonTrackLinks& links )
+reco::Muon MuonIdProducer::makeMuon( const EventData& data, const reco::MuonTrackLinks& links )
 {
    LogTrace("MuonIdentification") << "Creating a muon from a link to tracks object";
 
@@ -288,11 +383,11 @@ reco::Muon MuonIdProducer::makeMuon( const reco::MuonTrackLinks& links )
    reco::TrackRef pickyRef;
    bool useSigmaSwitch = false;
 
-   if (tpfmsCollectionHandle_.isValid() && !tpfmsCollectionHandle_.failedToGet() && 
-       pickyCollectionHandle_.isValid() && !pickyCollectionHandle_.failedToGet()) {
+   if (data.tpfmsCollectionHandle.isValid() && !data.tpfmsCollectionHandle.failedToGet() && 
+       data.pickyCollectionHandle.isValid() && !data.pickyCollectionHandle.failedToGet()) {
        
-     tpfmsRef = muon::getTevRefitTrack(links.globalTrack(), *tpfmsCollectionHandle_);
-     pickyRef = muon::getTevRefitTrack(links.globalTrack(), *pickyCollectionHandle_);
+     tpfmsRef = muon::getTevRefitTrack(links.globalTrack(), *data.tpfmsCollectionHandle);
+     pickyRef = muon::getTevRefitTrack(links.globalTrack(), *data.pickyCollectionHandle);
      
      if (tpfmsRef.isNull() && pickyRef.isNull()){
        edm::LogWarning("MakeMuonWithTEV")<<"Failed to get  TEV refits, fall back to sigma switch.";
@@ -319,17 +414,17 @@ reco::Muon MuonIdProducer::makeMuon( const reco::MuonTrackLinks& links )
    aMuon.setTunePBestTrack(chosenTrack.second);
 
    if(fillGlobalTrackRefits_){
-     if (tpfmsCollectionHandle_.isValid() && !tpfmsCollectionHandle_.failedToGet()) {
-       reco::TrackToTrackMap::const_iterator it = tpfmsCollectionHandle_->find(links.globalTrack());
-       if (it != tpfmsCollectionHandle_->end()) aMuon.setMuonTrack(reco::Muon::TPFMS, (it->val));
+     if (data.tpfmsCollectionHandle.isValid() && !data.tpfmsCollectionHandle.failedToGet()) {
+       reco::TrackToTrackMap::const_iterator it = data.tpfmsCollectionHandle->find(links.globalTrack());
+       if (it != data.tpfmsCollectionHandle->end()) aMuon.setMuonTrack(reco::Muon::TPFMS, (it->val));
      }
-     if (pickyCollectionHandle_.isValid() && !pickyCollectionHandle_.failedToGet()) {
-       reco::TrackToTrackMap::const_iterator it = pickyCollectionHandle_->find(links.globalTrack());
-       if (it != pickyCollectionHandle_->end()) aMuon.setMuonTrack(reco::Muon::Picky, (it->val));
+     if (data.pickyCollectionHandle.isValid() && !data.pickyCollectionHandle.failedToGet()) {
+       reco::TrackToTrackMap::const_iterator it = data.pickyCollectionHandle->find(links.globalTrack());
+       if (it != data.pickyCollectionHandle->end()) aMuon.setMuonTrack(reco::Muon::Picky, (it->val));
      }
-     if (dytCollectionHandle_.isValid() && !dytCollectionHandle_.failedToGet()) {
-       reco::TrackToTrackMap::const_iterator it = dytCollectionHandle_->find(links.globalTrack());
-       if (it != dytCollectionHandle_->end()) aMuon.setMuonTrack(reco::Muon::DYT, (it->val));
+     if (data.dytCollectionHandle.isValid() && !data.dytCollectionHandle.failedToGet()) {
+       reco::TrackToTrackMap::const_iterator it = data.dytCollectionHandle->find(links.globalTrack());
+       if (it != data.dytCollectionHandle->end()) aMuon.setMuonTrack(reco::Muon::DYT, (it->val));
      }
    }
    return aMuon;
@@ -380,37 +475,57 @@ unsigned int MuonIdProducer::chamberId( const DetId& id )
 }
 
 
-int MuonIdProducer::overlap(const reco::Muon& muon, const reco::Track& track)
+void MuonIdProducer::matchedChamberIds(const reco::Muon& muon, std::vector<unsigned int>& ids)
 {
-   int numberOfCommonDetIds = 0;
-   if ( ! muon.isMatchesValid() || 
-	track.extra().isNull() ||
-	track.extra()->recHits().isNull() ) return numberOfCommonDetIds;
+   ids.clear();
+   if ( ! muon.isMatchesValid() ) return;
    const std::vector<reco::MuonChamberMatch>& matches( muon.matches() );
    for ( std::vector<reco::MuonChamberMatch>::const_iterator match = matches.begin();
 	 match != matches.end(); ++match ) 
+     if ( ! match->segmentMatches.empty() ) ids.push_back( match->id.rawId() );
+   std::sort( ids.begin(), ids.end() );
+   ids.erase( std::unique( ids.begin(), ids.end() ), ids.end() );
+}
+
+void MuonIdProducer::trackChamberIds(const reco::Track& track, std::vector<unsigned int>& ids)
+{
+   ids.clear();
+   if ( track.extra().isNull() ||
+	track.extra()->recHits().isNull() ) return;
+   for ( TrackingRecHitRefVector::const_iterator hit = track.extra()->recHitsBegin();
+	 hit != track.extra()->recHitsEnd(); ++hit )
      {
-	if ( match->segmentMatches.empty() ) continue;
-	bool foundCommonDetId = false;
-	
-	for ( TrackingRecHitRefVector::const_iterator hit = track.extra()->recHitsBegin();
-	      hit != track.extra()->recHitsEnd(); ++hit )
-	  {
-	     // LogTrace("MuonIdentification") << "hit DetId: " << std::hex << hit->get()->geographicalId().rawId() <<
-	     //  "\t hit chamber DetId: " << getChamberId(hit->get()->geographicalId()) <<
-	     //  "\t segment DetId: " << match->id.rawId() << std::dec;
-	     
-	     if ( chamberId(hit->get()->geographicalId()) == match->id.rawId() ) {
-		foundCommonDetId = true;
-		break;
-	     }
-	  }
-	if ( foundCommonDetId ) {
-	   numberOfCommonDetIds++;
-	   break;
-	}
+	unsigned int id = chamberId(hit->get()->geographicalId());
+	// not a DT or CSC hit
+	if ( id == 0 ) continue;
+	ids.push_back( id );
      }
-   return numberOfCommonDetIds;
+   std::sort( ids.begin(), ids.end() );
+   ids.erase( std::unique( ids.begin(), ids.end() ), ids.end() );
+}
+
+int MuonIdProducer::overlap(const std::vector<unsigned int>& muonChamberIds, 
+			    const std::vector<unsigned int>& trackChamberIds)
+{
+   // both lists are sorted, a merge finds the first common chamber
+   std::vector<unsigned int>::const_iterator muonId  = muonChamberIds.begin();
+   std::vector<unsigned int>::const_iterator trackId = trackChamberIds.begin();
+   while ( muonId != muonChamberIds.end() && trackId != trackChamberIds.end() ) {
+      if ( *muonId < *trackId ) ++muonId;
+      else if ( *trackId < *muonId ) ++trackId;
+      else return 1;
+   }
+   return 0;
+}
+
+int MuonIdProducer::overlap(const reco::Muon& muon, const reco::Track& track)
+{
+   std::vector<unsigned int> muonIds;
+   std::vector<unsigned int> trackIds;
+   matchedChamberIds(muon, muonIds);
+   if ( muonIds.empty() ) return 0;
+   trackChamberIds(track, trackIds);
+   return overlap(muonIds, trackIds);
 }
 
 void MuonIdProducer::beginRun(const edm::Run& iRun, const edm::EventSetup& iSetup)
@@ -438,15 +553,67 @@ bool validateGlobalMuonPair( const reco::MuonTrackLinks& goodMuon,
   return true;
 }
 
+void resolveSharedLinks( const reco::MuonTrackLinksCollection& links,
+			 const std::vector<unsigned int>& group,
+			 std::vector<bool>& goodmuons, bool skipRejected )
+{
+  // same pair ordering as a full pairwise comparison restricted to the group
+  for ( unsigned int i=0; i+1<group.size(); ++i ){
+    if ( skipRejected && !goodmuons[group[i]] ) continue;
+    for ( unsigned int j=i+1; j<group.size(); ++j ){
+      if ( skipRejected && !goodmuons[group[j]] ) continue;
+      if ( validateGlobalMuonPair(links[group[i]],links[group[j]]) )
+	goodmuons[group[j]] = false;
+      else
+	goodmuons[group[i]] = false;
+    }
+  }
+}
+
+namespace {
+   // local state of the propagated track in a chamber
+   void fillChamberState( const TAMuonChamberMatch& chamber, reco::MuonChamberMatch& matchedChamber )
+   {
+      LocalError localError = chamber.tState.localError().positionError();
+      matchedChamber.x = chamber.tState.localPosition().x();
+      matchedChamber.y = chamber.tState.localPosition().y();
+      matchedChamber.xErr = sqrt( localError.xx() );
+      matchedChamber.yErr = sqrt( localError.yy() );
+      
+      matchedChamber.dXdZ = chamber.tState.localDirection().z()!=0?chamber.tState.localDirection().x()/chamber.tState.localDirection().z():9999;
+      matchedChamber.dYdZ = chamber.tState.localDirection().z()!=0?chamber.tState.localDirection().y()/chamber.tState.localDirection().z():9999;
+      // DANGEROUS - compiler cannot guaranty parameters ordering
+      AlgebraicSymMatrix55 trajectoryCovMatrix = chamber.tState.localError().matrix();
+      matchedChamber.dXdZErr = trajectoryCovMatrix(1,1)>0?sqrt(trajectoryCovMatrix(1,1)):0;
+      matchedChamber.dYdZErr = trajectoryCovMatrix(2,2)>0?sqrt(trajectoryCovMatrix(2,2)):0;
+      
+      matchedChamber.edgeX = chamber.localDistanceX;
+      matchedChamber.edgeY = chamber.localDistanceY;
+      
+      matchedChamber.id = chamber.id;
+   }
+
+   // setMatches takes the matches by const reference and copies them, so it
+   // is only used to flag the matches as valid and the content is swapped in
+   // afterwards. The vector ends up owned by the muon, a scratch buffer kept
+   // between muons would have to be copied out and would bring the copy back
+   void takeMatches( reco::Muon& muon, std::vector<reco::MuonChamberMatch>& matches )
+   {
+      muon.setMatches( std::vector<reco::MuonChamberMatch>() );
+      muon.matches().swap( matches );
+   }
+}
+
 void MuonIdProducer::produce(edm::Event& iEvent, const edm::EventSetup& iSetup)
 {
-   // TimerStack timers;
-   // timers.push("MuonIdProducer::produce");
-   
+   stageTimers_.beginEvent();
+   productSizes_.beginEvent();
+
    std::auto_ptr<reco::MuonCollection> outputMuons(new reco::MuonCollection);
    std::auto_ptr<reco::CaloMuonCollection> caloMuons( new reco::CaloMuonCollection );
 
-   init(iEvent, iSetup);
+   EventData data;
+   init(iEvent, iSetup, data);
 
    std::auto_ptr<reco::MuonTimeExtraMap> muonTimeMap(new reco::MuonTimeExtraMap());
    reco::MuonTimeExtraMap::Filler filler(*muonTimeMap);
@@ -467,182 +634,209 @@ void MuonIdProducer::produce(edm::Event& iEvent, const edm::EventSetup& iSetup)
    reco::IsoDepositMap::Filler jetDepFiller(*jetDepMap);
 
    // loop over input collections
+   stageTimers_.start(MuonIdStageTimers::InputMerge);
    
    // muons first - no cleaning, take as is.
-   if ( muonCollectionHandle_.isValid() )
-     for ( reco::MuonCollection::const_iterator muon = muonCollectionHandle_->begin();
-	   muon !=  muonCollectionHandle_->end(); ++muon )
+   if ( data.muonCollectionHandle.isValid() )
+     for ( reco::MuonCollection::const_iterator muon = data.muonCollectionHandle->begin();
+	   muon !=  data.muonCollectionHandle->end(); ++muon )
        outputMuons->push_back(*muon);
    
    // links second ( assume global muon type )
-   if ( linkCollectionHandle_.isValid() ){
-     std::vector<bool> goodmuons(linkCollectionHandle_->size(),true);
+   if ( data.linkCollectionHandle.isValid() ){
+     const reco::MuonTrackLinksCollection& linkCollection = *data.linkCollectionHandle;
+     std::vector<bool> goodmuons(linkCollection.size(),true);
      if ( goodmuons.size()>1 ){
-       // check for shared tracker tracks
-       for ( unsigned int i=0; i<linkCollectionHandle_->size()-1; ++i ){
-	 if (!checkLinks(&linkCollectionHandle_->at(i))) continue;
-	 for ( unsigned int j=i+1; j<linkCollectionHandle_->size(); ++j ){
-	   if (!checkLinks(&linkCollectionHandle_->at(j))) continue; 
-	   if ( linkCollectionHandle_->at(i).trackerTrack().isNonnull() &&
-		linkCollectionHandle_->at(i).trackerTrack() == 
-		linkCollectionHandle_->at(j).trackerTrack() )
-	     {
-	       // Tracker track is the essential part that dominates muon resolution
-	       // so taking either muon is fine. All that is important is to preserve
-	       // the muon identification information. If number of hits is small,
-	       // keep the one with large number of hits, otherwise take the smalest chi2/ndof
-	       if ( validateGlobalMuonPair(linkCollectionHandle_->at(i),linkCollectionHandle_->at(j)) )
-		 goodmuons[j] = false;
-	       else
-		 goodmuons[i] = false;
-	     }
-	 }
+       // only links pointing to the same tracker (stand-alone) track can
+       // be duplicates of each other, so group them first
+       LinkGroups linksByTrackerTrack;
+       LinkGroups linksByStandAloneTrack;
+       for ( unsigned int i=0; i<linkCollection.size(); ++i ){
+	 if (!checkLinks(&linkCollection[i])) continue;
+	 linksByTrackerTrack[linkCollection[i].trackerTrack()].push_back(i);
+	 linksByStandAloneTrack[linkCollection[i].standAloneTrack()].push_back(i);
        }
+       // check for shared tracker tracks
+       // Tracker track is the essential part that dominates muon resolution
+       // so taking either muon is fine. All that is important is to preserve
+       // the muon identification information. If number of hits is small,
+       // keep the one with large number of hits, otherwise take the smalest chi2/ndof
+       for ( LinkGroups::const_iterator group = linksByTrackerTrack.begin();
+	     group != linksByTrackerTrack.end(); ++group )
+	 resolveSharedLinks( linkCollection, group->second, goodmuons, false );
        // check for shared stand-alone muons.
-       for ( unsigned int i=0; i<linkCollectionHandle_->size()-1; ++i ){
-	 if ( !goodmuons[i] ) continue;
-	 if (!checkLinks(&linkCollectionHandle_->at(i))) continue;
-	 for ( unsigned int j=i+1; j<linkCollectionHandle_->size(); ++j ){
-	   if ( !goodmuons[j] ) continue;
-	   if (!checkLinks(&linkCollectionHandle_->at(j))) continue;
-	   if ( linkCollectionHandle_->at(i).standAloneTrack().isNonnull() &&
-		linkCollectionHandle_->at(i).standAloneTrack() == 
-		linkCollectionHandle_->at(j).standAloneTrack() )
-	     {
-	       if ( validateGlobalMuonPair(linkCollectionHandle_->at(i),linkCollectionHandle_->at(j)) )
-		 goodmuons[j] = false;
-	       else
-		 goodmuons[i] = false;
-	     }
-	 }
-       }
+       for ( LinkGroups::const_iterator group = linksByStandAloneTrack.begin();
+	     group != linksByStandAloneTrack.end(); ++group )
+	 resolveSharedLinks( linkCollection, group->second, goodmuons, true );
      }
-     for ( unsigned int i=0; i<linkCollectionHandle_->size(); ++i ){
+     // track refs of the muons already in the list
+     std::set<LinkedTracks> knownMuons;
+     for ( reco::MuonCollection::const_iterator muon = outputMuons->begin();
+	   muon !=  outputMuons->end(); ++muon )
+       knownMuons.insert( LinkedTracks(muon->track(), std::make_pair(muon->standAloneMuon(), muon->combinedMuon())) );
+     for ( unsigned int i=0; i<linkCollection.size(); ++i ){
        if ( !goodmuons[i] ) continue;
-       const reco::MuonTrackLinks* links = &linkCollectionHandle_->at(i);
+       const reco::MuonTrackLinks* links = &linkCollection[i];
        if ( ! checkLinks(links))   continue;
        // check if this muon is already in the list
-       bool newMuon = true;
-       for ( reco::MuonCollection::const_iterator muon = outputMuons->begin();
-	     muon !=  outputMuons->end(); ++muon )
-	 if ( muon->track() == links->trackerTrack() &&
-	      muon->standAloneMuon() == links->standAloneTrack() &&
-	      muon->combinedMuon() == links->globalTrack() )
-	   newMuon = false;
-       if ( newMuon ) {
-	 outputMuons->push_back( makeMuon( *links ) );
+       LinkedTracks tracks( links->trackerTrack(), std::make_pair(links->standAloneTrack(), links->globalTrack()) );
+       if ( knownMuons.insert(tracks).second ) {
+	 outputMuons->push_back( makeMuon( data, *links ) );
 	 outputMuons->back().setType(reco::Muon::GlobalMuon | reco::Muon::StandAloneMuon);
        }
      }
    }
 
+   stageTimers_.stop(MuonIdStageTimers::InputMerge);
+
    // tracker and calo muons are next
-   if ( innerTrackCollectionHandle_.isValid() ) {
+   if ( data.innerTrackCollectionHandle.isValid() ) {
+      MuonIdStageTimers::Sentry sentry(stageTimers_, MuonIdStageTimers::TrackerMuons);
       LogTrace("MuonIdentification") << "Creating tracker muons";
-      for ( unsigned int i = 0; i < innerTrackCollectionHandle_->size(); ++i )
+      // The association of each track does not depend on any other
+      // candidate, so all candidates are filled first. Duplicate checks
+      // and calo muon creation follow in a separate pass in the input
+      // order, which keeps the output independent of how the first pass
+      // is scheduled.
+      std::vector<reco::Muon> trackerMuonCandidates;
+      std::vector<TrackDetectorAssociator::Direction> candidateDirections;
+      fillTrackerMuonCandidates(iEvent, iSetup, data, trackerMuonCandidates, candidateDirections);
+
+      // output muons by inner track, in the order of the output collection
+      std::map<const reco::Track*, std::vector<unsigned int> > muonsByInnerTrack;
+      for ( unsigned int i = 0; i < outputMuons->size(); ++i )
+	if ( outputMuons->at(i).innerTrack().isNonnull() )
+	  muonsByInnerTrack[outputMuons->at(i).innerTrack().get()].push_back(i);
+      // candidates failing the tracker muon selection, in the input order
+      std::vector<const reco::Muon*> caloMuonCandidates;
+
+      for ( std::vector<reco::Muon>::iterator trackerMuon = trackerMuonCandidates.begin();
+	    trackerMuon != trackerMuonCandidates.end(); ++trackerMuon )
 	{
-	   const reco::Track& track = innerTrackCollectionHandle_->at(i);
-	   if ( ! isGoodTrack( track ) ) continue;
-	   bool splitTrack = false;
-	   if ( track.extra().isAvailable() && 
-		TrackDetectorAssociator::crossedIP( track ) ) splitTrack = true;
-	   std::vector<TrackDetectorAssociator::Direction> directions;
-	   if ( splitTrack ) {
-	      directions.push_back(TrackDetectorAssociator::InsideOut);
-	      directions.push_back(TrackDetectorAssociator::OutsideIn);
-	   } else {
-	      directions.push_back(TrackDetectorAssociator::Any);
-	   }
-	   for ( std::vector<TrackDetectorAssociator::Direction>::const_iterator direction = directions.begin();
-		 direction != directions.end(); ++direction )
-	     {
-		// make muon
-		// timers.push("MuonIdProducer::produce::fillMuonId");
-	       reco::Muon trackerMuon( makeMuon(iEvent, iSetup, reco::TrackRef( innerTrackCollectionHandle_, i ), reco::Muon::InnerTrack ) );
-		trackerMuon.setType( reco::Muon::TrackerMuon | reco::Muon::RPCMuon );
-		fillMuonId(iEvent, iSetup, trackerMuon, *direction);
-		// timers.pop();
-	  
-		if ( debugWithTruthMatching_ ) {
-		   // add MC hits to a list of matched segments. 
-		   // Since it's debugging mode - code is slow
-		   MuonIdTruthInfo::truthMatchMuon(iEvent, iSetup, trackerMuon);
-		}
-	  
-		// check if this muon is already in the list
-		// have to check where muon hits are really located
-		// to match properly
-		bool newMuon = true;
-		bool goodTrackerMuon = isGoodTrackerMuon( trackerMuon );
-		bool goodRPCMuon = isGoodRPCMuon( trackerMuon );
-		for ( reco::MuonCollection::iterator muon = outputMuons->begin();
-		      muon !=  outputMuons->end(); ++muon )
-		  {
-		     if ( muon->innerTrack().get() == trackerMuon.innerTrack().get() &&
-			  cos(phiOfMuonIneteractionRegion(*muon) - 
-			      phiOfMuonIneteractionRegion(trackerMuon)) > 0 )
-		       {
-			  newMuon = false;
-			  muon->setMatches( trackerMuon.matches() );
-			  if (trackerMuon.isTimeValid()) muon->setTime( trackerMuon.time() );
-			  if (trackerMuon.isEnergyValid()) muon->setCalEnergy( trackerMuon.calEnergy() );
-			  if (goodTrackerMuon) muon->setType( muon->type() | reco::Muon::TrackerMuon );
-			  if (goodRPCMuon) muon->setType( muon->type() | reco::Muon::RPCMuon );
-			  LogTrace("MuonIdentification") << "Found a corresponding global muon. Set energy, matches and move on";
-			  break;
-		       }
-		  }
-		if ( newMuon ) {
-		   if ( goodTrackerMuon ){
-		      outputMuons->push_back( trackerMuon );
-		   } else {
-		      LogTrace("MuonIdentification") << "track failed minimal number of muon matches requirement";
-		      const reco::CaloMuon& caloMuon = makeCaloMuon(trackerMuon);
-		      if ( ! caloMuon.isCaloCompatibilityValid() || caloMuon.caloCompatibility() < caloCut_ || caloMuon.p() < minPCaloMuon_) continue;
-		      caloMuons->push_back( caloMuon );
-		   }
+	   // split track legs filled without energy get it once they are used
+	   bool deferredEnergy = deferSplitTrackEnergy_ && fillEnergy_ && ! trackerMuon->isEnergyValid();
+	   TrackDetectorAssociator::Direction direction = candidateDirections[trackerMuon - trackerMuonCandidates.begin()];
+	   // check if this muon is already in the list
+	   // have to check where muon hits are really located
+	   // to match properly
+	   bool newMuon = true;
+	   bool goodTrackerMuon = isGoodTrackerMuon( *trackerMuon );
+	   bool goodRPCMuon = isGoodRPCMuon( *trackerMuon );
+	   std::vector<unsigned int>& sameTrackMuons = muonsByInnerTrack[trackerMuon->innerTrack().get()];
+	   if ( ! sameTrackMuons.empty() ) {
+	      const double trackerMuonPhi = phiOfMuonIneteractionRegion(*trackerMuon);
+	      for ( std::vector<unsigned int>::const_iterator index = sameTrackMuons.begin();
+		    index != sameTrackMuons.end(); ++index )
+		{
+		   reco::Muon& muon = outputMuons->at(*index);
+		   if ( cos(phiOfMuonIneteractionRegion(muon) - trackerMuonPhi) > 0 )
+		     {
+			newMuon = false;
+			if ( deferredEnergy ) fillDeferredMuonEnergy(iEvent, iSetup, data, *trackerMuon, direction);
+			// the candidate is dropped, its matches are taken over
+			takeMatches( muon, trackerMuon->matches() );
+			if (trackerMuon->isTimeValid()) muon.setTime( trackerMuon->time() );
+			if (trackerMuon->isEnergyValid()) muon.setCalEnergy( trackerMuon->calEnergy() );
+			if (goodTrackerMuon) muon.setType( muon.type() | reco::Muon::TrackerMuon );
+			if (goodRPCMuon) muon.setType( muon.type() | reco::Muon::RPCMuon );
+			LogTrace("MuonIdentification") << "Found a corresponding global muon. Set energy, matches and move on";
+			break;
+		     }
 		}
-	     }
+	   }
+	   if ( newMuon ) {
+	      if ( deferredEnergy && ( goodTrackerMuon || fillCaloCompatibility_ ) )
+		fillDeferredMuonEnergy(iEvent, iSetup, data, *trackerMuon, direction);
+	      if ( goodTrackerMuon ){
+		 sameTrackMuons.push_back( outputMuons->size() );
+		 outputMuons->push_back( *trackerMuon );
+	      } else {
+		 LogTrace("MuonIdentification") << "track failed minimal number of muon matches requirement";
+		 // without the compatibility no candidate passes the calo muon selection
+		 if ( fillCaloCompatibility_ ) caloMuonCandidates.push_back( &*trackerMuon );
+	      }
+	   }
+	}
+
+      // calo compatibility of all calo muon candidates in one call
+      std::vector<MuonCaloCompatibility::Input> caloInputs;
+      caloInputs.reserve( caloMuonCandidates.size() );
+      for ( std::vector<const reco::Muon*>::const_iterator candidate = caloMuonCandidates.begin();
+	    candidate != caloMuonCandidates.end(); ++candidate )
+	caloInputs.push_back( MuonCaloCompatibility::input(**candidate) );
+      std::vector<double> caloCompatibilities;
+      muonCaloCompatibility_.evaluate( caloInputs, caloCompatibilities );
+      for ( unsigned int i = 0; i < caloMuonCandidates.size(); ++i )
+	{
+	   reco::CaloMuon caloMuon = makeCaloMuon( *caloMuonCandidates[i] );
+	   caloMuon.setCaloCompatibility( caloCompatibilities[i] );
+	   if ( ! caloMuon.isCaloCompatibilityValid() || caloMuon.caloCompatibility() < caloCut_ || caloMuon.p() < minPCaloMuon_) continue;
+	   caloMuons->push_back( caloMuon );
 	}
    }
    
    // and at last the stand alone muons
-   if ( outerTrackCollectionHandle_.isValid() ) {
+   if ( data.outerTrackCollectionHandle.isValid() ) {
+      MuonIdStageTimers::Sentry sentry(stageTimers_, MuonIdStageTimers::StandAloneMuons);
       LogTrace("MuonIdentification") << "Looking for new muons among stand alone muon tracks";
-      for ( unsigned int i = 0; i < outerTrackCollectionHandle_->size(); ++i )
+      // muons with a stand-alone track are matched by the track itself,
+      // the others are tracker muon candidates for the DetId overlap
+      std::map<const reco::Track*, unsigned int> muonsByStandAloneTrack;
+      std::vector<unsigned int> muonsWithoutStandAloneTrack;
+      // sorted chamber ids with matched segments, per tracker muon
+      std::vector<std::vector<unsigned int> > muonChamberIds;
+      for ( unsigned int j = 0; j < outputMuons->size(); ++j ) {
+	 if ( ! outputMuons->at(j).standAloneMuon().isNull() )
+	   muonsByStandAloneTrack.insert( std::make_pair(outputMuons->at(j).standAloneMuon().get(), j) );
+	 else {
+	    muonsWithoutStandAloneTrack.push_back(j);
+	    muonChamberIds.push_back( std::vector<unsigned int>() );
+	    matchedChamberIds( outputMuons->at(j), muonChamberIds.back() );
+	 }
+      }
+      std::vector<unsigned int> outerTrackChamberIds;
+      for ( unsigned int i = 0; i < data.outerTrackCollectionHandle->size(); ++i )
 	{
+	   bool outerTrackChamberIdsFilled = false;
 	   // check if this muon is already in the list of global muons
 	   bool newMuon = true;
-	   for ( reco::MuonCollection::iterator muon = outputMuons->begin();
-		 muon !=  outputMuons->end(); ++muon ) 
+	   unsigned int firstGlobalMuon = outputMuons->size();
+	   std::map<const reco::Track*, unsigned int>::const_iterator globalMuon = 
+	     muonsByStandAloneTrack.find( &(data.outerTrackCollectionHandle->at(i)) );
+	   if ( globalMuon != muonsByStandAloneTrack.end() ) firstGlobalMuon = globalMuon->second;
+	   
+	   // tracker muon - no direct links to the standalone muon
+	   // since we have only a few real muons in an event, matching 
+	   // the stand alone muon to the tracker muon by DetIds should 
+	   // be good enough for association. At the end it's up to a 
+	   // user to redefine the association and what it means. Here 
+	   // we would like to avoid obvious double counting and we 
+	   // tolerate a potential miss association
+	   // Only muons in front of the matching global muon are looked at.
+	   for ( unsigned int k = 0; k < muonsWithoutStandAloneTrack.size() && 
+		   muonsWithoutStandAloneTrack[k] < firstGlobalMuon; ++k )
 	     {
-		if ( ! muon->standAloneMuon().isNull() ) {
-		   // global muon
-		   if ( muon->standAloneMuon().get() ==  &(outerTrackCollectionHandle_->at(i)) ) {
-		      newMuon = false;
-		      break;
-		   }
-		} else {
-		   // tracker muon - no direct links to the standalone muon
-		   // since we have only a few real muons in an event, matching 
-		   // the stand alone muon to the tracker muon by DetIds should 
-		   // be good enough for association. At the end it's up to a 
-		   // user to redefine the association and what it means. Here 
-		   // we would like to avoid obvious double counting and we 
-		   // tolerate a potential miss association
-		   if ( overlap(*muon,outerTrackCollectionHandle_->at(i))>0 ) {
-		      LogTrace("MuonIdentification") << "Found associated tracker muon. Set a reference and move on";
-		      newMuon = false;
-		      muon->setOuterTrack( reco::TrackRef( outerTrackCollectionHandle_, i ) );
-		      muon->setType( muon->type() | reco::Muon::StandAloneMuon );
-		      break;
-		   }
+		reco::Muon& muon = outputMuons->at(muonsWithoutStandAloneTrack[k]);
+		// already associated to one of the previous stand-alone tracks
+		if ( ! muon.standAloneMuon().isNull() ) continue;
+		if ( muonChamberIds[k].empty() ) continue;
+		if ( ! outerTrackChamberIdsFilled ) {
+		   trackChamberIds( data.outerTrackCollectionHandle->at(i), outerTrackChamberIds );
+		   outerTrackChamberIdsFilled = true;
+		}
+		if ( overlap(muonChamberIds[k],outerTrackChamberIds)>0 ) {
+		   LogTrace("MuonIdentification") << "Found associated tracker muon. Set a reference and move on";
+		   newMuon = false;
+		   muon.setOuterTrack( reco::TrackRef( data.outerTrackCollectionHandle, i ) );
+		   muon.setType( muon.type() | reco::Muon::StandAloneMuon );
+		   break;
 		}
 	     }
+	   if ( firstGlobalMuon < outputMuons->size() ) newMuon = false;
 	   if ( newMuon ) {
 	      LogTrace("MuonIdentification") << "No associated stand alone track is found. Making a muon";
 	      outputMuons->push_back( makeMuon(iEvent, iSetup, 
-					       reco::TrackRef( outerTrackCollectionHandle_, i ), reco::Muon::OuterTrack ) );
+					       reco::TrackRef( data.outerTrackCollectionHandle, i ), reco::Muon::OuterTrack ) );
 	      outputMuons->back().setType( reco::Muon::StandAloneMuon );
 	   }
 	}
@@ -655,80 +849,141 @@ void MuonIdProducer::produce(edm::Event& iEvent, const edm::EventSetup& iSetup)
    std::vector<reco::MuonTimeExtra> dtTimeColl(nMuons);
    std::vector<reco::MuonTimeExtra> cscTimeColl(nMuons);
    std::vector<reco::MuonTimeExtra> combinedTimeColl(nMuons);
-   std::vector<reco::IsoDeposit> trackDepColl(nMuons);
-   std::vector<reco::IsoDeposit> ecalDepColl(nMuons);
-   std::vector<reco::IsoDeposit> hcalDepColl(nMuons);
-   std::vector<reco::IsoDeposit> hoDepColl(nMuons);
-   std::vector<reco::IsoDeposit> jetDepColl(nMuons);
-
-   // Fill various information
-   unsigned int i=0;
+   // the deposits are only kept if they are written out, otherwise the
+   // isolation summaries are computed from the extracted deposits directly
+   int nDeposits = writeIsoDeposits_ && fillIsolation_ ? nMuons : 0;
+   std::vector<reco::IsoDeposit> trackDepColl(nDeposits);
+   std::vector<reco::IsoDeposit> ecalDepColl(nDeposits);
+   std::vector<reco::IsoDeposit> hcalDepColl(nDeposits);
+   std::vector<reco::IsoDeposit> hoDepColl(nDeposits);
+   std::vector<reco::IsoDeposit> jetDepColl(nDeposits);
+
+   // the isolation only depends on the track, so muons sharing it (like the
+   // two legs of a split tracker muon) take the deposits of the first one:
+   // track -> index of that muon and whether its deposits are stored
+   std::map<const reco::Track*, std::pair<unsigned int, bool> > isolatedMuonsByTrack;
+
+   // event setup of the timing extractors is the same for all muons
+   if ( nMuons > 0 ) theTimingFiller_->beginEvent(iEvent, iSetup);
+
+   // Fill various information, the muon id, quality and kink first
    for ( reco::MuonCollection::iterator muon = outputMuons->begin(); muon != outputMuons->end(); ++muon )
      {
 	// Fill muonID
-	// timers.push("MuonIdProducer::produce::fillMuonId");
-	if ( ( fillMatching_ && ! muon->isMatchesValid() ) || 
-	     ( fillEnergy_ && !muon->isEnergyValid() ) )
+	if ( ( ( fillMatching_ && ! muon->isMatchesValid() ) || 
+	       ( fillEnergy_ && !muon->isEnergyValid() ) ) && muonIdPreselection_(*muon) )
 	  {
+	     MuonIdStageTimers::Sentry sentry(stageTimers_, MuonIdStageTimers::MuonId);
 	     // predict direction based on the muon interaction region location 
 	     // if it's available
 	     if ( muon->isStandAloneMuon() ) {
 		if ( cos(phiOfMuonIneteractionRegion(*muon) - muon->phi()) > 0 )
-		  fillMuonId(iEvent, iSetup, *muon, TrackDetectorAssociator::InsideOut);
+		  fillMuonId(iEvent, iSetup, data, *muon, TrackDetectorAssociator::InsideOut);
 		else
-		  fillMuonId(iEvent, iSetup, *muon, TrackDetectorAssociator::OutsideIn);
+		  fillMuonId(iEvent, iSetup, data, *muon, TrackDetectorAssociator::OutsideIn);
 	     } else {
 		LogTrace("MuonIdentification") << "THIS SHOULD NEVER HAPPEN";
-		fillMuonId(iEvent, iSetup, *muon);
+		fillMuonId(iEvent, iSetup, data, *muon);
 	     }
 	  }
 
-	if (fillGlobalTrackQuality_){
+	if (fillGlobalTrackQuality_ && glbQualityPreselection_(*muon)){
 	  // Fill global quality information
-	  fillGlbQuality(iEvent, iSetup, *muon);
+	  MuonIdStageTimers::Sentry sentry(stageTimers_, MuonIdStageTimers::GlobalQuality);
+	  fillGlbQuality(data, *muon);
 	}
 	LogDebug("MuonIdentification");
 
-        if (fillTrackerKink_) {
-            fillTrackerKink(*muon);
+        if (fillTrackerKink_ && trackerKinkPreselection_(*muon)) {
+            MuonIdStageTimers::Sentry sentry(stageTimers_, MuonIdStageTimers::TrackerKink);
+            fillTrackerKink(data, *muon);
         }
+     }
 
-	// timers.push("MuonIdProducer::produce::fillCaloCompatibility");
-	if ( fillCaloCompatibility_ ) muon->setCaloCompatibility( muonCaloCompatibility_.evaluate(*muon) );
-	// timers.pop();
-	
-	// timers.push("MuonIdProducer::produce::fillIsolation");
-	if ( fillIsolation_ ) fillMuonIsolation(iEvent, iSetup, *muon,
-						trackDepColl[i], ecalDepColl[i], hcalDepColl[i], hoDepColl[i], jetDepColl[i]);
-	// timers.pop();
-
-        // fill timing information
-        reco::MuonTime muonTime;
-        reco::MuonTimeExtra dtTime;
-        reco::MuonTimeExtra cscTime;
-        reco::MuonTimeExtra combinedTime;
-
-        theTimingFiller_->fillTiming(*muon, dtTime, cscTime, combinedTime, iEvent, iSetup);
-
-        muonTime.nDof=combinedTime.nDof();
-        muonTime.timeAtIpInOut=combinedTime.timeAtIpInOut();
-        muonTime.timeAtIpInOutErr=combinedTime.timeAtIpInOutErr();
-        muonTime.timeAtIpOutIn=combinedTime.timeAtIpOutIn();
-        muonTime.timeAtIpOutInErr=combinedTime.timeAtIpOutInErr();
-
-        muon->setTime(	muonTime);
-        dtTimeColl[i] = dtTime;
-        cscTimeColl[i] = cscTime;
-        combinedTimeColl[i] = combinedTime;
+   // the calo compatibility of all muons at once, before the isolation and
+   // timing whose preselection may cut on it
+   if ( fillCaloCompatibility_ ) {
+      MuonIdStageTimers::Sentry sentry(stageTimers_, MuonIdStageTimers::CaloCompatibility);
+      std::vector<MuonCaloCompatibility::Input> caloInputs;
+      std::vector<unsigned int> caloMuonIndices;
+      caloInputs.reserve( outputMuons->size() );
+      caloMuonIndices.reserve( outputMuons->size() );
+      for ( unsigned int j = 0; j < outputMuons->size(); ++j ) {
+	 if ( ! caloCompatibilityPreselection_(outputMuons->at(j)) ) continue;
+	 caloInputs.push_back( MuonCaloCompatibility::input(outputMuons->at(j)) );
+	 caloMuonIndices.push_back( j );
+      }
+      std::vector<double> caloCompatibilities;
+      muonCaloCompatibility_.evaluate( caloInputs, caloCompatibilities );
+      for ( unsigned int j = 0; j < caloMuonIndices.size(); ++j )
+	outputMuons->at(caloMuonIndices[j]).setCaloCompatibility( caloCompatibilities[j] );
+   }
+
+   unsigned int i=0;
+   for ( reco::MuonCollection::iterator muon = outputMuons->begin(); muon != outputMuons->end(); ++muon )
+     {
+	if ( fillIsolation_ && isolationPreselection_(*muon) ) {
+	   MuonIdStageTimers::Sentry sentry(stageTimers_, MuonIdStageTimers::Isolation);
+	   bool keepDeposits = nDeposits > 0 && isoDepositSelected(*muon);
+	   const reco::Track* isoTrack = 0;
+	   if ( muon->track().isNonnull() ) isoTrack = muon->track().get();
+	   else if ( muon->standAloneMuon().isNonnull() ) isoTrack = muon->standAloneMuon().get();
+	   std::map<const reco::Track*, std::pair<unsigned int, bool> >::const_iterator first = 
+	     isoTrack ? isolatedMuonsByTrack.find(isoTrack) : isolatedMuonsByTrack.end();
+	   if ( first != isolatedMuonsByTrack.end() && ( ! keepDeposits || first->second.second ) ) {
+	      const reco::Muon& firstMuon = outputMuons->at(first->second.first);
+	      if ( firstMuon.isIsolationValid() ) 
+		muon->setIsolation( firstMuon.isolationR03(), firstMuon.isolationR05() );
+	      if ( keepDeposits ) {
+		 trackDepColl[i] = trackDepColl[first->second.first];
+		 ecalDepColl[i]  = ecalDepColl[first->second.first];
+		 hcalDepColl[i]  = hcalDepColl[first->second.first];
+		 hoDepColl[i]    = hoDepColl[first->second.first];
+		 jetDepColl[i]   = jetDepColl[first->second.first];
+	      }
+	   } else {
+	      if ( keepDeposits )
+		fillMuonIsolation(iEvent, iSetup, *muon,
+				  &trackDepColl[i], &ecalDepColl[i], &hcalDepColl[i], &hoDepColl[i], &jetDepColl[i]);
+	      else
+		fillMuonIsolation(iEvent, iSetup, *muon);
+	      if ( isoTrack && ( first == isolatedMuonsByTrack.end() || keepDeposits ) )
+		isolatedMuonsByTrack[isoTrack] = std::make_pair(i, keepDeposits);
+	   }
+	}
+
+        // fill timing information, the muons skipped keep empty times
+        if ( timingPreselection_(*muon) ) {
+           MuonIdStageTimers::Sentry sentry(stageTimers_, MuonIdStageTimers::Timing);
+           reco::MuonTime muonTime;
+           reco::MuonTimeExtra dtTime;
+           reco::MuonTimeExtra cscTime;
+           reco::MuonTimeExtra combinedTime;
+
+           theTimingFiller_->fillTiming(*muon, dtTime, cscTime, combinedTime, iEvent, iSetup);
+
+           muonTime.nDof=combinedTime.nDof();
+           muonTime.timeAtIpInOut=combinedTime.timeAtIpInOut();
+           muonTime.timeAtIpInOutErr=combinedTime.timeAtIpInOutErr();
+           muonTime.timeAtIpOutIn=combinedTime.timeAtIpOutIn();
+           muonTime.timeAtIpOutInErr=combinedTime.timeAtIpOutInErr();
+
+           muon->setTime(	muonTime);
+           dtTimeColl[i] = dtTime;
+           cscTimeColl[i] = cscTime;
+           combinedTimeColl[i] = combinedTime;
+        }
         
         i++;
      
      }
 	
    LogTrace("MuonIdentification") << "number of muons produced: " << outputMuons->size();
-   // timers.push("MuonIdProducer::produce::fillArbitration");
-   if ( fillMatching_ ) fillArbitrationInfo( outputMuons.get() );
-   // timers.pop();
+   if ( fillMatching_ ) {
+      MuonIdStageTimers::Sentry sentry(stageTimers_, MuonIdStageTimers::Arbitration);
+      fillArbitrationInfo( outputMuons.get() );
+   }
+   productSizes_.addMuons("muons", *outputMuons);
    edm::OrphanHandle<reco::MuonCollection> muonHandle = iEvent.put(outputMuons);
 
    filler.insert(muonHandle, combinedTimeColl.begin(), combinedTimeColl.end());
@@ -738,6 +993,9 @@ void MuonIdProducer::produce(edm::Event& iEvent, const edm::EventSetup& iSetup)
    fillerCSC.insert(muonHandle, cscTimeColl.begin(), cscTimeColl.end());
    fillerCSC.fill();
 
+   productSizes_.addValueMap("time combined", *muonTimeMap);
+   productSizes_.addValueMap("time dt", *muonTimeMapDT);
+   productSizes_.addValueMap("time csc", *muonTimeMapCSC);
    iEvent.put(muonTimeMap,"combined");
    iEvent.put(muonTimeMapDT,"dt");
    iEvent.put(muonTimeMapCSC,"csc");
@@ -745,25 +1003,114 @@ void MuonIdProducer::produce(edm::Event& iEvent, const edm::EventSetup& iSetup)
    if (writeIsoDeposits_ && fillIsolation_){
      trackDepFiller.insert(muonHandle, trackDepColl.begin(), trackDepColl.end());
      trackDepFiller.fill();
+     productSizes_.addValueMap("deposits " + trackDepositName_, *trackDepMap);
      iEvent.put(trackDepMap, trackDepositName_);
      ecalDepFiller.insert(muonHandle, ecalDepColl.begin(), ecalDepColl.end());
      ecalDepFiller.fill();
+     productSizes_.addValueMap("deposits " + ecalDepositName_, *ecalDepMap);
      iEvent.put(ecalDepMap,  ecalDepositName_);
      hcalDepFiller.insert(muonHandle, hcalDepColl.begin(), hcalDepColl.end());
      hcalDepFiller.fill();
+     productSizes_.addValueMap("deposits " + hcalDepositName_, *hcalDepMap);
      iEvent.put(hcalDepMap,  hcalDepositName_);
      hoDepFiller.insert(muonHandle, hoDepColl.begin(), hoDepColl.end());
      hoDepFiller.fill();
+     productSizes_.addValueMap("deposits " + hoDepositName_, *hoDepMap);
      iEvent.put(hoDepMap,    hoDepositName_);
      jetDepFiller.insert(muonHandle, jetDepColl.begin(), jetDepColl.end());
      jetDepFiller.fill();
+     productSizes_.addValueMap("deposits " + jetDepositName_, *jetDepMap);
      iEvent.put(jetDepMap,  jetDepositName_);
    }
 
+   productSizes_.addCollection("calo muons", *caloMuons);
+   productSizes_.endEvent("MuonIdProducer");
    iEvent.put(caloMuons);
+   data.associationCache.put(iEvent, "associationCache");
 }
 
 
+void MuonIdProducer::fillTrackerMuonCandidates(edm::Event& iEvent, const edm::EventSetup& iSetup,
+					       EventData& data, std::vector<reco::Muon>& candidates,
+					       std::vector<TrackDetectorAssociator::Direction>& candidateDirections)
+{
+   std::vector<unsigned int> goodTracks;
+   std::vector<const reco::Track*> goodTrackPointers;
+   for ( unsigned int i = 0; i < data.innerTrackCollectionHandle->size(); ++i )
+     if ( isGoodTrack( data.innerTrackCollectionHandle->at(i) ) ) {
+	goodTracks.push_back(i);
+	goodTrackPointers.push_back( &data.innerTrackCollectionHandle->at(i) );
+     }
+   // the stations crossed by all the good tracks at once
+   const bool predictStationCrossings = useStationCrossingFilter_ || validateStationCrossings_;
+   MuonStationCrossings stationCrossings( stationCrossingParameters_ );
+   if ( predictStationCrossings ) stationCrossings.propagate( goodTrackPointers );
+
+   for ( unsigned int k = 0; k < goodTracks.size(); ++k )
+     {
+	const unsigned int i = goodTracks[k];
+	const reco::Track& track = data.innerTrackCollectionHandle->at(i);
+	// without anything in the muon system along the road the candidate
+	// can only become a calo muon
+	bool withMuonSystem = data.muonOccupancy.inRoad( track );
+	bool splitTrack = false;
+	if ( track.extra().isAvailable() && 
+	     TrackDetectorAssociator::crossedIP( track ) ) splitTrack = true;
+	std::vector<TrackDetectorAssociator::Direction> directions;
+	if ( splitTrack ) {
+	   directions.push_back(TrackDetectorAssociator::InsideOut);
+	   directions.push_back(TrackDetectorAssociator::OutsideIn);
+	} else {
+	   directions.push_back(TrackDetectorAssociator::Any);
+	}
+	// the prediction starts from the reference point of the track, the
+	// split tracks are left to the general propagator
+	const bool predicted = predictStationCrossings && ! splitTrack;
+	if ( predicted && useStationCrossingFilter_ && ! validateStationCrossings_ &&
+	     stationCrossings.missesMuonSystem(k) ) withMuonSystem = false;
+	for ( std::vector<TrackDetectorAssociator::Direction>::const_iterator direction = directions.begin();
+	      direction != directions.end(); ++direction )
+	  {
+	     // make muon
+	     // timers.push("MuonIdProducer::produce::fillMuonId");
+	     candidates.push_back( makeMuon(iEvent, iSetup, reco::TrackRef( data.innerTrackCollectionHandle, i ), reco::Muon::InnerTrack ) );
+	     reco::Muon& trackerMuon = candidates.back();
+	     trackerMuon.setType( reco::Muon::TrackerMuon | reco::Muon::RPCMuon );
+	     candidateDirections.push_back( *direction );
+	     fillMuonId(iEvent, iSetup, data, trackerMuon, *direction, ! ( splitTrack && deferSplitTrackEnergy_ ), withMuonSystem );
+	     // timers.pop();
+	     if ( predicted && validateStationCrossings_ && withMuonSystem )
+	       validateStationCrossings( stationCrossings, k, trackerMuon );
+	     
+	     if ( debugWithTruthMatching_ ) {
+		// add MC hits to a list of matched segments. 
+		// Since it's debugging mode - code is slow
+		MuonIdTruthInfo::truthMatchMuon(data.truthSimHits, iSetup, trackerMuon);
+	     }
+	  }
+     }
+}
+
+void MuonIdProducer::validateStationCrossings( const MuonStationCrossings& crossings, unsigned int index,
+					       const reco::Muon& muon )
+{
+   unsigned int matchedStations = 0;
+   for ( std::vector<reco::MuonChamberMatch>::const_iterator chamber = muon.matches().begin();
+	 chamber != muon.matches().end(); ++chamber )
+     matchedStations |= MuonStationCrossings::stationBit( chamber->detector(), chamber->station() );
+   ++nCrossingsValidated_;
+   if ( crossings.stations(index) == matchedStations ) ++nCrossingsSameStations_;
+   if ( crossings.uncertain(index) ) ++nCrossingsUncertain_;
+   if ( crossings.missesMuonSystem(index) ) {
+      ++nCrossingsMissed_;
+      if ( matchedStations != 0 ) {
+	 ++nCrossingsMissedWithMatches_;
+	 LogTrace("MuonIdentification") << "Track with pt " << muon.pt() << " and eta " << muon.eta() 
+					<< " is predicted to miss the muon stations, but has chamber matches";
+      }
+   }
+}
+
 bool MuonIdProducer::isGoodTrackerMuon( const reco::Muon& muon )
 {
   if(muon.track()->pt() < minPt_ || muon.track()->p() < minP_) return false;
@@ -782,9 +1129,57 @@ bool MuonIdProducer::isGoodRPCMuon( const reco::Muon& muon )
    return ( muon.numberOfMatchedRPCLayers( reco::Muon::RPCHitAndTrackArbitration ) > minNumberOfMatches_ );
 }
 
+void MuonIdProducer::fillMuonEnergy(const TrackDetMatchInfo& info, reco::Muon& aMuon)
+{
+   reco::MuonEnergy muonEnergy;
+   muonEnergy.em      = info.crossedEnergy(TrackDetMatchInfo::EcalRecHits);
+   muonEnergy.had     = info.crossedEnergy(TrackDetMatchInfo::HcalRecHits);
+   muonEnergy.ho      = info.crossedEnergy(TrackDetMatchInfo::HORecHits);
+   muonEnergy.tower   = info.crossedEnergy(TrackDetMatchInfo::TowerTotal);
+   muonEnergy.emS9    = info.nXnEnergy(TrackDetMatchInfo::EcalRecHits,1); // 3x3 energy
+   muonEnergy.emS25   = info.nXnEnergy(TrackDetMatchInfo::EcalRecHits,2); // 5x5 energy
+   muonEnergy.hadS9   = info.nXnEnergy(TrackDetMatchInfo::HcalRecHits,1); // 3x3 energy
+   muonEnergy.hoS9    = info.nXnEnergy(TrackDetMatchInfo::HORecHits,1);   // 3x3 energy
+   muonEnergy.towerS9 = info.nXnEnergy(TrackDetMatchInfo::TowerTotal,1);  // 3x3 energy
+   muonEnergy.ecal_position = info.trkGlobPosAtEcal;
+   muonEnergy.hcal_position = info.trkGlobPosAtHcal;
+   if (! info.crossedEcalIds.empty() ) muonEnergy.ecal_id = info.crossedEcalIds.front();
+   if (! info.crossedHcalIds.empty() ) muonEnergy.hcal_id = info.crossedHcalIds.front();
+   // find maximal energy depositions and their time
+   DetId emMaxId      = info.findMaxDeposition(TrackDetMatchInfo::EcalRecHits,2); // max energy deposit in 5x5 shape
+   for(std::vector<const EcalRecHit*>::const_iterator hit=info.ecalRecHits.begin(); 
+	  hit!=info.ecalRecHits.end(); ++hit) {
+	 if ((*hit)->id() != emMaxId) continue;
+	 muonEnergy.emMax   = (*hit)->energy();
+	 muonEnergy.ecal_time = (*hit)->time();
+   }
+   DetId hadMaxId     = info.findMaxDeposition(TrackDetMatchInfo::HcalRecHits,1); // max energy deposit in 3x3 shape
+   for(std::vector<const HBHERecHit*>::const_iterator hit=info.hcalRecHits.begin(); 
+	  hit!=info.hcalRecHits.end(); ++hit) {
+	 if ((*hit)->id() != hadMaxId) continue;
+	 muonEnergy.hadMax   = (*hit)->energy();
+	 muonEnergy.hcal_time = (*hit)->time();
+   }
+   aMuon.setCalEnergy( muonEnergy );
+}
+
+void MuonIdProducer::fillDeferredMuonEnergy(edm::Event& iEvent, const edm::EventSetup& iSetup, EventData& data,
+					    reco::Muon& aMuon, TrackDetectorAssociator::Direction direction)
+{
+   const MuonAssociationCache::Key cacheKey = MuonAssociationCache::key(aMuon, direction, true, false);
+   const reco::Muon* cached = data.associationCache.find(cacheKey);
+   if ( cached && cached->isEnergyValid() ) {
+      aMuon.setCalEnergy( cached->calEnergy() );
+      return;
+   }
+   TrackDetMatchInfo info = trackAssociator_.associate(iEvent, iSetup, *aMuon.track(), caloParameters_, direction);
+   fillMuonEnergy(info, aMuon);
+   data.associationCache.insert(cacheKey, aMuon, 0);
+}
+
 void MuonIdProducer::fillMuonId(edm::Event& iEvent, const edm::EventSetup& iSetup,
-				reco::Muon& aMuon, 
-				TrackDetectorAssociator::Direction direction)
+				EventData& data, reco::Muon& aMuon, 
+				TrackDetectorAssociator::Direction direction, bool withEnergy, bool withMuonSystem)
 {
    // perform track - detector association
    const reco::Track* track = 0;
@@ -798,74 +1193,66 @@ void MuonIdProducer::fillMuonId(edm::Event& iEvent, const edm::EventSetup& iSetu
 	  throw cms::Exception("FatalError") << "Failed to fill muon id information for a muon with undefined references to tracks"; 
      }
    
-   TrackDetMatchInfo info = trackAssociator_.associate(iEvent, iSetup, *track, parameters_, direction);
+   if ( ! fillEnergy_ && muonSystemOnlyWithoutEnergy_ ) withEnergy = false;
+   if ( ! withMuonSystem && ! ( fillEnergy_ && withEnergy ) ) {
+      // nothing to associate
+      std::vector<reco::MuonChamberMatch> noMatches;
+      takeMatches(aMuon, noMatches);
+      return;
+   }
+
+   const bool needMatches = fillMatching_ || aMuon.isTrackerMuon() || aMuon.isRPCMuon();
+   const MuonAssociationCache::Key cacheKey = 
+     MuonAssociationCache::key(aMuon, direction, fillEnergy_ && withEnergy, withMuonSystem);
+   const reco::Muon* cached = data.associationCache.find(cacheKey);
+   if ( cached && ( cached->isMatchesValid() || ! needMatches ) ) {
+      // matching-only mode, only the cuts of the producer are applied again
+      if ( fillEnergy_ && withEnergy && cached->isEnergyValid() ) aMuon.setCalEnergy( cached->calEnergy() );
+      if ( ! needMatches ) return;
+      std::vector<reco::MuonChamberMatch> muonChamberMatches( cached->matches() );
+      applyMatchingCuts( muonChamberMatches );
+      takeMatches(aMuon, muonChamberMatches);
+      return;
+   }
+   if ( cached ) LogTrace("MuonIdentification") << "No chamber matches in the association cache, the track is propagated";
+
+   TrackDetMatchInfo info = trackAssociator_.associate(iEvent, iSetup, *track, 
+						       ! withMuonSystem ? caloParameters_ : ( withEnergy ? parameters_ : muonParameters_ ), 
+						       direction);
    
-   if ( fillEnergy_ ) {
-      reco::MuonEnergy muonEnergy;
-      muonEnergy.em      = info.crossedEnergy(TrackDetMatchInfo::EcalRecHits);
-      muonEnergy.had     = info.crossedEnergy(TrackDetMatchInfo::HcalRecHits);
-      muonEnergy.ho      = info.crossedEnergy(TrackDetMatchInfo::HORecHits);
-      muonEnergy.tower   = info.crossedEnergy(TrackDetMatchInfo::TowerTotal);
-      muonEnergy.emS9    = info.nXnEnergy(TrackDetMatchInfo::EcalRecHits,1); // 3x3 energy
-      muonEnergy.emS25   = info.nXnEnergy(TrackDetMatchInfo::EcalRecHits,2); // 5x5 energy
-      muonEnergy.hadS9   = info.nXnEnergy(TrackDetMatchInfo::HcalRecHits,1); // 3x3 energy
-      muonEnergy.hoS9    = info.nXnEnergy(TrackDetMatchInfo::HORecHits,1);   // 3x3 energy
-      muonEnergy.towerS9 = info.nXnEnergy(TrackDetMatchInfo::TowerTotal,1);  // 3x3 energy
-      muonEnergy.ecal_position = info.trkGlobPosAtEcal;
-      muonEnergy.hcal_position = info.trkGlobPosAtHcal;
-      if (! info.crossedEcalIds.empty() ) muonEnergy.ecal_id = info.crossedEcalIds.front();
-      if (! info.crossedHcalIds.empty() ) muonEnergy.hcal_id = info.crossedHcalIds.front();
-      // find maximal energy depositions and their time
-      DetId emMaxId      = info.findMaxDeposition(TrackDetMatchInfo::EcalRecHits,2); // max energy deposit in 5x5 shape
-      for(std::vector<const EcalRecHit*>::const_iterator hit=info.ecalRecHits.begin(); 
-	  hit!=info.ecalRecHits.end(); ++hit) {
-	 if ((*hit)->id() != emMaxId) continue;
-	 muonEnergy.emMax   = (*hit)->energy();
-	 muonEnergy.ecal_time = (*hit)->time();
-      }
-      DetId hadMaxId     = info.findMaxDeposition(TrackDetMatchInfo::HcalRecHits,1); // max energy deposit in 3x3 shape
-      for(std::vector<const HBHERecHit*>::const_iterator hit=info.hcalRecHits.begin(); 
-	  hit!=info.hcalRecHits.end(); ++hit) {
-	 if ((*hit)->id() != hadMaxId) continue;
-	 muonEnergy.hadMax   = (*hit)->energy();
-	 muonEnergy.hcal_time = (*hit)->time();
-      }
-      aMuon.setCalEnergy( muonEnergy );
+   if ( fillEnergy_ && withEnergy ) fillMuonEnergy(info, aMuon);
+   if ( ! needMatches ) {
+      data.associationCache.insert(cacheKey, aMuon, 0);
+      return;
    }
-   if ( ! fillMatching_ && ! aMuon.isTrackerMuon() && ! aMuon.isRPCMuon() ) return;
    
-  edm::Handle<RPCRecHitCollection> rpcRecHits;
-  iEvent.getByLabel(edm::InputTag("rpcRecHits"), rpcRecHits);
+   const bool rpcHitsAvailable = data.rpcHitHandle.isValid();
 
-   // fill muon match info
+   // fill muon match info, the chamber matches are filled in place; the
+   // cache keeps all the segments of the associator
    std::vector<reco::MuonChamberMatch> muonChamberMatches;
+   muonChamberMatches.reserve( info.chambers.size() );
+   std::vector<reco::MuonChamberMatch> cachedChamberMatches;
+   const bool writeCache = data.associationCache.writing();
+   if ( writeCache ) cachedChamberMatches.reserve( info.chambers.size() );
    unsigned int nubmerOfMatchesAccordingToTrackAssociator = 0;
    for( std::vector<TAMuonChamberMatch>::const_iterator chamber=info.chambers.begin();
 	chamber!=info.chambers.end(); chamber++ )
      {
-       if  (chamber->id.subdetId() == 3 && rpcRecHits.isValid()  ) continue; // Skip RPC chambers, they are taken care of below)
-	reco::MuonChamberMatch matchedChamber;
-	
-	LocalError localError = chamber->tState.localError().positionError();
-	matchedChamber.x = chamber->tState.localPosition().x();
-	matchedChamber.y = chamber->tState.localPosition().y();
-	matchedChamber.xErr = sqrt( localError.xx() );
-	matchedChamber.yErr = sqrt( localError.yy() );
-	                                                                                                                                                    
-	matchedChamber.dXdZ = chamber->tState.localDirection().z()!=0?chamber->tState.localDirection().x()/chamber->tState.localDirection().z():9999;
-	matchedChamber.dYdZ = chamber->tState.localDirection().z()!=0?chamber->tState.localDirection().y()/chamber->tState.localDirection().z():9999;
-	// DANGEROUS - compiler cannot guaranty parameters ordering
-	AlgebraicSymMatrix55 trajectoryCovMatrix = chamber->tState.localError().matrix();
-	matchedChamber.dXdZErr = trajectoryCovMatrix(1,1)>0?sqrt(trajectoryCovMatrix(1,1)):0;
-	matchedChamber.dYdZErr = trajectoryCovMatrix(2,2)>0?sqrt(trajectoryCovMatrix(2,2)):0;
-	
-	matchedChamber.edgeX = chamber->localDistanceX;
-	matchedChamber.edgeY = chamber->localDistanceY;
+       if  (chamber->id.subdetId() == 3 && rpcHitsAvailable  ) continue; // Skip RPC chambers, they are taken care of below)
+	muonChamberMatches.push_back( reco::MuonChamberMatch() );
+	reco::MuonChamberMatch& matchedChamber = muonChamberMatches.back();
+	fillChamberState( *chamber, matchedChamber );
+	reco::MuonChamberMatch* cachedChamber = 0;
+	if ( writeCache ) {
+	   cachedChamberMatches.push_back( matchedChamber );
+	   cachedChamber = &cachedChamberMatches.back();
+	}
 	
-	matchedChamber.id = chamber->id;
 	if ( ! chamber->segments.empty() ) ++nubmerOfMatchesAccordingToTrackAssociator;
 	
 	// fill segments
+	matchedChamber.segmentMatches.reserve( chamber->segments.size() );
 	for( std::vector<TAMuonSegmentMatch>::const_iterator segment = chamber->segments.begin();
      segment != chamber->segments.end(); segment++ ) 
 	  {
@@ -884,33 +1271,14 @@ void MuonIdProducer::fillMuonId(edm::Event& iEvent, const edm::EventSetup& iSetu
              matchedSegment.cscSegmentRef = segment->cscSegmentRef;
         matchedSegment.hasZed_ = segment->hasZed;
         matchedSegment.hasPhi_ = segment->hasPhi;
+	     if ( cachedChamber ) cachedChamber->segmentMatches.push_back(matchedSegment);
 	     // test segment
-	     bool matchedX = false;
-	     bool matchedY = false;
-	     LogTrace("MuonIdentification") << " matching local x, segment x: " << matchedSegment.x << 
-	       ", chamber x: " << matchedChamber.x << ", max: " << maxAbsDx_;
-	     LogTrace("MuonIdentification") << " matching local y, segment y: " << matchedSegment.y <<
-	       ", chamber y: " << matchedChamber.y << ", max: " << maxAbsDy_;
-	     if (matchedSegment.xErr>0 && matchedChamber.xErr>0 )
-	       LogTrace("MuonIdentification") << " xpull: " << 
-	       fabs(matchedSegment.x - matchedChamber.x)/sqrt(pow(matchedSegment.xErr,2) + pow(matchedChamber.xErr,2));
-	     if (matchedSegment.yErr>0 && matchedChamber.yErr>0 )
-	       LogTrace("MuonIdentification") << " ypull: " << 
-	       fabs(matchedSegment.y - matchedChamber.y)/sqrt(pow(matchedSegment.yErr,2) + pow(matchedChamber.yErr,2));
-	     
-	     if (fabs(matchedSegment.x - matchedChamber.x) < maxAbsDx_) matchedX = true;
-	     if (fabs(matchedSegment.y - matchedChamber.y) < maxAbsDy_) matchedY = true;
-	     if (matchedSegment.xErr>0 && matchedChamber.xErr>0 && 
-		 fabs(matchedSegment.x - matchedChamber.x)/sqrt(pow(matchedSegment.xErr,2) + pow(matchedChamber.xErr,2)) < maxAbsPullX_) matchedX = true;
-	     if (matchedSegment.yErr>0 && matchedChamber.yErr>0 && 
-		 fabs(matchedSegment.y - matchedChamber.y)/sqrt(pow(matchedSegment.yErr,2) + pow(matchedChamber.yErr,2)) < maxAbsPullY_) matchedY = true;
-	     if (matchedX && matchedY) matchedChamber.segmentMatches.push_back(matchedSegment);
+	     if ( isMatchedSegment(matchedChamber, matchedSegment) ) matchedChamber.segmentMatches.push_back(matchedSegment);
 	  }
-	muonChamberMatches.push_back(matchedChamber);
      }
 
   // Fill RPC info
-  if ( rpcRecHits.isValid() )
+  if ( rpcHitsAvailable )
   {
 
    for( std::vector<TAMuonChamberMatch>::const_iterator chamber=info.chambers.begin();
@@ -919,46 +1287,32 @@ void MuonIdProducer::fillMuonId(edm::Event& iEvent, const edm::EventSetup& iSetu
 
       if ( chamber->id.subdetId() != 3 ) continue; // Consider RPC chambers only
 
-      reco::MuonChamberMatch matchedChamber;
+      muonChamberMatches.push_back( reco::MuonChamberMatch() );
+      reco::MuonChamberMatch& matchedChamber = muonChamberMatches.back();
+      fillChamberState( *chamber, matchedChamber );
+      const double xErr = matchedChamber.xErr;
 
-      LocalError localError = chamber->tState.localError().positionError();
-      matchedChamber.x = chamber->tState.localPosition().x();
-      matchedChamber.y = chamber->tState.localPosition().y();
-      matchedChamber.xErr = sqrt( localError.xx() );
-      matchedChamber.yErr = sqrt( localError.yy() );
-      
-      matchedChamber.dXdZ = chamber->tState.localDirection().z()!=0?chamber->tState.localDirection().x()/chamber->tState.localDirection().z():9999;
-      matchedChamber.dYdZ = chamber->tState.localDirection().z()!=0?chamber->tState.localDirection().y()/chamber->tState.localDirection().z():9999;
-      // DANGEROUS - compiler cannot guaranty parameters ordering
-      AlgebraicSymMatrix55 trajectoryCovMatrix = chamber->tState.localError().matrix();
-      matchedChamber.dXdZErr = trajectoryCovMatrix(1,1)>0?sqrt(trajectoryCovMatrix(1,1)):0;
-      matchedChamber.dYdZErr = trajectoryCovMatrix(2,2)>0?sqrt(trajectoryCovMatrix(2,2)):0;
-	
-      matchedChamber.edgeX = chamber->localDistanceX;
-      matchedChamber.edgeY = chamber->localDistanceY;
-
-      matchedChamber.id = chamber->id;
-
-      for ( RPCRecHitCollection::const_iterator rpcRecHit = rpcRecHits->begin();
-            rpcRecHit != rpcRecHits->end(); ++rpcRecHit )
+      // the collection is a range map keyed by roll id, so only the hits
+      // of this chamber are visited
+      RPCRecHitCollection::range rpcHitRange = data.rpcHitHandle->get( RPCDetId(chamber->id.rawId()) );
+      for ( RPCRecHitCollection::const_iterator rpcRecHit = rpcHitRange.first;
+            rpcRecHit != rpcHitRange.second; ++rpcRecHit )
       {
         reco::MuonRPCHitMatch rpcHitMatch;
 
-        if ( rpcRecHit->rawId() != chamber->id.rawId() ) continue;
-
         rpcHitMatch.x = rpcRecHit->localPosition().x();
         rpcHitMatch.mask = 0;
         rpcHitMatch.bx = rpcRecHit->BunchX();
 
         const double AbsDx = fabs(rpcRecHit->localPosition().x()-chamber->tState.localPosition().x());
-        if( AbsDx <= 20 or AbsDx/sqrt(localError.xx()) <= 4 ) matchedChamber.rpcMatches.push_back(rpcHitMatch);
+        if( AbsDx <= 20 or AbsDx/xErr <= 4 ) matchedChamber.rpcMatches.push_back(rpcHitMatch);
       }
-
-      muonChamberMatches.push_back(matchedChamber);
+      if ( writeCache ) cachedChamberMatches.push_back( matchedChamber );
     }
   }
 
-   aMuon.setMatches(muonChamberMatches);
+   if ( writeCache ) data.associationCache.insert(cacheKey, aMuon, &cachedChamberMatches);
+   takeMatches(aMuon, muonChamberMatches);
 
    LogTrace("MuonIdentification") << "number of muon chambers: " << aMuon.matches().size() << "\n" 
      << "number of chambers with segments according to the associator requirements: " << 
@@ -969,14 +1323,129 @@ void MuonIdProducer::fillMuonId(edm::Event& iEvent, const edm::EventSetup& iSetu
    // fillTime( iEvent, iSetup, aMuon );
 }
 
+bool MuonIdProducer::isMatchedSegment( const reco::MuonChamberMatch& matchedChamber, 
+				       const reco::MuonSegmentMatch& matchedSegment ) const
+{
+   bool matchedX = false;
+   bool matchedY = false;
+   LogTrace("MuonIdentification") << " matching local x, segment x: " << matchedSegment.x << 
+     ", chamber x: " << matchedChamber.x << ", max: " << maxAbsDx_;
+   LogTrace("MuonIdentification") << " matching local y, segment y: " << matchedSegment.y <<
+     ", chamber y: " << matchedChamber.y << ", max: " << maxAbsDy_;
+   if (matchedSegment.xErr>0 && matchedChamber.xErr>0 )
+     LogTrace("MuonIdentification") << " xpull: " << 
+     fabs(matchedSegment.x - matchedChamber.x)/sqrt(pow(matchedSegment.xErr,2) + pow(matchedChamber.xErr,2));
+   if (matchedSegment.yErr>0 && matchedChamber.yErr>0 )
+     LogTrace("MuonIdentification") << " ypull: " << 
+     fabs(matchedSegment.y - matchedChamber.y)/sqrt(pow(matchedSegment.yErr,2) + pow(matchedChamber.yErr,2));
+   
+   if (fabs(matchedSegment.x - matchedChamber.x) < maxAbsDx_) matchedX = true;
+   if (fabs(matchedSegment.y - matchedChamber.y) < maxAbsDy_) matchedY = true;
+   if (matchedSegment.xErr>0 && matchedChamber.xErr>0 && 
+       fabs(matchedSegment.x - matchedChamber.x)/sqrt(pow(matchedSegment.xErr,2) + pow(matchedChamber.xErr,2)) < maxAbsPullX_) matchedX = true;
+   if (matchedSegment.yErr>0 && matchedChamber.yErr>0 && 
+       fabs(matchedSegment.y - matchedChamber.y)/sqrt(pow(matchedSegment.yErr,2) + pow(matchedChamber.yErr,2)) < maxAbsPullY_) matchedY = true;
+   return matchedX && matchedY;
+}
+
+void MuonIdProducer::applyMatchingCuts( std::vector<reco::MuonChamberMatch>& matches ) const
+{
+   for ( std::vector<reco::MuonChamberMatch>::iterator chamber = matches.begin(); chamber != matches.end(); ++chamber ) {
+      std::vector<reco::MuonSegmentMatch> segments;
+      segments.reserve( chamber->segmentMatches.size() );
+      for ( std::vector<reco::MuonSegmentMatch>::const_iterator segment = chamber->segmentMatches.begin();
+	    segment != chamber->segmentMatches.end(); ++segment )
+	if ( isMatchedSegment(*chamber, *segment) ) segments.push_back(*segment);
+      chamber->segmentMatches.swap( segments );
+   }
+}
+
+namespace {
+   typedef std::vector<std::pair<reco::MuonChamberMatch*,reco::MuonSegmentMatch*> > SegmentMatchPairs;
+
+   // location of a segment match in the output muon collection
+   struct SegmentMatchIndex {
+      unsigned int muon;
+      reco::MuonChamberMatch* chamber;
+      reco::MuonSegmentMatch* segment;
+   };
+
+   // segment matches of different muons describing the same segment
+   const double segmentMatchTolerance = 1E-3;
+   bool isSameSegment( const reco::MuonSegmentMatch& segment1, const reco::MuonSegmentMatch& segment2 )
+   {
+      return fabs(segment2.x       - segment1.x      ) < segmentMatchTolerance &&
+	     fabs(segment2.y       - segment1.y      ) < segmentMatchTolerance &&
+	     fabs(segment2.dXdZ    - segment1.dXdZ   ) < segmentMatchTolerance &&
+	     fabs(segment2.dYdZ    - segment1.dYdZ   ) < segmentMatchTolerance &&
+	     fabs(segment2.xErr    - segment1.xErr   ) < segmentMatchTolerance &&
+	     fabs(segment2.yErr    - segment1.yErr   ) < segmentMatchTolerance &&
+	     fabs(segment2.dXdZErr - segment1.dXdZErr) < segmentMatchTolerance &&
+	     fabs(segment2.dYdZErr - segment1.dYdZErr) < segmentMatchTolerance;
+   }
+
+   // set each flag on the best segment match according to its metric. The
+   // keys are sorted one metric after the other like the pairs used to be,
+   // so that ties are resolved in the same way.
+   void markBestSegments( const SegmentMatchPairs& pairs, std::vector<muonid::SegmentMatchKeys>& keys,
+			  unsigned int byDRSlope, unsigned int byDXSlope, unsigned int byDR, unsigned int byDX )
+   {
+      if(pairs.empty()) return;
+      if(pairs.size()==1) {
+	 pairs.front().second->setMask(byDRSlope);
+	 pairs.front().second->setMask(byDXSlope);
+	 pairs.front().second->setMask(byDR);
+	 pairs.front().second->setMask(byDX);
+	 return;
+      }
+      keys.clear();
+      for( unsigned int i = 0; i < pairs.size(); ++i )
+	 keys.push_back(muonid::SegmentMatchKeys(*pairs[i].first, *pairs[i].second, i));
+      sort(keys.begin(), keys.end(), muonid::SortSegmentMatchKeys<muonid::ByDRSlope>());
+      pairs[keys.front().index].second->setMask(byDRSlope);
+      sort(keys.begin(), keys.end(), muonid::SortSegmentMatchKeys<muonid::ByDXSlope>());
+      pairs[keys.front().index].second->setMask(byDXSlope);
+      sort(keys.begin(), keys.end(), muonid::SortSegmentMatchKeys<muonid::ByDR>());
+      pairs[keys.front().index].second->setMask(byDR);
+      sort(keys.begin(), keys.end(), muonid::SortSegmentMatchKeys<muonid::ByDX>());
+      pairs[keys.front().index].second->setMask(byDX);
+   }
+}
+
 void MuonIdProducer::fillArbitrationInfo( reco::MuonCollection* pOutputMuons )
 {
    //
    // apply segment flags
    //
-   std::vector<std::pair<reco::MuonChamberMatch*,reco::MuonSegmentMatch*> > chamberPairs;     // for chamber segment sorting
-   std::vector<std::pair<reco::MuonChamberMatch*,reco::MuonSegmentMatch*> > stationPairs;     // for station segment sorting
-   std::vector<std::pair<reco::MuonChamberMatch*,reco::MuonSegmentMatch*> > arbitrationPairs; // for muon segment arbitration
+   SegmentMatchPairs chamberPairs;         // for chamber segment sorting
+   SegmentMatchPairs stationPairs[4][3];   // for station segment sorting
+   SegmentMatchPairs arbitrationPairs;     // for muon segment arbitration
+   std::vector<muonid::SegmentMatchKeys> sortKeys; // sorting buffer of markBestSegments
+
+   // Segment matches of all tracker muons, indexed by local x. Identical
+   // segments of other muons are looked up in a narrow x window instead of
+   // looping over all muons, chambers and segments again. The window is
+   // wider than the tolerance, the exact test is done by isSameSegment.
+   std::vector<SegmentMatchIndex> trackerMuonSegments;
+   std::vector<std::pair<double,unsigned int> > segmentsByX;
+   for( unsigned int muonIndex = 0; muonIndex < pOutputMuons->size(); ++muonIndex )
+   {
+      if (! pOutputMuons->at(muonIndex).isTrackerMuon()) continue;
+      for( std::vector<reco::MuonChamberMatch>::iterator chamberIter = pOutputMuons->at(muonIndex).matches().begin();
+	    chamberIter != pOutputMuons->at(muonIndex).matches().end(); ++chamberIter )
+	 for( std::vector<reco::MuonSegmentMatch>::iterator segmentIter = chamberIter->segmentMatches.begin();
+	       segmentIter != chamberIter->segmentMatches.end(); ++segmentIter )
+	 {
+	    SegmentMatchIndex index = { muonIndex, &(*chamberIter), &(*segmentIter) };
+	    segmentsByX.push_back(std::make_pair(segmentIter->x, trackerMuonSegments.size()));
+	    trackerMuonSegments.push_back(index);
+	 }
+   }
+   std::sort(segmentsByX.begin(), segmentsByX.end());
+   std::vector<unsigned int> identicalSegments;
+
+   // clear old mesh and its segment caches before the ME1/a checks below
+   if(arbClean_) meshAlgo_->clearMesh();
 
    // muonIndex1
    for( unsigned int muonIndex1 = 0; muonIndex1 < pOutputMuons->size(); ++muonIndex1 )
@@ -998,59 +1467,37 @@ void MuonIdProducer::fillArbitrationInfo( reco::MuonCollection* pOutputMuons )
                arbitrationPairs.clear();
                arbitrationPairs.push_back(std::make_pair(&(*chamberIter1), &(*segmentIter1)));
 
-	       
-
                // find identical segments with which to arbitrate
                // tracker muons only
                if (pOutputMuons->at(muonIndex1).isTrackerMuon()) {
-                  // muonIndex2
-                  for( unsigned int muonIndex2 = muonIndex1+1; muonIndex2 < pOutputMuons->size(); ++muonIndex2 )
+                  identicalSegments.clear();
+                  std::vector<std::pair<double,unsigned int> >::const_iterator candidate = 
+                     std::lower_bound(segmentsByX.begin(), segmentsByX.end(), 
+                                      std::make_pair(segmentIter1->x - 2*segmentMatchTolerance, 0u));
+                  for( ; candidate != segmentsByX.end() && candidate->first < segmentIter1->x + 2*segmentMatchTolerance; ++candidate )
                   {
-                     // tracker muons only
-                     if (! pOutputMuons->at(muonIndex2).isTrackerMuon()) continue;
-                     // chamberIter2
-                     for( std::vector<reco::MuonChamberMatch>::iterator chamberIter2 = pOutputMuons->at(muonIndex2).matches().begin();
-                           chamberIter2 != pOutputMuons->at(muonIndex2).matches().end(); ++chamberIter2 )
-                     {
-                        // segmentIter2
-                        for( std::vector<reco::MuonSegmentMatch>::iterator segmentIter2 = chamberIter2->segmentMatches.begin();
-                              segmentIter2 != chamberIter2->segmentMatches.end(); ++segmentIter2 )
-                        {
-                           if(segmentIter2->isMask()) continue; // has already been arbitrated
-                           if(fabs(segmentIter2->x       - segmentIter1->x      ) < 1E-3 &&
-                                 fabs(segmentIter2->y       - segmentIter1->y      ) < 1E-3 &&
-                                 fabs(segmentIter2->dXdZ    - segmentIter1->dXdZ   ) < 1E-3 &&
-                                 fabs(segmentIter2->dYdZ    - segmentIter1->dYdZ   ) < 1E-3 &&
-                                 fabs(segmentIter2->xErr    - segmentIter1->xErr   ) < 1E-3 &&
-                                 fabs(segmentIter2->yErr    - segmentIter1->yErr   ) < 1E-3 &&
-                                 fabs(segmentIter2->dXdZErr - segmentIter1->dXdZErr) < 1E-3 &&
-                                 fabs(segmentIter2->dYdZErr - segmentIter1->dYdZErr) < 1E-3)
-                              arbitrationPairs.push_back(std::make_pair(&(*chamberIter2), &(*segmentIter2)));
-                        } // segmentIter2
-                     } // chamberIter2
-                  } // muonIndex2
+                     const SegmentMatchIndex& other = trackerMuonSegments[candidate->second];
+                     if(other.muon <= muonIndex1) continue; // only the muons that follow
+                     if(other.segment->isMask()) continue; // has already been arbitrated
+                     if(isSameSegment(*segmentIter1, *other.segment)) identicalSegments.push_back(candidate->second);
+                  }
+                  // keep the muon, chamber, segment order of the full loop, the
+                  // sorting below is not stable
+                  std::sort(identicalSegments.begin(), identicalSegments.end());
+                  for( std::vector<unsigned int>::const_iterator index = identicalSegments.begin();
+                        index != identicalSegments.end(); ++index )
+                     arbitrationPairs.push_back(std::make_pair(trackerMuonSegments[*index].chamber, 
+                                                               trackerMuonSegments[*index].segment));
                }
 
                // arbitration segment sort
-               if(arbitrationPairs.empty()) continue; // this should never happen
-               if(arbitrationPairs.size()==1) {
-                  arbitrationPairs.front().second->setMask(reco::MuonSegmentMatch::BelongsToTrackByDRSlope);
-                  arbitrationPairs.front().second->setMask(reco::MuonSegmentMatch::BelongsToTrackByDXSlope);
-                  arbitrationPairs.front().second->setMask(reco::MuonSegmentMatch::BelongsToTrackByDR);
-                  arbitrationPairs.front().second->setMask(reco::MuonSegmentMatch::BelongsToTrackByDX);
-                  arbitrationPairs.front().second->setMask(reco::MuonSegmentMatch::Arbitrated);
-               } else {
-                  sort(arbitrationPairs.begin(), arbitrationPairs.end(), SortMuonSegmentMatches(reco::MuonSegmentMatch::BelongsToTrackByDRSlope));
-                  arbitrationPairs.front().second->setMask(reco::MuonSegmentMatch::BelongsToTrackByDRSlope);
-                  sort(arbitrationPairs.begin(), arbitrationPairs.end(), SortMuonSegmentMatches(reco::MuonSegmentMatch::BelongsToTrackByDXSlope));
-                  arbitrationPairs.front().second->setMask(reco::MuonSegmentMatch::BelongsToTrackByDXSlope);
-                  sort(arbitrationPairs.begin(), arbitrationPairs.end(), SortMuonSegmentMatches(reco::MuonSegmentMatch::BelongsToTrackByDR));
-                  arbitrationPairs.front().second->setMask(reco::MuonSegmentMatch::BelongsToTrackByDR);
-                  sort(arbitrationPairs.begin(), arbitrationPairs.end(), SortMuonSegmentMatches(reco::MuonSegmentMatch::BelongsToTrackByDX));
-                  arbitrationPairs.front().second->setMask(reco::MuonSegmentMatch::BelongsToTrackByDX);
-                  for( unsigned int it = 0; it < arbitrationPairs.size(); ++it )
-                     arbitrationPairs.at(it).second->setMask(reco::MuonSegmentMatch::Arbitrated);
-               }
+               markBestSegments(arbitrationPairs, sortKeys,
+                                reco::MuonSegmentMatch::BelongsToTrackByDRSlope,
+                                reco::MuonSegmentMatch::BelongsToTrackByDXSlope,
+                                reco::MuonSegmentMatch::BelongsToTrackByDR,
+                                reco::MuonSegmentMatch::BelongsToTrackByDX);
+               for( unsigned int it = 0; it < arbitrationPairs.size(); ++it )
+                  arbitrationPairs.at(it).second->setMask(reco::MuonSegmentMatch::Arbitrated);
             }
 	    
 	    // setup me1a cleaning for later
@@ -1071,72 +1518,58 @@ void MuonIdProducer::fillArbitrationInfo( reco::MuonCollection* pOutputMuons )
          } // segmentIter1
 
          // chamber segment sort
-         if(chamberPairs.empty()) continue; // this should never happen
-         if(chamberPairs.size()==1) {
-            chamberPairs.front().second->setMask(reco::MuonSegmentMatch::BestInChamberByDRSlope);
-            chamberPairs.front().second->setMask(reco::MuonSegmentMatch::BestInChamberByDXSlope);
-            chamberPairs.front().second->setMask(reco::MuonSegmentMatch::BestInChamberByDR);
-            chamberPairs.front().second->setMask(reco::MuonSegmentMatch::BestInChamberByDX);
-         } else {
-            sort(chamberPairs.begin(), chamberPairs.end(), SortMuonSegmentMatches(reco::MuonSegmentMatch::BestInChamberByDRSlope));
-            chamberPairs.front().second->setMask(reco::MuonSegmentMatch::BestInChamberByDRSlope);
-            sort(chamberPairs.begin(), chamberPairs.end(), SortMuonSegmentMatches(reco::MuonSegmentMatch::BestInChamberByDXSlope));
-            chamberPairs.front().second->setMask(reco::MuonSegmentMatch::BestInChamberByDXSlope);
-            sort(chamberPairs.begin(), chamberPairs.end(), SortMuonSegmentMatches(reco::MuonSegmentMatch::BestInChamberByDR));
-            chamberPairs.front().second->setMask(reco::MuonSegmentMatch::BestInChamberByDR);
-            sort(chamberPairs.begin(), chamberPairs.end(), SortMuonSegmentMatches(reco::MuonSegmentMatch::BestInChamberByDX));
-            chamberPairs.front().second->setMask(reco::MuonSegmentMatch::BestInChamberByDX);
-         }
+         markBestSegments(chamberPairs, sortKeys,
+                          reco::MuonSegmentMatch::BestInChamberByDRSlope,
+                          reco::MuonSegmentMatch::BestInChamberByDXSlope,
+                          reco::MuonSegmentMatch::BestInChamberByDR,
+                          reco::MuonSegmentMatch::BestInChamberByDX);
       } // chamberIter1
 
-      // station segment sort
-      for( int stationIndex = 1; stationIndex < 5; ++stationIndex )
-         for( int detectorIndex = 1; detectorIndex < 4; ++detectorIndex )
-         {
-            stationPairs.clear();
+      // station segment sort, all stations and detectors filled in one pass
+      for( int stationIndex = 0; stationIndex < 4; ++stationIndex )
+         for( int detectorIndex = 0; detectorIndex < 3; ++detectorIndex )
+            stationPairs[stationIndex][detectorIndex].clear();
 
-            // chamberIter
-            for( std::vector<reco::MuonChamberMatch>::iterator chamberIter = pOutputMuons->at(muonIndex1).matches().begin();
-                  chamberIter != pOutputMuons->at(muonIndex1).matches().end(); ++chamberIter )
-            {
-               if(!(chamberIter->station()==stationIndex && chamberIter->detector()==detectorIndex)) continue;
-               if(chamberIter->segmentMatches.empty()) continue;
-
-               for( std::vector<reco::MuonSegmentMatch>::iterator segmentIter = chamberIter->segmentMatches.begin();
-                     segmentIter != chamberIter->segmentMatches.end(); ++segmentIter )
-                  stationPairs.push_back(std::make_pair(&(*chamberIter), &(*segmentIter)));
-            } // chamberIter
-
-            if(stationPairs.empty()) continue; // this may very well happen
-            if(stationPairs.size()==1) {
-               stationPairs.front().second->setMask(reco::MuonSegmentMatch::BestInStationByDRSlope);
-               stationPairs.front().second->setMask(reco::MuonSegmentMatch::BestInStationByDXSlope);
-               stationPairs.front().second->setMask(reco::MuonSegmentMatch::BestInStationByDR);
-               stationPairs.front().second->setMask(reco::MuonSegmentMatch::BestInStationByDX);
-            } else {
-               sort(stationPairs.begin(), stationPairs.end(), SortMuonSegmentMatches(reco::MuonSegmentMatch::BestInStationByDRSlope));
-               stationPairs.front().second->setMask(reco::MuonSegmentMatch::BestInStationByDRSlope);
-               sort(stationPairs.begin(), stationPairs.end(), SortMuonSegmentMatches(reco::MuonSegmentMatch::BestInStationByDXSlope));
-               stationPairs.front().second->setMask(reco::MuonSegmentMatch::BestInStationByDXSlope);
-               sort(stationPairs.begin(), stationPairs.end(), SortMuonSegmentMatches(reco::MuonSegmentMatch::BestInStationByDR));
-               stationPairs.front().second->setMask(reco::MuonSegmentMatch::BestInStationByDR);
-               sort(stationPairs.begin(), stationPairs.end(), SortMuonSegmentMatches(reco::MuonSegmentMatch::BestInStationByDX));
-               stationPairs.front().second->setMask(reco::MuonSegmentMatch::BestInStationByDX);
-            }
-         }
+      // chamberIter
+      for( std::vector<reco::MuonChamberMatch>::iterator chamberIter = pOutputMuons->at(muonIndex1).matches().begin();
+            chamberIter != pOutputMuons->at(muonIndex1).matches().end(); ++chamberIter )
+      {
+         if(chamberIter->segmentMatches.empty()) continue;
+         int station = chamberIter->station();
+         int detector = chamberIter->detector();
+         if(station < 1 || station > 4 || detector < 1 || detector > 3) continue;
+
+         for( std::vector<reco::MuonSegmentMatch>::iterator segmentIter = chamberIter->segmentMatches.begin();
+               segmentIter != chamberIter->segmentMatches.end(); ++segmentIter )
+            stationPairs[station-1][detector-1].push_back(std::make_pair(&(*chamberIter), &(*segmentIter)));
+      } // chamberIter
+
+      for( int stationIndex = 0; stationIndex < 4; ++stationIndex )
+         for( int detectorIndex = 0; detectorIndex < 3; ++detectorIndex )
+            markBestSegments(stationPairs[stationIndex][detectorIndex], sortKeys, // this may very well be empty
+                             reco::MuonSegmentMatch::BestInStationByDRSlope,
+                             reco::MuonSegmentMatch::BestInStationByDXSlope,
+                             reco::MuonSegmentMatch::BestInStationByDR,
+                             reco::MuonSegmentMatch::BestInStationByDX);
 
    } // muonIndex1
 
    if(arbClean_) {
-     // clear old mesh, create and prune new mesh!
-     meshAlgo_->clearMesh();
+     // create and prune new mesh!
+     MuonIdStageTimers::Sentry sentry(stageTimers_, MuonIdStageTimers::Mesh);
      meshAlgo_->runMesh(pOutputMuons);
    }
 }
 
+bool MuonIdProducer::isoDepositSelected(const reco::Muon& muon) const
+{
+   return muon.pt() >= isoDepositMinPt_ && 
+     ( isoDepositMinNumberOfMatches_ <= 0 || muon.numberOfMatches(reco::Muon::NoArbitration) >= isoDepositMinNumberOfMatches_ );
+}
+
 void MuonIdProducer::fillMuonIsolation(edm::Event& iEvent, const edm::EventSetup& iSetup, reco::Muon& aMuon,
-				       reco::IsoDeposit& trackDep, reco::IsoDeposit& ecalDep, reco::IsoDeposit& hcalDep, reco::IsoDeposit& hoDep,
-				       reco::IsoDeposit& jetDep)
+				       reco::IsoDeposit* trackDep, reco::IsoDeposit* ecalDep, reco::IsoDeposit* hcalDep, reco::IsoDeposit* hoDep,
+				       reco::IsoDeposit* jetDep)
 {
    reco::MuonIsolation isoR03, isoR05;
    const reco::Track* track = 0;
@@ -1160,15 +1593,16 @@ void MuonIdProducer::fillMuonIsolation(edm::Event& iEvent, const edm::EventSetup
       return;
    }
 
-   reco::IsoDeposit depEcal = caloDeps.at(0);
-   reco::IsoDeposit depHcal = caloDeps.at(1);
-   reco::IsoDeposit depHo   = caloDeps.at(2);
+   const reco::IsoDeposit& depEcal = caloDeps[0];
+   const reco::IsoDeposit& depHcal = caloDeps[1];
+   const reco::IsoDeposit& depHo   = caloDeps[2];
 
-   trackDep = depTrk;
-   ecalDep = depEcal;
-   hcalDep = depHcal;
-   hoDep = depHo;
-   jetDep = depJet;
+   // the deposits are only copied out if they are written to the event
+   if ( trackDep ) *trackDep = depTrk;
+   if ( ecalDep )  *ecalDep  = depEcal;
+   if ( hcalDep )  *hcalDep  = depHcal;
+   if ( hoDep )    *hoDep    = depHo;
+   if ( jetDep )   *jetDep   = depJet;
 
    isoR03.sumPt     = depTrk.depositWithin(0.3);
    isoR03.emEt      = depEcal.depositWithin(0.3);
@@ -1240,10 +1674,9 @@ double MuonIdProducer::phiOfMuonIneteractionRegion( const reco::Muon& muon ) con
    return sectorPhi(muon.matches().at(0).id);
 }
 
-void MuonIdProducer::fillGlbQuality(edm::Event& iEvent, const edm::EventSetup& iSetup, reco::Muon& aMuon)
+void MuonIdProducer::fillGlbQuality(const EventData& data, reco::Muon& aMuon)
 {
-  edm::Handle<edm::ValueMap<reco::MuonQuality> > glbQualH;
-  iEvent.getByLabel(globalTrackQualityInputTag_, glbQualH);
+  const edm::Handle<edm::ValueMap<reco::MuonQuality> >& glbQualH = data.glbQualityHandle;
 
   if(aMuon.isGlobalMuon() && glbQualH.isValid() && !glbQualH.failedToGet()) {
     aMuon.setCombinedQuality((*glbQualH)[aMuon.combinedMuon()]);
@@ -1253,13 +1686,16 @@ void MuonIdProducer::fillGlbQuality(edm::Event& iEvent, const edm::EventSetup& i
 
 }
 
-void MuonIdProducer::fillTrackerKink( reco::Muon& aMuon ) {
-    // skip muons with no tracks
+void MuonIdProducer::fillTrackerKink( const EventData& data, reco::Muon& aMuon ) {
+    // skip muons with no tracks, the others are preselected by fillerPreselection.trackerKink
     if (aMuon.innerTrack().isNull()) return;
     // get quality from muon if already there, otherwise make empty one
     reco::MuonQuality quality = (aMuon.isQualityValid() ? aMuon.combinedQuality() : reco::MuonQuality());
-    // fill it
-    bool filled = trackerKinkFinder_->fillTrkKink(quality, *aMuon.innerTrack());
+    // fill it, from the upstream trajectory if there is one
+    std::map<const reco::Track*, const Trajectory*>::const_iterator trajectory = data.kinkTrajectories.find(aMuon.innerTrack().get());
+    bool filled = trajectory != data.kinkTrajectories.end() ? 
+      trackerKinkFinder_->fillTrkKink(quality, *trajectory->second) :
+      trackerKinkFinder_->fillTrkKink(quality, *aMuon.innerTrack());
     // if quality was there, or if we filled it, commit to the muon 
     if (filled || aMuon.isQualityValid()) aMuon.setCombinedQuality(quality);
 }
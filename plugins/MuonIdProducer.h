@@ -25,6 +25,9 @@
 //
 
 
+// system include files
+#include <map>
+
 // user include files
 #include "FWCore/Framework/interface/Frameworkfwd.h"
 #include "FWCore/Framework/interface/EDProducer.h"
@@ -36,18 +39,28 @@
 #include "FWCore/ParameterSet/interface/ParameterSet.h"
 
 #include "DataFormats/Common/interface/Handle.h"
+#include "DataFormats/Common/interface/ValueMap.h"
 #include "DataFormats/TrackReco/interface/Track.h"
 #include "DataFormats/TrackReco/interface/TrackToTrackMap.h"
 #include "DataFormats/MuonReco/interface/Muon.h"
 #include "DataFormats/MuonReco/interface/MuonTrackLinks.h"
 #include "DataFormats/MuonReco/interface/MuonFwd.h"
+#include "DataFormats/MuonReco/interface/MuonQuality.h"
+#include "DataFormats/RPCRecHit/interface/RPCRecHitCollection.h"
+#include "TrackingTools/PatternTools/interface/TrajTrackAssociation.h"
 
 #include "TrackingTools/TrackAssociator/interface/TrackDetectorAssociator.h"
-// #include "Utilities/Timing/interface/TimerStack.h"
 
 #include "RecoMuon/MuonIdentification/interface/MuonTimingFiller.h"
+#include "RecoMuon/MuonIdentification/interface/MuonIdTruthInfo.h"
+#include "RecoMuon/MuonIdentification/interface/MuonSystemOccupancy.h"
+#include "RecoMuon/MuonIdentification/interface/MuonStationCrossings.h"
 #include "RecoMuon/MuonIdentification/interface/MuonCaloCompatibility.h"
 #include "PhysicsTools/IsolationAlgos/interface/IsoDepositExtractor.h"
+#include "RecoMuon/MuonIdentification/plugins/MuonFillerPreselection.h"
+#include "RecoMuon/MuonIdentification/plugins/MuonIdStageTimers.h"
+#include "RecoMuon/MuonIdentification/plugins/MuonProductSizeReport.h"
+#include "RecoMuon/MuonIdentification/plugins/MuonAssociationCache.h"
 
 class MuonMesh;
 class MuonKinkFinder;
@@ -55,6 +68,31 @@ class MuonKinkFinder;
 class MuonIdProducer : public edm::EDProducer {
  public:
    typedef reco::Muon::MuonTrackType TrackType;
+
+   // Input products of one event. They live on the stack of produce() and
+   // are passed down to the fillers, so that the module itself carries no
+   // per-event state.
+   struct EventData {
+      edm::Handle<reco::TrackCollection>             innerTrackCollectionHandle;
+      edm::Handle<reco::TrackCollection>             outerTrackCollectionHandle;
+      edm::Handle<reco::MuonCollection>              muonCollectionHandle;
+      edm::Handle<reco::MuonTrackLinksCollection>    linkCollectionHandle;
+      edm::Handle<reco::TrackToTrackMap>             tpfmsCollectionHandle;
+      edm::Handle<reco::TrackToTrackMap>             pickyCollectionHandle;
+      edm::Handle<reco::TrackToTrackMap>             dytCollectionHandle;
+      edm::Handle<RPCRecHitCollection>               rpcHitHandle;
+      // quality of the global tracks, if it is filled
+      edm::Handle<edm::ValueMap<reco::MuonQuality> > glbQualityHandle;
+      // upstream trajectories of the inner tracks for the kink finder
+      std::map<const reco::Track*, const Trajectory*> kinkTrajectories;
+      // simulation for the truth matching in the debug mode
+      MuonIdTruthInfo::SimHits                       truthSimHits;
+      // segments and RPC hits by eta-phi, accepts all tracks unless filled
+      MuonSystemOccupancy                            muonOccupancy;
+      // associations of a previous job in the matching-only mode, or the
+      // associations of this event if the cache is written
+      MuonAssociationCache                           associationCache;
+   };
   
    explicit MuonIdProducer(const edm::ParameterSet&);
    
@@ -62,25 +100,44 @@ class MuonIdProducer : public edm::EDProducer {
    
    virtual void produce(edm::Event&, const edm::EventSetup&) override;
    virtual void beginRun(const edm::Run&, const edm::EventSetup&) override;
+   virtual void endJob() override;
    
    static double sectorPhi( const DetId& id );
 
  private:
-   void          fillMuonId( edm::Event&, const edm::EventSetup&, reco::Muon&, 
-			     TrackDetectorAssociator::Direction direction = TrackDetectorAssociator::InsideOut );
+   void          fillMuonId( edm::Event&, const edm::EventSetup&, EventData&, reco::Muon&, 
+			     TrackDetectorAssociator::Direction direction = TrackDetectorAssociator::InsideOut,
+			     bool withEnergy = true, bool withMuonSystem = true );
+   void          fillMuonEnergy( const TrackDetMatchInfo&, reco::Muon& );
+   // calorimeter only association of a candidate filled without energy
+   void          fillDeferredMuonEnergy( edm::Event&, const edm::EventSetup&, EventData&, reco::Muon&,
+					 TrackDetectorAssociator::Direction direction );
+   // run the track - detector association for every good inner track
+   // (both legs of split tracks) without looking at other candidates,
+   // the directions used are returned in the same order as the candidates
+   void          fillTrackerMuonCandidates( edm::Event&, const edm::EventSetup&, EventData&,
+					    std::vector<reco::Muon>&,
+					    std::vector<TrackDetectorAssociator::Direction>& );
    void          fillArbitrationInfo( reco::MuonCollection* );
+   /// segment match passing the dx, dy and pull cuts of the producer
+   bool          isMatchedSegment( const reco::MuonChamberMatch&, const reco::MuonSegmentMatch& ) const;
+   /// drop the segment matches failing the cuts of the producer
+   void          applyMatchingCuts( std::vector<reco::MuonChamberMatch>& ) const;
+   /// the deposits are copied to the non-null arguments
    void          fillMuonIsolation( edm::Event&, const edm::EventSetup&, reco::Muon& aMuon,
-				    reco::IsoDeposit& trackDep, reco::IsoDeposit& ecalDep, reco::IsoDeposit& hcalDep, reco::IsoDeposit& hoDep,
-				    reco::IsoDeposit& jetDep);
-   void          fillGlbQuality( edm::Event&, const edm::EventSetup&, reco::Muon& aMuon );
-   void          fillTrackerKink( reco::Muon& aMuon ); 
-   void          init( edm::Event&, const edm::EventSetup& );
+				    reco::IsoDeposit* trackDep = 0, reco::IsoDeposit* ecalDep = 0, reco::IsoDeposit* hcalDep = 0,
+				    reco::IsoDeposit* hoDep = 0, reco::IsoDeposit* jetDep = 0);
+   /// preselection of the muons whose isolation deposits are written out
+   bool          isoDepositSelected( const reco::Muon& muon ) const;
+   void          fillGlbQuality( const EventData&, reco::Muon& aMuon );
+   void          fillTrackerKink( const EventData&, reco::Muon& aMuon ); 
+   void          init( edm::Event&, const edm::EventSetup&, EventData& );
    
    // make a muon based on a track ref
    reco::Muon    makeMuon( edm::Event& iEvent, const edm::EventSetup& iSetup, 
 			   const reco::TrackRef& track, TrackType type);
    // make a global muon based on the links object
-   reco::Muon    makeMuon( const reco::MuonTrackLinks& links );
+   reco::Muon    makeMuon( const EventData&, const reco::MuonTrackLinks& links );
    
    // make a muon based on track (p4)
    reco::Muon    makeMuon( const reco::Track& track );
@@ -91,25 +148,66 @@ class MuonIdProducer : public edm::EDProducer {
    bool          isGoodTrack( const reco::Track& track );
    
    bool          isGoodTrackerMuon( const reco::Muon& muon );
+   /// compare the predicted stations of a track to the chamber matches
+   void          validateStationCrossings( const MuonStationCrossings&, unsigned int index, const reco::Muon& );
    bool          isGoodRPCMuon( const reco::Muon& muon );
    
    // check number of common DetIds for a given trackerMuon and a stand alone
    // muon track
    int           overlap(const reco::Muon& muon, const reco::Track& track);
+   // same for precomputed, sorted chamber id lists
+   int           overlap(const std::vector<unsigned int>& muonChamberIds,
+			 const std::vector<unsigned int>& trackChamberIds);
+   // sorted DT/CSC chamber ids of the muon matches with segments
+   void          matchedChamberIds(const reco::Muon& muon, std::vector<unsigned int>& ids);
+   // sorted DT/CSC chamber ids of the track hits
+   void          trackChamberIds(const reco::Track& track, std::vector<unsigned int>& ids);
 
    unsigned int  chamberId(const DetId&);
    
    double phiOfMuonIneteractionRegion( const reco::Muon& muon ) const;
 
    bool checkLinks(const reco::MuonTrackLinks*) const ;
+
+   // indices of links sharing a track
+   typedef std::map<reco::TrackRef, std::vector<unsigned int> > LinkGroups;
+   // tracker, stand-alone and global track of a muon
+   typedef std::pair<reco::TrackRef, std::pair<reco::TrackRef, reco::TrackRef> > LinkedTracks;
      
    TrackDetectorAssociator trackAssociator_;
    TrackAssociatorParameters parameters_;
+   bool deferSplitTrackEnergy_;
+   bool muonSystemOnlyWithoutEnergy_;
+   // write the associations for a matching-only rerun, or take them from
+   // the cache instead of propagating the tracks
+   bool writeAssociationCache_;
+   edm::InputTag associationCacheTag_;
+   // tracker muon candidates without segments or RPC hits in their road
+   // skip the muon system association
+   bool useMuonOccupancyFilter_;
+   MuonSystemOccupancy muonOccupancyRoad_;
+   // tracker muon candidates predicted to miss the muon stations skip the
+   // muon system association, in the validation mode the prediction is
+   // compared to the chambers of the association instead
+   bool useStationCrossingFilter_;
+   bool validateStationCrossings_;
+   MuonStationCrossings::Parameters stationCrossingParameters_;
+   unsigned long long nCrossingsValidated_;
+   unsigned long long nCrossingsSameStations_;
+   unsigned long long nCrossingsMissed_;
+   unsigned long long nCrossingsMissedWithMatches_;
+   unsigned long long nCrossingsUncertain_;
+   TrackAssociatorParameters muonParameters_;
+   TrackAssociatorParameters caloParameters_;
    
    std::vector<edm::InputTag> inputCollectionLabels_;
    std::vector<std::string>   inputCollectionTypes_;
+   // the types above resolved once at construction
+   enum InputCollectionType { InnerTracks, OuterTracks, Links, Muons, TevFirstHit, TevPicky, TevDyt };
+   std::vector<InputCollectionType> inputCollectionTypeIds_;
+   edm::InputTag rpcHitTag_;
 
-   MuonTimingFiller* theTimingFiller_;
+   std::auto_ptr<MuonTimingFiller> theTimingFiller_;
 
    // selections
    double minPt_;
@@ -131,23 +229,17 @@ class MuonIdProducer : public edm::EDProducer {
    bool fillMatching_;
    bool fillIsolation_;
    bool writeIsoDeposits_;
+   double isoDepositMinPt_;
+   int    isoDepositMinNumberOfMatches_;
    double ptThresholdToFillCandidateP4WithGlobalFit_;
    double sigmaThresholdToFillCandidateP4WithGlobalFit_;
    
    bool debugWithTruthMatching_;
 
-   edm::Handle<reco::TrackCollection>             innerTrackCollectionHandle_;
-   edm::Handle<reco::TrackCollection>             outerTrackCollectionHandle_;
-   edm::Handle<reco::MuonCollection>              muonCollectionHandle_;
-   edm::Handle<reco::MuonTrackLinksCollection>    linkCollectionHandle_;
-   edm::Handle<reco::TrackToTrackMap>             tpfmsCollectionHandle_;
-   edm::Handle<reco::TrackToTrackMap>             pickyCollectionHandle_;
-   edm::Handle<reco::TrackToTrackMap>             dytCollectionHandle_;
-   
    MuonCaloCompatibility muonCaloCompatibility_;
-   reco::isodeposit::IsoDepositExtractor* muIsoExtractorCalo_;
-   reco::isodeposit::IsoDepositExtractor* muIsoExtractorTrack_;
-   reco::isodeposit::IsoDepositExtractor* muIsoExtractorJet_;
+   std::auto_ptr<reco::isodeposit::IsoDepositExtractor> muIsoExtractorCalo_;
+   std::auto_ptr<reco::isodeposit::IsoDepositExtractor> muIsoExtractorTrack_;
+   std::auto_ptr<reco::isodeposit::IsoDepositExtractor> muIsoExtractorJet_;
    std::string trackDepositName_;
    std::string ecalDepositName_;
    std::string hcalDepositName_;
@@ -160,11 +252,24 @@ class MuonIdProducer : public edm::EDProducer {
 
    bool fillTrackerKink_;
    std::auto_ptr<MuonKinkFinder> trackerKinkFinder_;
+   // optional trajectories used instead of the refit
+   edm::InputTag trackerKinkTrajectories_;
 
    double caloCut_;
    
    bool arbClean_;
-   MuonMesh* meshAlgo_;
+   std::auto_ptr<MuonMesh> meshAlgo_;
+
+   // muons failing these cuts skip the filler in the dressing loop
+   MuonFillerPreselection muonIdPreselection_;
+   MuonFillerPreselection glbQualityPreselection_;
+   MuonFillerPreselection trackerKinkPreselection_;
+   MuonFillerPreselection isolationPreselection_;
+   MuonFillerPreselection timingPreselection_;
+   MuonFillerPreselection caloCompatibilityPreselection_;
+
+   MuonIdStageTimers stageTimers_;
+   MuonProductSizeReport productSizes_;
 
 };
 #endif
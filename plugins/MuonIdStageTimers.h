@@ -0,0 +1,87 @@
+#ifndef MuonIdentification_MuonIdStageTimers_h
+#define MuonIdentification_MuonIdStageTimers_h
+
+/** \class MuonIdStageTimers
+ *
+ * Optional accounting of the time spent in the stages of the muon
+ * identification. Each stage accumulates the real and cpu time and the
+ * number of calls over the job, the summary is written to the MessageLogger
+ * at the end of the job. When disabled, starting and stopping a stage does
+ * nothing, so the timers can stay in the code.
+ *
+ */
+
+#include <iomanip>
+#include <string>
+
+#include "FWCore/Utilities/interface/CPUTimer.h"
+#include "FWCore/MessageLogger/interface/MessageLogger.h"
+
+class MuonIdStageTimers {
+ public:
+   enum Stage { InputMerge, TrackerMuons, StandAloneMuons, MuonId, GlobalQuality, TrackerKink,
+		Isolation, Timing, CaloCompatibility, Arbitration, Mesh, NumberOfStages };
+
+   MuonIdStageTimers() : enabled_(false), nEvents_(0) {
+      for ( unsigned int i = 0; i < NumberOfStages; ++i ) calls_[i] = 0;
+   }
+
+   void setEnabled( bool enabled ) { enabled_ = enabled; }
+   bool enabled() const { return enabled_; }
+
+   void beginEvent() { if ( enabled_ ) ++nEvents_; }
+   void start( Stage stage ) { if ( enabled_ ) timers_[stage].start(); }
+   void stop( Stage stage ) {
+      if ( ! enabled_ ) return;
+      timers_[stage].stop();
+      ++calls_[stage];
+   }
+
+   /// stops the stage when going out of scope
+   class Sentry {
+    public:
+      Sentry( MuonIdStageTimers& timers, Stage stage ) : timers_(timers), stage_(stage) { timers_.start(stage_); }
+      ~Sentry() { timers_.stop(stage_); }
+    private:
+      MuonIdStageTimers& timers_;
+      Stage stage_;
+   };
+
+   void report( const std::string& category ) const {
+      if ( ! enabled_ ) return;
+      edm::LogInfo log(category);
+      log << "Time per stage in " << nEvents_ << " events (real/cpu in s, calls, real ms per event):";
+      for ( unsigned int i = 0; i < NumberOfStages; ++i )
+	log << "\n  " << std::setw(18) << std::left << name(Stage(i)) << std::right
+	    << " " << std::setw(10) << timers_[i].realTime() << " " << std::setw(10) << timers_[i].cpuTime()
+	    << " " << std::setw(10) << calls_[i]
+	    << " " << std::setw(10) << ( nEvents_ > 0 ? 1000.*timers_[i].realTime()/nEvents_ : 0. );
+      log << "\n  (arbitration includes the mesh)";
+   }
+
+   static const char* name( Stage stage ) {
+      switch ( stage ) {
+       case InputMerge:        return "input merge";
+       case TrackerMuons:      return "tracker muons";
+       case StandAloneMuons:   return "stand-alone muons";
+       case MuonId:            return "muon id";
+       case GlobalQuality:     return "global quality";
+       case TrackerKink:       return "tracker kink";
+       case Isolation:         return "isolation";
+       case Timing:            return "timing";
+       case CaloCompatibility: return "calo compatibility";
+       case Arbitration:       return "arbitration";
+       case Mesh:              return "mesh";
+       default:                return "unknown";
+      }
+   }
+
+ private:
+   bool enabled_;
+   unsigned long long nEvents_;
+   // the timers are not copyable
+   edm::CPUTimer timers_[NumberOfStages];
+   unsigned long long calls_[NumberOfStages];
+};
+
+#endif
@@ -24,6 +24,7 @@
 
 #include "DataFormats/Common/interface/Handle.h"
 #include "DataFormats/TrackReco/interface/Track.h"
+#include "DataFormats/TrackReco/interface/TrackFwd.h"
 #include "DataFormats/MuonReco/interface/MuonFwd.h"
 #include "DataFormats/MuonReco/interface/Muon.h"
 #include "DataFormats/MuonReco/interface/MuonTrackLinks.h"
@@ -35,6 +36,13 @@ MuonLinksProducer::MuonLinksProducer(const edm::ParameterSet& iConfig)
 {
    produces<reco::MuonTrackLinksCollection>();
    m_inputCollection = iConfig.getParameter<edm::InputTag>("inputCollection");
+   m_produceInclusiveLinks = iConfig.existsAs<bool>("produceInclusiveLinks") ?
+     iConfig.getParameter<bool>("produceInclusiveLinks") : false;
+   if ( m_produceInclusiveLinks ) {
+      produces<reco::MuonTrackLinksCollection>("inclusive");
+      m_inclusiveTrackCollection = iConfig.getParameter<edm::InputTag>("InclusiveTrackerTrackCollection");
+      m_trackHitIndex.reset(new MuonLinksTrackHitIndex(iConfig));
+   }
 }
 
 MuonLinksProducer::~MuonLinksProducer()
@@ -53,5 +61,20 @@ void MuonLinksProducer::produce(edm::Event& iEvent, const edm::EventSetup& iSetu
 	if ( ! muon->isGlobalMuon() ) continue;
 	output->push_back( reco::MuonTrackLinks( muon->track(), muon->standAloneMuon(), muon->combinedMuon() ) );
      }
+
+   if ( m_produceInclusiveLinks ) {
+      std::auto_ptr<reco::MuonTrackLinksCollection> inclusive(new reco::MuonTrackLinksCollection());
+      edm::Handle<reco::TrackCollection> incTracks;
+      iEvent.getByLabel(m_inclusiveTrackCollection, incTracks);
+      m_trackHitIndex->build(*incTracks);
+      for ( reco::MuonTrackLinksCollection::const_iterator link = output->begin();
+	    link != output->end(); ++link )
+	{
+	   int trackIndex = m_trackHitIndex->match(*link->trackerTrack());
+	   reco::TrackRef track = trackIndex >= 0 ? reco::TrackRef(incTracks,trackIndex) : link->trackerTrack();
+	   inclusive->push_back( reco::MuonTrackLinks( track, link->standAloneTrack(), link->globalTrack() ) );
+	}
+      iEvent.put( inclusive, "inclusive" );
+   }
    iEvent.put( output );
 }
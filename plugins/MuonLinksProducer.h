@@ -10,6 +10,9 @@
  Simple producer to make reco::MuonTrackLinks collection 
  out of the global muons from "muons" collection to restore
  dropped links used as input for MuonIdProducer.
+ Optionally the links with the tracker track replaced by the
+ inclusive tracker track sharing its hits are written in the same
+ pass (instance "inclusive"), as MuonLinksProducerForHLT does.
  */
 //
 // Original Author:  Dmytro Kovalskyi
@@ -23,6 +26,8 @@
 #include "FWCore/Framework/interface/EDProducer.h"
 #include "FWCore/Framework/interface/Event.h"
 #include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "RecoMuon/MuonIdentification/plugins/MuonLinksTrackHitIndex.h"
+#include <memory>
 
 class MuonLinksProducer : public edm::EDProducer {
  public:
@@ -34,5 +39,8 @@ class MuonLinksProducer : public edm::EDProducer {
 
  private:
    edm::InputTag m_inputCollection;
+   bool m_produceInclusiveLinks;
+   edm::InputTag m_inclusiveTrackCollection;
+   std::auto_ptr<MuonLinksTrackHitIndex> m_trackHitIndex;
 };
 #endif
@@ -18,6 +18,7 @@
 #include "FWCore/Framework/interface/EDProducer.h"
 #include "FWCore/Framework/interface/Event.h"
 #include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "RecoMuon/MuonIdentification/plugins/MuonLinksTrackHitIndex.h"
 
 class MuonLinksProducerForHLT : public edm::EDProducer {
  public:
@@ -30,8 +31,6 @@ class MuonLinksProducerForHLT : public edm::EDProducer {
  private:
    edm::InputTag theLinkCollectionInInput;
    edm::InputTag theInclusiveTrackCollectionInInput;
-   double ptMin;
-   double pMin;
-   double shareHitFraction;
+   MuonLinksTrackHitIndex theTrackHitIndex;
 };
 #endif
@@ -0,0 +1,125 @@
+#ifndef MuonIdentification_MuonLinksTrackHitIndex_h
+#define MuonIdentification_MuonLinksTrackHitIndex_h
+
+/** \class MuonLinksTrackHitIndex
+ *
+ * Index of the hits of the inclusive tracker tracks of an event, used to
+ * replace the tracker track of the muon links by the inclusive track which
+ * shares its hits. The index is built once per event: the hits of the tracks
+ * passing the momentum cuts are copied with the DetId they are on, ordered
+ * by DetId, so that for each muon only the hits on the DetIds of the muon
+ * track are compared. A track matches if more than shareHitFraction of the
+ * hits of the shorter of the two tracks are shared; the first matching
+ * track of the collection is taken.
+ *
+ */
+
+#include <algorithm>
+#include <vector>
+
+#include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "DataFormats/TrackReco/interface/Track.h"
+#include "DataFormats/TrackReco/interface/TrackFwd.h"
+#include "DataFormats/TrackingRecHit/interface/TrackingRecHit.h"
+
+class MuonLinksTrackHitIndex {
+ public:
+   typedef std::pair<uint32_t, const TrackingRecHit*> Hit;
+
+   explicit MuonLinksTrackHitIndex( const edm::ParameterSet& iConfig ) :
+     ptMin_(iConfig.getParameter<double>("ptMin")),
+     pMin_(iConfig.getParameter<double>("pMin")),
+     shareHitFraction_(iConfig.getParameter<double>("shareHitFraction")) {}
+
+   /// index the hits of the tracks passing the momentum cuts
+   void build( const reco::TrackCollection& tracks ) {
+      detIdIndex_.clear();
+      hits_.clear();
+      hitOffsets_.assign(tracks.size()+1, 0);
+      maxCommonHits_.assign(tracks.size(), 0);
+      for ( unsigned int trackIndex = 0; trackIndex < tracks.size(); ++trackIndex ) {
+	 hitOffsets_[trackIndex] = hits_.size();
+	 const reco::Track& track = tracks[trackIndex];
+	 if ( track.pt() < ptMin_ ) continue;
+	 if ( track.p() < pMin_ ) continue;
+	 for ( TrackingRecHitRefVector::const_iterator hit = track.extra()->recHitsBegin();
+	       hit != track.extra()->recHitsEnd(); ++hit ) {
+	    const uint32_t detId = hit->get()->geographicalId().rawId();
+	    detIdIndex_.push_back(std::make_pair(detId, trackIndex));
+	    hits_.push_back(Hit(detId, hit->get()));
+	 }
+      }
+      hitOffsets_[tracks.size()] = hits_.size();
+      std::sort(detIdIndex_.begin(), detIdIndex_.end());
+   }
+
+   /// index of the first track sharing the hits of the muon tracker track, -1 if none
+   int match( const reco::Track& muonTrack ) {
+      const reco::TrackExtraRef& muonExtra = muonTrack.extra();
+      const unsigned int muonTrackHits = muonExtra->recHits().size();
+
+      // hits of the muon tracker track ordered by DetId
+      muonHits_.clear();
+      for ( TrackingRecHitRefVector::const_iterator mit = muonExtra->recHitsBegin();
+	    mit != muonExtra->recHitsEnd(); ++mit )
+	muonHits_.push_back(Hit(mit->get()->geographicalId().rawId(), mit->get()));
+      std::sort(muonHits_.begin(), muonHits_.end());
+
+      // a track hit can only be shared if the muon has a hit on the same DetId:
+      // count those hits of every track as an upper bound of the shared hits
+      std::fill(maxCommonHits_.begin(), maxCommonHits_.end(), 0);
+      for ( unsigned int i = 0; i < muonHits_.size(); ++i ) {
+	 if ( i > 0 && muonHits_[i].first == muonHits_[i-1].first ) continue;
+	 std::vector<std::pair<uint32_t, unsigned int> >::const_iterator entry =
+	   std::lower_bound(detIdIndex_.begin(), detIdIndex_.end(), std::make_pair(muonHits_[i].first, 0u));
+	 for ( ; entry != detIdIndex_.end() && entry->first == muonHits_[i].first; ++entry )
+	   maxCommonHits_[entry->second]++;
+      }
+
+      for ( unsigned int trackIndex = 0; trackIndex < maxCommonHits_.size(); ++trackIndex ) {
+	 if ( maxCommonHits_[trackIndex] == 0 ) continue;
+	 const unsigned int trackHits = hitOffsets_[trackIndex+1] - hitOffsets_[trackIndex];
+	 const unsigned int smallestNumberOfHits = trackHits < muonTrackHits ? trackHits : muonTrackHits;
+	 if ( (double)maxCommonHits_[trackIndex]/smallestNumberOfHits <= shareHitFraction_ ) continue;
+	 if ( sharesHits(trackIndex, smallestNumberOfHits) ) return trackIndex;
+      }
+      return -1;
+   }
+
+ private:
+   /// the fraction only grows with the hits, so the loop stops as soon as
+   /// the threshold is passed or cannot be reached any more
+   bool sharesHits( unsigned int trackIndex, unsigned int smallestNumberOfHits ) const {
+      int numberOfCommonDetIds = 0;
+      int remainingHits = maxCommonHits_[trackIndex];
+      for ( unsigned int i = hitOffsets_[trackIndex]; i < hitOffsets_[trackIndex+1]; ++i ) {
+	 const Hit key(hits_[i].first, 0);
+	 std::vector<Hit>::const_iterator mit = std::lower_bound(muonHits_.begin(), muonHits_.end(), key);
+	 if ( mit == muonHits_.end() || mit->first != key.first ) continue;
+	 for ( ; mit != muonHits_.end() && mit->first == key.first; ++mit ) {
+	    if ( hits_[i].second->sharesInput(mit->second,TrackingRecHit::some) ) {
+	       numberOfCommonDetIds++;
+	       break;
+	    }
+	 }
+	 remainingHits--;
+	 if ( (double)numberOfCommonDetIds/smallestNumberOfHits > shareHitFraction_ ) return true;
+	 if ( (double)(numberOfCommonDetIds + remainingHits)/smallestNumberOfHits <= shareHitFraction_ ) return false;
+      }
+      return false;
+   }
+
+   double ptMin_;
+   double pMin_;
+   double shareHitFraction_;
+
+   // (DetId, track) for every indexed hit, ordered by DetId
+   std::vector<std::pair<uint32_t, unsigned int> > detIdIndex_;
+   // the hits of the tracks in their order, the hits of track i start at hitOffsets_[i]
+   std::vector<Hit> hits_;
+   std::vector<unsigned int> hitOffsets_;
+   // per muon
+   std::vector<Hit> muonHits_;
+   std::vector<unsigned int> maxCommonHits_;
+};
+#endif
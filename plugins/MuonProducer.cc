@@ -14,6 +14,7 @@
 #include "FWCore/Framework/interface/EventSetup.h"
 #include "FWCore/ParameterSet/interface/ParameterSet.h"
 #include "FWCore/MessageLogger/interface/MessageLogger.h"
+#include "FWCore/Utilities/interface/Exception.h"
 
 #include "DataFormats/MuonReco/interface/Muon.h"
 #include "DataFormats/MuonReco/interface/MuonTrackLinks.h"
@@ -21,6 +22,7 @@
 #include "DataFormats/MuonReco/interface/MuonShower.h"
 #include "DataFormats/MuonReco/interface/MuonCosmicCompatibility.h"
 #include "DataFormats/MuonReco/interface/MuonToMuonMap.h"
+#include "DataFormats/MuonReco/interface/MuonSegmentMatch.h"
 
 #include "DataFormats/ParticleFlowCandidate/interface/PFCandidate.h"
 #include "DataFormats/ParticleFlowCandidate/interface/PFCandidateFwd.h"
@@ -38,13 +40,34 @@
 
 using std::endl;
 
-typedef std::map<reco::MuonRef, unsigned int> MuToPFMap;
-
-
 namespace reco {
   typedef edm::ValueMap<reco::MuonShower> MuonShowerMap;
 }
 
+namespace {
+  // segment arbitration flags by name, for the configuration of the slimming
+  unsigned int segmentMask(const std::string& name){
+    struct Flag { const char* name; unsigned int mask; };
+    static const Flag flags[] = {
+      {"BestInChamberByDX",        reco::MuonSegmentMatch::BestInChamberByDX},
+      {"BestInChamberByDR",        reco::MuonSegmentMatch::BestInChamberByDR},
+      {"BestInChamberByDXSlope",   reco::MuonSegmentMatch::BestInChamberByDXSlope},
+      {"BestInChamberByDRSlope",   reco::MuonSegmentMatch::BestInChamberByDRSlope},
+      {"BestInStationByDX",        reco::MuonSegmentMatch::BestInStationByDX},
+      {"BestInStationByDR",        reco::MuonSegmentMatch::BestInStationByDR},
+      {"BestInStationByDXSlope",   reco::MuonSegmentMatch::BestInStationByDXSlope},
+      {"BestInStationByDRSlope",   reco::MuonSegmentMatch::BestInStationByDRSlope},
+      {"BelongsToTrackByDX",       reco::MuonSegmentMatch::BelongsToTrackByDX},
+      {"BelongsToTrackByDR",       reco::MuonSegmentMatch::BelongsToTrackByDR},
+      {"BelongsToTrackByDXSlope",  reco::MuonSegmentMatch::BelongsToTrackByDXSlope},
+      {"BelongsToTrackByDRSlope",  reco::MuonSegmentMatch::BelongsToTrackByDRSlope}
+    };
+    for(unsigned int i = 0; i < sizeof(flags)/sizeof(flags[0]); ++i)
+      if(name == flags[i].name) return flags[i].mask;
+    throw cms::Exception("Configuration") << "MuonProducer: unknown segment arbitration flag " << name;
+  }
+}
+
 
 /// Constructor
 MuonProducer::MuonProducer(const edm::ParameterSet& pSet):debug_(pSet.getUntrackedParameter<bool>("ActivateDebug",false)){
@@ -67,6 +90,17 @@ MuonProducer::MuonProducer(const edm::ParameterSet& pSet):debug_(pSet.getUntrack
   fillShoweringInfo_          = pSet.getParameter<bool>("FillShoweringInfo");
   fillTimingInfo_             = pSet.getParameter<bool>("FillTimingInfo");
 
+  // Optionally keep only the arbitrated segment matches
+  slimMatches_ = pSet.existsAs<bool>("SlimMatches") ? pSet.getParameter<bool>("SlimMatches") : false;
+  slimMatchesSegmentMask_ = 0;
+  if(slimMatches_){
+    std::vector<std::string> flags = pSet.getParameter<std::vector<std::string> >("SlimMatchesSegmentFlags");
+    for(std::vector<std::string>::const_iterator flag = flags.begin(); flag != flags.end(); ++flag)
+      slimMatchesSegmentMask_ |= segmentMask(*flag);
+  }
+
+  productSizes_.setEnabled(pSet.existsAs<bool>("ReportProductSizes") ? pSet.getParameter<bool>("ReportProductSizes") : false);
+
   produces<reco::MuonCollection>();
 
   if(fillTimingInfo_){
@@ -163,11 +197,18 @@ MuonProducer::~MuonProducer(){
 }
 
 
+void MuonProducer::endJob(){
+  productSizes_.report("MuonProducer");
+}
+
+
 /// reconstruct muons
 void MuonProducer::produce(edm::Event& event, const edm::EventSetup& eventSetup){
 
    const std::string metname = "Muon|RecoMuon|MuonIdentification|MuonProducer";
 
+   productSizes_.beginEvent();
+
    // the muon collection, it will be loaded in the event
    std::auto_ptr<reco::MuonCollection> outputMuons(new reco::MuonCollection());
    reco::MuonRefProd outputMuonsRefProd = event.getRefBeforePut<reco::MuonCollection>();
@@ -191,23 +232,12 @@ void MuonProducer::produce(edm::Event& event, const edm::EventSetup& eventSetup)
    
    int nMuons=inputMuons->size();
 
-   std::vector<reco::MuonTimeExtra> dtTimeColl(nMuons);
-   std::vector<reco::MuonTimeExtra> cscTimeColl(nMuons);
-   std::vector<reco::MuonTimeExtra> combinedTimeColl(nMuons);
-
    if(fillTimingInfo_){
      event.getByLabel(theMuonsCollectionLabel.label(),"combined",timeMapCmb);
      event.getByLabel(theMuonsCollectionLabel.label(),"dt",timeMapDT);
      event.getByLabel(theMuonsCollectionLabel.label(),"csc",timeMapCSC);
    }
 
-   std::vector<reco::IsoDeposit> trackDepColl(nMuons);
-   std::vector<reco::IsoDeposit> ecalDepColl(nMuons);
-   std::vector<reco::IsoDeposit> hcalDepColl(nMuons);
-   std::vector<reco::IsoDeposit> hoDepColl(nMuons);
-   std::vector<reco::IsoDeposit> jetDepColl(nMuons);
-
-
    edm::Handle<reco::IsoDepositMap> trackIsoDepMap;
    edm::Handle<reco::IsoDepositMap> ecalIsoDepMap;
    edm::Handle<reco::IsoDepositMap> hcalIsoDepMap;
@@ -226,19 +256,15 @@ void MuonProducer::produce(edm::Event& event, const edm::EventSetup& eventSetup)
    
 
    std::vector<std::map<std::string,edm::Handle<edm::ValueMap<double> > > > pfIsoMaps;
-   std::vector<std::map<std::string,std::vector<double> > > pfIsoMapVals;
 
    if(fillPFIsolation_){
     for(unsigned int j=0;j<pfIsoMapNames.size();++j) {
-	std::map<std::string,std::vector<double> > mapVals;
 	std::map<std::string,edm::Handle<edm::ValueMap<double> > > maps;
 	for(std::map<std::string,edm::InputTag>::const_iterator map = pfIsoMapNames.at(j).begin(); map != pfIsoMapNames.at(j).end(); ++map) {
 	  edm::Handle<edm::ValueMap<double> > handleTmp;
 	  event.getByLabel(map->second,handleTmp);
 	  maps[map->first]=handleTmp;
-	  mapVals[map->first].resize(nMuons);
 	}
-	pfIsoMapVals.push_back(mapVals);
 	pfIsoMaps.push_back(maps);
 
     }
@@ -247,110 +273,65 @@ void MuonProducer::produce(edm::Event& event, const edm::EventSetup& eventSetup)
 
    
    std::vector<edm::Handle<edm::ValueMap<bool> > >  selectorMaps(fillSelectors_ ? theSelectorMapNames.size() : 0); 
-   std::vector<std::vector<bool> > selectorMapResults(fillSelectors_ ? theSelectorMapNames.size() : 0);
    if(fillSelectors_){
      unsigned int s=0;
-     for(InputTags::const_iterator tag = theSelectorMapNames.begin(); tag != theSelectorMapNames.end(); ++tag, ++s){
+     for(InputTags::const_iterator tag = theSelectorMapNames.begin(); tag != theSelectorMapNames.end(); ++tag, ++s)
        event.getByLabel(*tag,selectorMaps[s]);
-       selectorMapResults[s].resize(nMuons);
-     }
    }
 
    edm::Handle<reco::MuonShowerMap> showerInfoMap;
    if(fillShoweringInfo_) event.getByLabel(theShowerMapName,showerInfoMap);
 
-   std::vector<reco::MuonShower> showerInfoColl(nMuons);
-
    edm::Handle<edm::ValueMap<unsigned int> > cosmicIdMap;
    if(fillCosmicsIdMap_) event.getByLabel(theCosmicCompMapName,cosmicIdMap);
-   std::vector<unsigned int> cosmicIdColl(fillCosmicsIdMap_ ? nMuons : 0);
    
    edm::Handle<edm::ValueMap<reco::MuonCosmicCompatibility> > cosmicCompMap;
    if(fillCosmicsIdMap_) event.getByLabel(theCosmicCompMapName,cosmicCompMap);
-   std::vector<reco::MuonCosmicCompatibility> cosmicCompColl(fillCosmicsIdMap_ ? nMuons : 0);
 
 
    std::vector<reco::MuonRef> muonRefColl(nMuons);
 
-
-
-   if(inputMuons->empty()) {
-     edm::OrphanHandle<reco::MuonCollection> muonHandle = event.put(outputMuons);
-     
-     if(fillTimingInfo_){
-       fillMuonMap<reco::MuonTimeExtra>(event, muonHandle, combinedTimeColl,"combined");
-       fillMuonMap<reco::MuonTimeExtra>(event, muonHandle, dtTimeColl,"dt");
-       fillMuonMap<reco::MuonTimeExtra>(event, muonHandle, cscTimeColl,"csc");
-     }
-     
-     if(fillDetectorBasedIsolation_){
-       fillMuonMap<reco::IsoDeposit>(event, muonHandle, trackDepColl, labelOrInstance(theTrackDepositName));
-       fillMuonMap<reco::IsoDeposit>(event, muonHandle, jetDepColl,   labelOrInstance(theJetDepositName));
-       fillMuonMap<reco::IsoDeposit>(event, muonHandle, ecalDepColl,  theEcalDepositName.instance());
-       fillMuonMap<reco::IsoDeposit>(event, muonHandle, hcalDepColl,  theHcalDepositName.instance());
-       fillMuonMap<reco::IsoDeposit>(event, muonHandle, hoDepColl,    theHoDepositName.instance());
-     }
-
-     if(fillSelectors_){
-       unsigned int s = 0;
-       for(InputTags::const_iterator tag = theSelectorMapNames.begin(); 
-	   tag != theSelectorMapNames.end(); ++tag, ++s){
-	 fillMuonMap<bool>(event, muonHandle, selectorMapResults[s], labelOrInstance(*tag));
-       }
-     }
-
-     if(fillShoweringInfo_) fillMuonMap<reco::MuonShower>(event, muonHandle, showerInfoColl, labelOrInstance(theShowerMapName));
-
-     if(fillCosmicsIdMap_){
-       fillMuonMap<unsigned int>(event, muonHandle, cosmicIdColl, labelOrInstance(theCosmicCompMapName));
-       fillMuonMap<reco::MuonCosmicCompatibility>(event, muonHandle, cosmicCompColl, labelOrInstance(theCosmicCompMapName));
-     }
-
-     fillMuonMap<reco::MuonRef>(event,inputMuonsOH, muonRefColl, theMuToMuMapName);
-
-     if(fillPFIsolation_){
-       for(unsigned int j=0;j<pfIsoMapNames.size();++j) 
-	 for(std::map<std::string,edm::InputTag>::const_iterator map = pfIsoMapNames.at(j).begin(); map != pfIsoMapNames.at(j).end(); ++map) {
-	   fillMuonMap<double>(event, muonHandle, pfIsoMapVals.at(j)[map->first], labelOrInstance(map->second));
-	}
-     }
-     return;
-   }
-   
    // FIXME: add the option to swith off the Muon-PF "info association".
    
 
-   MuToPFMap muToPFMap;
+   // index of the PF candidate of each input muon, -1 if there is none
+   std::vector<int> muToPFMap;
 
-   if(fillPFMomentum_){
+   if(fillPFMomentum_ && !inputMuons->empty()){
+     muToPFMap.resize(nMuons, -1);
+     unsigned int nPFMuons = 0;
      dout << "Number of PFCandidates: " << pfCandidates->size() << endl;
      for(unsigned int i=0;i< pfCandidates->size();++i)
        if(abs(pfCandidates->at(i).pdgId()) == 13){
-	 muToPFMap[pfCandidates->at(i).muonRef()] = i;
-	 dout << "MuonRef: " << pfCandidates->at(i).muonRef().id() << " " << pfCandidates->at(i).muonRef().key() << " PF p4: " << pfCandidates->at(i).p4() << endl;
+	 const reco::MuonRef& pfMuonRef = pfCandidates->at(i).muonRef();
+	 dout << "MuonRef: " << pfMuonRef.id() << " " << pfMuonRef.key() << " PF p4: " << pfCandidates->at(i).p4() << endl;
+	 if(pfMuonRef.id() != inputMuons.id() || pfMuonRef.key() >= muToPFMap.size()) continue;
+	 if(muToPFMap[pfMuonRef.key()] < 0) ++nPFMuons;
+	 muToPFMap[pfMuonRef.key()] = i;
        }
-     dout << "Number of PFMuons: " << muToPFMap.size() << endl;
+     dout << "Number of PFMuons: " << nPFMuons << endl;
      dout << "Number of Muons in the original collection: " << inputMuons->size() << endl;
    }
 
+   outputMuons->reserve(nMuons);
+
    reco::MuonRef::key_type muIndex = 0;
-   unsigned int i = 0;
    foreach(const reco::Muon &inMuon, *inputMuons){
      
      reco::MuonRef muRef(inputMuons, muIndex);
-     muonRefColl[i] = reco::MuonRef(outputMuonsRefProd, muIndex++);
+     muonRefColl[muIndex] = reco::MuonRef(outputMuonsRefProd, muIndex);
+     ++muIndex;
 
      // Copy the muon 
      reco::Muon outMuon = inMuon;
     
      if(fillPFMomentum_){ 
      // search for the corresponding pf candidate
-       MuToPFMap::iterator iter =  muToPFMap.find(muRef);
-       if(iter != muToPFMap.end()){
-	 outMuon.setPFP4(pfCandidates->at(iter->second).p4());
-	 outMuon.setP4(pfCandidates->at(iter->second).p4());//PF is the default
-	 outMuon.setBestTrack(pfCandidates->at(iter->second).bestMuonTrackType());
-	 muToPFMap.erase(iter);
+       int pfIndex = muToPFMap[muRef.key()];
+       if(pfIndex >= 0){
+	 outMuon.setPFP4(pfCandidates->at(pfIndex).p4());
+	 outMuon.setP4(pfCandidates->at(pfIndex).p4());//PF is the default
+	 outMuon.setBestTrack(pfCandidates->at(pfIndex).bestMuonTrackType());
 	 dout << "MuonRef: " << muRef.id() << " " << muRef.key() 
 	      << " Is it PF? " << outMuon.isPFMuon() 
 	      << " PF p4: " << outMuon.pfP4() << endl;
@@ -367,72 +348,39 @@ void MuonProducer::produce(edm::Event& event, const edm::EventSetup& eventSetup)
      }
 
      // Add PF isolation info
-     if(fillPFIsolation_){
-       thePFIsoHelper->embedPFIsolation(outMuon,muRef);
-
-       for(unsigned int j=0;j<pfIsoMapNames.size();++j) {
-	 for(std::map<std::string,edm::InputTag>::const_iterator map = pfIsoMapNames[j].begin(); map != pfIsoMapNames[j].end(); ++map){
-	   (pfIsoMapVals[j])[map->first][i] = (*pfIsoMaps[j][map->first])[muRef];
-	 }
-       }
-     }
-     
-     // Fill timing information   
-     if(fillTimingInfo_){
-       combinedTimeColl[i] = (*timeMapCmb)[muRef];
-       dtTimeColl[i] = (*timeMapDT)[muRef];
-       cscTimeColl[i] = (*timeMapCSC)[muRef];
-     }
-     
-     if(fillDetectorBasedIsolation_){
-       trackDepColl[i] = (*trackIsoDepMap)[muRef];
-       ecalDepColl[i]  = (*ecalIsoDepMap)[muRef];
-       hcalDepColl[i]  = (*hcalIsoDepMap)[muRef];
-       hoDepColl[i]    = (*hoIsoDepMap)[muRef];
-       jetDepColl[i]   = (*jetIsoDepMap)[muRef];;
-     }
-     
-     if(fillSelectors_){
-       unsigned int s = 0;
-       for(InputTags::const_iterator tag = theSelectorMapNames.begin(); 
-	   tag != theSelectorMapNames.end(); ++tag, ++s)
-	 selectorMapResults[s][i] = (*selectorMaps[s])[muRef];
-     }
-
-     // Fill the Showering Info
-     if(fillShoweringInfo_) showerInfoColl[i] = (*showerInfoMap)[muRef];
+     if(fillPFIsolation_) thePFIsoHelper->embedPFIsolation(outMuon,muRef);
 
-     if(fillCosmicsIdMap_){
-       cosmicIdColl[i] = (*cosmicIdMap)[muRef];
-       cosmicCompColl[i] = (*cosmicCompMap)[muRef];
-     }
+     if(slimMatches_) slimMatches(outMuon);
 
      outputMuons->push_back(outMuon); 
-     ++i;
    }
    
    dout << "Number of Muons in the new muon collection: " << outputMuons->size() << endl;
+   productSizes_.addMuons("muons", *outputMuons);
    edm::OrphanHandle<reco::MuonCollection> muonHandle = event.put(outputMuons);
 
+   // The output muons are copies of the input ones in the same order, so the
+   // value maps are only re-keyed: the block of each input map that belongs to
+   // the input muons is handed over to the new map as it is.
    if(fillTimingInfo_){
-     fillMuonMap<reco::MuonTimeExtra>(event, muonHandle, combinedTimeColl,"combined");
-     fillMuonMap<reco::MuonTimeExtra>(event, muonHandle, dtTimeColl,"dt");
-     fillMuonMap<reco::MuonTimeExtra>(event, muonHandle, cscTimeColl,"csc");
+     remapMuonMap<reco::MuonTimeExtra>(event, inputMuons, muonHandle, timeMapCmb,"combined");
+     remapMuonMap<reco::MuonTimeExtra>(event, inputMuons, muonHandle, timeMapDT,"dt");
+     remapMuonMap<reco::MuonTimeExtra>(event, inputMuons, muonHandle, timeMapCSC,"csc");
    }
 
    if(fillDetectorBasedIsolation_){
-     fillMuonMap<reco::IsoDeposit>(event, muonHandle, trackDepColl, labelOrInstance(theTrackDepositName));
-     fillMuonMap<reco::IsoDeposit>(event, muonHandle, jetDepColl,   labelOrInstance(theJetDepositName));
-     fillMuonMap<reco::IsoDeposit>(event, muonHandle, ecalDepColl,  theEcalDepositName.instance());
-     fillMuonMap<reco::IsoDeposit>(event, muonHandle, hcalDepColl,  theHcalDepositName.instance());
-     fillMuonMap<reco::IsoDeposit>(event, muonHandle, hoDepColl,    theHoDepositName.instance());
+     remapMuonMap<reco::IsoDeposit>(event, inputMuons, muonHandle, trackIsoDepMap, labelOrInstance(theTrackDepositName));
+     remapMuonMap<reco::IsoDeposit>(event, inputMuons, muonHandle, jetIsoDepMap,   labelOrInstance(theJetDepositName));
+     remapMuonMap<reco::IsoDeposit>(event, inputMuons, muonHandle, ecalIsoDepMap,  theEcalDepositName.instance());
+     remapMuonMap<reco::IsoDeposit>(event, inputMuons, muonHandle, hcalIsoDepMap,  theHcalDepositName.instance());
+     remapMuonMap<reco::IsoDeposit>(event, inputMuons, muonHandle, hoIsoDepMap,    theHoDepositName.instance());
    }
    
    if(fillPFIsolation_){
 
      for(unsigned int j=0;j<pfIsoMapNames.size();++j) {
        for(std::map<std::string,edm::InputTag>::const_iterator map = pfIsoMapNames[j].begin(); map != pfIsoMapNames[j].end(); ++map) 
-	 fillMuonMap<double>(event, muonHandle, pfIsoMapVals[j][map->first], labelOrInstance(map->second));
+	 remapMuonMap<double>(event, inputMuons, muonHandle, pfIsoMaps[j][map->first], labelOrInstance(map->second));
      }
    }   
 
@@ -440,17 +388,19 @@ void MuonProducer::produce(edm::Event& event, const edm::EventSetup& eventSetup)
      unsigned int s = 0;
      for(InputTags::const_iterator tag = theSelectorMapNames.begin(); 
 	 tag != theSelectorMapNames.end(); ++tag, ++s)
-       fillMuonMap<bool>(event, muonHandle, selectorMapResults[s], labelOrInstance(*tag));
+       remapMuonMap<bool>(event, inputMuons, muonHandle, selectorMaps[s], labelOrInstance(*tag));
    }
 
-   if(fillShoweringInfo_) fillMuonMap<reco::MuonShower>(event, muonHandle, showerInfoColl, labelOrInstance(theShowerMapName));
+   if(fillShoweringInfo_) remapMuonMap<reco::MuonShower>(event, inputMuons, muonHandle, showerInfoMap, labelOrInstance(theShowerMapName));
 
    if(fillCosmicsIdMap_){
-     fillMuonMap<unsigned int>(event, muonHandle, cosmicIdColl, labelOrInstance(theCosmicCompMapName));
-     fillMuonMap<reco::MuonCosmicCompatibility>(event, muonHandle, cosmicCompColl, labelOrInstance(theCosmicCompMapName));
+     remapMuonMap<unsigned int>(event, inputMuons, muonHandle, cosmicIdMap, labelOrInstance(theCosmicCompMapName));
+     remapMuonMap<reco::MuonCosmicCompatibility>(event, inputMuons, muonHandle, cosmicCompMap, labelOrInstance(theCosmicCompMapName));
    }
 
    fillMuonMap<reco::MuonRef>(event,inputMuonsOH, muonRefColl, theMuToMuMapName);
+
+   productSizes_.endEvent("MuonProducer");
    
  
 }
@@ -471,10 +421,60 @@ void MuonProducer::fillMuonMap(edm::Event& event,
     filler.insert(muonHandle, muonExtra.begin(), muonExtra.end());
     filler.fill();
   }
+  productSizes_.addValueMap(label, *muonMap);
   event.put(muonMap,label);
 }
 
 
+template<typename TYPE>
+void MuonProducer::remapMuonMap(edm::Event& event,
+				const edm::Handle<reco::MuonCollection>& inputMuons,
+				const edm::OrphanHandle<reco::MuonCollection>& muonHandle,
+				const edm::Handle<edm::ValueMap<TYPE> >& inputMap,
+				const std::string& label){
+
+  typedef typename edm::ValueMap<TYPE>::Filler FILLER; 
+
+  std::auto_ptr<edm::ValueMap<TYPE> > muonMap(new edm::ValueMap<TYPE>());
+  // the input map is only read when there are muons to remap, as without
+  // muons an empty map is written
+  if(!inputMuons->empty()){
+    // the values of one product are stored contiguously and in key order
+    typename edm::ValueMap<TYPE>::const_iterator range = inputMap->begin();
+    for(; range != inputMap->end(); ++range)
+      if(range.id() == inputMuons.id()) break;
+
+    if(range == inputMap->end() || range.size() != inputMuons->size())
+      throw cms::Exception("MuonProducer") << "The input value map for " << label 
+					  << " does not cover the input muon collection " << theMuonsCollectionLabel;
+
+    FILLER filler(*muonMap);
+    filler.insert(muonHandle, range.begin(), range.end());
+    filler.fill();
+  }
+  productSizes_.addValueMap(label, *muonMap);
+  event.put(muonMap,label);
+}
+
+
+void MuonProducer::slimMatches(reco::Muon& muon) const{
+  // the chambers are kept, also without segments, since the expected
+  // stations of the muon selectors are taken from them
+  for(std::vector<reco::MuonChamberMatch>::iterator chamber = muon.matches().begin();
+      chamber != muon.matches().end(); ++chamber){
+    std::vector<reco::MuonSegmentMatch>& segments = chamber->segmentMatches;
+    unsigned int nKept = 0;
+    for(unsigned int i = 0; i < segments.size(); ++i)
+      if(segments[i].mask & slimMatchesSegmentMask_){
+	if(nKept != i) segments[nKept] = segments[i];
+	++nKept;
+      }
+    if(nKept == segments.size()) continue;
+    // shrink the storage to the segments kept
+    std::vector<reco::MuonSegmentMatch>(segments.begin(), segments.begin()+nKept).swap(segments);
+  }
+}
+
 std::string MuonProducer::labelOrInstance(const edm::InputTag &input) const{
   if(fastLabelling_) return input.label();
 
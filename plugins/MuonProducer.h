@@ -18,6 +18,9 @@
 
 #include "DataFormats/MuonReco/interface/MuonFwd.h"
 #include "DataFormats/MuonReco/interface/MuonTimeExtra.h"
+#include "DataFormats/Common/interface/Handle.h"
+#include "DataFormats/Common/interface/ValueMap.h"
+#include "RecoMuon/MuonIdentification/plugins/MuonProductSizeReport.h"
 
 namespace reco {class Track;}
 #include "FWCore/Framework/interface/ESHandle.h"
@@ -38,6 +41,8 @@ public:
   /// reconstruct muons
   virtual void produce(edm::Event&, const edm::EventSetup&);
 
+  virtual void endJob();
+
 
   typedef std::vector<edm::InputTag> InputTags;
 
@@ -49,6 +54,16 @@ private:
 		     const edm::OrphanHandle<reco::MuonCollection>& muonHandle,
 		     const std::vector<TYPE>& muonExtra,
 		     const std::string& label);
+
+  /// put a copy of the input map re-keyed to the output muons, which are
+  /// stored in the same order as the input ones; the input map is not read
+  /// if there are no muons
+  template<typename TYPE>
+    void remapMuonMap(edm::Event& event,
+		      const edm::Handle<reco::MuonCollection>& inputMuons,
+		      const edm::OrphanHandle<reco::MuonCollection>& muonHandle,
+		      const edm::Handle<edm::ValueMap<TYPE> >& inputMap,
+		      const std::string& label);
   
   std::string theAlias;
 
@@ -59,6 +74,9 @@ private:
 
   std::string labelOrInstance(const edm::InputTag &) const;
 
+  /// drop the segment matches without any of the configured arbitration flags
+  void slimMatches(reco::Muon&) const;
+
 private:
   bool debug_;
   bool fastLabelling_;
@@ -75,6 +93,11 @@ private:
   bool fillDetectorBasedIsolation_;
   bool fillShoweringInfo_;
   bool fillTimingInfo_;
+  bool slimMatches_;
+  unsigned int slimMatchesSegmentMask_;
+
+  /// bytes and elements of the products, per event and over the job
+  MuonProductSizeReport productSizes_;
 
   edm::InputTag theTrackDepositName;
   edm::InputTag theEcalDepositName;
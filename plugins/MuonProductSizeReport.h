@@ -0,0 +1,209 @@
+#ifndef MuonIdentification_MuonProductSizeReport_h
+#define MuonIdentification_MuonProductSizeReport_h
+
+/** \class MuonProductSizeReport
+ *
+ * Optional accounting of the size of the products written by the muon
+ * producers. For each product the number of elements and the bytes they
+ * hold in memory, including their vectors and maps, are written to the
+ * MessageLogger for every event (category MuonProductSize) and summed over
+ * the job. The muons are also counted by type, per event and over the job;
+ * a muon is counted once, as the first of global, tracker, stand-alone and
+ * calo muon it is. The heap
+ * blocks are the vectors with allocated memory a muon carries, i.e. the
+ * allocations every copy of the muon makes. When disabled nothing is
+ * computed.
+ *
+ */
+
+#include <iomanip>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "FWCore/MessageLogger/interface/MessageLogger.h"
+#include "DataFormats/Common/interface/ValueMap.h"
+#include "DataFormats/MuonReco/interface/Muon.h"
+#include "DataFormats/MuonReco/interface/MuonFwd.h"
+#include "DataFormats/RecoCandidate/interface/IsoDeposit.h"
+
+class MuonProductSizeReport {
+ public:
+   enum MuonType { Global, Tracker, StandAlone, Calo, Other, NumberOfTypes };
+
+   MuonProductSizeReport() : enabled_(false), nEvents_(0) {
+      for ( unsigned int i = 0; i < NumberOfTypes; ++i ) typeCounts_[i] = typeBytes_[i] = 0;
+      muonBlocks_ = 0;
+      clearEventTypes();
+   }
+
+   void setEnabled( bool enabled ) { enabled_ = enabled; }
+   bool enabled() const { return enabled_; }
+
+   void beginEvent() {
+      if ( ! enabled_ ) return;
+      ++nEvents_;
+      event_.clear();
+      clearEventTypes();
+   }
+
+   void addMuons( const std::string& product, const reco::MuonCollection& muons ) {
+      if ( ! enabled_ ) return;
+      Size size;
+      for ( reco::MuonCollection::const_iterator muon = muons.begin(); muon != muons.end(); ++muon ) {
+	 unsigned int blocks = 0;
+	 unsigned long long muonBytes = bytes(*muon, blocks);
+	 MuonType type = muonType(*muon);
+	 ++typeCounts_[type];
+	 typeBytes_[type] += muonBytes;
+	 muonBlocks_ += blocks;
+	 ++eventTypeCounts_[type];
+	 eventTypeBytes_[type] += muonBytes;
+	 eventMuonBlocks_ += blocks;
+	 ++size.elements;
+	 size.bytes += muonBytes;
+      }
+      add( product, size );
+   }
+
+   template <class T>
+   void addCollection( const std::string& product, const std::vector<T>& collection ) {
+      if ( ! enabled_ ) return;
+      Size size;
+      for ( typename std::vector<T>::const_iterator element = collection.begin(); element != collection.end(); ++element ) {
+	 ++size.elements;
+	 size.bytes += bytes(*element);
+      }
+      add( product, size );
+   }
+
+   template <class T>
+   void addValueMap( const std::string& product, const edm::ValueMap<T>& map ) {
+      if ( ! enabled_ ) return;
+      Size size;
+      for ( typename edm::ValueMap<T>::const_iterator range = map.begin(); range != map.end(); ++range )
+	for ( typename edm::ValueMap<T>::container::const_iterator value = range.begin(); value != range.end(); ++value ) {
+	   ++size.elements;
+	   size.bytes += bytes(*value);
+	}
+      add( product, size );
+   }
+
+   void endEvent( const std::string& producer ) const {
+      if ( ! enabled_ ) return;
+      edm::LogInfo log("MuonProductSize");
+      log << producer << " products of the event (elements, bytes):";
+      for ( std::map<std::string, Size>::const_iterator product = event_.begin(); product != event_.end(); ++product )
+	log << "\n  " << std::setw(24) << std::left << product->first << std::right
+	    << " " << std::setw(8) << product->second.elements << " " << std::setw(10) << product->second.bytes;
+      unsigned long long nMuons = 0;
+      log << "\nMuons of the event by type (muons, bytes):";
+      for ( unsigned int i = 0; i < NumberOfTypes; ++i ) {
+	 nMuons += eventTypeCounts_[i];
+	 log << "\n  " << std::setw(24) << std::left << name(MuonType(i)) << std::right
+	     << " " << std::setw(8) << eventTypeCounts_[i] << " " << std::setw(10) << eventTypeBytes_[i];
+      }
+      log << "\nHeap blocks per muon: " << ( nMuons > 0 ? double(eventMuonBlocks_)/nMuons : 0. );
+   }
+
+   void report( const std::string& category ) const {
+      if ( ! enabled_ ) return;
+      const double n = nEvents_ > 0 ? nEvents_ : 1;
+      edm::LogInfo log(category);
+      log << "Products per event in " << nEvents_ << " events (elements, bytes):";
+      for ( std::map<std::string, Size>::const_iterator product = job_.begin(); product != job_.end(); ++product )
+	log << "\n  " << std::setw(24) << std::left << product->first << std::right
+	    << " " << std::setw(10) << product->second.elements/n << " " << std::setw(12) << product->second.bytes/n;
+      unsigned long long nMuons = 0;
+      log << "\nMuons per event by type (muons, bytes):";
+      for ( unsigned int i = 0; i < NumberOfTypes; ++i ) {
+	 nMuons += typeCounts_[i];
+	 log << "\n  " << std::setw(24) << std::left << name(MuonType(i)) << std::right
+	     << " " << std::setw(10) << typeCounts_[i]/n << " " << std::setw(12) << typeBytes_[i]/n;
+      }
+      log << "\nHeap blocks per muon: " << ( nMuons > 0 ? double(muonBlocks_)/nMuons : 0. );
+   }
+
+   static MuonType muonType( const reco::Muon& muon ) {
+      if ( muon.isGlobalMuon() ) return Global;
+      if ( muon.isTrackerMuon() ) return Tracker;
+      if ( muon.isStandAloneMuon() ) return StandAlone;
+      if ( muon.isCaloMuon() ) return Calo;
+      return Other;
+   }
+
+   static const char* name( MuonType type ) {
+      switch ( type ) {
+       case Global:     return "global";
+       case Tracker:    return "tracker";
+       case StandAlone: return "stand-alone";
+       case Calo:       return "calo";
+       default:         return "other";
+      }
+   }
+
+   /// memory of the muon and of its matches, the vectors holding memory are counted in blocks
+   static unsigned long long bytes( const reco::Muon& muon, unsigned int& blocks ) {
+      unsigned long long size = sizeof(reco::Muon);
+      const std::vector<reco::MuonChamberMatch>& matches = muon.matches();
+      size += capacity(matches, blocks);
+      for ( std::vector<reco::MuonChamberMatch>::const_iterator chamber = matches.begin(); chamber != matches.end(); ++chamber )
+	size += capacity(chamber->segmentMatches, blocks) + capacity(chamber->truthMatches, blocks) +
+	  capacity(chamber->rpcMatches, blocks);
+      return size;
+   }
+   static unsigned long long bytes( const reco::Muon& muon ) {
+      unsigned int blocks = 0;
+      return bytes(muon, blocks);
+   }
+   /// the deposits are kept in a multimap, a node has three pointers and the colour next to the value
+   static unsigned long long bytes( const reco::IsoDeposit& deposit ) {
+      unsigned long long size = sizeof(reco::IsoDeposit);
+      for ( reco::IsoDeposit::const_iterator it = deposit.begin(); it != deposit.end(); ++it )
+	size += sizeof(std::pair<const reco::IsoDeposit::Distance, float>) + 4*sizeof(void*);
+      return size;
+   }
+   template <class T>
+   static unsigned long long bytes( const T& ) { return sizeof(T); }
+
+ private:
+   struct Size {
+      Size() : elements(0), bytes(0) {}
+      unsigned long long elements;
+      unsigned long long bytes;
+   };
+
+   template <class T>
+   static unsigned long long capacity( const std::vector<T>& v, unsigned int& blocks ) {
+      if ( v.capacity() > 0 ) ++blocks;
+      return v.capacity()*sizeof(T);
+   }
+
+   void clearEventTypes() {
+      for ( unsigned int i = 0; i < NumberOfTypes; ++i ) eventTypeCounts_[i] = eventTypeBytes_[i] = 0;
+      eventMuonBlocks_ = 0;
+   }
+
+   void add( const std::string& product, const Size& size ) {
+      Size& event = event_[product];
+      event.elements += size.elements;
+      event.bytes += size.bytes;
+      Size& job = job_[product];
+      job.elements += size.elements;
+      job.bytes += size.bytes;
+   }
+
+   bool enabled_;
+   unsigned long long nEvents_;
+   std::map<std::string, Size> event_;
+   std::map<std::string, Size> job_;
+   unsigned long long typeCounts_[NumberOfTypes];
+   unsigned long long typeBytes_[NumberOfTypes];
+   unsigned long long muonBlocks_;
+   // the same for the current event
+   unsigned long long eventTypeCounts_[NumberOfTypes];
+   unsigned long long eventTypeBytes_[NumberOfTypes];
+   unsigned long long eventMuonBlocks_;
+};
+
+#endif
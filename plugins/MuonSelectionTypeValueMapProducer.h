@@ -14,15 +14,38 @@
 #include "FWCore/Framework/interface/Frameworkfwd.h"
 #include "FWCore/Framework/interface/MakerMacros.h"
 #include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "FWCore/Utilities/interface/Exception.h"
 
+// With "selectionType" a single ValueMap<bool> is produced. With a list of
+// "selectionTypes" all of them are evaluated in one pass over the muons and
+// a ValueMap<bool> per type is put with the instance label "muid"+type;
+// optionally the results are also packed in a ValueMap<unsigned int>
+// ("muidSelectionTypes") with bit muon::SelectionType set for each passed type.
 class MuonSelectionTypeValueMapProducer : public edm::EDProducer {
     public:
         explicit MuonSelectionTypeValueMapProducer(const edm::ParameterSet& iConfig) :
             inputMuonCollection_(iConfig.getParameter<edm::InputTag>("inputMuonCollection")),
-            selectionTypeLabel_(iConfig.getParameter<std::string>("selectionType"))
+            singleType_(!iConfig.existsAs<std::vector<std::string> >("selectionTypes")),
+            fillBoolMaps_(iConfig.existsAs<bool>("fillBoolMaps") ? iConfig.getParameter<bool>("fillBoolMaps") : true),
+            fillPackedMap_(iConfig.existsAs<bool>("fillPackedMap") ? iConfig.getParameter<bool>("fillPackedMap") : false)
         {
-            selectionType_ = muon::selectionTypeFromString(selectionTypeLabel_);
-            produces<edm::ValueMap<bool> >().setBranchAlias("muid"+selectionTypeLabel_);
+            if (singleType_) {
+                selectionTypeLabels_.push_back(iConfig.getParameter<std::string>("selectionType"));
+                selectionTypes_.push_back(muon::selectionTypeFromString(selectionTypeLabels_.front()));
+                produces<edm::ValueMap<bool> >().setBranchAlias("muid"+selectionTypeLabels_.front());
+                fillPackedMap_ = false;
+                return;
+            }
+            selectionTypeLabels_ = iConfig.getParameter<std::vector<std::string> >("selectionTypes");
+            for (std::vector<std::string>::const_iterator label = selectionTypeLabels_.begin(); label != selectionTypeLabels_.end(); ++label) {
+                selectionTypes_.push_back(muon::selectionTypeFromString(*label));
+                if (fillPackedMap_ && selectionTypes_.back() >= 32)
+                    throw cms::Exception("Configuration") << "selection type " << *label << " does not fit in the packed selection map\n";
+                if (fillBoolMaps_)
+                    produces<edm::ValueMap<bool> >("muid"+*label).setBranchAlias("muid"+*label);
+            }
+            if (fillPackedMap_)
+                produces<edm::ValueMap<unsigned int> >("muidSelectionTypes").setBranchAlias("muidSelectionTypes");
         }
         virtual ~MuonSelectionTypeValueMapProducer() {}
 
@@ -30,8 +53,11 @@ class MuonSelectionTypeValueMapProducer : public edm::EDProducer {
         virtual void produce(edm::Event&, const edm::EventSetup&);
 
         edm::InputTag inputMuonCollection_;
-        std::string selectionTypeLabel_;
-        muon::SelectionType selectionType_;
+        bool singleType_;
+        bool fillBoolMaps_;
+        bool fillPackedMap_;
+        std::vector<std::string> selectionTypeLabels_;
+        std::vector<muon::SelectionType> selectionTypes_;
 };
 
 void
@@ -42,21 +68,41 @@ MuonSelectionTypeValueMapProducer::produce(edm::Event& iEvent, const edm::EventS
     iEvent.getByLabel(inputMuonCollection_, muonsH);
 
     // reserve some space
-    std::vector<bool> values;
-    values.reserve(muonsH->size());
+    const unsigned int nTypes = selectionTypes_.size();
+    std::vector<std::vector<bool> > values(nTypes);
+    for (unsigned int i = 0; i < nTypes; ++i) values[i].reserve(muonsH->size());
+    std::vector<unsigned int> packed;
+    if (fillPackedMap_) packed.reserve(muonsH->size());
 
-    // isGoodMuon
-    for(reco::MuonCollection::const_iterator it = muonsH->begin(); it != muonsH->end(); ++it)
-        values.push_back(muon::isGoodMuon(*it, selectionType_));
-
-    // create and fill value map
-    std::auto_ptr<edm::ValueMap<bool> > out(new edm::ValueMap<bool>());
-    edm::ValueMap<bool>::Filler filler(*out);
-    filler.insert(muonsH, values.begin(), values.end());
-    filler.fill();
+    // isGoodMuon, all the types of a muon at once
+    for(reco::MuonCollection::const_iterator it = muonsH->begin(); it != muonsH->end(); ++it) {
+        unsigned int bits = 0;
+        for (unsigned int i = 0; i < nTypes; ++i) {
+            bool good = muon::isGoodMuon(*it, selectionTypes_[i]);
+            values[i].push_back(good);
+            if (good && fillPackedMap_) bits |= 1u << selectionTypes_[i];
+        }
+        if (fillPackedMap_) packed.push_back(bits);
+    }
 
-    // put value map into event
-    iEvent.put(out);
+    // create and fill value maps and put them into the event
+    if (singleType_ || fillBoolMaps_) {
+        for (unsigned int i = 0; i < nTypes; ++i) {
+            std::auto_ptr<edm::ValueMap<bool> > out(new edm::ValueMap<bool>());
+            edm::ValueMap<bool>::Filler filler(*out);
+            filler.insert(muonsH, values[i].begin(), values[i].end());
+            filler.fill();
+            if (singleType_) iEvent.put(out);
+            else iEvent.put(out, "muid"+selectionTypeLabels_[i]);
+        }
+    }
+    if (fillPackedMap_) {
+        std::auto_ptr<edm::ValueMap<unsigned int> > out(new edm::ValueMap<unsigned int>());
+        edm::ValueMap<unsigned int>::Filler filler(*out);
+        filler.insert(muonsH, packed.begin(), packed.end());
+        filler.fill();
+        iEvent.put(out, "muidSelectionTypes");
+    }
 }
 
 #endif
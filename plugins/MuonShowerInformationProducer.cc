@@ -15,6 +15,7 @@
 #include "FWCore/ParameterSet/interface/ParameterSet.h"
 
 #include "RecoMuon/MuonIdentification/interface/MuonShowerInformationFiller.h"
+#include "RecoMuon/MuonIdentification/plugins/MuonFillerPreselection.h"
 
 class MuonShowerInformationProducer : public edm::EDProducer {
 public:
@@ -23,15 +24,19 @@ public:
     inputTrackCollection_(iConfig.getParameter<edm::InputTag>("trackCollection")),
     showerFiller_(iConfig.getParameter<edm::ParameterSet>("ShowerInformationFillerParameters"))
   {
+    preselection_.configure(iConfig, "preselection");
     produces<edm::ValueMap<reco::MuonShower> >().setBranchAlias("muonShowerInformation");
   }
   virtual ~MuonShowerInformationProducer() {}
 
 private:
   virtual void produce(edm::Event&, const edm::EventSetup&);
+  virtual void endJob() { preselection_.report("MuonShowerInformationProducer"); }
   edm::InputTag inputMuonCollection_;
   edm::InputTag inputTrackCollection_;
   MuonShowerInformationFiller showerFiller_;
+  // muons failing the cut get an empty shower
+  MuonFillerPreselection preselection_;
 };
 
 void
@@ -40,16 +45,15 @@ MuonShowerInformationProducer::produce(edm::Event& iEvent, const edm::EventSetup
   edm::Handle<reco::MuonCollection> muons;
   iEvent.getByLabel(inputMuonCollection_, muons);
 
-  // reserve some space for output
   std::vector<reco::MuonShower> showerInfoValues;
-  showerInfoValues.reserve(muons->size());
-  
-  for(reco::MuonCollection::const_iterator muon = muons->begin(); 
-      muon != muons->end(); ++muon)
-    {
-     // if (!muon->isGlobalMuon() && !muon->isStandAloneMuon()) continue;
-      showerInfoValues.push_back(showerFiller_.fillShowerInformation(*muon,iEvent,iSetup));
-    }
+  if ( preselection_.active() ) {
+    std::vector<bool> selected;
+    selected.reserve(muons->size());
+    for ( reco::MuonCollection::const_iterator muon = muons->begin(); muon != muons->end(); ++muon )
+      selected.push_back(preselection_(*muon));
+    showerFiller_.fillShowerInformation(*muons, showerInfoValues, iEvent, iSetup, &selected);
+  } else
+    showerFiller_.fillShowerInformation(*muons, showerInfoValues, iEvent, iSetup);
 
   // create and fill value map
   std::auto_ptr<edm::ValueMap<reco::MuonShower> > outC(new edm::ValueMap<reco::MuonShower>());
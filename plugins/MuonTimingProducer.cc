@@ -90,27 +90,11 @@ MuonTimingProducer::produce(edm::Event& iEvent, const edm::EventSetup& iSetup) {
   edm::Handle<reco::MuonCollection> muons; 
   iEvent.getByLabel(m_muonCollection, muons);
 
-  unsigned int nMuons = muons->size();
-  
-  std::vector<reco::MuonTimeExtra> dtTimeColl(nMuons);
-  std::vector<reco::MuonTimeExtra> cscTimeColl(nMuons);
-  std::vector<reco::MuonTimeExtra> combinedTimeColl(nMuons);
-
-  for ( unsigned int i=0; i<nMuons; ++i ) {
-
-    reco::MuonTimeExtra dtTime;
-    reco::MuonTimeExtra cscTime;
-    reco::MuonTimeExtra combinedTime;
-
-    reco::MuonRef muonr(muons,i);
-    
-    theTimingFiller_->fillTiming(*muonr, dtTime, cscTime, combinedTime, iEvent, iSetup);
-    
-    dtTimeColl[i] = dtTime;
-    cscTimeColl[i] = cscTime;
-    combinedTimeColl[i] = combinedTime;
-     
-  }
+  // timing of all muons in one call, written directly into the value map inputs
+  std::vector<reco::MuonTimeExtra> dtTimeColl;
+  std::vector<reco::MuonTimeExtra> cscTimeColl;
+  std::vector<reco::MuonTimeExtra> combinedTimeColl;
+  theTimingFiller_->fillTiming(*muons, dtTimeColl, cscTimeColl, combinedTimeColl, iEvent, iSetup);
   
   filler.insert(muons, combinedTimeColl.begin(), combinedTimeColl.end());
   filler.fill();
@@ -19,20 +19,58 @@
 #include "DataFormats/TrackReco/interface/TrackFwd.h"
 #include "DataFormats/TrackReco/interface/TrackToTrackMap.h"
 
-reco::Muon::MuonTrackTypePair tevOptimizedTMR(const reco::Muon& muon, const reco::TrackToTrackMap& fmsMap,
+#include <vector>
+
+namespace {
+  // The refitted tracks of a track-to-track map by key of the global
+  // track, flattened once per event so that each muon needs a single
+  // vector access instead of a search in the map.
+  class RefitTrackIndex {
+  public:
+    void fill(const reco::TrackToTrackMap& map) {
+      refits_.clear();
+      keyId_ = edm::ProductID();
+      for (reco::TrackToTrackMap::const_iterator it = map.begin(); it != map.end(); ++it) {
+	if (refits_.empty()) keyId_ = it->key.id();
+	if (it->key.key() >= refits_.size()) refits_.resize(it->key.key() + 1);
+	refits_[it->key.key()] = it->val;
+      }
+    }
+
+    // null if the global track is not in the map, like TrackToTrackMap::find
+    reco::TrackRef find(const reco::TrackRef& combinedTrack) const {
+      if (combinedTrack.isNull() || combinedTrack.id() != keyId_ || combinedTrack.key() >= refits_.size())
+	return reco::TrackRef();
+      return refits_[combinedTrack.key()];
+    }
+
+    // map with the refit of this global track only, to be passed by value
+    // to muon::tevOptimized instead of the full map
+    reco::TrackToTrackMap singleEntryMap(const reco::TrackRef& combinedTrack) const {
+      reco::TrackToTrackMap map;
+      reco::TrackRef refit = find(combinedTrack);
+      if (refit.isNonnull()) map.insert(combinedTrack, refit);
+      return map;
+    }
+
+  private:
+    edm::ProductID keyId_;
+    std::vector<reco::TrackRef> refits_;
+  };
+}
+
+reco::Muon::MuonTrackTypePair tevOptimizedTMR(const reco::Muon& muon, const reco::TrackRef& fmsTrack,
 				const double cut) {
   const reco::TrackRef& combinedTrack = muon.globalTrack();
   const reco::TrackRef& trackerTrack  = muon.innerTrack();
 
-  reco::TrackToTrackMap::const_iterator fmsTrack = fmsMap.find(combinedTrack);
-
   double probTK  = 0;
   double probFMS = 0;
 
   if (trackerTrack.isAvailable() && trackerTrack->numberOfValidHits())
     probTK = muon::trackProbability(trackerTrack);
-  if (fmsTrack != fmsMap.end() && fmsTrack->val->numberOfValidHits())
-    probFMS = muon::trackProbability(fmsTrack->val);
+  if (fmsTrack.isNonnull() && fmsTrack->numberOfValidHits())
+    probFMS = muon::trackProbability(fmsTrack);
 
   bool TKok  = probTK > 0;
   bool FMSok = probFMS > 0;
@@ -41,10 +79,10 @@ reco::Muon::MuonTrackTypePair tevOptimizedTMR(const reco::Muon& muon, const reco
     if (probFMS - probTK > cut)
       return make_pair(trackerTrack,reco::Muon::InnerTrack);
     else
-      return make_pair(fmsTrack->val,reco::Muon::TPFMS);
+      return make_pair(fmsTrack,reco::Muon::TPFMS);
   }
   else if (FMSok)
-    return make_pair(fmsTrack->val,reco::Muon::TPFMS);
+    return make_pair(fmsTrack,reco::Muon::TPFMS);
   else if (TKok)
     return make_pair(trackerTrack,reco::Muon::InnerTrack);
 
@@ -77,11 +115,11 @@ private:
   // Store the track-to-track map(s) used when using TeV refit tracks.
   bool storeMatchMaps(const edm::Event& event);
 
-  // Take the muon passed in, clone it (so that we save all the muon
+  // Take the copy of the muon passed in (so that we save all the muon
   // id information such as isolation, calo energy, etc.) and replace
   // its combined muon track with the passed in track.
-  reco::Muon* cloneAndSwitchTrack(const reco::Muon& muon,
-				  const reco::Muon::MuonTrackTypePair& newTrack) const;
+  void switchTrack(const reco::Muon& muon, const reco::Muon::MuonTrackTypePair& newTrack,
+		   reco::Muon& mu) const;
 
   // The input muons -- i.e. the merged collection of reco::Muons.
   edm::InputTag src;
@@ -138,6 +176,12 @@ private:
   edm::Handle<reco::TrackToTrackMap> trackMapDefault;
   edm::Handle<reco::TrackToTrackMap> trackMapFirstHit;
   edm::Handle<reco::TrackToTrackMap> trackMapPicky;
+
+  // The maps above flattened by global track key.
+  RefitTrackIndex refits;
+  RefitTrackIndex refitsDefault;
+  RefitTrackIndex refitsFirstHit;
+  RefitTrackIndex refitsPicky;
 };
 
 MuonsFromRefitTracksProducer::MuonsFromRefitTracksProducer(const edm::ParameterSet& cfg)
@@ -161,17 +205,27 @@ bool MuonsFromRefitTracksProducer::storeMatchMaps(const edm::Event& event) {
     event.getByLabel(tevMuonTracks, "default",  trackMapDefault);
     event.getByLabel(tevMuonTracks, "firstHit", trackMapFirstHit);
     event.getByLabel(tevMuonTracks, "picky",    trackMapPicky);
-    return !trackMapDefault.failedToGet() && 
-      !trackMapFirstHit.failedToGet() && !trackMapPicky.failedToGet();
+    if (trackMapDefault.failedToGet() || 
+	trackMapFirstHit.failedToGet() || trackMapPicky.failedToGet())
+      return false;
+    refitsFirstHit.fill(*trackMapFirstHit);
+    if (!fromTMR) {
+      refitsDefault.fill(*trackMapDefault);
+      refitsPicky.fill(*trackMapPicky);
+    }
+    return true;
   }
   else {
     event.getByLabel(edm::InputTag(tevMuonTracks), trackMap);
-    return !trackMap.failedToGet();
+    if (trackMap.failedToGet()) return false;
+    refits.fill(*trackMap);
+    return true;
   }
 }
 
-reco::Muon* MuonsFromRefitTracksProducer::cloneAndSwitchTrack(const reco::Muon& muon,
-							      const  reco::Muon::MuonTrackTypePair& newTrack) const {
+void MuonsFromRefitTracksProducer::switchTrack(const reco::Muon& muon,
+					       const reco::Muon::MuonTrackTypePair& newTrack,
+					       reco::Muon& mu) const {
   // Muon mass to make a four-vector out of the new track.
   static const double muMass = 0.10566;
 
@@ -185,15 +239,13 @@ reco::Muon* MuonsFromRefitTracksProducer::cloneAndSwitchTrack(const reco::Muon&
   p4.SetXYZT(newTrack.first->px(), newTrack.first->py(), newTrack.first->pz(),
 	     sqrt(p*p + muMass*muMass));
 
-  reco::Muon* mu = muon.clone();
-  mu->setCharge(newTrack.first->charge());
-  mu->setP4(p4);
-  mu->setVertex(vtx);
-  mu->setGlobalTrack(newTrack.first);
-  mu->setInnerTrack(tkTrack);
-  mu->setOuterTrack(muTrack);
-  mu->setBestTrack(newTrack.second);
-  return mu;
+  mu.setCharge(newTrack.first->charge());
+  mu.setP4(p4);
+  mu.setVertex(vtx);
+  mu.setGlobalTrack(newTrack.first);
+  mu.setInnerTrack(tkTrack);
+  mu.setOuterTrack(muTrack);
+  mu.setBestTrack(newTrack.second);
 }
 
 void MuonsFromRefitTracksProducer::produce(edm::Event& event, const edm::EventSetup& eSetup) {
@@ -218,6 +270,7 @@ void MuonsFromRefitTracksProducer::produce(edm::Event& event, const edm::EventSe
   std::auto_ptr<reco::MuonCollection> cands(new reco::MuonCollection);
 
   if (ok) {
+    cands->reserve(muons->size());
     edm::View<reco::Muon>::const_iterator muon;
     for (muon = muons->begin(); muon != muons->end(); muon++) {
       // Filter out the so-called trackerMuons and stand-alone muons
@@ -233,31 +286,41 @@ void MuonsFromRefitTracksProducer::produce(edm::Event& event, const edm::EventSe
 	// desired. Otherwise, get the refit track from the desired track
 	// map.
 	if (fromTMR)
-	  tevTk = tevOptimizedTMR(*muon, *trackMapFirstHit, TMRcut);
-	else if (fromCocktail)
-	  tevTk = muon::tevOptimized(*muon, *trackMapDefault, *trackMapFirstHit,
-				     *trackMapPicky);
+	  tevTk = tevOptimizedTMR(*muon, refitsFirstHit.find(muon->globalTrack()), TMRcut);
+	else if (fromCocktail) {
+	  // tevOptimized only looks up the global track of this muon in the
+	  // maps it takes by value, so it is given maps with that entry only
+	  const reco::TrackRef& combinedTrack = muon->combinedMuon();
+	  tevTk = muon::tevOptimized(*muon, refitsDefault.singleEntryMap(combinedTrack),
+				     refitsFirstHit.singleEntryMap(combinedTrack),
+				     refitsPicky.singleEntryMap(combinedTrack));
+	}
 	else if (fromSigmaSwitch)
 	  tevTk = sigmaSwitch(*muon, nSigmaSwitch, ptThreshold);
 	else {
-        reco::TrackToTrackMap::const_iterator tevTkRef =
-	    trackMap->find(muon->combinedMuon());
-	  if (tevTkRef != trackMap->end())
-	    tevTk = make_pair(tevTkRef->val,reco::Muon::CombinedTrack);
+	  reco::TrackRef tevTkRef = refits.find(muon->combinedMuon());
+	  if (tevTkRef.isNonnull())
+	    tevTk = make_pair(tevTkRef,reco::Muon::CombinedTrack);
 	}
 	
 	// If the TrackRef is valid, make a new Muon that has the same
 	// tracker and stand-alone tracks, but has the refit track as
 	// its global track.
-	if (tevTk.first.isNonnull())
-	  cands->push_back(*cloneAndSwitchTrack(*muon, tevTk));
+	if (tevTk.first.isNonnull()) {
+	  cands->push_back(*muon);
+	  switchTrack(*muon, tevTk, cands->back());
+	}
+      }
+      else if (fromTrackerTrack) {
+	cands->push_back(*muon);
+	switchTrack(*muon, make_pair(muon->innerTrack(),reco::Muon::InnerTrack), cands->back());
+      }
+      else if (fromGlobalTrack) {
+	cands->push_back(*muon);
+	switchTrack(*muon, make_pair(muon->globalTrack(),reco::Muon::CombinedTrack), cands->back());
       }
-      else if (fromTrackerTrack)
-	cands->push_back(*cloneAndSwitchTrack(*muon, make_pair(muon->innerTrack(),reco::Muon::InnerTrack)));
-      else if (fromGlobalTrack)
-	cands->push_back(*cloneAndSwitchTrack(*muon, make_pair(muon->globalTrack(),reco::Muon::CombinedTrack)));
       else {
-	cands->push_back(*muon->clone());
+	cands->push_back(*muon);
 
 	// Just cloning does not work in the case of the source being
 	// a pat::Muon with embedded track references -- these do not
@@ -90,6 +90,13 @@ void TrajectorySeedFromMuonProducer::produce(edm::Event& iEvent, const edm::Even
   edm::Handle<reco::TrackCollection> trackCollectionHandle;
   iEvent.getByLabel(trackCollectionTag_, trackCollectionHandle);
 
+  // tracks indexed by direction for the back-to-back search of all muons
+  muonid::OppositeTrackFinder oppositeTrackFinder;
+  if( skipMatchedMuons_ && !muonCollectionHandle->empty() )
+    oppositeTrackFinder.setTracks(trackCollectionHandle);
+
+  result->reserve(muonCollectionHandle->size());
+
   // Loop over the muon track
   for (edm::View<Muon>::const_iterator muon = muonCollectionHandle->begin();  muon != muonCollectionHandle->end(); ++muon) {
     // muon must have a tracker track
@@ -97,7 +104,7 @@ void TrajectorySeedFromMuonProducer::produce(edm::Event& iEvent, const edm::Even
     edm::RefToBase<reco::Track> track(muon->innerTrack());
     // check if there is a back-to-back track
     if( skipMatchedMuons_ &&
-	muonid::findOppositeTrack(trackCollectionHandle, *track).isNonnull() ) continue;
+	oppositeTrackFinder.find(*track).isNonnull() ) continue;
     if( (!track->innerOk()) || (!track->recHit(0)->isValid())) continue;
     GlobalPoint innerPosition(track->innerPosition().x(), track->innerPosition().y(), track->innerPosition().z());
     GlobalVector innerMomentum(track->innerMomentum().x(), track->innerMomentum().y(), track->innerMomentum().z());
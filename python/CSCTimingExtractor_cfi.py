@@ -20,6 +20,8 @@ CSCTimingExtractorBlock = cms.PSet(
     # One of these next two lines must be true or no time is created
     UseStripTime = cms.bool(True),
     UseWireTime = cms.bool(True),
+    # straight line distance from the IP instead of the propagation to each hit
+    UseFastDistance = cms.bool(False),
     debug = cms.bool(False)
   )
 )
@@ -20,6 +20,8 @@ DTTimingExtractorBlock = cms.PSet(
     DoWireCorr = cms.bool(True),
     DropTheta = cms.bool(True),
     RequireBothProjections = cms.bool(False),
+    # straight line distance from the IP instead of the propagation to each hit
+    UseFastDistance = cms.bool(False),
     debug = cms.bool(False),
   )
 )
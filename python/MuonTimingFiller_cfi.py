@@ -17,7 +17,11 @@ TimingFillerBlock = cms.PSet(
     # On/off switches for combined time measurement
     UseDT  = cms.bool(True),
     UseCSC = cms.bool(True),
-    UseECAL= cms.bool(True)
+    UseECAL= cms.bool(True),
+
+    # Take the DT and CSC segments from the muon chamber matches
+    # instead of matching them to the track again
+    UseSegmentsFromMatches = cms.bool(False)
   )
 )
 
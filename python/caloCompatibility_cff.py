@@ -5,6 +5,9 @@ MuonCaloCompatibilityBlock = cms.PSet(
     MuonCaloCompatibility = cms.PSet(
         PionTemplateFileName = cms.FileInPath('RecoMuon/MuonIdentification/data/MuID_templates_pions_lowPt_3_1_norm.root'),
         MuonTemplateFileName = cms.FileInPath('RecoMuon/MuonIdentification/data/MuID_templates_muons_lowPt_3_1_norm.root'),
+        # binary file written by test/MuonCaloTemplateConverter_cfg.py, mapped
+        # read-only instead of reading the ROOT files when it is given
+        BinaryTemplateFileName = cms.string(''),
         delta_eta = cms.double(0.02),
         delta_phi = cms.double(0.02),
         allSiPMHO = cms.bool(False)
@@ -31,6 +31,8 @@ cosmicsVeto = cms.EDProducer("CosmicsMuonIdProducer"
     ,MuonCosmicCompatibilityParameters 
     ,muonCollection = cms.InputTag("muons1stStep")
     ,trackCollections = cms.VInputTag(cms.InputTag("generalTracks"), cms.InputTag("cosmicsVetoTracks")) 
+    # string cut on the muons to check, an empty cut selects all muons
+    ,preselection = cms.string("")
 
     )
 
@@ -1,5 +1,12 @@
 import FWCore.ParameterSet.Config as cms
 globalMuonLinks = cms.EDProducer("MuonLinksProducer",
-    inputCollection = cms.InputTag("muons")
+    inputCollection = cms.InputTag("muons"),
+    # also write the links with the tracker track replaced by the inclusive
+    # track sharing its hits (instance "inclusive"), see MuonLinksProducerForHLT
+    produceInclusiveLinks = cms.bool(False),
+    InclusiveTrackerTrackCollection = cms.InputTag("generalTracks"),
+    ptMin = cms.double(2.5),
+    pMin = cms.double(2.5),
+    shareHitFraction = cms.double(0.80)
 )
 
@@ -79,3 +79,33 @@ muonSelectionTypeSequence = cms.Sequence(
     +muidTMOneStationAngLoose
     +muidTMOneStationAngTight
     +muidRPCMuLoose)
+#
+# all the selection types above evaluated by a single module in one pass over
+# the muons; the maps are available as ("muonSelectionTypes","muid"+type)
+muonSelectionTypes = muonSelectionTypeValueMapProducer.clone()
+del muonSelectionTypes.selectionType
+muonSelectionTypes.selectionTypes = cms.vstring(
+    "TrackerMuonArbitrated",
+    "AllArbitrated",
+    "GlobalMuonPromptTight",
+    "TMLastStationLoose",
+    "TMLastStationTight",
+    "TM2DCompatibilityLoose",
+    "TM2DCompatibilityTight",
+    "TMOneStationLoose",
+    "TMOneStationTight",
+    "TMLastStationOptimizedLowPtLoose",
+    "TMLastStationOptimizedLowPtTight",
+    "GMTkChiCompatibility",
+    "GMStaChiCompatibility",
+    "GMTkKinkTight",
+    "TMLastStationAngLoose",
+    "TMLastStationAngTight",
+    "TMOneStationAngLoose",
+    "TMOneStationAngTight",
+    "RPCMuLoose")
+muonSelectionTypes.fillBoolMaps = cms.bool(True)
+# bit muon::SelectionType of "muidSelectionTypes" is set for each passed type
+muonSelectionTypes.fillPackedMap = cms.bool(False)
+#
+muonSelectionTypeSinglePassSequence = cms.Sequence(muonSelectionTypes)
@@ -3,5 +3,8 @@ muonShowerInformation = cms.EDProducer("MuonShowerInformationProducer",
                                            MuonServiceProxy,
     muonCollection = cms.InputTag("muons1stStep"),
     trackCollection = cms.InputTag("generalTracks"),
+    # string cut on the muons to fill, an empty cut selects all muons;
+    # showers only matter at high momentum, e.g. "p > 20"
+    preselection = cms.string(""),
     ShowerInformationFillerParameters = MuonShowerParameters.MuonShowerInformationFillerParameters
 )
@@ -19,6 +19,29 @@ muons1stStep = cms.EDProducer("MuonIdProducer",
     TrackerKinkFinderParametersBlock,
 
     fillEnergy = cms.bool(True),
+    # associate the legs of split tracks to the calorimeters only if they are used
+    deferSplitTrackEnergy = cms.bool(False),
+    # without fillEnergy, propagate through the muon system only
+    muonSystemOnlyWithoutEnergy = cms.bool(False),
+    # skip the muon system association of tracks without DT/CSC segments
+    # or RPC hits in an eta-phi road, |dphi| < phiRoadPt/pt + phiRoad
+    useMuonOccupancyFilter = cms.bool(False),
+    muonOccupancyFilterParameters = cms.PSet( etaRoad = cms.double(0.3),
+                                              phiRoad = cms.double(0.2),
+                                              phiRoadPt = cms.double(2.0) ),
+    # skip the muon system association of tracks predicted to miss the muon
+    # stations by a fast batch propagation, or only compare the prediction
+    # to the chamber matches of the association (summary at the end of job)
+    useStationCrossingFilter = cms.bool(False),
+    validateStationCrossings = cms.bool(False),
+    stationCrossingParameters = cms.PSet( stepSize = cms.double(5.0),        # cm
+                                          maxPathLength = cms.double(3000.0),
+                                          margin = cms.double(30.0),
+                                          minMomentum = cms.double(0.2) ),   # GeV
+    # write the track - detector associations ("associationCache" instance),
+    # or rerun with other matching cuts from the cache of a previous job
+    writeAssociationCache = cms.bool(False),
+    associationCache = cms.InputTag(""),
     # OR
     maxAbsPullX = cms.double(4.0),
     maxAbsEta = cms.double(3.0),
@@ -51,6 +74,11 @@ muons1stStep = cms.EDProducer("MuonIdProducer",
     maxAbsDx = cms.double(3.0),
     fillIsolation = cms.bool(True),
     writeIsoDeposits = cms.bool(True),
+    # only muons passing these cuts get their deposits written, the others
+    # are stored with empty deposits (the isolation summaries are always filled);
+    # the matches are counted before the arbitration
+    isoDepositMinPt = cms.double(0.0),
+    isoDepositMinNumberOfMatches = cms.int32(0),
     minNumberOfMatches = cms.int32(1),
     fillMatching = cms.bool(True),
 
@@ -64,10 +92,29 @@ muons1stStep = cms.EDProducer("MuonIdProducer",
 
     # tracker kink finding
     fillTrackerKink = cms.bool(True),
+    # trajectory to track association of the inner tracks with smoothed
+    # trajectories, if empty or missing the tracks are refitted
+    trackerKinkTrajectories = cms.InputTag(""),
     
     # calo muons
     minCaloCompatibility = cms.double(0.6),
 
+    # report the time spent in each stage at the end of the job
+    reportStageTiming = cms.bool(False),
+    # bytes and elements of the products per event (MuonProductSize
+    # messages) and over the job
+    reportProductSizes = cms.bool(False),
+
+    # string cuts on the muons that get each block in the dressing loop,
+    # empty or missing cuts select all muons; e.g. the kink of the global
+    # muons above some pt only: trackerKink = "isGlobalMuon && innerTrack.pt > 5"
+    fillerPreselection = cms.PSet( muonId = cms.string(""),
+                                   globalTrackQuality = cms.string(""),
+                                   trackerKink = cms.string(""),
+                                   isolation = cms.string(""),
+                                   timing = cms.string(""),
+                                   caloCompatibility = cms.string("") ),
+
     # arbitration cleaning                       
     runArbitrationCleaner = cms.bool(True),
     arbitrationCleanerOptions = cms.PSet( ME1a = cms.bool(True),
@@ -81,7 +128,9 @@ muons1stStep = cms.EDProducer("MuonIdProducer",
 )
                        
 muonEcalDetIds = cms.EDProducer("InterestingEcalDetIdProducer",
-                                inputCollection = cms.InputTag("muons1stStep")
+                                inputCollection = cms.InputTag("muons1stStep"),
+                                # sort the ids instead of keeping the order of the muon windows
+                                sortedOutput = cms.bool(False)
 )
 
 
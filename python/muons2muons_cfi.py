@@ -13,6 +13,11 @@ muons = cms.EDProducer("MuonProducer",
                        PFCandidates = cms.InputTag("particleFlow"),
                        
                        FillTimingInfo = cms.bool(True),
+
+                       # keep only the segment matches with one of these arbitration flags,
+                       # the chamber matches are all kept
+                       SlimMatches = cms.bool(False),
+                       SlimMatchesSegmentFlags = cms.vstring('BestInChamberByDR', 'BestInChamberByDX'),
                        
                        FillDetectorBasedIsolation = cms.bool(True),
                        EcalIsoDeposits  = cms.InputTag("muons","ecal"),
@@ -11,6 +11,15 @@ muons = cms.EDProducer("MuonProducer",
                        PFCandidates = cms.InputTag("particleFlowTmp"),
 
                        FillTimingInfo = cms.bool(True),
+
+                       # keep only the segment matches with one of these arbitration flags,
+                       # the chamber matches are all kept
+                       SlimMatches = cms.bool(False),
+                       SlimMatchesSegmentFlags = cms.vstring('BestInChamberByDR', 'BestInChamberByDX'),
+
+                       # bytes and elements of the products per event (MuonProductSize
+                       # messages) and over the job
+                       ReportProductSizes = cms.bool(False),
                        
                        FillDetectorBasedIsolation = cms.bool(True),
                        EcalIsoDeposits  = cms.InputTag("muIsoDepositCalByAssociatorTowers","ecal"),
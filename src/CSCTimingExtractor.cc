@@ -16,6 +16,7 @@
 //
 
 #include "RecoMuon/MuonIdentification/interface/CSCTimingExtractor.h"
+#include "RecoMuon/MuonIdentification/interface/TimeMeasurementDistance.h"
 
 
 // user include files
@@ -26,6 +27,7 @@
 #include "FWCore/Framework/interface/MakerMacros.h"
 
 #include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "FWCore/Utilities/interface/Exception.h"
 
 #include "RecoMuon/TrackingTools/interface/MuonServiceProxy.h"
 
@@ -77,7 +79,8 @@ CSCTimingExtractor::CSCTimingExtractor(const edm::ParameterSet& iConfig)
   theWireError_(iConfig.getParameter<double>("CSCWireError")),
   UseWireTime(iConfig.getParameter<bool>("UseWireTime")),
   UseStripTime(iConfig.getParameter<bool>("UseStripTime")),
-  debug(iConfig.getParameter<bool>("debug"))
+  debug(iConfig.getParameter<bool>("debug")),
+  useFastDistance_(iConfig.existsAs<bool>("UseFastDistance") ? iConfig.getParameter<bool>("UseFastDistance") : false)
 {
   edm::ParameterSet serviceParameters = iConfig.getParameter<edm::ParameterSet>("ServiceParameters");
   theService = new MuonServiceProxy(serviceParameters);
@@ -85,6 +88,8 @@ CSCTimingExtractor::CSCTimingExtractor(const edm::ParameterSet& iConfig)
   edm::ParameterSet matchParameters = iConfig.getParameter<edm::ParameterSet>("MatchParameters");
 
   theMatcher = new MuonSegmentMatcher(matchParameters, theService);
+
+  thePropagatorCacheId = 0;
 }
 
 
@@ -99,27 +104,53 @@ CSCTimingExtractor::~CSCTimingExtractor()
 // member functions
 //
 
+void
+CSCTimingExtractor::beginEvent(const edm::Event& iEvent, const edm::EventSetup& iSetup)
+{
+  theService->update(iSetup);
+
+  // get the propagator when its record changes
+  const unsigned long long propagatorCacheId = iSetup.get<TrackingComponentsRecord>().cacheIdentifier();
+  if ( propagatorCacheId != thePropagatorCacheId || ! thePropagator.isValid() ) {
+    iSetup.get<TrackingComponentsRecord>().get("SteppingHelixPropagatorAny", thePropagator);
+    thePropagatorCacheId = propagatorCacheId;
+  }
+}
+
 // ------------ method called to produce the data  ------------
 void
 CSCTimingExtractor::fillTiming(TimeMeasurementSequence &tmSequence, reco::TrackRef muonTrack, const edm::Event& iEvent, const edm::EventSetup& iSetup)
+{
+  // refresh the setup, this is a no-op if beginEvent was called for the event
+  beginEvent(iEvent, iSetup);
+
+  // get the CSC segments that were used to construct the muon
+  std::vector<const CSCSegment*> range = theMatcher->matchCSC(*muonTrack,iEvent);
+  fillTiming(tmSequence, muonTrack, range);
+}
+
+void
+CSCTimingExtractor::fillTiming(TimeMeasurementSequence &tmSequence, reco::TrackRef muonTrack, const std::vector<const CSCSegment*>& range)
 {
 
   if (debug) 
     std::cout << " *** CSC Timimng Extractor ***" << std::endl;
 
-  theService->update(iSetup);
-
+  // the service and the propagator are updated in beginEvent
+  if ( ! thePropagator.isValid() )
+    throw cms::Exception("Configuration") << "CSCTimingExtractor::fillTiming called with segments before beginEvent";
   const GlobalTrackingGeometry *theTrackingGeometry = &*theService->trackingGeometry();
   
-  edm::ESHandle<Propagator> propagator;
-  iSetup.get<TrackingComponentsRecord>().get("SteppingHelixPropagatorAny", propagator);
-  const Propagator *propag = propagator.product();
+  const Propagator *propag = thePropagator.product();
 
   double invbeta=0;
   double invbetaerr=0;
   double totalWeightInvbeta=0;
   double totalWeightVertex=0;
-  std::vector<TimeMeasurement> tms;
+  // the measurements are a member, cleared here to reuse their storage
+  std::vector<TimeMeasurement>& tms = theMeasurements;
+  tms.clear();
+  tmSequence.clear();
 
   math::XYZPoint  pos=muonTrack->innerPosition();
   math::XYZVector mom=muonTrack->innerMomentum();
@@ -133,11 +164,8 @@ CSCTimingExtractor::fillTiming(TimeMeasurementSequence &tmSequence, reco::TrackR
   GlobalVector momv(mom.x(), mom.y(), mom.z());
   FreeTrajectoryState muonFTS(posp, momv, (TrackCharge)muonTrack->charge(), theService->magneticField().product());
 
-  // get the CSC segments that were used to construct the muon
-  std::vector<const CSCSegment*> range = theMatcher->matchCSC(*muonTrack,iEvent);
-
   // create a collection on TimeMeasurements for the track        
-  for (std::vector<const CSCSegment*>::iterator rechit = range.begin(); rechit!=range.end();++rechit) {
+  for (std::vector<const CSCSegment*>::const_iterator rechit = range.begin(); rechit!=range.end();++rechit) {
 
     // Create the ChamberId
     DetId id = (*rechit)->geographicalId();
@@ -154,12 +182,15 @@ CSCTimingExtractor::fillTiming(TimeMeasurementSequence &tmSequence, reco::TrackR
       const GeomDet* cscDet = theTrackingGeometry->idToDet(hiti->geographicalId());
       TimeMeasurement thisHit;
 
-      std::pair< TrajectoryStateOnSurface, double> tsos;
-      tsos=propag->propagateWithPath(muonFTS,cscDet->surface());
-
       double dist;            
-      if (tsos.first.isValid()) dist = tsos.second+posp.mag(); 
-        else dist = cscDet->toGlobal(hiti->localPosition()).mag();
+      if (useFastDistance_) dist = muonid::straightLineDistance(posp, momv, cscDet->toGlobal(hiti->localPosition()));
+      else {
+        std::pair< TrajectoryStateOnSurface, double> tsos;
+        tsos=propag->propagateWithPath(muonFTS,cscDet->surface());
+
+        if (tsos.first.isValid()) dist = tsos.second+posp.mag(); 
+          else dist = cscDet->toGlobal(hiti->localPosition()).mag();
+      }
 
       thisHit.distIP = dist;
       if (UseStripTime) {
@@ -184,26 +215,22 @@ CSCTimingExtractor::fillTiming(TimeMeasurementSequence &tmSequence, reco::TrackR
   } // rechit
       
   bool modified = false;
-  std::vector <double> dstnc, dsegm, dtraj, hitWeightInvbeta, hitWeightVertex;
+  // the measurements surviving the pruning are collected directly in tmSequence
+  const std::vector<double>& dstnc = tmSequence.dstnc;
+  const std::vector<double>& dsegm = tmSequence.local_t0;
+  const std::vector<double>& hitWeightInvbeta = tmSequence.weightInvbeta;
 
   // Now loop over the measurements, calculate 1/beta and cut away outliers
   do {    
 
     modified = false;
-    dstnc.clear();
-    dsegm.clear();
-    dtraj.clear();
-    hitWeightInvbeta.clear();
-    hitWeightVertex.clear();
+    tmSequence.clear();
       
     totalWeightInvbeta=0;
     totalWeightVertex=0;
       
 	for (std::vector<TimeMeasurement>::iterator tm=tms.begin(); tm!=tms.end(); ++tm) {
-	  dstnc.push_back(tm->distIP);
-	  dsegm.push_back(tm->timeCorr);
-	  hitWeightInvbeta.push_back(tm->weightInvbeta);
-          hitWeightVertex.push_back(tm->weightVertex);
+	  tmSequence.push_back(tm->distIP, tm->timeCorr, tm->weightVertex, tm->weightInvbeta);
 	  totalWeightInvbeta+=tm->weightInvbeta;
 	  totalWeightVertex+=tm->weightVertex;
 	}
@@ -249,13 +276,6 @@ CSCTimingExtractor::fillTiming(TimeMeasurementSequence &tmSequence, reco::TrackR
 
   // std::cout << " *** FINAL Measured 1/beta: " << invbeta << " +/- " << invbetaerr << std::endl;
 
-  for (unsigned int i=0;i<dstnc.size();i++) {
-    tmSequence.dstnc.push_back(dstnc.at(i));
-    tmSequence.local_t0.push_back(dsegm.at(i));
-    tmSequence.weightInvbeta.push_back(hitWeightInvbeta.at(i));
-    tmSequence.weightVertex.push_back(hitWeightVertex.at(i));
-  }
-
   tmSequence.totalWeightInvbeta=totalWeightInvbeta;
   tmSequence.totalWeightVertex=totalWeightVertex;
 
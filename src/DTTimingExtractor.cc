@@ -16,6 +16,8 @@
 //
 
 #include "RecoMuon/MuonIdentification/interface/DTTimingExtractor.h"
+#include "RecoMuon/MuonIdentification/interface/TimeMeasurementFit.h"
+#include "RecoMuon/MuonIdentification/interface/TimeMeasurementDistance.h"
 
 
 // user include files
@@ -26,6 +28,7 @@
 #include "FWCore/Framework/interface/MakerMacros.h"
 
 #include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "FWCore/Utilities/interface/Exception.h"
 
 #include "RecoMuon/TrackingTools/interface/MuonServiceProxy.h"
 
@@ -84,7 +87,8 @@ DTTimingExtractor::DTTimingExtractor(const edm::ParameterSet& iConfig)
   doWireCorr_(iConfig.getParameter<bool>("DoWireCorr")),
   dropTheta_(iConfig.getParameter<bool>("DropTheta")),
   requireBothProjections_(iConfig.getParameter<bool>("RequireBothProjections")),
-  debug(iConfig.getParameter<bool>("debug"))
+  debug(iConfig.getParameter<bool>("debug")),
+  useFastDistance_(iConfig.existsAs<bool>("UseFastDistance") ? iConfig.getParameter<bool>("UseFastDistance") : false)
 {
   edm::ParameterSet serviceParameters = iConfig.getParameter<edm::ParameterSet>("ServiceParameters");
   theService = new MuonServiceProxy(serviceParameters);
@@ -92,6 +96,8 @@ DTTimingExtractor::DTTimingExtractor(const edm::ParameterSet& iConfig)
   edm::ParameterSet matchParameters = iConfig.getParameter<edm::ParameterSet>("MatchParameters");
 
   theMatcher = new MuonSegmentMatcher(matchParameters, theService);
+
+  theGeometryCacheId = thePropagatorCacheId = 0;
 }
 
 
@@ -106,9 +112,39 @@ DTTimingExtractor::~DTTimingExtractor()
 // member functions
 //
 
+void
+DTTimingExtractor::beginEvent(const edm::Event& iEvent, const edm::EventSetup& iSetup)
+{
+  theService->update(iSetup);
+
+  // get the DT geometry and the propagator when their records change
+  const unsigned long long geometryCacheId = iSetup.get<MuonGeometryRecord>().cacheIdentifier();
+  if ( geometryCacheId != theGeometryCacheId || ! theDTGeom.isValid() ) {
+    iSetup.get<MuonGeometryRecord>().get(theDTGeom);
+    theGeometryCacheId = geometryCacheId;
+  }
+  
+  const unsigned long long propagatorCacheId = iSetup.get<TrackingComponentsRecord>().cacheIdentifier();
+  if ( propagatorCacheId != thePropagatorCacheId || ! thePropagator.isValid() ) {
+    iSetup.get<TrackingComponentsRecord>().get("SteppingHelixPropagatorAny", thePropagator);
+    thePropagatorCacheId = propagatorCacheId;
+  }
+}
+
 // ------------ method called to produce the data  ------------
 void
 DTTimingExtractor::fillTiming(TimeMeasurementSequence &tmSequence, reco::TrackRef muonTrack, const edm::Event& iEvent, const edm::EventSetup& iSetup)
+{
+  // refresh the setup, this is a no-op if beginEvent was called for the event
+  beginEvent(iEvent, iSetup);
+
+  // get the DT segments that were used to construct the muon
+  std::vector<const DTRecSegment4D*> range = theMatcher->matchDT(*muonTrack,iEvent);
+  fillTiming(tmSequence, muonTrack, range);
+}
+
+void
+DTTimingExtractor::fillTiming(TimeMeasurementSequence &tmSequence, reco::TrackRef muonTrack, const std::vector<const DTRecSegment4D*>& range)
 {
 
 //  using reco::TrackCollection;
@@ -116,23 +152,21 @@ DTTimingExtractor::fillTiming(TimeMeasurementSequence &tmSequence, reco::TrackRe
   if (debug) 
     std::cout << " *** Muon Timimng Extractor ***" << std::endl;
 
-  theService->update(iSetup);
-
+  // the service, geometry and propagator are updated in beginEvent
+  if ( ! theDTGeom.isValid() || ! thePropagator.isValid() )
+    throw cms::Exception("Configuration") << "DTTimingExtractor::fillTiming called with segments before beginEvent";
   const GlobalTrackingGeometry *theTrackingGeometry = &*theService->trackingGeometry();
 
-  // get the DT geometry
-  edm::ESHandle<DTGeometry> theDTGeom;
-  iSetup.get<MuonGeometryRecord>().get(theDTGeom);
-  
-  edm::ESHandle<Propagator> propagator;
-  iSetup.get<TrackingComponentsRecord>().get("SteppingHelixPropagatorAny", propagator);
-  const Propagator *propag = propagator.product();
+  const Propagator *propag = thePropagator.product();
 
   double invbeta=0;
   double invbetaerr=0;
   double totalWeightInvbeta=0;
   double totalWeightVertex=0;
-  std::vector<TimeMeasurement> tms;
+  // the measurements and fit buffers are members, cleared here to reuse their storage
+  std::vector<TimeMeasurement>& tms = theMeasurements;
+  tms.clear();
+  tmSequence.clear();
 
   math::XYZPoint  pos=muonTrack->innerPosition();
   math::XYZVector mom=muonTrack->innerMomentum();
@@ -140,11 +174,8 @@ DTTimingExtractor::fillTiming(TimeMeasurementSequence &tmSequence, reco::TrackRe
   GlobalVector momv(mom.x(), mom.y(), mom.z());
   FreeTrajectoryState muonFTS(posp, momv, (TrackCharge)muonTrack->charge(), theService->magneticField().product());
 
-  // get the DT segments that were used to construct the muon
-  std::vector<const DTRecSegment4D*> range = theMatcher->matchDT(*muonTrack,iEvent);
-
   // create a collection on TimeMeasurements for the track        
-  for (std::vector<const DTRecSegment4D*>::iterator rechit = range.begin(); rechit!=range.end();++rechit) {
+  for (std::vector<const DTRecSegment4D*>::const_iterator rechit = range.begin(); rechit!=range.end();++rechit) {
 
     // Create the ChamberId
     DetId id = (*rechit)->geographicalId();
@@ -178,11 +209,14 @@ DTTimingExtractor::fillTiming(TimeMeasurementSequence &tmSequence, reco::TrackRe
 	TimeMeasurement thisHit;
 
 	std::pair< TrajectoryStateOnSurface, double> tsos;
-	tsos=propag->propagateWithPath(muonFTS,dtcell->surface());
+	if (!useFastDistance_) tsos=propag->propagateWithPath(muonFTS,dtcell->surface());
 
         double dist;            
         double dist_straight = dtcell->toGlobal(hiti->localPosition()).mag(); 
-	if (tsos.first.isValid()) { 
+	if (useFastDistance_) {
+	  // without a propagated state the wire correction below is not applied
+	  dist = muonid::straightLineDistance(posp, momv, dtcell->toGlobal(hiti->localPosition()));
+	} else if (tsos.first.isValid()) { 
 	  dist = tsos.second+posp.mag(); 
 //	  std::cout << "Propagate distance: " << dist << " ( innermost: " << posp.mag() << ")" << std::endl; 
 	} else { 
@@ -224,96 +258,49 @@ DTTimingExtractor::fillTiming(TimeMeasurementSequence &tmSequence, reco::TrackRe
     } // phi = (0,1) 	        
   } // rechit
       
+  // the segment local z of the cells does not change when hits are pruned
+  std::vector<double>& cellZ = theCellZ;
+  cellZ.clear();
+  for (std::vector<TimeMeasurement>::const_iterator tm=tms.begin(); tm!=tms.end(); ++tm) {
+    DetId id = tm->driftCell;
+    const GeomDet* dtcell = theTrackingGeometry->idToDet(id);
+    DTChamberId chamberId(id.rawId());
+    const GeomDet* dtcham = theTrackingGeometry->idToDet(chamberId);
+    cellZ.push_back(dtcham->toLocal(dtcell->position()).z());
+  }
+  theActive.assign(tms.size(), true);
+
+  // fit all (station, projection) segments once, after that only the
+  // segment which lost a hit is refitted
+  for (unsigned int segment=0; segment<nSegments; segment++) fitSegment(segment);
+
   bool modified = false;
-  std::vector <double> dstnc, dsegm, dtraj, hitWeightVertex, hitWeightInvbeta, left;
+  // the measurements accepted by the segment fits are collected directly in tmSequence
+  const std::vector<double>& dstnc = tmSequence.dstnc;
+  const std::vector<double>& dsegm = tmSequence.local_t0;
+  const std::vector<double>& hitWeightInvbeta = tmSequence.weightInvbeta;
+  std::vector<int>& hit_idx = theHitIndices;
     
   // Now loop over the measurements, calculate 1/beta and cut away outliers
   do {    
 
     modified = false;
-    dstnc.clear();
-    dsegm.clear();
-    dtraj.clear();
-    hitWeightVertex.clear();
-    hitWeightInvbeta.clear();
-    left.clear();
+    tmSequence.clear();
       
-    std::vector <int> hit_idx;
+    hit_idx.clear();
     totalWeightInvbeta=0;
     totalWeightVertex=0;
       
-    // Rebuild segments
-    for (int sta=1;sta<5;sta++)
-      for (int phi=0;phi<2;phi++) {
-        std::vector <TimeMeasurement> seg;
-        std::vector <int> seg_idx;
-	int tmpos=0;
-	for (std::vector<TimeMeasurement>::iterator tm=tms.begin(); tm!=tms.end(); ++tm) {
-	  if ((tm->station==sta) && (tm->isPhi==phi)) {
-	    seg.push_back(*tm);
-	    seg_idx.push_back(tmpos);
-	  }
-	  tmpos++;  
-	}
-
-	unsigned int segsize = seg.size();
-	if (segsize<theHitsMin_) continue;
-
-	double a=0, b=0;
-        std::vector <double> hitxl,hitxr,hityl,hityr;
-
-	for (std::vector<TimeMeasurement>::iterator tm=seg.begin(); tm!=seg.end(); ++tm) {
- 
-	  DetId id = tm->driftCell;
-	  const GeomDet* dtcell = theTrackingGeometry->idToDet(id);
-	  DTChamberId chamberId(id.rawId());
-	  const GeomDet* dtcham = theTrackingGeometry->idToDet(chamberId);
-
-	  double celly=dtcham->toLocal(dtcell->position()).z();
-            
-	  if (tm->isLeft) {
-	    hitxl.push_back(celly);
-	    hityl.push_back(tm->posInLayer);
-	  } else {
-	    hitxr.push_back(celly);
-	    hityr.push_back(tm->posInLayer);
-	  }    
-	}
-
-	if (!fitT0(a,b,hitxl,hityl,hitxr,hityr)) {
-	  if (debug)
-	    std::cout << "     t0 = zero, Left hits: " << hitxl.size() << " Right hits: " << hitxr.size() << std::endl;
-	  continue;
-	}
-          
-	// a segment must have at least one left and one right hit
-	if ((!hitxl.size()) || (!hityl.size())) continue;
-
-	int segidx=0;
-	for (std::vector<TimeMeasurement>::const_iterator tm=seg.begin(); tm!=seg.end(); ++tm) {
-
-	  DetId id = tm->driftCell;
-	  const GeomDet* dtcell = theTrackingGeometry->idToDet(id);
-	  DTChamberId chamberId(id.rawId());
-	  const GeomDet* dtcham = theTrackingGeometry->idToDet(chamberId);
-
-	  double layerZ  = dtcham->toLocal(dtcell->position()).z();
-	  double segmLocalPos = b+layerZ*a;
-	  double hitLocalPos = tm->posInLayer;
-	  int hitSide = -tm->isLeft*2+1;
-	  double t0_segm = (-(hitSide*segmLocalPos)+(hitSide*hitLocalPos))/0.00543+tm->timeCorr;
-            
-	  dstnc.push_back(tm->distIP);
-	  dsegm.push_back(t0_segm);
-	  left.push_back(hitSide);
-	  hitWeightInvbeta.push_back(((double)seg.size()-2.)*tm->distIP*tm->distIP/((double)seg.size()*30.*30.*theError_*theError_));
-          hitWeightVertex.push_back(((double)seg.size()-2.)/((double)seg.size()*theError_*theError_));
-	  hit_idx.push_back(seg_idx.at(segidx));
-	  segidx++;
-	  totalWeightInvbeta+=((double)seg.size()-2.)*tm->distIP*tm->distIP/((double)seg.size()*30.*30.*theError_*theError_);
-	  totalWeightVertex+=((double)seg.size()-2.)/((double)seg.size()*theError_*theError_);
-	}
+    // collect the fitted segments in the (station, projection) order
+    for (unsigned int segment=0; segment<nSegments; segment++) {
+      const std::vector<FittedHit>& hits = theFittedHits[segment];
+      for (std::vector<FittedHit>::const_iterator hit=hits.begin(); hit!=hits.end(); ++hit) {
+	tmSequence.push_back(hit->distIP, hit->t0, hit->weightVertex, hit->weightInvbeta);
+	hit_idx.push_back(hit->index);
+	totalWeightInvbeta+=hit->weightInvbeta;
+	totalWeightVertex+=hit->weightVertex;
       }
+    }
 
     if (totalWeightInvbeta==0) break;        
 
@@ -327,7 +314,7 @@ DTTimingExtractor::fillTiming(TimeMeasurementSequence &tmSequence, reco::TrackRe
       invbeta+=(1.+dsegm.at(i)/dstnc.at(i)*30.)*hitWeightInvbeta.at(i)/totalWeightInvbeta;
 
     double chimax=0.;
-    std::vector<TimeMeasurement>::iterator tmmax;
+    int tmmax=-1;
     
     // the dispersion of inverse beta
     double diff;
@@ -336,7 +323,7 @@ DTTimingExtractor::fillTiming(TimeMeasurementSequence &tmSequence, reco::TrackRe
       diff=diff*diff*hitWeightInvbeta.at(i);
       invbetaerr+=diff;
       if (diff>chimax) { 
-	tmmax=tms.begin()+hit_idx.at(i);
+	tmmax=hit_idx.at(i);
 	chimax=diff;
       }
     }
@@ -345,7 +332,8 @@ DTTimingExtractor::fillTiming(TimeMeasurementSequence &tmSequence, reco::TrackRe
  
     // cut away the outliers
     if (chimax>thePruneCut_) {
-      tms.erase(tmmax);
+      theActive[tmmax]=false;
+      fitSegment((tms[tmmax].station-1)*2+tms[tmmax].isPhi);
       modified=true;
     }    
 
@@ -354,59 +342,69 @@ DTTimingExtractor::fillTiming(TimeMeasurementSequence &tmSequence, reco::TrackRe
 
   } while (modified);
 
-  for (unsigned int i=0;i<dstnc.size();i++) {
-    tmSequence.dstnc.push_back(dstnc.at(i));
-    tmSequence.local_t0.push_back(dsegm.at(i));
-    tmSequence.weightInvbeta.push_back(hitWeightInvbeta.at(i));
-    tmSequence.weightVertex.push_back(hitWeightVertex.at(i));
-  }
-
   tmSequence.totalWeightInvbeta=totalWeightInvbeta;
   tmSequence.totalWeightVertex=totalWeightVertex;
 
 }
 
-double
-DTTimingExtractor::fitT0(double &a, double &b, const std::vector<double>& xl, const std::vector<double>& yl, const std::vector<double>& xr, const std::vector<double>& yr ) {
-
-  double sx=0,sy=0,sxy=0,sxx=0,ssx=0,ssy=0,s=0,ss=0;
-
-  for (unsigned int i=0; i<xl.size(); i++) {
-    sx+=xl[i];
-    sy+=yl[i];
-    sxy+=xl[i]*yl[i];
-    sxx+=xl[i]*xl[i];
-    s++;
-    ssx+=xl[i];
-    ssy+=yl[i];
-    ss++;
-  } 
-
-  for (unsigned int i=0; i<xr.size(); i++) {
-    sx+=xr[i];
-    sy+=yr[i];
-    sxy+=xr[i]*yr[i];
-    sxx+=xr[i]*xr[i];
-    s++;
-    ssx-=xr[i];
-    ssy-=yr[i];
-    ss--;
-  } 
-
-  double delta = ss*ss*sxx+s*sx*sx+s*ssx*ssx-s*s*sxx-2*ss*sx*ssx;
-  
-  double t0_corr=0.;
-
-  if (delta) {
-    a=(ssy*s*ssx+sxy*ss*ss+sy*sx*s-sy*ss*ssx-ssy*sx*ss-sxy*s*s)/delta;
-    b=(ssx*sy*ssx+sxx*ssy*ss+sx*sxy*s-sxx*sy*s-ssx*sxy*ss-sx*ssy*ssx)/delta;
-    t0_corr=(ssx*s*sxy+sxx*ss*sy+sx*sx*ssy-sxx*s*ssy-sx*ss*sxy-ssx*sx*sy)/delta;
-  }
+void
+DTTimingExtractor::fitSegment(unsigned int segment) {
+
+  int sta = segment/2+1;
+  bool phi = segment%2;
+  std::vector<FittedHit>& fitted = theFittedHits[segment];
+  fitted.clear();
+
+  const std::vector<TimeMeasurement>& tms = theMeasurements;
+  std::vector<int>& seg_idx = theSegmentIndices;
+  seg_idx.clear();
+  for (unsigned int tmpos=0; tmpos<tms.size(); tmpos++)
+    if (theActive[tmpos] && (tms[tmpos].station==sta) && (tms[tmpos].isPhi==phi)) seg_idx.push_back(tmpos);
+
+  unsigned int segsize = seg_idx.size();
+  if (segsize<theHitsMin_) return;
+
+  // the left hits are added first, as in the original fit loops
+  DTT0FitSums sums;
+  unsigned int nLeft=0, nRight=0;
+  for (std::vector<int>::const_iterator idx=seg_idx.begin(); idx!=seg_idx.end(); ++idx)
+    if (tms[*idx].isLeft) {
+      sums.addLeft(theCellZ[*idx], tms[*idx].posInLayer);
+      nLeft++;
+    }
+  for (std::vector<int>::const_iterator idx=seg_idx.begin(); idx!=seg_idx.end(); ++idx)
+    if (!tms[*idx].isLeft) {
+      sums.addRight(theCellZ[*idx], tms[*idx].posInLayer);
+      nRight++;
+    }
 
+  double a=0, b=0;
   // convert drift distance to time
-  t0_corr/=-0.00543;
-
-  return t0_corr;
+  double t0_corr = sums.fit(a,b)/-0.00543;
+  if (!t0_corr) {
+    if (debug)
+      std::cout << "     t0 = zero, Left hits: " << nLeft << " Right hits: " << nRight << std::endl;
+    return;
+  }
+          
+  // a segment must have at least one left and one right hit
+  if (!nLeft) return;
+
+  for (std::vector<int>::const_iterator idx=seg_idx.begin(); idx!=seg_idx.end(); ++idx) {
+    const TimeMeasurement& tm = tms[*idx];
+    double layerZ  = theCellZ[*idx];
+    double segmLocalPos = b+layerZ*a;
+    double hitLocalPos = tm.posInLayer;
+    int hitSide = -tm.isLeft*2+1;
+
+    FittedHit hit;
+    hit.index = *idx;
+    hit.distIP = tm.distIP;
+    hit.t0 = (-(hitSide*segmLocalPos)+(hitSide*hitLocalPos))/0.00543+tm.timeCorr;
+    hit.weightInvbeta = ((double)segsize-2.)*tm.distIP*tm.distIP/((double)segsize*30.*30.*theError_*theError_);
+    hit.weightVertex = ((double)segsize-2.)/((double)segsize*theError_*theError_);
+    fitted.push_back(hit);
+  }
 }
 
 
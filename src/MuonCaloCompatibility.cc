@@ -16,107 +16,349 @@
 #include "RecoMuon/MuonIdentification/interface/MuonCaloCompatibility.h"
 #include "DataFormats/TrackReco/interface/Track.h"
 #include "FWCore/MessageLogger/interface/MessageLogger.h"
+#include "FWCore/Utilities/interface/Exception.h"
+#include "TH2D.h"
+#include "TFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <stdint.h>
+#include <boost/weak_ptr.hpp>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+   // binary format of the templates, native byte order; the file header and
+   // the record headers are multiples of 8 bytes, so that the doubles that
+   // follow each record header stay aligned in the mapped file
+   const char binaryMagic[8] = { 'M','u','I','D','C','a','l','o' };
+   const uint32_t binaryVersion = 1;
+   struct BinaryHeader {
+      char magic[8];
+      uint32_t version;
+      uint32_t nTemplates;
+   };
+   // followed by xmin, xmax, ymin, ymax, the x and y edges and the contents
+   struct BinaryRecord {
+      char name[32];
+      int32_t nbins[2];
+      int32_t nedges[2];
+   };
+
+   // templates of the pions and then of the muons
+   const char* const histogramNames[] = { "em_etaEmi", "had_etaEmi", "em_etaTmi", "had_etaTmi",
+					  "em_etaB", "had_etaB", "ho_etaB", "em_etaTpl", "had_etaTpl",
+					  "em_etaEpl", "had_etaEpl" };
+}
 
-void MuonCaloCompatibility::configure(const edm::ParameterSet& iConfig)
+class MuonCaloCompatibility::TemplateSet {
+ public:
+   enum Histogram { EmEtaEmi, HadEtaEmi, EmEtaTmi, HadEtaTmi, EmEtaB, HadEtaB, HoEtaB, EmEtaTpl, HadEtaTpl,
+		    EmEtaEpl, HadEtaEpl, NumberOfHistograms };
+
+   /// templates read from the ROOT files of the muons and the pions
+   static boost::shared_ptr<const TemplateSet> fromRoot( const std::string& muonFileName, const std::string& pionFileName );
+   /// templates mapped read-only from a binary file
+   static boost::shared_ptr<const TemplateSet> fromBinary( const std::string& fileName );
+
+   ~TemplateSet();
+
+   const Template& pion( Histogram histogram ) const { return templates_[histogram]; }
+   const Template& muon( Histogram histogram ) const { return templates_[NumberOfHistograms + histogram]; }
+
+   void write( const std::string& fileName ) const;
+
+ private:
+   TemplateSet() : data_(0), size_(0), map_(0) {}
+   TemplateSet( const TemplateSet& );
+   TemplateSet& operator=( const TemplateSet& );
+
+   // the sets stay shared as long as an instance uses them
+   typedef std::map<std::string, boost::weak_ptr<const TemplateSet> > Cache;
+   static Cache& cache() { static Cache theCache; return theCache; }
+
+   void readRoot( const std::string& muonFileName, const std::string& pionFileName );
+   void mapFile( const std::string& fileName );
+   // set the templates pointing into data_, checking the format
+   void setTemplates( const std::string& source );
+
+   const char* data_;
+   size_t size_;
+   // image built from the ROOT files, doubles to keep the alignment
+   std::vector<double> image_;
+   void* map_;
+   Template templates_[2*NumberOfHistograms];
+};
+
+boost::shared_ptr<const MuonCaloCompatibility::TemplateSet>
+MuonCaloCompatibility::TemplateSet::fromRoot( const std::string& muonFileName, const std::string& pionFileName )
+{
+   const std::string key = muonFileName + "\n" + pionFileName;
+   boost::shared_ptr<const TemplateSet> set = cache()[key].lock();
+   if ( set ) return set;
+   TemplateSet* newSet = new TemplateSet;
+   set.reset( newSet );
+   newSet->readRoot( muonFileName, pionFileName );
+   cache()[key] = set;
+   return set;
+}
+
+boost::shared_ptr<const MuonCaloCompatibility::TemplateSet>
+MuonCaloCompatibility::TemplateSet::fromBinary( const std::string& fileName )
+{
+   boost::shared_ptr<const TemplateSet> set = cache()[fileName].lock();
+   if ( set ) return set;
+   TemplateSet* newSet = new TemplateSet;
+   set.reset( newSet );
+   newSet->mapFile( fileName );
+   cache()[fileName] = set;
+   return set;
+}
+
+MuonCaloCompatibility::TemplateSet::~TemplateSet()
+{
+   if ( map_ ) munmap( map_, size_ );
+}
+
+void MuonCaloCompatibility::TemplateSet::readRoot( const std::string& muonFileName, const std::string& pionFileName )
+{
+   // the histograms are copied, the files are not needed afterwards
+   std::auto_ptr<TFile> muon_templates( new TFile(muonFileName.c_str(),"READ") );
+   std::auto_ptr<TFile> pion_templates( new TFile(pionFileName.c_str(),"READ") );
+
+   const TH2D* histos[2*NumberOfHistograms];
+   for ( unsigned int i = 0; i < NumberOfHistograms; ++i ) {
+      histos[i] = (TH2D*) pion_templates->Get(histogramNames[i]);
+      histos[NumberOfHistograms + i] = (TH2D*) muon_templates->Get(histogramNames[i]);
+   }
+
+   // a missing histogram is written without bins and stays invalid
+   size_t size = sizeof(BinaryHeader);
+   for ( unsigned int i = 0; i < 2*NumberOfHistograms; ++i ) {
+      size += sizeof(BinaryRecord) + 4*sizeof(double);
+      if ( ! histos[i] ) continue;
+      const TAxis* axes[2] = { histos[i]->GetXaxis(), histos[i]->GetYaxis() };
+      size += ( axes[0]->GetXbins()->GetSize() + axes[1]->GetXbins()->GetSize() +
+		axes[0]->GetNbins()*axes[1]->GetNbins() )*sizeof(double);
+   }
+   image_.assign( size/sizeof(double), 0. );
+   char* out = reinterpret_cast<char*>( &image_[0] );
+
+   BinaryHeader header;
+   std::copy( binaryMagic, binaryMagic + sizeof(binaryMagic), header.magic );
+   header.version = binaryVersion;
+   header.nTemplates = 2*NumberOfHistograms;
+   memcpy( out, &header, sizeof(header) );
+   out += sizeof(header);
+
+   for ( unsigned int i = 0; i < 2*NumberOfHistograms; ++i ) {
+      const TH2D* histo = histos[i];
+      BinaryRecord record;
+      memset( &record, 0, sizeof(record) );
+      strncpy( record.name, histogramNames[i % NumberOfHistograms], sizeof(record.name)-1 );
+      double ranges[4] = { 0, 0, 0, 0 };
+      const TAxis* axes[2] = { 0, 0 };
+      if ( histo ) {
+	 strncpy( record.name, histo->GetName(), sizeof(record.name)-1 );
+	 axes[0] = histo->GetXaxis();
+	 axes[1] = histo->GetYaxis();
+	 for ( unsigned int j = 0; j < 2; ++j ) {
+	    record.nbins[j]  = axes[j]->GetNbins();
+	    record.nedges[j] = axes[j]->GetXbins()->GetSize();
+	    ranges[2*j]   = axes[j]->GetXmin();
+	    ranges[2*j+1] = axes[j]->GetXmax();
+	 }
+      }
+      memcpy( out, &record, sizeof(record) );
+      out += sizeof(record);
+      memcpy( out, ranges, sizeof(ranges) );
+      out += sizeof(ranges);
+      if ( ! histo ) continue;
+
+      for ( unsigned int j = 0; j < 2; ++j ) {
+	 if ( record.nedges[j] == 0 ) continue;
+	 memcpy( out, axes[j]->GetXbins()->GetArray(), record.nedges[j]*sizeof(double) );
+	 out += record.nedges[j]*sizeof(double);
+      }
+      double* contents = reinterpret_cast<double*>( out );
+      for ( int biny = 1; biny <= record.nbins[1]; ++biny )
+	for ( int binx = 1; binx <= record.nbins[0]; ++binx )
+	  contents[(biny-1)*record.nbins[0] + binx-1] = histo->GetBinContent(binx, biny);
+      out += record.nbins[0]*record.nbins[1]*sizeof(double);
+   }
+
+   data_ = reinterpret_cast<const char*>( &image_[0] );
+   size_ = size;
+   setTemplates( muonFileName + " and " + pionFileName );
+}
+
+void MuonCaloCompatibility::TemplateSet::mapFile( const std::string& fileName )
+{
+   int fd = open( fileName.c_str(), O_RDONLY );
+   if ( fd < 0 ) 
+     throw cms::Exception("Configuration") << "cannot open the calo compatibility templates " << fileName;
+   struct stat status;
+   if ( fstat(fd, &status) != 0 || status.st_size <= 0 ) {
+      close( fd );
+      throw cms::Exception("Configuration") << "cannot read the calo compatibility templates " << fileName;
+   }
+   size_ = status.st_size;
+   // shared read-only pages, the processes mapping the file use one copy
+   map_ = mmap( 0, size_, PROT_READ, MAP_SHARED, fd, 0 );
+   close( fd );
+   if ( map_ == MAP_FAILED ) {
+      map_ = 0;
+      throw cms::Exception("Configuration") << "cannot map the calo compatibility templates " << fileName;
+   }
+   data_ = static_cast<const char*>( map_ );
+   setTemplates( fileName );
+}
+
+void MuonCaloCompatibility::TemplateSet::setTemplates( const std::string& source )
+{
+   const char* in = data_;
+   const char* end = data_ + size_;
+
+   BinaryHeader header;
+   if ( size_ < sizeof(header) ) 
+     throw cms::Exception("Configuration") << "truncated calo compatibility templates " << source;
+   memcpy( &header, in, sizeof(header) );
+   in += sizeof(header);
+   if ( ! std::equal( binaryMagic, binaryMagic + sizeof(binaryMagic), header.magic ) ||
+	header.version != binaryVersion || header.nTemplates != 2*NumberOfHistograms )
+     throw cms::Exception("Configuration") << "unknown format of the calo compatibility templates " << source;
+
+   for ( unsigned int i = 0; i < 2*NumberOfHistograms; ++i ) {
+      BinaryRecord record;
+      if ( size_t(end - in) < sizeof(record) + 4*sizeof(double) )
+	throw cms::Exception("Configuration") << "truncated calo compatibility templates " << source;
+      memcpy( &record, in, sizeof(record) );
+      in += sizeof(record);
+      const double* ranges = reinterpret_cast<const double*>( in );
+      in += 4*sizeof(double);
+
+      Template& templ = templates_[i];
+      record.name[sizeof(record.name)-1] = 0;
+      templ.name_ = record.name;
+      Template::Axis* axes[2] = { &templ.xAxis_, &templ.yAxis_ };
+      for ( unsigned int j = 0; j < 2; ++j ) {
+	 if ( record.nbins[j] < 0 || ( record.nedges[j] != 0 && record.nedges[j] != record.nbins[j] + 1 ) )
+	   throw cms::Exception("Configuration") << "corrupted calo compatibility template " << templ.name_ << " in " << source;
+	 axes[j]->nbins  = record.nbins[j];
+	 axes[j]->min    = ranges[2*j];
+	 axes[j]->max    = ranges[2*j+1];
+	 axes[j]->nedges = record.nedges[j];
+      }
+      const size_t ncontents = size_t(record.nbins[0])*size_t(record.nbins[1]);
+      if ( size_t(end - in) < ( ncontents + record.nedges[0] + record.nedges[1] )*sizeof(double) )
+	throw cms::Exception("Configuration") << "truncated calo compatibility templates " << source;
+      for ( unsigned int j = 0; j < 2; ++j ) {
+	 axes[j]->edges = axes[j]->nedges > 0 ? reinterpret_cast<const double*>( in ) : 0;
+	 in += axes[j]->nedges*sizeof(double);
+      }
+      templ.contents_ = ncontents > 0 ? reinterpret_cast<const double*>( in ) : 0;
+      in += ncontents*sizeof(double);
+   }
+}
+
+void MuonCaloCompatibility::TemplateSet::write( const std::string& fileName ) const
 {
-   MuonfileName_ = (iConfig.getParameter<edm::FileInPath>("MuonTemplateFileName")).fullPath();
-   PionfileName_ = (iConfig.getParameter<edm::FileInPath>("PionTemplateFileName")).fullPath();
-   muon_templates.reset( new TFile(MuonfileName_.c_str(),"READ") );
-   pion_templates.reset( new TFile(PionfileName_.c_str(),"READ") );
+   std::ofstream file( fileName.c_str(), std::ios::out | std::ios::binary | std::ios::trunc );
+   file.write( data_, size_ );
+   if ( ! file ) 
+     throw cms::Exception("Configuration") << "cannot write the calo compatibility templates " << fileName;
+}
 
-   pion_em_etaEmi  = (TH2D*) pion_templates->Get("em_etaEmi");
-   pion_had_etaEmi = (TH2D*) pion_templates->Get("had_etaEmi");
+MuonCaloCompatibility::MuonCaloCompatibility():
+  isConfigured_(false),
+  pion_had_etaEpl(0), pion_em_etaEpl(0), pion_had_etaTpl(0), pion_em_etaTpl(0), pion_ho_etaB(0), pion_had_etaB(0),
+  pion_em_etaB(0), pion_had_etaTmi(0), pion_em_etaTmi(0), pion_had_etaEmi(0), pion_em_etaEmi(0),
+  muon_had_etaEpl(0), muon_em_etaEpl(0), muon_had_etaTpl(0), muon_em_etaTpl(0), muon_ho_etaB(0), muon_had_etaB(0),
+  muon_em_etaB(0), muon_had_etaTmi(0), muon_em_etaTmi(0), muon_had_etaEmi(0), muon_em_etaEmi(0),
+  use_corrected_hcal(true), use_em_special(true)
+{}
+
+void MuonCaloCompatibility::configure(const edm::ParameterSet& iConfig)
+{
+   const std::string binaryFileName = iConfig.existsAs<std::string>("BinaryTemplateFileName") ? 
+     iConfig.getParameter<std::string>("BinaryTemplateFileName") : "";
+   if ( ! binaryFileName.empty() ) {
+      templateSet_ = TemplateSet::fromBinary( binaryFileName );
+   } else {
+      MuonfileName_ = (iConfig.getParameter<edm::FileInPath>("MuonTemplateFileName")).fullPath();
+      PionfileName_ = (iConfig.getParameter<edm::FileInPath>("PionTemplateFileName")).fullPath();
+      templateSet_ = TemplateSet::fromRoot( MuonfileName_, PionfileName_ );
+   }
+
+   pion_em_etaEmi  = &templateSet_->pion(TemplateSet::EmEtaEmi);
+   pion_had_etaEmi = &templateSet_->pion(TemplateSet::HadEtaEmi);
 	       	
-   pion_em_etaTmi  = (TH2D*) pion_templates->Get("em_etaTmi");
-   pion_had_etaTmi = (TH2D*) pion_templates->Get("had_etaTmi");
+   pion_em_etaTmi  = &templateSet_->pion(TemplateSet::EmEtaTmi);
+   pion_had_etaTmi = &templateSet_->pion(TemplateSet::HadEtaTmi);
 		
-   pion_em_etaB    = (TH2D*) pion_templates->Get("em_etaB");
-   pion_had_etaB   = (TH2D*) pion_templates->Get("had_etaB");
-   pion_ho_etaB    = (TH2D*) pion_templates->Get("ho_etaB");
+   pion_em_etaB    = &templateSet_->pion(TemplateSet::EmEtaB);
+   pion_had_etaB   = &templateSet_->pion(TemplateSet::HadEtaB);
+   pion_ho_etaB    = &templateSet_->pion(TemplateSet::HoEtaB);
    
-   pion_em_etaTpl  = (TH2D*) pion_templates->Get("em_etaTpl");
-   pion_had_etaTpl = (TH2D*) pion_templates->Get("had_etaTpl");
+   pion_em_etaTpl  = &templateSet_->pion(TemplateSet::EmEtaTpl);
+   pion_had_etaTpl = &templateSet_->pion(TemplateSet::HadEtaTpl);
 	       	
-   pion_em_etaEpl  = (TH2D*) pion_templates->Get("em_etaEpl");
-   pion_had_etaEpl = (TH2D*) pion_templates->Get("had_etaEpl");
+   pion_em_etaEpl  = &templateSet_->pion(TemplateSet::EmEtaEpl);
+   pion_had_etaEpl = &templateSet_->pion(TemplateSet::HadEtaEpl);
 		
-   muon_em_etaEmi  = (TH2D*) muon_templates->Get("em_etaEmi");
-   muon_had_etaEmi = (TH2D*) muon_templates->Get("had_etaEmi");
+   muon_em_etaEmi  = &templateSet_->muon(TemplateSet::EmEtaEmi);
+   muon_had_etaEmi = &templateSet_->muon(TemplateSet::HadEtaEmi);
 	       	
-   muon_em_etaTmi  = (TH2D*) muon_templates->Get("em_etaTmi");
-   muon_had_etaTmi = (TH2D*) muon_templates->Get("had_etaTmi");
+   muon_em_etaTmi  = &templateSet_->muon(TemplateSet::EmEtaTmi);
+   muon_had_etaTmi = &templateSet_->muon(TemplateSet::HadEtaTmi);
 	       	
-   muon_em_etaB    = (TH2D*) muon_templates->Get("em_etaB");
-   muon_had_etaB   = (TH2D*) muon_templates->Get("had_etaB");
-   muon_ho_etaB    = (TH2D*) muon_templates->Get("ho_etaB");
+   muon_em_etaB    = &templateSet_->muon(TemplateSet::EmEtaB);
+   muon_had_etaB   = &templateSet_->muon(TemplateSet::HadEtaB);
+   muon_ho_etaB    = &templateSet_->muon(TemplateSet::HoEtaB);
 	       	
-   muon_em_etaTpl  = (TH2D*) muon_templates->Get("em_etaTpl");
-   muon_had_etaTpl = (TH2D*) muon_templates->Get("had_etaTpl");
+   muon_em_etaTpl  = &templateSet_->muon(TemplateSet::EmEtaTpl);
+   muon_had_etaTpl = &templateSet_->muon(TemplateSet::HadEtaTpl);
 		
-   muon_em_etaEpl  = (TH2D*) muon_templates->Get("em_etaEpl");
-   muon_had_etaEpl = (TH2D*) muon_templates->Get("had_etaEpl");
-
-   pbx = -1;
-   pby = -1;
-   pbz = -1;
-
-   psx = -1;
-   psy = -1;
-   psz = -1;
-
-   muon_compatibility = -1;
+   muon_em_etaEpl  = &templateSet_->muon(TemplateSet::EmEtaEpl);
+   muon_had_etaEpl = &templateSet_->muon(TemplateSet::HadEtaEpl);
 
    use_corrected_hcal = true;
    use_em_special = true;
    isConfigured_ = true;
 }
 
-bool MuonCaloCompatibility::accessing_overflow( TH2D* histo, double x, double y ) {
-  bool access = false;
-
-  if( histo->GetXaxis()->FindBin(x) == 0 || 
-      histo->GetXaxis()->FindBin(x) > histo->GetXaxis()->GetNbins() ) {
-    access = true;
-  }
-  if( histo->GetYaxis()->FindBin(y) == 0 || 
-      histo->GetYaxis()->FindBin(y) > histo->GetYaxis()->GetNbins() ) {
-    access = true;
-  }
-  return access;
+void MuonCaloCompatibility::writeBinaryTemplates( const edm::ParameterSet& iConfig, const std::string& fileName )
+{
+   TemplateSet::fromRoot( (iConfig.getParameter<edm::FileInPath>("MuonTemplateFileName")).fullPath(),
+			  (iConfig.getParameter<edm::FileInPath>("PionTemplateFileName")).fullPath() )->write( fileName );
 }
 
-double MuonCaloCompatibility::evaluate( const reco::Muon& amuon ) {
-  if (! isConfigured_) {
-     edm::LogWarning("MuonIdentification") << "MuonCaloCompatibility is not configured! Nothing is calculated.";
-     return -9999;
-  }
-   
-  double eta = 0.;
-  double p   = 0.;
-  double em  = 0.;
-  double had = 0.;
-  double ho  = 0.;
-
-  // had forgotten this reset in previous versions 070409
-  pbx = 1.;
-  pby = 1.;
-  pbz = 1.;
+int MuonCaloCompatibility::Template::Axis::findBin( double x ) const
+{
+   if ( x < min ) return 0;
+   if ( !(x < max) ) return nbins+1;
+   if ( ! edges ) return 1 + int( nbins*(x-min)/(max-min) );
+   // same as 1 + TMath::BinarySearch
+   return std::upper_bound( edges, edges + nedges, x ) - edges;
+}
 
-  psx = 1.;
-  psy = 1.;
-  psz = 1.;
+bool MuonCaloCompatibility::Template::lookup( double x, double y, double& content ) const
+{
+   const int binx = xAxis_.findBin(x);
+   const int biny = yAxis_.findBin(y);
+   if ( binx == 0 || binx > xAxis_.nbins || biny == 0 || biny > yAxis_.nbins ) return false;
+   content = contents_[(biny-1)*xAxis_.nbins + binx-1];
+   return true;
+}
 
-  muon_compatibility = -1.;
-  
-  pion_template_em   = NULL;
-  muon_template_em   = NULL;
-  
-  pion_template_had  = NULL;
-  muon_template_had  = NULL;
-  
-  pion_template_ho   = NULL;
-  muon_template_ho   = NULL;
-  
+MuonCaloCompatibility::Input MuonCaloCompatibility::input( const reco::Muon& amuon )
+{
   // 071002: Get either tracker track, or SAmuon track.
   // CaloCompatibility templates may have to be specialized for 
   // the use with SAmuons, currently just using the ones produced
@@ -134,49 +376,83 @@ double MuonCaloCompatibility::evaluate( const reco::Muon& amuon ) {
     }
   }
 
-  if( !use_corrected_hcal ) { // old eta regions, uncorrected energy
-    eta = track->eta();
-    p   = track->p(); 
+  Input in;
+  in.eta   = track->eta();
+  in.theta = track->theta();
+  in.p     = track->p();
+  in.em    = amuon.calEnergy().em;
+  in.had   = amuon.calEnergy().had;
+  in.ho    = amuon.calEnergy().ho;
+  return in;
+}
+
+double MuonCaloCompatibility::evaluate( const reco::Muon& amuon ) const {
+  if (! isConfigured_) {
+     edm::LogWarning("MuonIdentification") << "MuonCaloCompatibility is not configured! Nothing is calculated.";
+     return -9999;
+  }
+  return compatibility( input(amuon) );
+}
+
+void MuonCaloCompatibility::evaluate( const std::vector<Input>& inputs, std::vector<double>& results ) const {
+  results.resize( inputs.size() );
+  if (! isConfigured_) {
+     if ( ! inputs.empty() ) 
+       edm::LogWarning("MuonIdentification") << "MuonCaloCompatibility is not configured! Nothing is calculated.";
+     std::fill( results.begin(), results.end(), -9999. );
+     return;
+  }
+  for ( unsigned int i = 0; i < inputs.size(); ++i ) results[i] = compatibility( inputs[i] );
+}
 
-    // new 070904: Set lookup momentum to 1999.9 if larger than 2 TeV. 
-    // Though the templates were produced with p<2TeV, we believe that
-    // this approximation should be roughly valid. A special treatment
-    // for >1 TeV muons is advisable anyway :)
-    if( p>=2000. ) p = 1999.9;
+double MuonCaloCompatibility::compatibility( const Input& in ) const {
+  double eta = 0.;
+  double p   = 0.;
+  double em  = 0.;
+  double had = 0.;
+  double ho  = 0.;
 
-    //    p   = 10./sin(track->theta()); // use this for templates < 1_5
-    if( use_em_special ) {
-      if( amuon.calEnergy().em == 0. )    em  = -5.;
-      else em  = amuon.calEnergy().em;
-    }
-    else {
-      em  = amuon.calEnergy().em;
-    }
-    had = amuon.calEnergy().had;
-    ho  = amuon.calEnergy().ho;
+  // had forgotten this reset in previous versions 070409
+  double pbx = 1.;
+  double pby = 1.;
+  double pbz = 1.;
+
+  double psx = 1.;
+  double psy = 1.;
+  double psz = 1.;
+
+  double muon_compatibility = -1.;
+  
+  // used input templates for given eta
+  const Template* pion_template_em   = 0;
+  const Template* muon_template_em   = 0;
+  
+  const Template* pion_template_had  = 0;
+  const Template* muon_template_had  = 0;
+  
+  const Template* pion_template_ho   = 0;
+  const Template* muon_template_ho   = 0;
+  
+  eta = in.eta;
+  p   = in.p;
+    
+  // new 070904: Set lookup momentum to 1999.9 if larger than 2 TeV. 
+  // Though the templates were produced with p<2TeV, we believe that
+  // this approximation should be roughly valid. A special treatment
+  // for >1 TeV muons is advisable anyway :)
+  if( p>=2000. ) p = 1999.9;
+
+  //    p   = 10./sin(in.theta);  // use this for templates < 1_5
+  // hcal energy is now done where we get the template histograms (to use corrected cal energy)!
+  if( use_em_special ) {
+    if( in.em == 0. )    em  = -5.;
+    else em  = in.em;
   }
   else {
-    eta = track->eta();
-    p   = track->p();
-    
-    // new 070904: Set lookup momentum to 1999.9 if larger than 2 TeV. 
-    // Though the templates were produced with p<2TeV, we believe that
-    // this approximation should be roughly valid. A special treatment
-    // for >1 TeV muons is advisable anyway :)
-    if( p>=2000. ) p = 1999.9;
-
-    //    p   = 10./sin(track->theta());  // use this for templates < 1_5
-    // hcal energy is now done where we get the template histograms (to use corrected cal energy)!
-    //     had = amuon.calEnergy().had;
-    if( use_em_special ) {
-      if( amuon.calEnergy().em == 0. )    em  = -5.;
-      else em  = amuon.calEnergy().em;
-    }
-    else {
-      em  = amuon.calEnergy().em;
-    }
-    ho  = amuon.calEnergy().ho;
+    em  = in.em;
   }
+  ho  = in.ho;
+  if( !use_corrected_hcal ) had = in.had; // uncorrected energy
 
 
   // Skip everyting and return "I don't know" (i.e. 0.5) for uncovered regions:
@@ -186,205 +462,110 @@ double MuonCaloCompatibility::evaluate( const reco::Muon& amuon ) {
   // temporary fix for low association efficiency:
   // set caloCompatibility to 0.12345 for tracks
   // which have 0 energy in BOTH ecal and hcal
-  if( amuon.calEnergy().had == 0.0 && amuon.calEnergy().em == 0.0 ) return 0.12345; 
-
-  //  std::cout<<std::endl<<"Input values are: "<<eta <<" "<< p <<" "<< em <<" "<< had <<" "<< ho;
-
-  //  depending on the eta, choose correct histogram: (now all for barrel):
-  // bad! eta range has to be syncronised with choice for histogram... should be read out from the histo file somehow... 070322
-  if(42 != 42) { // old eta ranges and uncorrected hcal energy
-    if(eta <= -1.4) {
-      //    std::cout<<"Emi"<<std::endl;
-      pion_template_em  = pion_em_etaEmi;
-      pion_template_had = pion_had_etaEmi;
-      muon_template_em  = muon_em_etaEmi;
-      muon_template_had = muon_had_etaEmi;
-    }
-    else if(eta > -1.4 && eta <= -1.31) {
-      //    std::cout<<"Tmi"<<std::endl;
-      pion_template_em  = pion_em_etaTmi;
-      pion_template_had = pion_had_etaTmi;
-      muon_template_em  = muon_em_etaTmi;
-      muon_template_had = muon_had_etaTmi;
-    }
-    else if(eta > -1.31 && eta <= 1.31) {
-      //    std::cout<<"B"<<std::endl;
-      pion_template_em  = pion_em_etaB;
-      pion_template_had = pion_had_etaB;
-      pion_template_ho  = pion_ho_etaB;
-      muon_template_em  = muon_em_etaB;
-      muon_template_had = muon_had_etaB;
-      muon_template_ho  = muon_ho_etaB;
-    }
-    else if(eta > 1.31 && eta <= 1.4) {
-      //    std::cout<<"Tpl"<<std::endl;
-      pion_template_em  = pion_em_etaTpl;
-      pion_template_had = pion_had_etaTpl;
-      muon_template_em  = muon_em_etaTpl;
-      muon_template_had = muon_had_etaTpl;
-    }
-    else if(eta > 1.4) {
-      //    std::cout<<"Epl"<<std::endl;
-      pion_template_em  = pion_em_etaEpl;
-      pion_template_had = pion_had_etaEpl;
-      muon_template_em  = muon_em_etaEpl;
-      muon_template_had = muon_had_etaEpl;
-    }
-    else {
-      LogTrace("MuonIdentification")<<"Some very weird thing happened in MuonCaloCompatibility::evaluate - go figure ;) ";
-      return -999;
-    }
-  }
-  else if( 42 == 42 ) { // new eta bins, corrected hcal energy
-    if(  track->eta() >  1.27  ) {
-      // 	had_etaEpl ->Fill(muon->track().get()->p(),1.8/2.2*muon->calEnergy().had );
-      if(use_corrected_hcal)	had = 1.8/2.2*amuon.calEnergy().had;
-      else	had = amuon.calEnergy().had;
-      pion_template_had = pion_had_etaEpl;
-      muon_template_had = muon_had_etaEpl;
-    }
-    if( track->eta() <=  1.27  && track->eta() >  1.1 ) {
-      // 	had_etaTpl ->Fill(muon->track().get()->p(),(1.8/(-2.2*muon->track().get()->eta()+5.5))*muon->calEnergy().had );
-      if(use_corrected_hcal)	had = (1.8/(-2.2*track->eta()+5.5))*amuon.calEnergy().had;
-      else 	had = amuon.calEnergy().had;
-      pion_template_had  = pion_had_etaTpl;
-      muon_template_had  = muon_had_etaTpl;
-    }
-    if( track->eta() <=  1.1 && track->eta() > -1.1 ) {
-      // 	had_etaB   ->Fill(muon->track().get()->p(),sin(muon->track().get()->theta())*muon->calEnergy().had );
-      if(use_corrected_hcal)	had = sin(track->theta())*amuon.calEnergy().had;
-      else 	had = amuon.calEnergy().had;
-      pion_template_had  = pion_had_etaB;
-      muon_template_had  = muon_had_etaB;
-    }
-    if( track->eta() <= -1.1 && track->eta() > -1.27 ) {
-      // 	had_etaTmi ->Fill(muon->track().get()->p(),(1.8/(-2.2*muon->track().get()->eta()+5.5))*muon->calEnergy().had );
-      if(use_corrected_hcal)	had = (1.8/(2.2*track->eta()+5.5))*amuon.calEnergy().had;
-      else 	had = amuon.calEnergy().had;
-      pion_template_had = pion_had_etaTmi;
-      muon_template_had = muon_had_etaTmi;
-    }
-    if( track->eta() <= -1.27 ) {
-      // 	had_etaEmi ->Fill(muon->track().get()->p(),1.8/2.2*muon->calEnergy().had );
-      if(use_corrected_hcal)	had = 1.8/2.2*amuon.calEnergy().had;
-      else 	had = amuon.calEnergy().had;
-      pion_template_had = pion_had_etaEmi;
-      muon_template_had = muon_had_etaEmi;
-    }
-    
-    // just two eta regions for Ecal (+- 1.479 for barrel, else for rest), no correction:
-
-    //    std::cout<<"We have a muon with an eta of: "<<track->eta()<<std::endl;
-
-    if(  track->eta() >  1.479  ) {
-      // 	em_etaEpl  ->Fill(muon->track().get()->p(),muon->calEnergy().em   );
-      // 	//	em_etaTpl  ->Fill(muon->track().get()->p(),muon->calEnergy().em   );
-      ////      em  = amuon.calEnergy().em;
-      pion_template_em  = pion_em_etaEpl;
-      muon_template_em  = muon_em_etaEpl;
-    }
-    if( track->eta() <=  1.479 && track->eta() > -1.479 ) {
-      // 	em_etaB    ->Fill(muon->track().get()->p(),muon->calEnergy().em   );
-      ////      em  = amuon.calEnergy().em;
-      pion_template_em  = pion_em_etaB;
-      muon_template_em  = muon_em_etaB;
-    }
-    if( track->eta() <= -1.479 ) {
-      // 	//	em_etaTmi  ->Fill(muon->track().get()->p(),muon->calEnergy().em   );
-      // 	em_etaEmi  ->Fill(muon->track().get()->p(),muon->calEnergy().em   );
-      ////      em  = amuon.calEnergy().em;
-      pion_template_em  = pion_em_etaEmi;
-      muon_template_em  = muon_em_etaEmi;
-    }
-    
-    // just one barrel eta region for the HO, no correction
-    //    if( track->eta() < 1.4 && track->eta() > -1.4 ) { // experimenting now...
-    if( track->eta() < 1.28 && track->eta() > -1.28 ) {
-      // 	ho_etaB    ->Fill(muon->track().get()->p(),muon->calEnergy().ho   );
-      ////      ho  = amuon.calEnergy().ho;
-      pion_template_ho  = pion_ho_etaB;
-      muon_template_ho  = muon_ho_etaB;
-    }
+  if( in.had == 0.0 && in.em == 0.0 ) return 0.12345; 
 
+  //  depending on the eta, choose correct histogram, new eta bins, corrected hcal energy
+  if(  eta >  1.27  ) {
+    if(use_corrected_hcal)	had = 1.8/2.2*in.had;
+    pion_template_had = pion_had_etaEpl;
+    muon_template_had = muon_had_etaEpl;
+  }
+  if( eta <=  1.27  && eta >  1.1 ) {
+    if(use_corrected_hcal)	had = (1.8/(-2.2*eta+5.5))*in.had;
+    pion_template_had  = pion_had_etaTpl;
+    muon_template_had  = muon_had_etaTpl;
+  }
+  if( eta <=  1.1 && eta > -1.1 ) {
+    if(use_corrected_hcal)	had = sin(in.theta)*in.had;
+    pion_template_had  = pion_had_etaB;
+    muon_template_had  = muon_had_etaB;
+  }
+  if( eta <= -1.1 && eta > -1.27 ) {
+    if(use_corrected_hcal)	had = (1.8/(2.2*eta+5.5))*in.had;
+    pion_template_had = pion_had_etaTmi;
+    muon_template_had = muon_had_etaTmi;
+  }
+  if( eta <= -1.27 ) {
+    if(use_corrected_hcal)	had = 1.8/2.2*in.had;
+    pion_template_had = pion_had_etaEmi;
+    muon_template_had = muon_had_etaEmi;
+  }
     
+  // just two eta regions for Ecal (+- 1.479 for barrel, else for rest), no correction:
+  if(  eta >  1.479  ) {
+    pion_template_em  = pion_em_etaEpl;
+    muon_template_em  = muon_em_etaEpl;
   }
-
-
-  if( 42 != 42 ) { // check validity of input template histos and input variables"
-    pion_template_em ->ls();
-    pion_template_had->ls();
-    if(pion_template_ho)   pion_template_ho ->ls();
-    muon_template_em ->ls();
-    muon_template_had->ls();
-    if(muon_template_ho)   muon_template_ho ->ls();
-
-    LogTrace("MuonIdentification")<<"Input variables: eta    p     em     had    ho "<<"\n"
-	     <<eta<<" "<<p<<" "<<em<<" "<<had<<" "<<ho<<" "<<"\n"
-	     <<"cal uncorr:    em     had    ho "<<"\n"
-	     <<eta<<" "<<p<<" "<<amuon.calEnergy().em<<" "<<amuon.calEnergy().had<<" "<<amuon.calEnergy().ho;
+  if( eta <=  1.479 && eta > -1.479 ) {
+    pion_template_em  = pion_em_etaB;
+    muon_template_em  = muon_em_etaB;
+  }
+  if( eta <= -1.479 ) {
+    pion_template_em  = pion_em_etaEmi;
+    muon_template_em  = muon_em_etaEmi;
+  }
+    
+  // just one barrel eta region for the HO, no correction
+  //    if( track->eta() < 1.4 && track->eta() > -1.4 ) { // experimenting now...
+  if( eta < 1.28 && eta > -1.28 ) {
+    pion_template_ho  = pion_ho_etaB;
+    muon_template_ho  = muon_ho_etaB;
   }
-  
 
   //  Look up Compatibility by, where x is p and y the energy. 
   //  We have a set of different histograms for different regions of eta.
 
   // need error meassage in case the template histos are missing / the template file is not present!!! 070412
 
-  if( pion_template_em )  { // access ecal background template
-    if( accessing_overflow( pion_template_em, p, em ) ) {
+  if( pion_template_em && pion_template_em->isValid() )  { // access ecal background template
+    if( ! pion_template_em->lookup( p, em, pbx ) ) {
       pbx = 1.;
       psx = 1.;
       LogTrace("MuonIdentification")<<"            // Message: trying to access overflow bin in MuonCompatibility template for ecal - defaulting signal and background  ";
-      LogTrace("MuonIdentification")<<"            // template value to 1. "<<pion_template_em->GetName()<<" e: "<<em<<" p: "<<p;
+      LogTrace("MuonIdentification")<<"            // template value to 1. "<<pion_template_em->name()<<" e: "<<em<<" p: "<<p;
     }
-    else pbx =  pion_template_em->GetBinContent(  pion_template_em->GetXaxis()->FindBin(p), pion_template_em->GetYaxis()->FindBin(em) );
   }
-  if( pion_template_had ) { // access hcal background template
-    if( accessing_overflow( pion_template_had, p, had ) ) {
+  if( pion_template_had && pion_template_had->isValid() ) { // access hcal background template
+    if( ! pion_template_had->lookup( p, had, pby ) ) {
       pby = 1.;
       psy = 1.;
       LogTrace("MuonIdentification")<<"            // Message: trying to access overflow bin in MuonCompatibility template for hcal - defaulting signal and background  ";
-      LogTrace("MuonIdentification")<<"            // template value to 1. "<<pion_template_had->GetName()<<" e: "<<had<<" p: "<<p;
+      LogTrace("MuonIdentification")<<"            // template value to 1. "<<pion_template_had->name()<<" e: "<<had<<" p: "<<p;
     }
-    else pby =  pion_template_had->GetBinContent(  pion_template_had->GetXaxis()->FindBin(p), pion_template_had->GetYaxis()->FindBin(had) );
   }
-  if(pion_template_ho) { // access ho background template
-    if( accessing_overflow( pion_template_ho, p, ho ) ) {
+  if( pion_template_ho && pion_template_ho->isValid() ) { // access ho background template
+    if( ! pion_template_ho->lookup( p, ho, pbz ) ) {
       pbz = 1.;
       psz = 1.;
       LogTrace("MuonIdentification")<<"            // Message: trying to access overflow bin in MuonCompatibility template for ho   - defaulting signal and background  ";
-      LogTrace("MuonIdentification")<<"            // template value to 1. "<<pion_template_ho->GetName()<<" e: "<<em<<" p: "<<p; 
+      LogTrace("MuonIdentification")<<"            // template value to 1. "<<pion_template_ho->name()<<" e: "<<em<<" p: "<<p; 
     }
-    else pbz =  pion_template_ho->GetBinContent(  pion_template_ho->GetXaxis()->FindBin(p), pion_template_ho->GetYaxis()->FindBin(ho) );
   }
 
 
-  if( muon_template_em )  { // access ecal background template
-    if( accessing_overflow( muon_template_em, p, em ) ) {
+  if( muon_template_em && muon_template_em->isValid() )  { // access ecal background template
+    if( ! muon_template_em->lookup( p, em, psx ) ) {
       psx = 1.;
       pbx = 1.;
       LogTrace("MuonIdentification")<<"            // Message: trying to access overflow bin in MuonCompatibility template for ecal - defaulting signal and background  ";
-      LogTrace("MuonIdentification")<<"            // template value to 1. "<<muon_template_em->GetName()<<" e: "<<em<<" p: "<<p;
+      LogTrace("MuonIdentification")<<"            // template value to 1. "<<muon_template_em->name()<<" e: "<<em<<" p: "<<p;
     }
-    else psx =  muon_template_em->GetBinContent(  muon_template_em->GetXaxis()->FindBin(p), muon_template_em->GetYaxis()->FindBin(em) );
   }
-  if( muon_template_had ) { // access hcal background template
-    if( accessing_overflow( muon_template_had, p, had ) ) {
+  if( muon_template_had && muon_template_had->isValid() ) { // access hcal background template
+    if( ! muon_template_had->lookup( p, had, psy ) ) {
       psy = 1.;
       pby = 1.;
       LogTrace("MuonIdentification")<<"            // Message: trying to access overflow bin in MuonCompatibility template for hcal - defaulting signal and background  ";
-      LogTrace("MuonIdentification")<<"            // template value to 1. "<<muon_template_had->GetName()<<" e: "<<had<<" p: "<<p;
+      LogTrace("MuonIdentification")<<"            // template value to 1. "<<muon_template_had->name()<<" e: "<<had<<" p: "<<p;
     }
-    else psy =  muon_template_had->GetBinContent(  muon_template_had->GetXaxis()->FindBin(p), muon_template_had->GetYaxis()->FindBin(had) );
   }
-  if(muon_template_ho) { // access ho background template
-    if( accessing_overflow( muon_template_ho, p, ho ) ) {
+  if( muon_template_ho && muon_template_ho->isValid() ) { // access ho background template
+    if( ! muon_template_ho->lookup( p, ho, psz ) ) {
       psz = 1.;
       pbz = 1.;
        LogTrace("MuonIdentification")<<"            // Message: trying to access overflow bin in MuonCompatibility template for ho   - defaulting signal and background  ";
-       LogTrace("MuonIdentification")<<"            // template value to 1. "<<muon_template_ho->GetName()<<" e: "<<ho<<" p: "<<p;
+       LogTrace("MuonIdentification")<<"            // template value to 1. "<<muon_template_ho->name()<<" e: "<<ho<<" p: "<<p;
     }
-    else psz =  muon_template_ho->GetBinContent(  muon_template_ho->GetXaxis()->FindBin(p), muon_template_ho->GetYaxis()->FindBin(ho) );
   }
 
   // erm - what is this?!?! How could the HO probability be less than 0????? Do we want this line!?!?
@@ -437,7 +618,7 @@ double MuonCaloCompatibility::evaluate( const reco::Muon& amuon ) {
     LogTrace("MuonIdentification")<<"Input variables: eta    p     em     had    ho "<<"\n"
 	     <<eta<<" "<<p<<" "<<em<<" "<<had<<" "<<ho<<" "<<"\n"
 	     <<"cal uncorr:    em     had    ho "<<"\n"
-	     <<eta<<" "<<p<<" "<<amuon.calEnergy().em<<" "<<amuon.calEnergy().had<<" "<<amuon.calEnergy().ho;
+	     <<eta<<" "<<p<<" "<<in.em<<" "<<in.had<<" "<<in.ho;
   }
   return muon_compatibility;
 }
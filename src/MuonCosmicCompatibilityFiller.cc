@@ -16,6 +16,7 @@
 // system include files
 #include <memory>
 #include <string>
+#include <algorithm>
 
 // user include files
 #include "FWCore/Framework/interface/Event.h"
@@ -107,21 +108,86 @@ MuonCosmicCompatibilityFiller::~MuonCosmicCompatibilityFiller() {
   if (service_) delete service_;
 }
 
+const muonid::OppositeTrackFinder*
+MuonCosmicCompatibilityFiller::oppositeTrackFinder( const EventContext& context, const edm::InputTag& tag ) const
+{
+  for (unsigned int iColl = 0; iColl<inputTrackCollections_.size() && iColl<context.tracks.size(); ++iColl)
+    if ( inputTrackCollections_[iColl] == tag && context.tracks[iColl].isValid() )
+      return &context.oppositeTrackFinders[iColl];
+  return 0;
+}
+
+void
+MuonCosmicCompatibilityFiller::fillEventContext( EventContext& context, const edm::Event& iEvent, const edm::EventSetup& iSetup )
+{
+  service_->update(iSetup);
+
+  // all reco muons, used for the multiplicity and the "other" muon of the event
+  context.globalMuons.clear();
+  iEvent.getByLabel(inputMuonCollections_[1], context.muons);
+  if( !context.muons.failedToGet() ) {
+    for ( reco::MuonCollection::const_iterator iMuon = context.muons->begin(); iMuon !=  context.muons->end(); ++iMuon ) {
+      if (!iMuon->isGlobalMuon()) continue;
+      context.globalMuons.push_back(&*iMuon);
+    }
+  }
+
+  context.tracks.resize(inputTrackCollections_.size());
+  context.oppositeTrackFinders.resize(inputTrackCollections_.size());
+  for (unsigned int iColl = 0; iColl<inputTrackCollections_.size(); ++iColl){
+    iEvent.getByLabel(inputTrackCollections_[iColl],context.tracks[iColl]);
+    context.oppositeTrackFinders[iColl].setTracks(context.tracks[iColl]);
+  }
+
+  iEvent.getByLabel(inputVertexCollection_,context.vertices);
+
+  // Global Tracking Geometry
+  iSetup.get<GlobalTrackingGeometryRecord>().get(context.trackingGeometry);
+
+  // valid hits of the cosmic muons and where they are
+  context.cosmicMuonHits.clear();
+  iEvent.getByLabel(inputCosmicMuonCollection_, context.cosmicMuons);
+  if( !context.cosmicMuons.failedToGet() ) {
+    context.cosmicMuonHits.resize(context.cosmicMuons->size());
+    for ( unsigned int iCosmic = 0; iCosmic < context.cosmicMuons->size(); ++iCosmic ) {
+      reco::TrackRef costrack = (*context.cosmicMuons)[iCosmic].outerTrack();
+      if( costrack.isNull() ) continue;
+      CosmicMuonHits& hits = context.cosmicMuonHits[iCosmic];
+      for( trackingRecHit_iterator coshit = costrack->recHitsBegin(); coshit != costrack->recHitsEnd(); coshit++ ) {
+	if( (*coshit)->isValid() ) {
+	  DetId id((*coshit)->geographicalId());
+	  double hity = context.trackingGeometry->idToDet(id)->position().y();
+	  if( hity > 0 ) hits.nhitsUp++;
+	  if( hity < 0 ) hits.nhitsDown++;
+	  hits.validHits.push_back(HitKey(id.rawId(), (*coshit)->localPosition()));
+	}
+      }
+      std::sort(hits.validHits.begin(), hits.validHits.end());
+    }
+  }
+
+  context.goodVertices = eventActivity(context);
+}
+
 reco::MuonCosmicCompatibility
 MuonCosmicCompatibilityFiller::fillCompatibility( const reco::Muon& muon, edm::Event& iEvent, const edm::EventSetup& iSetup )
 {
-  const std::string theCategory = "MuonCosmicCompatibilityFiller";
+  EventContext context;
+  fillEventContext(context, iEvent, iSetup);
+  return fillCompatibility(muon, context);
+}
 
+reco::MuonCosmicCompatibility
+MuonCosmicCompatibilityFiller::fillCompatibility( const reco::Muon& muon, const EventContext& context ) const
+{
   reco::MuonCosmicCompatibility returnComp;
   
-  service_->update(iSetup);
-  
-  float timeCompatibility = muonTiming(iEvent, muon, false);
-  float backToBackCompatibility = backToBack2LegCosmic(iEvent,muon);    
-  float overlapCompatibility = isOverlappingMuon(iEvent,iSetup,muon);
-  float ipCompatibility = pvMatches(iEvent,muon,false);
-  float vertexCompatibility = eventActivity(iEvent,muon);
-  float combinedCompatibility = combinedCosmicID(iEvent,iSetup,muon,false,false);
+  float timeCompatibility = muonTiming(context, muon, false);
+  float backToBackCompatibility = backToBack2LegCosmic(context,muon);    
+  float overlapCompatibility = isOverlappingMuon(context,muon);
+  float ipCompatibility = pvMatches(context,muon,false);
+  float vertexCompatibility = context.goodVertices;
+  float combinedCompatibility = combinedCosmicID(context,muon,false,false);
   
   returnComp.timeCompatibility = timeCompatibility;
   returnComp.backToBackCompatibility = backToBackCompatibility;
@@ -138,7 +204,7 @@ MuonCosmicCompatibilityFiller::fillCompatibility( const reco::Muon& muon, edm::E
 //Timing: 0 - not cosmic-like
 //
 float
-MuonCosmicCompatibilityFiller::muonTiming(const edm::Event& iEvent, const reco::Muon& muon, bool isLoose) const {
+MuonCosmicCompatibilityFiller::muonTiming(const EventContext& context, const reco::Muon& muon, bool isLoose) const {
 
    float offTimeNegMult, offTimePosMult, offTimeNeg, offTimePos;
 
@@ -159,7 +225,7 @@ MuonCosmicCompatibilityFiller::muonTiming(const edm::Event& iEvent, const reco::
 
   if( muon.isTimeValid() ) {
     //case of multiple muon event
-    if (nMuons(iEvent) > 1) {
+    if (context.globalMuons.size() > 1) {
 
       float positiveTime = 0;
       if ( muon.time().timeAtIpInOut < offTimeNegMult || muon.time().timeAtIpInOut > offTimePosMult) result = 1.;
@@ -176,28 +242,21 @@ MuonCosmicCompatibilityFiller::muonTiming(const edm::Event& iEvent, const reco::
               if( outertrack->phi() > 0 ) isUp = true;
 
               //loop over muons in that event and find if there are any in the opposite hemi 
-              edm::Handle<reco::MuonCollection> muonHandle;
-              iEvent.getByLabel(inputMuonCollections_[1], muonHandle);
-
-              if( !muonHandle.failedToGet() ) {
-                  for ( reco::MuonCollection::const_iterator iMuon = muonHandle->begin(); iMuon !=  muonHandle->end(); ++iMuon ) {
-                      if (!iMuon->isGlobalMuon()) continue;
-
-                      reco::TrackRef checkedTrack = iMuon->outerTrack();
-                      if( muon.isTimeValid() ) {
-
-                          // from bottom up
-                          if (checkedTrack->phi() < 0 && isUp) {
-                              if (iMuon->time().timeAtIpInOut < corrTimeNeg_) result = 1.0;
-                              break;
-                          } else if (checkedTrack->phi() > 0 && !isUp) {
-                               // from top down 
-                               if (iMuon->time().timeAtIpInOut < corrTimeNeg_) result = 1.0; 
-                               break;
-                             }
-                         } //muon is time valid
-                     } 
-                 }
+              for ( std::vector<const reco::Muon*>::const_iterator iMuon = context.globalMuons.begin(); iMuon != context.globalMuons.end(); ++iMuon ) {
+                  reco::TrackRef checkedTrack = (*iMuon)->outerTrack();
+                  if( muon.isTimeValid() ) {
+
+                      // from bottom up
+                      if (checkedTrack->phi() < 0 && isUp) {
+                          if ((*iMuon)->time().timeAtIpInOut < corrTimeNeg_) result = 1.0;
+                          break;
+                      } else if (checkedTrack->phi() > 0 && !isUp) {
+                           // from top down 
+                           if ((*iMuon)->time().timeAtIpInOut < corrTimeNeg_) result = 1.0; 
+                           break;
+                         }
+                     } //muon is time valid
+                 } 
              } //track is nonnull
          } //double check timing
      } else {
@@ -209,7 +268,7 @@ MuonCosmicCompatibilityFiller::muonTiming(const edm::Event& iEvent, const reco::
   
    if (!isLoose && result > 0) {
      //check loose ip
-     if (pvMatches(iEvent, muon, true) == 0) result *= 2.;
+     if (pvMatches(context, muon, true) == 0) result *= 2.;
    } 
 
    return result;
@@ -219,7 +278,7 @@ MuonCosmicCompatibilityFiller::muonTiming(const edm::Event& iEvent, const reco::
 //Back-to-back selector 
 //
 unsigned int 
-MuonCosmicCompatibilityFiller::backToBack2LegCosmic(const edm::Event& iEvent, const reco::Muon& muon) const {
+MuonCosmicCompatibilityFiller::backToBack2LegCosmic(const EventContext& context, const reco::Muon& muon) const {
 
   unsigned int result = 0; //no partners - collision
   reco::TrackRef track;
@@ -227,10 +286,12 @@ MuonCosmicCompatibilityFiller::backToBack2LegCosmic(const edm::Event& iEvent, co
   else if ( muon.isTrackerMuon() )       track = muon.track();
   else if ( muon.isStandAloneMuon() )    return false;
 
-  for (unsigned int iColl = 0; iColl<inputTrackCollections_.size(); ++iColl){
-    edm::Handle<reco::TrackCollection> trackHandle;
-    iEvent.getByLabel(inputTrackCollections_[iColl],trackHandle);
-    if (muonid::findOppositeTrack(trackHandle, *track, angleThreshold_, deltaPt_).isNonnull()) { 
+  for (unsigned int iColl = 0; iColl<context.tracks.size(); ++iColl){
+    // a missing collection fails in findOppositeTrack as it used to
+    reco::TrackRef partner = context.tracks[iColl].isValid() ?
+      context.oppositeTrackFinders[iColl].find(*track, angleThreshold_, deltaPt_) :
+      muonid::findOppositeTrack(context.tracks[iColl], *track, angleThreshold_, deltaPt_);
+    if (partner.isNonnull()) { 
       result++;
      }
    } //loop over track collections
@@ -238,33 +299,11 @@ MuonCosmicCompatibilityFiller::backToBack2LegCosmic(const edm::Event& iEvent, co
   return result;
 }
 
-//
-//Check the number of global muons in an event, return true if there are more than 1 muon
-//
-unsigned int
-MuonCosmicCompatibilityFiller::nMuons(const edm::Event& iEvent) const {
-
-    unsigned int nGlb = 0;
-
-    edm::Handle<reco::MuonCollection> muonHandle;
-    iEvent.getByLabel(inputMuonCollections_[1], muonHandle);
-
-    if( !muonHandle.failedToGet() ) {
-      for ( reco::MuonCollection::const_iterator iMuon = muonHandle->begin(); iMuon !=  muonHandle->end(); ++iMuon ) {
-         if (!iMuon->isGlobalMuon()) continue;
-           nGlb++;
-        }
-      } 
- 
-    return nGlb;
-}
-
-
 //
 //Check overlap between collections, use shared hits info
 //
 bool 
-MuonCosmicCompatibilityFiller::isOverlappingMuon(const edm::Event& iEvent, const edm::EventSetup& iSetup, const reco::Muon& muon) const {
+MuonCosmicCompatibilityFiller::isOverlappingMuon(const EventContext& context, const reco::Muon& muon) const {
 
   // 4 steps in this module
   // step1 : check whether it's 1leg cosmic muon or not
@@ -277,27 +316,11 @@ MuonCosmicCompatibilityFiller::isOverlappingMuon(const edm::Event& iEvent, const
   if( !muon.isGlobalMuon() ) return false;
   
   // reco muons for cosmics
-  edm::Handle<reco::MuonCollection> muonHandle;
-  iEvent.getByLabel(inputCosmicMuonCollection_, muonHandle);
-  
-  // Global Tracking Geometry
-  ESHandle<GlobalTrackingGeometry> trackingGeometry;
-  iSetup.get<GlobalTrackingGeometryRecord>().get(trackingGeometry);
-  
-  // PV
-  math::XYZPoint RefVtx;
-  RefVtx.SetXYZ(0, 0, 0);
-  
-  edm::Handle<reco::VertexCollection> pvHandle;
-  iEvent.getByLabel(inputVertexCollection_,pvHandle);
-  const reco::VertexCollection & vertices = *pvHandle.product();
-  for(reco::VertexCollection::const_iterator it=vertices.begin() ; it!=vertices.end() ; ++it) {
-      RefVtx = it->position();
-  }
-  
+  const edm::Handle<reco::MuonCollection>& muonHandle = context.cosmicMuons;
   
   if( !muonHandle.failedToGet() ) {
     for ( reco::MuonCollection::const_iterator cosmicMuon = muonHandle->begin();cosmicMuon !=  muonHandle->end(); ++cosmicMuon ) {
+      const CosmicMuonHits& cosmicHits = context.cosmicMuonHits[cosmicMuon - muonHandle->begin()];
       if ( cosmicMuon->innerTrack() == muon.innerTrack() || cosmicMuon->outerTrack() == muon.outerTrack()) return true;
       
       reco::TrackRef outertrack = muon.outerTrack();
@@ -312,26 +335,14 @@ MuonCosmicCompatibilityFiller::isOverlappingMuon(const edm::Event& iEvent, const
       int shared = 0;
       // count hits for same hemisphere
       if( costrack.isNonnull() ) {
-	int nhitsUp = 0;
-	int nhitsDown = 0;
 	// unused
 	//	bool isCosmic1Leg = false;
 	//	bool isCloseIP = false;
 	//	bool isCloseRef = false;
 
-	for( trackingRecHit_iterator coshit = costrack->recHitsBegin(); coshit != costrack->recHitsEnd(); coshit++ ) {
-	  if( (*coshit)->isValid() ) {
-	    DetId id((*coshit)->geographicalId());
-	    double hity = trackingGeometry->idToDet(id)->position().y();
-	    if( hity > 0 ) nhitsUp++;
-	    if( hity < 0 ) nhitsDown++;
-
-	    if( isUp && hity > 0 ) RecHitsCosmicMuon++;
-	    if( !isUp && hity < 0 ) RecHitsCosmicMuon++;
-	  }
-	}
+	RecHitsCosmicMuon = isUp ? cosmicHits.nhitsUp : cosmicHits.nhitsDown;
 	// step1
-	//UNUSED:	if( nhitsUp > 0 && nhitsDown > 0 ) isCosmic1Leg = true;
+	//UNUSED:	if( cosmicHits.nhitsUp > 0 && cosmicHits.nhitsDown > 0 ) isCosmic1Leg = true;
 	//if( !isCosmic1Leg ) continue;
 	
 	if( outertrack.isNonnull() ) {
@@ -350,13 +361,12 @@ MuonCosmicCompatibilityFiller::isOverlappingMuon(const edm::Event& iEvent, const
 
 	  for( trackingRecHit_iterator trkhit = outertrack->recHitsBegin(); trkhit != outertrack->recHitsEnd(); trkhit++ ) {
 	    if( (*trkhit)->isValid() ) {
-	      for( trackingRecHit_iterator coshit = costrack->recHitsBegin(); coshit != costrack->recHitsEnd(); coshit++ ) {
-		if( (*coshit)->isValid() ) {
-		  if( (*trkhit)->geographicalId() == (*coshit)->geographicalId() ) {
-		    if( ((*trkhit)->localPosition() - (*coshit)->localPosition()).mag()< 10e-5 ) shared++;
-		  }
-		  
-		}
+	      // only the cosmic hits on the same DetId can be shared
+	      HitKey key((*trkhit)->geographicalId().rawId(), (*trkhit)->localPosition());
+	      std::pair<std::vector<HitKey>::const_iterator, std::vector<HitKey>::const_iterator> sameId =
+		std::equal_range(cosmicHits.validHits.begin(), cosmicHits.validHits.end(), key);
+	      for( std::vector<HitKey>::const_iterator coshit = sameId.first; coshit != sameId.second; coshit++ ) {
+		if( (key.position - coshit->position).mag()< 10e-5 ) shared++;
 	      }
 	    }
 	  }
@@ -380,7 +390,7 @@ MuonCosmicCompatibilityFiller::isOverlappingMuon(const edm::Event& iEvent, const
 //pv matches
 //
 unsigned int 
-MuonCosmicCompatibilityFiller::pvMatches(const edm::Event& iEvent, const reco::Muon& muon, bool isLoose) const {
+MuonCosmicCompatibilityFiller::pvMatches(const EventContext& context, const reco::Muon& muon, bool isLoose) const {
 
    float maxdxyMult, maxdzMult, maxdxy, maxdz;
 
@@ -405,14 +415,12 @@ MuonCosmicCompatibilityFiller::pvMatches(const edm::Event& iEvent, const reco::M
   else if ( muon.isStandAloneMuon())  track = muon.standAloneMuon();
   
   bool multipleMu = false;
-  if (nMuons(iEvent) > 1) multipleMu = true;
+  if (context.globalMuons.size() > 1) multipleMu = true;
 
   math::XYZPoint RefVtx;
   RefVtx.SetXYZ(0, 0, 0);
 
-  edm::Handle<reco::VertexCollection> pvHandle;
-  iEvent.getByLabel(inputVertexCollection_,pvHandle);
-  const reco::VertexCollection & vertices = *pvHandle.product();
+  const reco::VertexCollection & vertices = *context.vertices.product();
   for(reco::VertexCollection::const_iterator it=vertices.begin() ; it!=vertices.end() ; ++it){
     RefVtx = it->position();
 
@@ -444,33 +452,21 @@ MuonCosmicCompatibilityFiller::pvMatches(const edm::Event& iEvent, const reco::M
    //special case for non-cosmic large ip muons
    if (result == 0 && multipleMu) {
       // consider all reco muons in an event
-      edm::Handle<reco::MuonCollection> muonHandle;
-      iEvent.getByLabel(inputMuonCollections_[1], muonHandle);
-
-      //cosmic event should have zero good vertices
-      edm::Handle<reco::VertexCollection> pvHandle;
-      iEvent.getByLabel(inputVertexCollection_,pvHandle);
-      const reco::VertexCollection & vertices = *pvHandle.product();
-
       //find the "other" one
-      if( !muonHandle.failedToGet() ) {
-         for ( reco::MuonCollection::const_iterator muons = muonHandle->begin(); muons !=  muonHandle->end(); ++muons ) {
-            if (!muons->isGlobalMuon()) continue;
-            //skip this track  
-            if ( muons->innerTrack() == muon.innerTrack() && muons->outerTrack() == muon.outerTrack()) continue;
-                //check ip and vertex of the "other" muon
-                reco::TrackRef tracks;
-                if (muons->isGlobalMuon()) tracks = muons->innerTrack();
-                if (fabs((*tracks).dxy(RefVtx)) > hIpTrdxy_) continue; 
-                //check if vertex collection is empty
-                if (vertices.begin() == vertices.end()) continue;
-                //for(reco::VertexCollection::const_iterator it=vertices.begin() ; it!=vertices.end() ; ++it) {
-                    //find matching vertex by position
-                    //if (fabs(it->z() - tracks->vz()) > 0.01) continue; //means will not be untagged from cosmics 
-                    if (TMath::Prob(vertices.front().chi2(),(int)(vertices.front().ndof())) > hIpTrvProb_) result = 1; 
-               //}
-           }
-      }
+      for ( std::vector<const reco::Muon*>::const_iterator muons = context.globalMuons.begin(); muons != context.globalMuons.end(); ++muons ) {
+         //skip this track  
+         if ( (*muons)->innerTrack() == muon.innerTrack() && (*muons)->outerTrack() == muon.outerTrack()) continue;
+             //check ip and vertex of the "other" muon
+             reco::TrackRef tracks = (*muons)->innerTrack();
+             if (fabs((*tracks).dxy(RefVtx)) > hIpTrdxy_) continue; 
+             //check if vertex collection is empty
+             if (vertices.begin() == vertices.end()) continue;
+             //for(reco::VertexCollection::const_iterator it=vertices.begin() ; it!=vertices.end() ; ++it) {
+                 //find matching vertex by position
+                 //if (fabs(it->z() - tracks->vz()) > 0.01) continue; //means will not be untagged from cosmics 
+                 if (TMath::Prob(vertices.front().chi2(),(int)(vertices.front().ndof())) > hIpTrvProb_) result = 1; 
+            //}
+        }
  }
 
     return result;
@@ -478,8 +474,8 @@ MuonCosmicCompatibilityFiller::pvMatches(const edm::Event& iEvent, const reco::M
 }
 
 float
-MuonCosmicCompatibilityFiller::combinedCosmicID(const edm::Event& iEvent,
-                                   const edm::EventSetup& iSetup, const reco::Muon& muon, bool CheckMuonID, bool checkVertex) const {
+MuonCosmicCompatibilityFiller::combinedCosmicID(const EventContext& context, 
+                                   const reco::Muon& muon, bool CheckMuonID, bool checkVertex) const {
 
   float result = 0.0;
 
@@ -487,13 +483,13 @@ MuonCosmicCompatibilityFiller::combinedCosmicID(const edm::Event& iEvent,
   // return 0.0 = identify as collision muon
   if( muon.isGlobalMuon() ) {
 
-    unsigned int cosmicVertex = eventActivity(iEvent, muon);
-    bool isOverlapping = isOverlappingMuon(iEvent, iSetup, muon);
-    unsigned int looseIp = pvMatches(iEvent, muon, true);
-    unsigned int tightIp = pvMatches(iEvent, muon, false);
-    float looseTime = muonTiming(iEvent, muon, true);
-    float tightTime = muonTiming(iEvent, muon, false);
-    unsigned int backToback = backToBack2LegCosmic(iEvent,muon);
+    unsigned int cosmicVertex = context.goodVertices;
+    bool isOverlapping = isOverlappingMuon(context, muon);
+    unsigned int looseIp = pvMatches(context, muon, true);
+    unsigned int tightIp = pvMatches(context, muon, false);
+    float looseTime = muonTiming(context, muon, true);
+    float tightTime = muonTiming(context, muon, false);
+    unsigned int backToback = backToBack2LegCosmic(context,muon);
     //bool cosmicSegment = checkMuonSegments(muon);
 
     //short cut to reject cosmic event
@@ -576,19 +572,18 @@ MuonCosmicCompatibilityFiller::combinedCosmicID(const edm::Event& iEvent,
 //Track activity/vertex quality, count good vertices
 //
 unsigned int 
-MuonCosmicCompatibilityFiller::eventActivity(const edm::Event& iEvent, const reco::Muon& muon) const
+MuonCosmicCompatibilityFiller::eventActivity(const EventContext& context) const
 {
 
   unsigned int result = 0; //no good vertices - cosmic-like
 
   //check track activity
-  edm::Handle<reco::TrackCollection> tracks;
-  iEvent.getByLabel(inputTrackCollections_[0],tracks);
+  const edm::Handle<reco::TrackCollection>& tracks = context.tracks[0];
   if (!tracks.failedToGet() && tracks->size() < 3) return 0; 
 
   //cosmic event should have zero good vertices
-  edm::Handle<reco::VertexCollection> pvHandle;
-  if (!iEvent.getByLabel(inputVertexCollection_,pvHandle)) {return 0;} else {
+  const edm::Handle<reco::VertexCollection>& pvHandle = context.vertices;
+  if (!pvHandle.isValid()) {return 0;} else {
       const reco::VertexCollection & vertices = *pvHandle.product();
       //check if vertex collection is empty
       if (vertices.begin() == vertices.end()) return 0;
@@ -1,5 +1,7 @@
 #include "RecoMuon/MuonIdentification/interface/MuonCosmicsId.h"
 #include "DataFormats/TrackReco/interface/Track.h"
+#include <algorithm>
+#include <cmath>
 
 bool directionAlongMomentum(const reco::Track& track){
   // check is done in 2D
@@ -42,3 +44,164 @@ muonid::findOppositeTrack(const edm::Handle<reco::TrackCollection>& tracks,
   return reco::TrackRef();
 
 }
+
+namespace {
+  // unit vector along which the track was reconstructed
+  bool reconstructedDirection(const reco::Track& track, double& x, double& y, double& z){
+    double p = track.p();
+    if ( !(p > 0) ) return false;
+    double sign = directionAlongMomentum(track) ? 1. : -1.;
+    x = sign*track.px()/p;
+    y = sign*track.py()/p;
+    z = sign*track.pz()/p;
+    return true;
+  }
+}
+
+muonid::OppositeTrackFinder::OppositeTrackFinder()
+{}
+
+muonid::OppositeTrackFinder::OppositeTrackFinder(const edm::Handle<reco::TrackCollection>& tracks)
+{
+  setTracks(tracks);
+}
+
+unsigned int
+muonid::OppositeTrackFinder::cosThetaBin(double cosTheta)
+{
+  int bin = int( floor( (cosTheta+1.)/2.*nCosThetaBins ) );
+  if ( bin < 0 ) return 0;
+  if ( bin >= int(nCosThetaBins) ) return nCosThetaBins-1;
+  return bin;
+}
+
+unsigned int
+muonid::OppositeTrackFinder::phiBin(double phi)
+{
+  int bin = int( floor( (phi+M_PI)/(2*M_PI)*nPhiBins ) ) % int(nPhiBins);
+  if ( bin < 0 ) bin += nPhiBins;
+  return bin;
+}
+
+void
+muonid::OppositeTrackFinder::setTracks(const edm::Handle<reco::TrackCollection>& tracks)
+{
+  tracks_ = tracks;
+  binBegin_.assign(nCosThetaBins*nPhiBins+1, 0);
+  entries_.clear();
+  if ( ! tracks.isValid() ) return;
+  
+  // the tracks without momentum never match and are not indexed
+  std::vector<int> trackBins(tracks->size(), -1);
+  for (unsigned int i=0; i<tracks->size(); ++i){
+    double x, y, z;
+    if ( ! reconstructedDirection(tracks->at(i), x, y, z) ) continue;
+    trackBins[i] = cosThetaBin(z)*nPhiBins + phiBin(atan2(y,x));
+    ++binBegin_[trackBins[i]+1];
+  }
+  for (unsigned int bin=0; bin<nCosThetaBins*nPhiBins; ++bin)
+    binBegin_[bin+1] += binBegin_[bin];
+  entries_.resize(binBegin_.back());
+  std::vector<unsigned int> next(binBegin_.begin(), binBegin_.end()-1);
+  for (unsigned int i=0; i<tracks->size(); ++i){
+    if ( trackBins[i] < 0 ) continue;
+    const reco::Track& track = tracks->at(i);
+    Entry& entry = entries_[next[trackBins[i]]++];
+    entry.px = track.px();
+    entry.py = track.py();
+    entry.pz = track.pz();
+    entry.p  = track.p();
+    entry.pt = track.pt();
+    entry.alongMomentum = directionAlongMomentum(track);
+    entry.index = i;
+  }
+  for (unsigned int bin=0; bin<nCosThetaBins*nPhiBins; ++bin)
+    if ( binBegin_[bin+1] - binBegin_[bin] > 1 )
+      std::sort(entries_.begin()+binBegin_[bin], entries_.begin()+binBegin_[bin+1]);
+}
+
+reco::TrackRef
+muonid::OppositeTrackFinder::find(const reco::Track& muonTrack,
+				  double angleMatch,
+				  double momentumMatch) const
+{
+  if ( ! tracks_.isValid() || entries_.empty() ) return reco::TrackRef();
+  
+  // the momentum match is never fulfilled for a muon without pt
+  const double muonPt = muonTrack.pt();
+  if ( !(muonPt > 0) || !(momentumMatch > 0) ) return reco::TrackRef();
+  
+  // the matching tracks point against the muon
+  double x, y, z;
+  if ( ! reconstructedDirection(muonTrack, x, y, z) ) return reco::TrackRef();
+  x = -x; y = -y; z = -z;
+  
+  // |pt-ptMuon|/sqrt(pt*ptMuon) < momentumMatch for ptMuon/r < pt < ptMuon*r,
+  // with a margin for the rounding
+  const double sqrtRatio = (momentumMatch + sqrt(momentumMatch*momentumMatch+4))/2;
+  const double ptMin = muonPt/(sqrtRatio*sqrtRatio)*(1-1e-6);
+  const double ptMax = muonPt*(sqrtRatio*sqrtRatio)*(1+1e-6);
+  
+  // cosines above cosAccept are within the angle, below cosReject they are
+  // outside, in between acos decides like in matchTracks
+  double cosReject = -2, cosAccept = 2;
+  if ( angleMatch > 0 && angleMatch < M_PI ){
+    cosReject = cos(angleMatch) - 1e-9;
+    cosAccept = cos(angleMatch) + 1e-9;
+  }
+  const bool muonAlongMomentum = directionAlongMomentum(muonTrack);
+  const double muonP = muonTrack.p();
+  
+  // bins within the angle, with a margin for the rounding in matchTracks
+  const double angle = angleMatch*1.001 + 1e-6;
+  unsigned int firstCosThetaBin = 0, lastCosThetaBin = nCosThetaBins-1;
+  unsigned int firstPhiBin = 0, nPhi = nPhiBins;
+  if ( angle < M_PI ){
+    double theta = acos( std::max(-1., std::min(1., z)) );
+    double thetaMin = std::max(0., theta-angle);
+    double thetaMax = std::min(M_PI, theta+angle);
+    firstCosThetaBin = cosThetaBin(cos(thetaMax));
+    lastCosThetaBin  = cosThetaBin(cos(thetaMin));
+    if ( thetaMin > 0 && thetaMax < M_PI ){
+      // sin(dPhi/2) < sin(angle/2)/sqrt(sin(theta1)*sin(theta2)) for the directions in the band
+      double ratio = sin(angle/2)/std::min(sin(thetaMin), sin(thetaMax));
+      if ( ratio < 1 ){
+	double dPhi = 2*asin(ratio);
+	// a window close to the full circle is not counted modulo the bins
+	if ( dPhi < M_PI - 2*M_PI/nPhiBins ){
+	  double phi = atan2(y,x);
+	  firstPhiBin = phiBin(phi-dPhi);
+	  unsigned int lastPhiBin = phiBin(phi+dPhi);
+	  nPhi = (lastPhiBin + nPhiBins - firstPhiBin) % nPhiBins + 1;
+	}
+      }
+    }
+  }
+  
+  // first matching track in the collection order
+  Entry lowest;
+  lowest.pt = ptMin;
+  lowest.index = 0;
+  unsigned int best = tracks_->size();
+  for (unsigned int cosThetaIndex = firstCosThetaBin; cosThetaIndex <= lastCosThetaBin; ++cosThetaIndex)
+    for (unsigned int k = 0; k < nPhi; ++k){
+      unsigned int bin = cosThetaIndex*nPhiBins + (firstPhiBin+k) % nPhiBins;
+      std::vector<Entry>::const_iterator end = entries_.begin()+binBegin_[bin+1];
+      for (std::vector<Entry>::const_iterator entry = std::lower_bound(entries_.begin()+binBegin_[bin], end, lowest);
+	   entry != end && entry->pt < ptMax; ++entry){
+	if ( entry->index >= best ) continue;
+	// same arithmetic as matchTracks
+	int match_sign = muonAlongMomentum==entry->alongMomentum ? -1 : +1;
+	double sprod = muonTrack.px()*entry->px + muonTrack.py()*entry->py + muonTrack.pz()*entry->pz;
+	double argCos = match_sign*(sprod/muonP/entry->p);
+	if (argCos < -1.0) argCos = -1.0;
+	if (argCos > 1.0) argCos = 1.0;
+	if ( argCos < cosReject ) continue;
+	if ( argCos <= cosAccept && !(acos(argCos) < angleMatch) ) continue;
+	if ( fabs(entry->pt-muonPt)/sqrt(muonPt*entry->pt) < momentumMatch )
+	  best = entry->index;
+      }
+    }
+  if ( best < tracks_->size() ) return reco::TrackRef(tracks_,best);
+  return reco::TrackRef();
+}
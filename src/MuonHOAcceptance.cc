@@ -18,21 +18,16 @@
 
 #include "FWCore/Framework/interface/ESHandle.h"
 
-std::vector<uint32_t> MuonHOAcceptance::deadIds;
-std::vector<MuonHOAcceptance::deadRegion> MuonHOAcceptance::deadRegions;
-std::vector<uint32_t> MuonHOAcceptance::SiPMIds;
-std::vector<MuonHOAcceptance::deadRegion> MuonHOAcceptance::SiPMRegions;
-bool MuonHOAcceptance::inited = false;
-int const MuonHOAcceptance::etaBounds = 5;
-double const MuonHOAcceptance::etaMin[etaBounds] = 
+int const MuonHOAcceptanceMap::etaBounds = 5;
+double const MuonHOAcceptanceMap::etaMin[etaBounds] = 
   //{-1.262, -0.861, -0.307, 0.341, 0.885};
   {-1.2544, -0.8542, -0.3017, 0.3425, 0.8796};
-double const MuonHOAcceptance::etaMax[etaBounds] = 
+double const MuonHOAcceptanceMap::etaMax[etaBounds] = 
   //{-0.885, -0.341,  0.307, 0.861, 1.262};
   {-0.8796, -0.3425,  0.3017, 0.8542, 1.2544};
-double const MuonHOAcceptance::twopi = 2.*3.14159265358979323846;
-int const MuonHOAcceptance::phiSectors = 12;
-double const MuonHOAcceptance::phiMinR0[phiSectors] = {-0.16172,
+double const MuonHOAcceptanceMap::twopi = 2.*3.14159265358979323846;
+int const MuonHOAcceptanceMap::phiSectors = 12;
+double const MuonHOAcceptanceMap::phiMinR0[phiSectors] = {-0.16172,
 						        0.3618786,
 						        0.8854773,
 						        1.409076116,
@@ -44,7 +39,7 @@ double const MuonHOAcceptance::phiMinR0[phiSectors] = {-0.16172,
 						        4.55066877,
 						        5.074267545,
 						        5.597866321 };
-double const MuonHOAcceptance::phiMaxR0[phiSectors] = { 0.317395374,
+double const MuonHOAcceptanceMap::phiMaxR0[phiSectors] = { 0.317395374,
 							0.84099415,
 							1.364592925,
 							1.888191701,
@@ -56,7 +51,7 @@ double const MuonHOAcceptance::phiMaxR0[phiSectors] = { 0.317395374,
 							5.029784355,
 							5.55338313,
 							6.076981906 };
-double const MuonHOAcceptance::phiMinR12[phiSectors] = {-0.166264081,
+double const MuonHOAcceptanceMap::phiMinR12[phiSectors] = {-0.166264081,
 							 0.357334694,
 							 0.88093347,
 							 1.404532245,
@@ -68,7 +63,7 @@ double const MuonHOAcceptance::phiMinR12[phiSectors] = {-0.166264081,
 							 4.546124899,
 							 5.069723674,
 							 5.59332245 };
-double const MuonHOAcceptance::phiMaxR12[phiSectors] = { 0.34398862,
+double const MuonHOAcceptanceMap::phiMaxR12[phiSectors] = { 0.34398862,
 							 0.867587396,
 							 1.391186172,
 							 1.914784947,
@@ -81,35 +76,47 @@ double const MuonHOAcceptance::phiMaxR12[phiSectors] = { 0.34398862,
 							 5.579976376,
 							 6.103575152 };
 
-bool MuonHOAcceptance::isChannelDead(uint32_t id) {
+MuonHOAcceptanceMap::MuonHOAcceptanceMap(edm::EventSetup const& eSetup) : 
+  inited(false) 
+{
+  initIds(eSetup);
+}
+
+bool MuonHOAcceptanceMap::isChannelDead(uint32_t id) const {
   if (!inited) return false;
-  std::vector<uint32_t>::const_iterator found = 
-    std::find(deadIds.begin(), deadIds.end(), id);
-  if ((found != deadIds.end()) && (*found == id)) return true;
-  else return false;
+  // the ids are sorted in initIds
+  return std::binary_search(deadIds.begin(), deadIds.end(), id);
 }
 
-bool MuonHOAcceptance::isChannelSiPM(uint32_t id) {
+bool MuonHOAcceptanceMap::isChannelSiPM(uint32_t id) const {
   if (!inited) return false;
-  std::vector<uint32_t>::const_iterator found =
-    std::find(SiPMIds.begin(), SiPMIds.end(), id);
-  if ((found != SiPMIds.end()) && (*found == id)) return true;
-  else return false;
+  return std::binary_search(SiPMIds.begin(), SiPMIds.end(), id);
 }
 
-bool MuonHOAcceptance::inGeomAccept(double eta, double phi, 
+bool MuonHOAcceptanceMap::inGeomAccept(double eta, double phi, 
 				    double delta_eta, double delta_phi)
 {
+  static double const phiStep = twopi/phiSectors;
   for (int ieta = 0; ieta<etaBounds; ++ieta) {
     if ( (eta > etaMin[ieta]+delta_eta) &&
 	 (eta < etaMax[ieta]-delta_eta) ) {
-      for (int iphi = 0; iphi<phiSectors; ++iphi) {
-	double const * mins =  ((ieta == 2) ? phiMinR0 : phiMinR12);
-	double const * maxes = ((ieta == 2) ? phiMaxR0 : phiMaxR12);
-	while (phi < mins[0]) 
-	  phi += twopi;
-	while (phi > mins[0]+twopi)
-	  phi -= twopi;
+      double const * mins =  ((ieta == 2) ? phiMinR0 : phiMinR12);
+      double const * maxes = ((ieta == 2) ? phiMaxR0 : phiMaxR12);
+      while (phi < mins[0]) 
+	phi += twopi;
+      while (phi > mins[0]+twopi)
+	phi -= twopi;
+      // the sectors start every 2pi/12 and are narrower than that, so with
+      // a non negative margin only the sector below phi and its neighbours
+      // can contain it
+      int first = 0;
+      int last = phiSectors-1;
+      if (delta_phi >= 0.) {
+	int const iphi = int((phi - mins[0])/phiStep);
+	first = std::max(iphi-1, 0);
+	last = std::min(iphi+1, phiSectors-1);
+      }
+      for (int iphi = first; iphi<=last; ++iphi) {
 	if ( ( phi > mins[iphi] + delta_phi ) &&
 	     ( phi < maxes[iphi] - delta_phi ) ) {
 	  return true;
@@ -121,8 +128,23 @@ bool MuonHOAcceptance::inGeomAccept(double eta, double phi,
   return false;
 }
 
-bool MuonHOAcceptance::inNotDeadGeom(double eta, double phi, 
-				     double delta_eta, double delta_phi) {
+namespace {
+  struct inExpandedRegion {
+    inExpandedRegion(double e, double p, double de, double dp) :
+      eta(e), phi(p), delta_eta(de), delta_phi(dp) { }
+    template <class Region>
+    bool operator() (Region const& region) const {
+      return ( (phi < region.phiMax + delta_phi) && 
+	       (phi > region.phiMin - delta_phi) &&
+	       (eta < region.etaMax + delta_eta) &&
+	       (eta > region.etaMin - delta_eta) );
+    }
+    double eta, phi, delta_eta, delta_phi;
+  };
+}
+
+bool MuonHOAcceptanceMap::inNotDeadGeom(double eta, double phi, 
+				     double delta_eta, double delta_phi) const {
   if (!inited) return true;
   int ieta = int(eta/0.087) + ((eta>0) ? 1 : -1);
   double const * mins = ((std::abs(ieta) > 4) ? phiMinR12 : phiMinR0);
@@ -130,19 +152,13 @@ bool MuonHOAcceptance::inNotDeadGeom(double eta, double phi,
     phi += twopi;
   while (phi > mins[0]+twopi)
     phi -= twopi;
-  std::vector<deadRegion>::const_iterator region;
-  for (region = deadRegions.begin(); region != deadRegions.end(); ++region) {
-    if ( (phi < region->phiMax + delta_phi) && 
-	 (phi > region->phiMin - delta_phi) &&
-	 (eta < region->etaMax + delta_eta) &&
-	 (eta > region->etaMin - delta_eta) )
-      return false;
-  }
-  return true;
+  return !deadGrid.any(deadRegions, eta, phi, 
+		       std::abs(delta_eta), std::abs(delta_phi),
+		       inExpandedRegion(eta, phi, delta_eta, delta_phi));
 }
 
-bool MuonHOAcceptance::inSiPMGeom(double eta, double phi, 
-				  double delta_eta, double delta_phi) {
+bool MuonHOAcceptanceMap::inSiPMGeom(double eta, double phi, 
+				  double delta_eta, double delta_phi) const {
   if (!inited) return false;
   int ieta = int(eta/0.087) + ((eta>0) ? 1 : -1);
   double const * mins = ((std::abs(ieta) > 4) ? phiMinR12 : phiMinR0);
@@ -150,20 +166,49 @@ bool MuonHOAcceptance::inSiPMGeom(double eta, double phi,
     phi += twopi;
   while (phi > mins[0]+twopi)
     phi -= twopi;
-  std::vector<deadRegion>::const_iterator region;
-  for (region = SiPMRegions.begin(); region != SiPMRegions.end(); ++region) {
-    if ( (phi < region->phiMax - delta_phi) && 
-	 (phi > region->phiMin + delta_phi) &&
-	 (eta < region->etaMax - delta_eta) && 
-	 (eta > region->etaMin + delta_eta) ) {
-      return true;
-    }
+  // the SiPM test shrinks the regions by the margins
+  return SiPMGrid.any(SiPMRegions, eta, phi, 
+		      std::abs(delta_eta), std::abs(delta_phi),
+		      inExpandedRegion(eta, phi, -delta_eta, -delta_phi));
+}
+
+int MuonHOAcceptanceMap::RegionGrid::etaBin(double eta) {
+  // HO towers up to |ieta| 15 in steps of 0.087, the edge bins take the rest
+  int bin = int(std::floor(eta/0.087)) + etaBins/2;
+  return std::min(std::max(bin, 0), etaBins-1);
+}
+
+int MuonHOAcceptanceMap::RegionGrid::phiBin(double phi) {
+  // the queries and the region boundaries are within 2pi above the lowest
+  // sector boundary of the two rings
+  double const phiLow = std::min(phiMinR0[0], phiMinR12[0]);
+  int bin = int(std::floor((phi - phiLow)/(twopi/phiBins)));
+  return std::min(std::max(bin, 0), phiBins-1);
+}
+
+void MuonHOAcceptanceMap::RegionGrid::build(std::vector<deadRegion> const& regions) {
+  for (int ie = 0; ie < etaBins; ++ie)
+    for (int ip = 0; ip < phiBins; ++ip)
+      cells[ie][ip].clear();
+  // a region is entered in every cell its bounding box touches; the bins
+  // are monotonic, so any region within the query margins is found in one
+  // of the cells of the query box
+  for (unsigned int i = 0; i < regions.size(); ++i) {
+    deadRegion const& region = regions[i];
+    int const eHigh = etaBin(std::max(region.etaMin, region.etaMax));
+    int const pLow = phiBin(std::min(region.phiMin, region.phiMax));
+    int const pHigh = phiBin(std::max(region.phiMin, region.phiMax));
+    for (int ie = etaBin(std::min(region.etaMin, region.etaMax)); ie <= eHigh; ++ie)
+      for (int ip = pLow; ip <= pHigh; ++ip)
+	cells[ie][ip].push_back(i);
   }
-  return false;
 }
 
-void MuonHOAcceptance::initIds(edm::EventSetup const& eSetup) {
+void MuonHOAcceptanceMap::initIds(edm::EventSetup const& eSetup) {
   deadIds.clear();
+  SiPMIds.clear();
+  deadRegions.clear();
+  SiPMRegions.clear();
 
   edm::ESHandle<HcalChannelQuality> p;
   eSetup.get<HcalChannelQualityRcd>().get(p);
@@ -215,7 +260,7 @@ void MuonHOAcceptance::initIds(edm::EventSetup const& eSetup) {
   delete myqual;
 }
 
-void MuonHOAcceptance::buildDeadAreas() {
+void MuonHOAcceptanceMap::buildDeadAreas() {
   std::vector<uint32_t>::iterator did;
   std::list<deadIdRegion> didregions;
   for (did = deadIds.begin(); did != deadIds.end(); ++did) {
@@ -227,9 +272,10 @@ void MuonHOAcceptance::buildDeadAreas() {
 
   mergeRegionLists(didregions);
   convertRegions(didregions, deadRegions);
+  deadGrid.build(deadRegions);
 }
 
-void MuonHOAcceptance::buildSiPMAreas() {
+void MuonHOAcceptanceMap::buildSiPMAreas() {
   std::vector<uint32_t>::iterator sid;
   std::list<deadIdRegion> idregions;
 
@@ -241,9 +287,10 @@ void MuonHOAcceptance::buildSiPMAreas() {
 
   mergeRegionLists(idregions);
   convertRegions(idregions,SiPMRegions);
+  SiPMGrid.build(SiPMRegions);
 }
 
-void MuonHOAcceptance::mergeRegionLists (std::list<deadIdRegion>& didregions) {
+void MuonHOAcceptanceMap::mergeRegionLists (std::list<deadIdRegion>& didregions) {
   std::list<deadIdRegion>::iterator curr;
   std::list<deadIdRegion> list2;
   unsigned int startSize;
@@ -283,7 +330,7 @@ void MuonHOAcceptance::mergeRegionLists (std::list<deadIdRegion>& didregions) {
   } while (startSize > didregions.size());
 }
 
-void MuonHOAcceptance::convertRegions(std::list<deadIdRegion> const& idregions,
+void MuonHOAcceptanceMap::convertRegions(std::list<deadIdRegion> const& idregions,
 				      std::vector<deadRegion>& regions) {
   double e1, e2;
   double eMin,eMax,pMin,pMax;
@@ -341,7 +388,7 @@ void MuonHOAcceptance::convertRegions(std::list<deadIdRegion> const& idregions,
   }
 }
 
-TMultiGraph * MuonHOAcceptance::graphRegions(std::vector<deadRegion> const& regions) {
+TMultiGraph * MuonHOAcceptanceMap::graphRegions(std::vector<deadRegion> const& regions) {
   TMultiGraph * bounds = new TMultiGraph("bounds", "bounds");
   std::vector<deadRegion>::const_iterator region;
   TGraph * gr;
@@ -384,9 +431,30 @@ TMultiGraph * MuonHOAcceptance::graphRegions(std::vector<deadRegion> const& regi
   return bounds;
 }
 
-void MuonHOAcceptance::deadIdRegion::merge (deadIdRegion const& other) {
+void MuonHOAcceptanceMap::deadIdRegion::merge (deadIdRegion const& other) {
   etaMin = std::min(etaMin, other.etaMin);
   etaMax = std::max(etaMax, other.etaMax);
   phiMin = std::min(phiMin, other.phiMin);
   phiMax = std::max(phiMax, other.phiMax);
 }
+
+boost::shared_ptr<const MuonHOAcceptanceMap> MuonHOAcceptanceCache::get(edm::EventSetup const& eSetup) {
+  // both watchers have to be checked to keep their IOVs up to date
+  bool qualityChanged = qualityWatcher_.check(eSetup);
+  bool severityChanged = severityWatcher_.check(eSetup);
+  if (!acceptance_ || qualityChanged || severityChanged)
+    acceptance_.reset(new MuonHOAcceptanceMap(eSetup));
+  return acceptance_;
+}
+
+boost::shared_ptr<const MuonHOAcceptanceMap> MuonHOAcceptance::current_;
+
+void MuonHOAcceptance::initIds(edm::EventSetup const& eSetup) {
+  current_.reset(new MuonHOAcceptanceMap(eSetup));
+}
+
+MuonHOAcceptanceMap const& MuonHOAcceptance::current() {
+  // before initIds: no dead or SiPM channels, as the earlier releases did
+  static MuonHOAcceptanceMap const empty;
+  return current_ ? *current_ : empty;
+}
@@ -7,17 +7,43 @@
 #include "Geometry/Records/interface/GlobalTrackingGeometryRecord.h"
 #include "Geometry/CommonDetUnit/interface/GeomDet.h"
 
+void MuonIdTruthInfo::groupByTrack( const edm::PSimHitContainer& hits, SimHits::HitsByTrack& hitsByTrack )
+{
+   hitsByTrack.clear();
+   for( edm::PSimHitContainer::const_iterator hit = hits.begin(); hit != hits.end(); hit++)
+     hitsByTrack[hit->trackId()].push_back( &*hit );
+}
+
+void MuonIdTruthInfo::fillSimHits( const edm::Event& iEvent, SimHits& simHits )
+{
+   iEvent.getByLabel<edm::SimTrackContainer>("g4SimHits", "", simHits.simTracks);
+   if (! simHits.simTracks.isValid() ) return;
+   
+   iEvent.getByLabel("g4SimHits", "MuonDTHits", simHits.dtSimHits);
+   if ( simHits.dtSimHits.isValid() ) groupByTrack( *simHits.dtSimHits, simHits.dtHitsByTrack );
+   iEvent.getByLabel("g4SimHits", "MuonCSCHits", simHits.cscSimHits);
+   if ( simHits.cscSimHits.isValid() ) groupByTrack( *simHits.cscSimHits, simHits.cscHitsByTrack );
+}
+
 void MuonIdTruthInfo::truthMatchMuon(const edm::Event& iEvent, 
 				     const edm::EventSetup& iSetup,
 				     reco::Muon& aMuon)
+{
+   SimHits simHits;
+   fillSimHits( iEvent, simHits );
+   truthMatchMuon( simHits, iSetup, aMuon );
+}
+
+void MuonIdTruthInfo::truthMatchMuon(const SimHits& simHits, 
+				     const edm::EventSetup& iSetup,
+				     reco::Muon& aMuon)
 {
    // get a list of simulated track and find a track with the best match to
    // the muon.track(). Use its id and chamber id to localize hits
    // If a hit has non-zero local z coordinate, it's position wrt
    // to the center of a chamber is extrapolated by a straight line
    
-   edm::Handle<edm::SimTrackContainer> simTracks;
-   iEvent.getByLabel<edm::SimTrackContainer>("g4SimHits", "", simTracks);
+   const edm::Handle<edm::SimTrackContainer>& simTracks = simHits.simTracks;
    if (! simTracks.isValid() ) {
       LogTrace("MuonIdentification") <<"No tracks found";
       return;
@@ -44,6 +70,13 @@ void MuonIdTruthInfo::truthMatchMuon(const edm::Event& iEvent,
    
    bestMatch -= offset;
    
+   // hits of the best matched track, all of them are checked against each chamber
+   static const std::vector<const PSimHit*> noHits;
+   SimHits::HitsByTrack::const_iterator dtHits = simHits.dtHitsByTrack.find(bestMatch);
+   const std::vector<const PSimHit*>& bestDTHits = dtHits != simHits.dtHitsByTrack.end() ? dtHits->second : noHits;
+   SimHits::HitsByTrack::const_iterator cscHits = simHits.cscHitsByTrack.find(bestMatch);
+   const std::vector<const PSimHit*>& bestCSCHits = cscHits != simHits.cscHitsByTrack.end() ? cscHits->second : noHits;
+   
    std::vector<reco::MuonChamberMatch>& matches = aMuon.matches();
    int numberOfTruthMatchedChambers = 0;
 
@@ -61,22 +94,18 @@ void MuonIdTruthInfo::truthMatchMuon(const edm::Event& iEvent,
 	if ( chamberMatch->id.subdetId() == MuonSubdetId::DT) {
 	   DTChamberId detId(chamberMatch->id.rawId());
 
-	   edm::Handle<edm::PSimHitContainer> simHits;
-	   iEvent.getByLabel("g4SimHits", "MuonDTHits", simHits);
-	   if ( simHits.isValid() ) {
-	      for( edm::PSimHitContainer::const_iterator hit = simHits->begin(); hit != simHits->end(); hit++)
-		if ( hit->trackId() == bestMatch ) checkSimHitForBestMatch(bestSegmentMatch, distance, *hit, detId, geometry );
+	   if ( simHits.dtSimHits.isValid() ) {
+	      for( std::vector<const PSimHit*>::const_iterator hit = bestDTHits.begin(); hit != bestDTHits.end(); hit++)
+		checkSimHitForBestMatch(bestSegmentMatch, distance, **hit, detId, geometry );
 	   }else LogTrace("MuonIdentification") <<"No DT simulated hits are found";
 	}
 
 	if ( chamberMatch->id.subdetId() == MuonSubdetId::CSC) {
 	   CSCDetId detId(chamberMatch->id.rawId());
 
-	   edm::Handle<edm::PSimHitContainer> simHits;
-	   iEvent.getByLabel("g4SimHits", "MuonCSCHits", simHits);
-	   if ( simHits.isValid() ) {
-	      for( edm::PSimHitContainer::const_iterator hit = simHits->begin(); hit != simHits->end(); hit++)
-		if ( hit->trackId() == bestMatch ) checkSimHitForBestMatch(bestSegmentMatch, distance, *hit, detId, geometry );
+	   if ( simHits.cscSimHits.isValid() ) {
+	      for( std::vector<const PSimHit*>::const_iterator hit = bestCSCHits.begin(); hit != bestCSCHits.end(); hit++)
+		checkSimHitForBestMatch(bestSegmentMatch, distance, **hit, detId, geometry );
 	   }else LogTrace("MuonIdentification") <<"No CSC simulated hits are found";
 	}
 	if (distance < 9999) {
@@ -51,14 +51,38 @@ double MuonKinkFinder::getChi2(const TrajectoryStateOnSurface &start, const Traj
     AlgebraicSymMatrix55 cov;
     if (start.hasError()) cov += start.localError().matrix();
     if (other.hasError()) cov += other.localError().matrix();
-    cropAndInvert(cov);
     AlgebraicVector5 diff(start.localParameters().mixedFormatVector() - other.localParameters().mixedFormatVector());
+    if (usePosition_) {
+        return diagonalOnly_ ? kinkChi2<true,true>(diff, cov) : kinkChi2<true,false>(diff, cov);
+    } else {
+        return diagonalOnly_ ? kinkChi2<false,true>(diff, cov) : kinkChi2<false,false>(diff, cov);
+    }
+}
+
+template<bool usePosition, bool diagonalOnly>
+double MuonKinkFinder::kinkChi2(const AlgebraicVector5 &diff, AlgebraicSymMatrix55 &cov) {
+    if (diagonalOnly) {
+        // the cropped matrix is diagonal in the blocks that are inverted, so
+        // the inverse is made of reciprocals. The sums are done in the order
+        // of the similarity product of the full matrix.
+        double chi2 = 0;
+        if (usePosition) {
+            for (size_t i = 0; i < 5; ++i) chi2 += diff[i] * ((1./cov(i,i))*diff[i]);
+        } else {
+            // the blocks between the momentum and the position parameters
+            // are kept from the covariance, the position block is zero
+            for (size_t i = 0; i < 3; ++i) chi2 += diff[i] * ((1./cov(i,i))*diff[i] + cov(i,3)*diff[3] + cov(i,4)*diff[4]);
+            for (size_t i = 3; i < 5; ++i) chi2 += diff[i] * (cov(i,0)*diff[0] + cov(i,1)*diff[1] + cov(i,2)*diff[2]);
+        }
+        return chi2;
+    }
+    cropAndInvert(cov, usePosition, false);
     return ROOT::Math::Similarity(diff, cov);
 }
 
-void MuonKinkFinder::cropAndInvert(AlgebraicSymMatrix55 &cov) const {
-    if (usePosition_) {
-        if (diagonalOnly_) {
+void MuonKinkFinder::cropAndInvert(AlgebraicSymMatrix55 &cov, bool usePosition, bool diagonalOnly) {
+    if (usePosition) {
+        if (diagonalOnly) {
             for (size_t i = 0; i < 5; ++i) { for (size_t j = i+1; j < 5; ++j) {
                 cov(i,j) = 0;
             } }
@@ -67,7 +91,7 @@ void MuonKinkFinder::cropAndInvert(AlgebraicSymMatrix55 &cov) const {
     } else {
         // get 3x3 covariance
         AlgebraicSymMatrix33 momCov = cov.Sub<AlgebraicSymMatrix33>(0,0); // get 3x3 matrix
-        if (diagonalOnly_) { momCov(0,1) = 0; momCov(0,2) = 0; momCov(1,2) = 0; }
+        if (diagonalOnly) { momCov(0,1) = 0; momCov(0,2) = 0; momCov(1,2) = 0; }
         // invert        
         momCov.Invert();
         // place it
@@ -17,98 +17,94 @@ MuonMesh::MuonMesh(const edm::ParameterSet& parm) : doME1a(parm.getParameter<boo
 
 void MuonMesh::fillMesh(std::vector<reco::Muon>* inputMuons) {
 
-  for(std::vector<reco::Muon>::iterator muonIter1 = inputMuons->begin();
-      muonIter1 != inputMuons->end();
-      ++muonIter1) {
-    if(muonIter1->isTrackerMuon()){
-
-      mesh_[&*muonIter1]; // create this entry if it's a tracker muon
-      for(std::vector<reco::Muon>::iterator muonIter2 = inputMuons->begin();
-	  muonIter2 != inputMuons->end();
-	  ++muonIter2) {
-	if(muonIter2->isTrackerMuon()) {
-	  if(muonIter2 != muonIter1) {
-	    
-	    // now fill all the edges for muon1 based on overlaps with muon2
-	    for(std::vector<reco::MuonChamberMatch>::iterator chamberIter1 = muonIter1->matches().begin();
-		chamberIter1 != muonIter1->matches().end();
-		++chamberIter1) {	      
-	      for(std::vector<reco::MuonSegmentMatch>::iterator segmentIter1 = chamberIter1->segmentMatches.begin();
-		  segmentIter1 != chamberIter1->segmentMatches.end();
-		  ++segmentIter1) {
-		for(std::vector<reco::MuonChamberMatch>::iterator chamberIter2 = muonIter2->matches().begin();
-		    chamberIter2 != muonIter2->matches().end();
-		    ++chamberIter2) {		  
-		  for(std::vector<reco::MuonSegmentMatch>::iterator segmentIter2 = chamberIter2->segmentMatches.begin();
-		      segmentIter2 != chamberIter2->segmentMatches.end();
-		      ++segmentIter2) {
-		    		      
-
-		    //if(segmentIter1->mask & 0x1e0000 && segmentIter2->mask &0x1e0000) {
-
-		      bool addsegment(false);
-		      
-		      if( segmentIter1->cscSegmentRef.isNonnull() && segmentIter2->cscSegmentRef.isNonnull() ) {
-						
-			if( doME1a && 
-			    isDuplicateOf(segmentIter1->cscSegmentRef,segmentIter2->cscSegmentRef) &&
-			    CSCDetId(chamberIter1->id).ring() == 4 && CSCDetId(chamberIter2->id).ring() == 4 &&
-			    chamberIter1->id == chamberIter2->id ) {
-			  addsegment = true;
-			  //std::cout << "\tME1/a sharing detected." << std::endl;
-			}
-			
-			if( doOverlaps &&
-			    isDuplicateOf(std::make_pair(CSCDetId(chamberIter1->id),segmentIter1->cscSegmentRef),
-					 std::make_pair(CSCDetId(chamberIter2->id),segmentIter2->cscSegmentRef)) ) {
-			  addsegment = true;
-			  //std::cout << "\tChamber Overlap sharing detected." << std::endl;
-			}
-			
-			if( doClustering &&
-			    isClusteredWith(std::make_pair(CSCDetId(chamberIter1->id),segmentIter1->cscSegmentRef),
-					   std::make_pair(CSCDetId(chamberIter2->id),segmentIter2->cscSegmentRef)) ) {
-			  addsegment = true;
-			  //std::cout << "\tCluster sharing detected." << std::endl;
-			}
-			//std::cout << std::endl;
-		      } // has valid csc segment ref
-		      
-		      if(addsegment) { // add segment if clusters/overlaps/replicant and doesn't already exist
-			
-			if(find(mesh_[&*muonIter1].begin(),
-				mesh_[&*muonIter1].end(),
-				std::make_pair(&*muonIter2,
-					       std::make_pair(&*chamberIter2,
-							      &*segmentIter2)
-					       )
-				) == mesh_[&*muonIter1].end()) {
-			  mesh_[&*muonIter1].push_back(std::make_pair(&*muonIter2,
-								      std::make_pair(&*chamberIter2,
-										     &*segmentIter2)
-								      )
-						       );
-			} // find
-		      } // add segment?
-		      //} // both segments won arbitration
-		  } // segmentIter 2				  		  
-		} // chamberIter2
-	      } //segmentIter1
-	    } // chamberIter1	
-	    
-	  } // if different muon	
-	} // is tracker muon  
-      } // muonIter2
-      
-    } // is tracker muon
-  } // muonIter1
+  // the nodes are the tracker muons, for each of them collect the segment
+  // matches that can take part in the cleaning (valid CSC segment ref)
+  unsigned int nNodes(0);
+  for(std::vector<reco::Muon>::iterator muonIter = inputMuons->begin();
+      muonIter != inputMuons->end();
+      ++muonIter) {
+    if(!muonIter->isTrackerMuon()) continue;
+    nodes_.push_back(&*muonIter);
+    if(cscSegments_.size() < nodes_.size()) cscSegments_.resize(nodes_.size());
+    std::vector<CSCSegmentEntry>& segments = cscSegments_[nNodes++];
+    segments.clear();
+    for(std::vector<reco::MuonChamberMatch>::iterator chamberIter = muonIter->matches().begin();
+	chamberIter != muonIter->matches().end();
+	++chamberIter) {
+      for(std::vector<reco::MuonSegmentMatch>::iterator segmentIter = chamberIter->segmentMatches.begin();
+	  segmentIter != chamberIter->segmentMatches.end();
+	  ++segmentIter) {
+	if(segmentIter->cscSegmentRef.isNull()) continue;
+	CSCSegmentEntry entry = { CSCDetId(chamberIter->id), &*chamberIter, &*segmentIter };
+	segments.push_back(entry);
+      }
+    }
+  }
+
+  for(unsigned int node1 = 0; node1 < nodes_.size(); ++node1) {
+
+    edgeBegin_.push_back(edges_.size());
+    const std::vector<CSCSegmentEntry>& segments1 = cscSegments_[node1];
+    if(segments1.empty()) continue;
+
+    for(unsigned int node2 = 0; node2 < nodes_.size(); ++node2) {
+      if(node2 == node1) continue;
+      const std::vector<CSCSegmentEntry>& segments2 = cscSegments_[node2];
+      // an edge to the same segment of muon2 is added only once
+      edgeAdded_.assign(segments2.size(),0);
+
+      // now fill all the edges for muon1 based on overlaps with muon2
+      for(std::vector<CSCSegmentEntry>::const_iterator segment1 = segments1.begin();
+	  segment1 != segments1.end();
+	  ++segment1) {
+	for(unsigned int index2 = 0; index2 < segments2.size(); ++index2) {
+	  const CSCSegmentEntry& segment2 = segments2[index2];
+
+	  // all three cleanings need both segments in the same endcap
+	  if(segment1->id.endcap() != segment2.id.endcap()) continue;
+	  if(edgeAdded_[index2]) continue;
+
+	  bool addsegment(false);
+
+	  if( doME1a && 
+	      isDuplicateOf(segment1->segment->cscSegmentRef,segment2.segment->cscSegmentRef) &&
+	      segment1->id.ring() == 4 && segment2.id.ring() == 4 &&
+	      segment1->chamber->id == segment2.chamber->id ) {
+	    addsegment = true;
+	    //std::cout << "\tME1/a sharing detected." << std::endl;
+	  }
+
+	  if( !addsegment && doOverlaps &&
+	      isDuplicateOf(std::make_pair(segment1->id,segment1->segment->cscSegmentRef),
+			    std::make_pair(segment2.id,segment2.segment->cscSegmentRef)) ) {
+	    addsegment = true;
+	    //std::cout << "\tChamber Overlap sharing detected." << std::endl;
+	  }
+
+	  if( !addsegment && doClustering &&
+	      isClusteredWith(std::make_pair(segment1->id,segment1->segment->cscSegmentRef),
+			      std::make_pair(segment2.id,segment2.segment->cscSegmentRef)) ) {
+	    addsegment = true;
+	    //std::cout << "\tCluster sharing detected." << std::endl;
+	  }
+
+	  if(addsegment) { // add segment if clusters/overlaps/replicant and doesn't already exist
+	    MeshEdge edge = { node2, segment2.chamber, segment2.segment };
+	    edges_.push_back(edge);
+	    edgeAdded_[index2] = 1;
+	  } // add segment?
+	} // segment2
+      } // segment1
+    } // node2
+  } // node1
+  edgeBegin_.push_back(edges_.size());
 
   // special cases
 
   // one muon: mark all segments belonging to a muon as cleaned as there are no other muons to fight with
-  if(mesh_.size() == 1) {
-    for(std::vector<reco::MuonChamberMatch>::iterator chamberIter1 = mesh_.begin()->first->matches().begin();
-	chamberIter1 != mesh_.begin()->first->matches().end();
+  if(nodes_.size() == 1) {
+    for(std::vector<reco::MuonChamberMatch>::iterator chamberIter1 = nodes_.front()->matches().begin();
+	chamberIter1 != nodes_.front()->matches().end();
 	++chamberIter1) {	      
       for(std::vector<reco::MuonSegmentMatch>::iterator segmentIter1 = chamberIter1->segmentMatches.begin();
 	  segmentIter1 != chamberIter1->segmentMatches.end();
@@ -120,10 +116,10 @@ void MuonMesh::fillMesh(std::vector<reco::Muon>* inputMuons) {
 
   // segments that are not shared amongst muons and the have won all segment arbitration flags need to be promoted
   // also promote DT segments
-  if(mesh_.size() > 1) {
-    for( MeshType::iterator i = mesh_.begin(); i != mesh_.end(); ++i ) {
-      for( std::vector<reco::MuonChamberMatch>::iterator chamberIter1 = i->first->matches().begin();
-	   chamberIter1 != i->first->matches().end();
+  if(nodes_.size() > 1) {
+    for( unsigned int i = 0; i < nodes_.size(); ++i ) {
+      for( std::vector<reco::MuonChamberMatch>::iterator chamberIter1 = nodes_[i]->matches().begin();
+	   chamberIter1 != nodes_[i]->matches().end();
 	   ++chamberIter1 ) {	
 	for(std::vector<reco::MuonSegmentMatch>::iterator segmentIter1 = chamberIter1->segmentMatches.begin();
 	    segmentIter1 != chamberIter1->segmentMatches.end();
@@ -131,30 +127,29 @@ void MuonMesh::fillMesh(std::vector<reco::Muon>* inputMuons) {
 
 	  bool shared(false);
 	  
-	  for( AssociationType::iterator j = i->second.begin();
-	       j != i->second.end();
-	       ++j ) {
+	  for( unsigned int j = edgeBegin_[i]; j != edgeBegin_[i+1] && !shared; ++j ) {
+	    const MeshEdge& edge = edges_[j];
 
 	    if( segmentIter1->cscSegmentRef.isNonnull() && 
-		j->second.second->cscSegmentRef.isNonnull() ) {	       	      
+		edge.segment->cscSegmentRef.isNonnull() ) {	       	      
 	      if(chamberIter1->id.subdetId() == MuonSubdetId::CSC &&
-		 j->second.first->id.subdetId() == MuonSubdetId::CSC ) {
-		CSCDetId segIterId(chamberIter1->id), shareId(j->second.first->id);
+		 edge.chamber->id.subdetId() == MuonSubdetId::CSC ) {
+		CSCDetId segIterId(chamberIter1->id), shareId(edge.chamber->id);
 
 		if( doOverlaps &&
 		    isDuplicateOf(std::make_pair(segIterId,segmentIter1->cscSegmentRef),
-				  std::make_pair(shareId,j->second.second->cscSegmentRef)) )
+				  std::make_pair(shareId,edge.segment->cscSegmentRef)) )
 		  shared = true;
 		
-		if( doME1a && 
-		    isDuplicateOf(segmentIter1->cscSegmentRef,j->second.second->cscSegmentRef) &&
+		if( !shared && doME1a && 
+		    isDuplicateOf(segmentIter1->cscSegmentRef,edge.segment->cscSegmentRef) &&
 		    segIterId.ring() == 4 && shareId.ring() == 4 &&
 		    segIterId == segIterId)
 		  shared = true;
 
-		if( doClustering && 
-		    isClusteredWith(std::make_pair(CSCDetId(chamberIter1->id),segmentIter1->cscSegmentRef),
-				    std::make_pair(CSCDetId(j->second.first->id),j->second.second->cscSegmentRef)) )
+		if( !shared && doClustering && 
+		    isClusteredWith(std::make_pair(segIterId,segmentIter1->cscSegmentRef),
+				    std::make_pair(shareId,edge.segment->cscSegmentRef)) )
 		  shared = true;
 	      } // in CSCs?
 	    } // cscSegmentRef non null?
@@ -174,39 +169,43 @@ void MuonMesh::fillMesh(std::vector<reco::Muon>* inputMuons) {
 
 void MuonMesh::pruneMesh() {
   
-  for( MeshType::iterator i = mesh_.begin(); i != mesh_.end(); ++i ) {
+  for( unsigned int i = 0; i < nodes_.size(); ++i ) {
+
+    reco::Muon* muon1 = nodes_[i];
 
-        for( AssociationType::iterator j = i->second.begin();
-	 j != i->second.end();
-	 ++j ) {
+    for( unsigned int j = edgeBegin_[i]; j != edgeBegin_[i+1]; ++j ) {
 
-      for( std::vector<reco::MuonChamberMatch>::iterator chamberIter1 = i->first->matches().begin();
-	   chamberIter1 != i->first->matches().end();
+      reco::Muon* muon2 = nodes_[edges_[j].muon];
+      reco::MuonChamberMatch* chamber2 = edges_[j].chamber;
+      reco::MuonSegmentMatch* segment2 = edges_[j].segment;
+
+      for( std::vector<reco::MuonChamberMatch>::iterator chamberIter1 = muon1->matches().begin();
+	   chamberIter1 != muon1->matches().end();
 	   ++chamberIter1 ) {	
 	for(std::vector<reco::MuonSegmentMatch>::iterator segmentIter1 = chamberIter1->segmentMatches.begin();
 	    segmentIter1 != chamberIter1->segmentMatches.end();
 	    ++segmentIter1) {
 
-	  if(j->second.second->cscSegmentRef.isNonnull() && segmentIter1->cscSegmentRef.isNonnull()) {
+	  if(segment2->cscSegmentRef.isNonnull() && segmentIter1->cscSegmentRef.isNonnull()) {
 	    
 	    //UNUSED:	    bool me1a(false), overlap(false), cluster(false);
 
 	    // remove physical overlap duplicates first
 	    if( doOverlaps &&
 		isDuplicateOf(std::make_pair(CSCDetId(chamberIter1->id),segmentIter1->cscSegmentRef),
-			      std::make_pair(CSCDetId(j->second.first->id),j->second.second->cscSegmentRef)) ) {
+			      std::make_pair(CSCDetId(chamber2->id),segment2->cscSegmentRef)) ) {
 
-	      if ( i->first->numberOfMatches((reco::Muon::ArbitrationType)0x1e0000) >
-		   j->first->numberOfMatches((reco::Muon::ArbitrationType)0x1e0000) ) {
+	      if ( muon1->numberOfMatches((reco::Muon::ArbitrationType)0x1e0000) >
+		   muon2->numberOfMatches((reco::Muon::ArbitrationType)0x1e0000) ) {
 		
 		segmentIter1->setMask(reco::MuonSegmentMatch::BelongsToTrackByOvlClean);
 		segmentIter1->setMask(reco::MuonSegmentMatch::BelongsToTrackByCleaning);
 		
 		//UNUSED:		overlap = true;
-	      } else if ( i->first->numberOfMatches((reco::Muon::ArbitrationType)0x1e0000) ==
-			  j->first->numberOfMatches((reco::Muon::ArbitrationType)0x1e0000) ) { // muon with more matched stations wins
+	      } else if ( muon1->numberOfMatches((reco::Muon::ArbitrationType)0x1e0000) ==
+			  muon2->numberOfMatches((reco::Muon::ArbitrationType)0x1e0000) ) { // muon with more matched stations wins
 		
-		if((segmentIter1->mask & 0x1e0000) > (j->second.second->mask & 0x1e0000)) { // segment with better match wins 
+		if((segmentIter1->mask & 0x1e0000) > (segment2->mask & 0x1e0000)) { // segment with better match wins 
 		  
 		  segmentIter1->setMask(reco::MuonSegmentMatch::BelongsToTrackByOvlClean);
 		  segmentIter1->setMask(reco::MuonSegmentMatch::BelongsToTrackByCleaning);
@@ -222,51 +221,48 @@ void MuonMesh::pruneMesh() {
 	    // Unlike the other cleanings this one removes the bits from segments associated to tracks which
 	    // fail cleaning. (Instead of setting bits for the segments which win.)
 	    if( doME1a && 
-		isDuplicateOf(segmentIter1->cscSegmentRef,j->second.second->cscSegmentRef) &&
-		CSCDetId(chamberIter1->id).ring() == 4 && CSCDetId(j->second.first->id).ring() == 4 &&
-		chamberIter1->id ==  j->second.first->id ) {	      
+		isDuplicateOf(segmentIter1->cscSegmentRef,segment2->cscSegmentRef) &&
+		CSCDetId(chamberIter1->id).ring() == 4 && CSCDetId(chamber2->id).ring() == 4 &&
+		chamberIter1->id ==  chamber2->id ) {	      
 
-	      if( j->first->numberOfMatches((reco::Muon::ArbitrationType)0x1e0000) < 
-		  i->first->numberOfMatches((reco::Muon::ArbitrationType)0x1e0000) ) {
+	      if( muon2->numberOfMatches((reco::Muon::ArbitrationType)0x1e0000) < 
+		  muon1->numberOfMatches((reco::Muon::ArbitrationType)0x1e0000) ) {
 				
-		for(AssociationType::iterator AsscIter1 = i->second.begin();
-		    AsscIter1 != i->second.end();
-		    ++AsscIter1) {
-		  if(AsscIter1->second.second->cscSegmentRef.isNonnull())
-		    if(j->first == AsscIter1->first &&
-		       j->second.first == AsscIter1->second.first &&
-		       isDuplicateOf(segmentIter1->cscSegmentRef,AsscIter1->second.second->cscSegmentRef)) {
-		      AsscIter1->second.second->mask &= ~reco::MuonSegmentMatch::BelongsToTrackByME1aClean;
+		for( unsigned int k = edgeBegin_[i]; k != edgeBegin_[i+1]; ++k ) {
+		  const MeshEdge& assc = edges_[k];
+		  if(assc.segment->cscSegmentRef.isNonnull())
+		    if(edges_[j].muon == assc.muon &&
+		       chamber2 == assc.chamber &&
+		       isDuplicateOf(segmentIter1->cscSegmentRef,assc.segment->cscSegmentRef)) {
+		      assc.segment->mask &= ~reco::MuonSegmentMatch::BelongsToTrackByME1aClean;
 		    }		
 		}  
 
 		//UNUSED:		me1a = true;
-	      } else if ( j->first->numberOfMatches((reco::Muon::ArbitrationType)0x1e0000) == 
-			  i->first->numberOfMatches((reco::Muon::ArbitrationType)0x1e0000) ) { // muon with best arbitration wins
+	      } else if ( muon2->numberOfMatches((reco::Muon::ArbitrationType)0x1e0000) == 
+			  muon1->numberOfMatches((reco::Muon::ArbitrationType)0x1e0000) ) { // muon with best arbitration wins
 						
 		bool bestArb(true);
 		
-		for(AssociationType::iterator AsscIter1 = i->second.begin();
-		    AsscIter1 != i->second.end();
-		    ++AsscIter1) {
-		  if(AsscIter1->second.second->cscSegmentRef.isNonnull())
-		    if(j->first == AsscIter1->first &&
-		       j->second.first == AsscIter1->second.first &&
-		       isDuplicateOf(segmentIter1->cscSegmentRef,AsscIter1->second.second->cscSegmentRef) && 
-		       (segmentIter1->mask & 0x1e0000) < (AsscIter1->second.second->mask & 0x1e0000))
+		for( unsigned int k = edgeBegin_[i]; k != edgeBegin_[i+1]; ++k ) {
+		  const MeshEdge& assc = edges_[k];
+		  if(assc.segment->cscSegmentRef.isNonnull())
+		    if(edges_[j].muon == assc.muon &&
+		       chamber2 == assc.chamber &&
+		       isDuplicateOf(segmentIter1->cscSegmentRef,assc.segment->cscSegmentRef) && 
+		       (segmentIter1->mask & 0x1e0000) < (assc.segment->mask & 0x1e0000))
 		      bestArb = false;
 		}
 		
 		if(bestArb) {
 		  
-		  for(AssociationType::iterator AsscIter1 = i->second.begin();
-		      AsscIter1 != i->second.end();
-		      ++AsscIter1) {
-		    if(AsscIter1->second.second->cscSegmentRef.isNonnull())
-		      if(j->first == AsscIter1->first &&
-			 j->second.first == AsscIter1->second.first &&
-			 isDuplicateOf(segmentIter1->cscSegmentRef,AsscIter1->second.second->cscSegmentRef)) {
-			AsscIter1->second.second->mask &= ~reco::MuonSegmentMatch::BelongsToTrackByME1aClean;
+		  for( unsigned int k = edgeBegin_[i]; k != edgeBegin_[i+1]; ++k ) {
+		    const MeshEdge& assc = edges_[k];
+		    if(assc.segment->cscSegmentRef.isNonnull())
+		      if(edges_[j].muon == assc.muon &&
+			 chamber2 == assc.chamber &&
+			 isDuplicateOf(segmentIter1->cscSegmentRef,assc.segment->cscSegmentRef)) {
+			assc.segment->mask &= ~reco::MuonSegmentMatch::BelongsToTrackByME1aClean;
 		      }
 		  }
 		  
@@ -278,34 +274,34 @@ void MuonMesh::pruneMesh() {
 	    
 	    if(doClustering && 
 	       isClusteredWith(std::make_pair(CSCDetId(chamberIter1->id),segmentIter1->cscSegmentRef),
-			       std::make_pair(CSCDetId(j->second.first->id),j->second.second->cscSegmentRef))) {
+			       std::make_pair(CSCDetId(chamber2->id),segment2->cscSegmentRef))) {
 
-	      if (i->first->numberOfMatches((reco::Muon::ArbitrationType)0x1e0000) >
-		  j->first->numberOfMatches((reco::Muon::ArbitrationType)0x1e0000) ) {
+	      if (muon1->numberOfMatches((reco::Muon::ArbitrationType)0x1e0000) >
+		  muon2->numberOfMatches((reco::Muon::ArbitrationType)0x1e0000) ) {
 
 		 segmentIter1->setMask(reco::MuonSegmentMatch::BelongsToTrackByClusClean);
 		 segmentIter1->setMask(reco::MuonSegmentMatch::BelongsToTrackByCleaning);
 
 		 //UNUSED:		 cluster = true;
-	      } else if (i->first->numberOfMatches((reco::Muon::ArbitrationType)0x1e0000) <
-			 j->first->numberOfMatches((reco::Muon::ArbitrationType)0x1e0000)) {
+	      } else if (muon1->numberOfMatches((reco::Muon::ArbitrationType)0x1e0000) <
+			 muon2->numberOfMatches((reco::Muon::ArbitrationType)0x1e0000)) {
 
-		j->second.second->setMask(reco::MuonSegmentMatch::BelongsToTrackByClusClean);
-		j->second.second->setMask(reco::MuonSegmentMatch::BelongsToTrackByCleaning);
+		segment2->setMask(reco::MuonSegmentMatch::BelongsToTrackByClusClean);
+		segment2->setMask(reco::MuonSegmentMatch::BelongsToTrackByCleaning);
 		
 		//UNUSED:		cluster = true;
 	      } else { // muon with more matched stations wins
 		 
-		 if((segmentIter1->mask & 0x1e0000) > (j->second.second->mask & 0x1e0000)) { // segment with better match wins 
+		 if((segmentIter1->mask & 0x1e0000) > (segment2->mask & 0x1e0000)) { // segment with better match wins 
 		   
 		   segmentIter1->setMask(reco::MuonSegmentMatch::BelongsToTrackByClusClean);
 		   segmentIter1->setMask(reco::MuonSegmentMatch::BelongsToTrackByCleaning);
 		   
 		   //UNUSED:		   cluster = true;				   
-		 } else if ((segmentIter1->mask & 0x1e0000) < (j->second.second->mask & 0x1e0000)){ //
+		 } else if ((segmentIter1->mask & 0x1e0000) < (segment2->mask & 0x1e0000)){ //
 		   
-		   j->second.second->setMask(reco::MuonSegmentMatch::BelongsToTrackByClusClean);
-		   j->second.second->setMask(reco::MuonSegmentMatch::BelongsToTrackByCleaning);
+		   segment2->setMask(reco::MuonSegmentMatch::BelongsToTrackByClusClean);
+		   segment2->setMask(reco::MuonSegmentMatch::BelongsToTrackByCleaning);
 		   
 		   //UNUSED:		   cluster = true;				   
 		 } else {
@@ -318,13 +314,13 @@ void MuonMesh::pruneMesh() {
 	} // segmentIter1
       } // chamberIter1       
     } // j, associated segments iterator
-  } // i, map iterator
+  } // i, node iterator
 
   // final step: make sure everything that's won a cleaning flag has the "BelongsToTrackByCleaning" flag
 
-   for( MeshType::iterator i = mesh_.begin(); i != mesh_.end(); ++i ) {
-     for( std::vector<reco::MuonChamberMatch>::iterator chamberIter1 = i->first->matches().begin();
-	  chamberIter1 != i->first->matches().end();
+   for( unsigned int i = 0; i < nodes_.size(); ++i ) {
+     for( std::vector<reco::MuonChamberMatch>::iterator chamberIter1 = nodes_[i]->matches().begin();
+	  chamberIter1 != nodes_[i]->matches().end();
 	  ++chamberIter1 ) {	
        for(std::vector<reco::MuonSegmentMatch>::iterator segmentIter1 = chamberIter1->segmentMatches.begin();
 	   segmentIter1 != chamberIter1->segmentMatches.end();
@@ -339,51 +335,71 @@ void MuonMesh::pruneMesh() {
   
 }
 
-bool MuonMesh::isDuplicateOf(const CSCSegmentRef& lhs, const CSCSegmentRef& rhs) const // this isDuplicateOf() deals with duplicate segments in ME1/a
+bool MuonMesh::sameLocalParameters(const SegmentLocalParameters& lhs, const SegmentLocalParameters& rhs)
 {
-  bool result(false);
- 
-  if(!lhs->isME11a_duplicate())
-    return result;
-
-  std::vector<CSCSegment> lhs_duplicates = lhs->duplicateSegments();
-      
-  if(fabs(lhs->localPosition().x()        - rhs->localPosition().x()      ) < 1E-3 &&
-     fabs(lhs->localPosition().y()        - rhs->localPosition().y()      ) < 1E-3 &&
-     fabs(lhs->localDirection().x()/lhs->localDirection().z()    - rhs->localDirection().x()/rhs->localDirection().z()   ) < 1E-3 &&
-     fabs(lhs->localDirection().y()/lhs->localDirection().z()    - rhs->localDirection().y()/rhs->localDirection().z()   ) < 1E-3 &&
-     fabs(lhs->localPositionError().xx()  - rhs->localPositionError().xx()   ) < 1E-3 &&
-     fabs(lhs->localPositionError().yy()  - rhs->localPositionError().yy()   ) < 1E-3 &&
-     fabs(lhs->localDirectionError().xx() - rhs->localDirectionError().xx()) < 1E-3 &&
-     fabs(lhs->localDirectionError().yy() - rhs->localDirectionError().yy()) < 1E-3)
-    result = true;
-
-  for( std::vector<CSCSegment>::const_iterator segIter1 = lhs_duplicates.begin();
-       segIter1 != lhs_duplicates.end();
-       ++segIter1 ) { // loop over lhs duplicates
-
-    if(fabs(segIter1->localPosition().x()        - rhs->localPosition().x()      ) < 1E-3 &&
-       fabs(segIter1->localPosition().y()        - rhs->localPosition().y()      ) < 1E-3 &&
-       fabs(segIter1->localDirection().x()/segIter1->localDirection().z()    - rhs->localDirection().x()/rhs->localDirection().z()   ) < 1E-3 &&
-       fabs(segIter1->localDirection().y()/segIter1->localDirection().z()    - rhs->localDirection().y()/rhs->localDirection().z()   ) < 1E-3 &&
-       fabs(segIter1->localPositionError().xx()  - rhs->localPositionError().xx()   ) < 1E-3 &&
-       fabs(segIter1->localPositionError().yy()  - rhs->localPositionError().yy()   ) < 1E-3 &&
-       fabs(segIter1->localDirectionError().xx() - rhs->localDirectionError().xx()) < 1E-3 &&
-       fabs(segIter1->localDirectionError().yy() - rhs->localDirectionError().yy()) < 1E-3)
-      result = true;
-    /*
-    if(fabs(segIter1->localPosition().x()        - rhs->localPosition().x()      ) < 2*sqrt(segIter1->localPositionError().xx()) &&
-       fabs(segIter1->localPosition().y()        - rhs->localPosition().y()      ) < 2*sqrt(segIter1->localPositionError().yy()) &&
-       fabs(segIter1->localDirection().x()/segIter1->localDirection().z()    - rhs->localDirection().x()/rhs->localDirection().z()   ) 
-       < 2*std::sqrt(std::max(segIter1->localDirectionError().yy(),rhs->localDirectionError().xx())) &&
-       fabs(segIter1->localDirection().y()/segIter1->localDirection().z()    - rhs->localDirection().y()/rhs->localDirection().z()   ) 
-       < 2*std::sqrt(std::max(segIter1->localDirectionError().yy(),rhs->localDirectionError().yy())))
-      result = true;
-    */
+  return fabs(lhs.x        - rhs.x       ) < 1E-3 &&
+         fabs(lhs.y        - rhs.y       ) < 1E-3 &&
+         fabs(lhs.dXdZ     - rhs.dXdZ    ) < 1E-3 &&
+         fabs(lhs.dYdZ     - rhs.dYdZ    ) < 1E-3 &&
+         fabs(lhs.xErr2    - rhs.xErr2   ) < 1E-3 &&
+         fabs(lhs.yErr2    - rhs.yErr2   ) < 1E-3 &&
+         fabs(lhs.dXdZErr2 - rhs.dXdZErr2) < 1E-3 &&
+         fabs(lhs.dYdZErr2 - rhs.dYdZErr2) < 1E-3;
+}
 
-  } // loop over duplicates
+const MuonMesh::SegmentGlobalPosition& MuonMesh::globalPosition(const std::pair<CSCDetId,CSCSegmentRef>& segment) const
+{
+  GlobalPositionCache::iterator cached = globalPositions_.find(segment);
+  if(cached != globalPositions_.end()) return cached->second;
 
-  return result;
+  GlobalPoint position = geometry_->chamber(segment.first)->toGlobal(segment.second->localPosition());
+  SegmentGlobalPosition result = { position.phi(), position.theta(), position.z() };
+  return globalPositions_.insert(std::make_pair(segment,result)).first->second;
+}
+
+const MuonMesh::ME1aGroup& MuonMesh::me1aGroup(const CSCSegmentRef& segment) const
+{
+  ME1aGroupCache::iterator cached = me1aGroups_.find(segment);
+  if(cached != me1aGroups_.end()) return cached->second;
+
+  ME1aGroup& group = me1aGroups_[segment];
+  group.isME11aDuplicate = segment->isME11a_duplicate();
+
+  std::vector<CSCSegment> segments(1,*segment);
+  if(group.isME11aDuplicate) {
+    std::vector<CSCSegment> duplicates = segment->duplicateSegments();
+    segments.insert(segments.end(),duplicates.begin(),duplicates.end());
+  }
+  for(std::vector<CSCSegment>::const_iterator segIter = segments.begin(); segIter != segments.end(); ++segIter) {
+    SegmentLocalParameters parameters = { segIter->localPosition().x(),
+					  segIter->localPosition().y(),
+					  segIter->localDirection().x()/segIter->localDirection().z(),
+					  segIter->localDirection().y()/segIter->localDirection().z(),
+					  segIter->localPositionError().xx(),
+					  segIter->localPositionError().yy(),
+					  segIter->localDirectionError().xx(),
+					  segIter->localDirectionError().yy() };
+    group.segments.push_back(parameters);
+  }
+  return group;
+}
+
+bool MuonMesh::isDuplicateOf(const CSCSegmentRef& lhs, const CSCSegmentRef& rhs) const // this isDuplicateOf() deals with duplicate segments in ME1/a
+{
+  const ME1aGroup& lhsGroup = me1aGroup(lhs);
+ 
+  if(!lhsGroup.isME11aDuplicate)
+    return false;
+
+  // the first entry is the segment itself, the rest are its duplicates
+  const SegmentLocalParameters& rhsParameters = me1aGroup(rhs).segments.front();
+  for( std::vector<SegmentLocalParameters>::const_iterator segIter1 = lhsGroup.segments.begin();
+       segIter1 != lhsGroup.segments.end();
+       ++segIter1 ) 
+    if(sameLocalParameters(*segIter1,rhsParameters))
+      return true;
+
+  return false;
 }
 
 bool MuonMesh::isDuplicateOf(const std::pair<CSCDetId,CSCSegmentRef>& rhs, 
@@ -397,12 +413,7 @@ bool MuonMesh::isDuplicateOf(const std::pair<CSCDetId,CSCSegmentRef>& rhs,
   if(rhs.first.endcap() == lhs.first.endcap() &&
      rhs.first.station() == lhs.first.station() &&
      rhs.first.ring() == lhs.first.ring()) { // if same endcap,station,ring (minimal requirement for ovl candidate)
-    /*
-    std::cout << "Chamber 1: " << rhs.first << std::endl 
-	      << "Chamber 2: " << lhs.first << std::endl;
 
-    std::cout << "Same endcap,ring,station." << std::endl;    
-    */
     //create neighboring chamber labels, treat ring as (Z mod 36 or 18) + 1 number line: left, right defined accordingly.
     unsigned modulus = ((rhs.first.ring() != 1 || rhs.first.station() == 1) ? 36 : 18);
     int left_neighbor = (((rhs.first.chamber() - 1 + modulus)%modulus == 0 ) ? modulus : (rhs.first.chamber() - 1 + modulus)%modulus ); // + modulus to ensure positivity
@@ -410,69 +421,17 @@ bool MuonMesh::isDuplicateOf(const std::pair<CSCDetId,CSCSegmentRef>& rhs,
 
     if(lhs.first.chamber() == left_neighbor || 
        lhs.first.chamber() == right_neighbor) { // if this is a neighboring chamber then it can be an overlap
-      
-      std::vector<CSCSegment> thesegments;
-      thesegments.push_back(*(lhs.second));
-      /*
-      if(lhs.second->isME11a_duplicate())
-	thesegments.insert(thesegments.begin(),
-			   lhs.second->duplicateSegments().begin(),
-			   lhs.second->duplicateSegments().end());
-      */
-
-      //std::cout << "lhs is in neighoring chamber of rhs." << std::endl;
-
-      // rhs local direction info
-      /*
-      double rhs_dydz = geometry_->chamber(rhs.first)->toGlobal(rhs.second->localDirection()).y()/
-	                geometry_->chamber(rhs.first)->toGlobal(rhs.second->localDirection()).z();
-      double rhs_dxdz = geometry_->chamber(rhs.first)->toGlobal(rhs.second->localDirection()).x()/
-	                geometry_->chamber(rhs.first)->toGlobal(rhs.second->localDirection()).z();
-      double rhs_dydz_err = rhs.second->localDirectionError().yy();
-      double rhs_dxdz_err = rhs.second->localDirectionError().xx();
-      */
-      
-      //rhs global position info
-      double rhs_phi = geometry_->chamber(rhs.first)->toGlobal(rhs.second->localPosition()).phi();
-      double rhs_theta = geometry_->chamber(rhs.first)->toGlobal(rhs.second->localPosition()).theta();
-      double rhs_z = geometry_->chamber(rhs.first)->toGlobal(rhs.second->localPosition()).z();
-
-      for(std::vector<CSCSegment>::const_iterator ilhs = thesegments.begin(); ilhs != thesegments.end(); ++ilhs) {
-	
-	// lhs local direction info
-	/*
-	double lhs_dydz = geometry_->chamber(lhs.first)->toGlobal(ilhs->localDirection()).y()/
-	                  geometry_->chamber(lhs.first)->toGlobal(ilhs->localDirection()).z();
-	double lhs_dxdz = geometry_->chamber(lhs.first)->toGlobal(ilhs->localDirection()).x()/
-	                  geometry_->chamber(lhs.first)->toGlobal(ilhs->localDirection()).z();
-	double lhs_dydz_err = ilhs->localDirectionError().yy();
-	double lhs_dxdz_err = ilhs->localDirectionError().xx();
-	*/
-	
-	//lhs global position info
-	double lhs_phi = geometry_->chamber(lhs.first)->toGlobal(ilhs->localPosition()).phi();
-	double lhs_theta = geometry_->chamber(lhs.first)->toGlobal(ilhs->localPosition()).theta();
-	double lhs_z = geometry_->chamber(lhs.first)->toGlobal(ilhs->localPosition()).z();
-	/*
-	  std::cout << "RHS Segment Parameters:" << std::endl
-	  << "\t RHS Phi   : " << rhs_phi << std::endl
-	  << "\t RHS Theta : " << rhs_theta << std::endl
-	  << "\t RHS dx/dz : " << rhs_dxdz << " +- " << rhs_dxdz_err << std::endl
-	  << "\t RHS dy/dz : " << rhs_dydz << " +- " << rhs_dydz_err << std::endl; 
-	  
-	  std::cout << "LHS Segment Parameters:" << std::endl
-	  << "\t LHS Phi   : " << lhs_phi << std::endl
-	  << "\t LHS Theta : " << lhs_theta << std::endl
-	  << "\t LHS dx/dz : " << lhs_dxdz << " +- " << lhs_dxdz_err << std::endl
-	  << "\t LHS dy/dz : " << lhs_dydz << " +- " << lhs_dydz_err << std::endl; 
-	*/
+
+      // ME1/a duplicates of lhs are not considered here
+      const SegmentGlobalPosition& rhsPosition = globalPosition(rhs);
+      const SegmentGlobalPosition& lhsPosition = globalPosition(lhs);
 	
-	double phidiff = (fabs(rhs_phi - lhs_phi) > 2*M_PI ? fabs(rhs_phi - lhs_phi) - 2*M_PI : fabs(rhs_phi - lhs_phi));
+      double phidiff = (fabs(rhsPosition.phi - lhsPosition.phi) > 2*M_PI ? 
+			fabs(rhsPosition.phi - lhsPosition.phi) - 2*M_PI : fabs(rhsPosition.phi - lhsPosition.phi));
 
-	if(phidiff < OverlapDPhi && fabs(rhs_theta - lhs_theta) < OverlapDTheta && 
-	   fabs(rhs_z) < fabs(lhs_z) && rhs_z*lhs_z > 0) // phi overlap region is 3.5 degrees and rhs is infront of lhs
-	  result = true;
-      } // loop over duplicate segments
+      if(phidiff < OverlapDPhi && fabs(rhsPosition.theta - lhsPosition.theta) < OverlapDTheta && 
+	 fabs(rhsPosition.z) < fabs(lhsPosition.z) && rhsPosition.z*lhsPosition.z > 0) // phi overlap region is 3.5 degrees and rhs is infront of lhs
+	result = true;
     }// neighboring chamber
   } // same endcap,station,ring
 
@@ -487,68 +446,17 @@ bool MuonMesh::isClusteredWith(const std::pair<CSCDetId,CSCSegmentRef>& lhs,
   // try to implement the simple case first just back-to-back segments without treatment of ME1/a ganging
   // ME1a should be a simple extension of this
 
-  //std::cout << lhs.first << ' ' << rhs.first << std::endl;
-
   if(rhs.first.endcap() == lhs.first.endcap() && lhs.first.station() < rhs.first.station()) {
-          
-      std::vector<CSCSegment> thesegments;
-      thesegments.push_back(*(lhs.second));
-      /*
-      if(lhs.second->isME11a_duplicate())
-	thesegments.insert(thesegments.begin(),
-			   lhs.second->duplicateSegments().begin(),
-			   lhs.second->duplicateSegments().end());
-      */
-      //std::cout << "lhs is in neighoring chamber of rhs." << std::endl;
-
-      // rhs local direction info
-      /*
-      double rhs_dydz = geometry_->chamber(rhs.first)->toGlobal(rhs.second->localDirection()).y()/
-	                geometry_->chamber(rhs.first)->toGlobal(rhs.second->localDirection()).z();
-      double rhs_dxdz = geometry_->chamber(rhs.first)->toGlobal(rhs.second->localDirection()).x()/
-	                geometry_->chamber(rhs.first)->toGlobal(rhs.second->localDirection()).z();
-      double rhs_dydz_err = rhs.second->localDirectionError().yy();
-      double rhs_dxdz_err = rhs.second->localDirectionError().xx();
-      */
-      
-      //rhs global position info
-      double rhs_phi = geometry_->chamber(rhs.first)->toGlobal(rhs.second->localPosition()).phi();
-      double rhs_theta = geometry_->chamber(rhs.first)->toGlobal(rhs.second->localPosition()).theta();
-
-      for(std::vector<CSCSegment>::const_iterator ilhs = thesegments.begin(); ilhs != thesegments.end(); ++ilhs) {
- 	
-	// lhs local direction info
-	/*
-	double lhs_dydz = geometry_->chamber(lhs.first)->toGlobal(ilhs->localDirection()).y()/
-	                  geometry_->chamber(lhs.first)->toGlobal(ilhs->localDirection()).z();
-	double lhs_dxdz = geometry_->chamber(lhs.first)->toGlobal(ilhs->localDirection()).x()/
-	                  geometry_->chamber(lhs.first)->toGlobal(ilhs->localDirection()).z();
-	double lhs_dydz_err = ilhs->localDirectionError().yy();
-	double lhs_dxdz_err = ilhs->localDirectionError().xx();
-	*/
-
-	//lhs global position info
-	double lhs_phi = geometry_->chamber(lhs.first)->toGlobal(ilhs->localPosition()).phi();
-	double lhs_theta = geometry_->chamber(lhs.first)->toGlobal(ilhs->localPosition()).theta();
-	/*
-	  std::cout << "RHS Segment Parameters:" << std::endl
-	  << "\t RHS Phi   : " << rhs_phi << std::endl
-	  << "\t RHS Theta : " << rhs_theta << std::endl
-	  << "\t RHS dx/dz : " << rhs_dxdz << " +- " << rhs_dxdz_err << std::endl
-	  << "\t RHS dy/dz : " << rhs_dydz << " +- " << rhs_dydz_err << std::endl; 
-	  
-	  std::cout << "LHS Segment Parameters:" << std::endl
-	  << "\t LHS Phi   : " << lhs_phi << std::endl
-	  << "\t LHS Theta : " << lhs_theta << std::endl
-	  << "\t LHS dx/dz : " << lhs_dxdz << " +- " << lhs_dxdz_err << std::endl
-	  << "\t LHS dy/dz : " << lhs_dydz << " +- " << lhs_dydz_err << std::endl; 
-	*/
-
-	double phidiff = (fabs(rhs_phi - lhs_phi) > 2*M_PI ? fabs(rhs_phi - lhs_phi) - 2*M_PI : fabs(rhs_phi - lhs_phi));
+
+    // ME1/a duplicates of lhs are not considered here
+    const SegmentGlobalPosition& rhsPosition = globalPosition(rhs);
+    const SegmentGlobalPosition& lhsPosition = globalPosition(lhs);
+
+    double phidiff = (fabs(rhsPosition.phi - lhsPosition.phi) > 2*M_PI ? 
+		      fabs(rhsPosition.phi - lhsPosition.phi) - 2*M_PI : fabs(rhsPosition.phi - lhsPosition.phi));
 	
-	if(phidiff < ClusterDPhi && fabs(rhs_theta - lhs_theta) < ClusterDTheta) // phi overlap region is 37 degrees
-	  result = true;
-      } // loop over duplicate segments    
+    if(phidiff < ClusterDPhi && fabs(rhsPosition.theta - lhsPosition.theta) < ClusterDTheta) // phi overlap region is 37 degrees
+      result = true;
   } // same endcap,station,ring
 
   return result;
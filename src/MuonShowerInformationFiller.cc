@@ -15,6 +15,7 @@
 
 // system include files
 #include <memory>
+#include <map>
 #include <algorithm>
 #include <iostream>
 
@@ -51,6 +52,7 @@
 #include "RecoTracker/TkDetLayers/interface/GeometricSearchTracker.h"
 #include "RecoMuon/DetLayers/interface/MuonDetLayerGeometry.h"
 #include "Geometry/Records/interface/MuonGeometryRecord.h"
+#include "RecoMuon/Records/interface/MuonRecoGeometryRecord.h"
 
 #include "RecoTracker/Record/interface/TrackerRecoGeometryRecord.h"
 #include "MagneticField/Records/interface/IdealMagneticFieldRecord.h"
@@ -83,16 +85,11 @@ MuonShowerInformationFiller::MuonShowerInformationFiller(const edm::ParameterSet
 
   theCacheId_TRH = 0;
   theCacheId_MT = 0;
+  theCacheId_DLG = 0;
+  theCacheId_GTG = 0;
 
   category_ = "MuonShowerInformationFiller";
 
-  for (int istat = 0; istat < 4; istat++) {
-      theStationShowerDeltaR.push_back(0.);
-      theStationShowerTSize.push_back(0.);
-      theAllStationHits.push_back(0);
-      theCorrelatedStationHits.push_back(0);
-  }
-
 }
 
 //
@@ -114,21 +111,39 @@ reco::MuonShower MuonShowerInformationFiller::fillShowerInformation( const reco:
   setEvent(iEvent);
   setServices(theService->eventSetup());
 
-  fillHitsByStation(muon);
-  std::vector<int> nStationHits = theAllStationHits;
-  std::vector<int> nStationCorrelatedHits = theCorrelatedStationHits;
-  std::vector<float> stationShowerSizeT = theStationShowerTSize;
-  std::vector<float> stationShowerDeltaR = theStationShowerDeltaR;
-  
-  returnShower.nStationHits = nStationHits; 
-  returnShower.nStationCorrelatedHits = nStationCorrelatedHits;
-  returnShower.stationShowerSizeT = stationShowerSizeT;
-  returnShower.stationShowerDeltaR = stationShowerDeltaR; 
+  fillShower(muon, returnShower);
 
   return returnShower;
 
 }
 
+void MuonShowerInformationFiller::fillShowerInformation( const reco::MuonCollection& muons, std::vector<reco::MuonShower>& showers, 
+                                                         const edm::Event& iEvent, const edm::EventSetup& iSetup,
+                                                         const std::vector<bool>* selected ) {
+
+  showers.clear();
+  showers.reserve(muons.size());
+  if (muons.empty()) return;
+
+  // Update the services once for all the muons
+  theService->update(iSetup);
+  setEvent(iEvent);
+  setServices(theService->eventSetup());
+
+  for (reco::MuonCollection::const_iterator muon = muons.begin(); muon != muons.end(); ++muon) {
+    showers.push_back(reco::MuonShower());
+    if ( selected && !(*selected)[muon - muons.begin()] ) continue;
+    fillShower(*muon, showers.back());
+  }
+
+}
+
+void MuonShowerInformationFiller::fillShower( const reco::Muon& muon, reco::MuonShower& shower) {
+
+  fillHitsByStation(muon, shower);
+
+}
+
 //
 // Set Event
 //
@@ -140,11 +155,14 @@ void MuonShowerInformationFiller::setEvent(const edm::Event& event) {
   event.getByLabel(theCSCSegmentsLabel, theCSCSegments);
   event.getByLabel(theDT4DRecSegmentLabel, theDT4DRecSegments);
 
-  for (int istat = 0; istat < 4; istat++) {
-      theStationShowerDeltaR.at(istat) = 0.;
-      theStationShowerTSize.at(istat) = 0.;
-      theAllStationHits.at(istat) = 0;
-      theCorrelatedStationHits.at(istat) = 0;
+  theDetHits.clear();
+
+  // CSC segment chambers by chamber number, in the order of the collection
+  theCSCSegmentChambers.assign(CSCDetId::maxChamberId() + 1, vector<CSCDetId>());
+  if (theCSCSegments.isValid()) {
+    for (CSCSegmentCollection::id_iterator chamberId = theCSCSegments->id_begin();
+         chamberId != theCSCSegments->id_end(); ++chamberId)
+      theCSCSegmentChambers.at((*chamberId).chamber()).push_back(*chamberId);
   }
 }
 
@@ -168,6 +186,54 @@ void MuonShowerInformationFiller::setServices(const EventSetup& setup) {
     setup.get<TransientRecHitRecord>().get(theMuonRecHitBuilderName,theMuonRecHitBuilder);
   }
 
+  // muon layer surfaces and chamber lookup tables
+  unsigned long long newCacheId_DLG = setup.get<MuonRecoGeometryRecord>().cacheIdentifier();
+  unsigned long long newCacheId_GTG = setup.get<GlobalTrackingGeometryRecord>().cacheIdentifier();
+  if ( newCacheId_DLG != theCacheId_DLG || newCacheId_GTG != theCacheId_GTG ) {
+    theCacheId_DLG = newCacheId_DLG;
+    theCacheId_GTG = newCacheId_GTG;
+    fillLayerCache();
+  }
+
+}
+
+//
+// Radii of the DT layers, z of the CSC layers and the GeomDets of the
+// chambers, taken from the geometry once per IOV
+//
+void MuonShowerInformationFiller::fillLayerCache() {
+
+  theDTLayerRadii.clear();
+  const vector<DetLayer*>& dtlayers = theService->detLayerGeometry()->allDTLayers();
+  for (vector<DetLayer*>::const_iterator iLayer = dtlayers.begin(); iLayer != dtlayers.end(); ++iLayer) {
+    const BoundCylinder& bc = dynamic_cast<const BarrelDetLayer*>(*iLayer)->specificSurface();
+    theDTLayerRadii.push_back(bc.radius());
+  }
+
+  theCSCLayerZ.clear();
+  const vector<DetLayer*>& csclayers = theService->detLayerGeometry()->allCSCLayers();
+  for (vector<DetLayer*>::const_iterator iLayer = csclayers.begin(); iLayer != csclayers.end(); ++iLayer) {
+    const BoundDisk& disk = dynamic_cast<const ForwardDetLayer*>(*iLayer)->specificSurface();
+    theCSCLayerZ.push_back(diskCrossingZ(disk));
+  }
+
+  // same lookups as per muon before, missing chambers stay null
+  const GlobalTrackingGeometry* geometry = &*theService->trackingGeometry();
+  theDTChambers.assign(5*4*14, 0);
+  for (int iwheel = -2; iwheel <= 2; ++iwheel)
+    for (int station = 1; station <= 4; ++station)
+      for (int sector = 1; sector <= 14; ++sector)
+        theDTChambers[dtChamberIndex(iwheel, station, sector)] = geometry->idToDet(DTChamberId(iwheel, station, sector));
+
+  theCSCLayers.assign(2*4*3*36*6, 0);
+  for (int endcap = 1; endcap <= 2; ++endcap)
+    for (int station = 1; station <= 4; ++station)
+      for (int ring = 1; ring <= 3; ++ring)
+        for (int chamber = 1; chamber <= 36; ++chamber)
+          for (int layer = 1; layer <= 6; ++layer)
+            theCSCLayers[cscLayerIndex(endcap, station, ring, chamber, layer)] = 
+              geometry->idToDet(CSCDetId(endcap, station, ring, chamber, layer));
+
 }
 
 //
@@ -186,32 +252,23 @@ MuonShowerInformationFiller::hitsFromSegments(const GeomDet* geomDet,
 
     DTChamberId chamberId(geoId.rawId());
 
-    // loop on segments 4D                 
-    DTRecSegment4DCollection::id_iterator chamberIdIt;
-    for (chamberIdIt = dtSegments->id_begin();
-         chamberIdIt != dtSegments->id_end();
-         ++chamberIdIt){
-
-      if (*chamberIdIt != chamberId) continue;
-
-      // Get the range for the corresponding ChamberId              
-      DTRecSegment4DCollection::range  range = dtSegments->get((*chamberIdIt));
+    // Get the range for the corresponding ChamberId, empty without segments
+    DTRecSegment4DCollection::range  range = dtSegments->get(chamberId);
   
-      for (DTRecSegment4DCollection::const_iterator iseg = range.first;
-        iseg!=range.second;++iseg) {
-        if (iseg->dimension() != 4) continue;
-        segments.push_back(MuonTransientTrackingRecHit::specificBuild(geomDet,&*iseg));
-      }
-    } 
+    for (DTRecSegment4DCollection::const_iterator iseg = range.first;
+      iseg!=range.second;++iseg) {
+      if (iseg->dimension() != 4) continue;
+      segments.push_back(MuonTransientTrackingRecHit::specificBuild(geomDet,&*iseg));
+    }
   }
   else if (geoId.subdetId() == MuonSubdetId::CSC) {
 
       CSCDetId did(geoId.rawId());
 
-      for (  CSCSegmentCollection::id_iterator chamberId = cscSegments->id_begin();
-         chamberId != cscSegments->id_end(); ++chamberId) {
-
-      if ((*chamberId).chamber() != did.chamber()) continue;
+      // all segment chambers with the chamber number of the det, as indexed in setEvent
+      const vector<CSCDetId>& chambers = theCSCSegmentChambers.at(did.chamber());
+      for (vector<CSCDetId>::const_iterator chamberId = chambers.begin();
+         chamberId != chambers.end(); ++chamberId) {
 
       // Get the range for the corresponding ChamberId                                                                                                                     
       CSCSegmentCollection::range  range = cscSegments->get((*chamberId));
@@ -236,6 +293,14 @@ MuonShowerInformationFiller::hitsFromSegments(const GeomDet* geomDet,
 
   if (segments.size() == 1) return allhitscorrelated;
 
+  // positions of the hits taken so far by DetId. Hits closer than 1 cm are
+  // on the same layer (the layers are further apart), so only the hits with
+  // the same DetId need to be compared.
+  multimap<uint32_t, GlobalPoint> usedPositions;
+  for (TransientTrackingRecHit::ConstRecHitContainer::const_iterator ihit = allhitscorrelated.begin();
+       ihit != allhitscorrelated.end(); ++ihit )
+    usedPositions.insert(make_pair((*ihit)->geographicalId().rawId(), (*ihit)->globalPosition()));
+
   for (MuonTransientTrackingRecHit::MuonRecHitContainer::const_iterator iseg = segments.begin() + 1;
        iseg != segments.end(); ++iseg) {
 
@@ -246,21 +311,23 @@ MuonShowerInformationFiller::hitsFromSegments(const GeomDet* geomDet,
          ihit1 != hits1.end(); ++ihit1 ) {
 
       bool usedbefore = false;       
-      //unused      DetId thisID = (*ihit1)->geographicalId();
-      //LocalPoint lp1dinsegHit = (*ihit1)->localPosition();
+      uint32_t thisID = (*ihit1)->geographicalId().rawId();
       GlobalPoint gp1dinsegHit = (*ihit1)->globalPosition();
 
-      for (TransientTrackingRecHit::ConstRecHitContainer::const_iterator ihit2 = allhitscorrelated.begin();
-           ihit2 != allhitscorrelated.end(); ++ihit2 ) {
-
-	//unused        DetId thisID2 = (*ihit2)->geographicalId();
-        //LocalPoint lp1dinsegHit2 = (*ihit2)->localPosition();
-        GlobalPoint gp1dinsegHit2 = (*ihit2)->globalPosition();
+      pair<multimap<uint32_t, GlobalPoint>::const_iterator, multimap<uint32_t, GlobalPoint>::const_iterator> 
+        sameDet = usedPositions.equal_range(thisID);
+      for (multimap<uint32_t, GlobalPoint>::const_iterator ihit2 = sameDet.first; ihit2 != sameDet.second; ++ihit2 ) {
 
-        if ( (gp1dinsegHit2 - gp1dinsegHit).mag() < 1.0 ) usedbefore = true;
+        if ( (ihit2->second - gp1dinsegHit).mag() < 1.0 ) {
+          usedbefore = true;
+          break;
+        }
 
       }
-      if ( !usedbefore ) allhitscorrelated.push_back(*ihit1);
+      if ( !usedbefore ) {
+        allhitscorrelated.push_back(*ihit1);
+        usedPositions.insert(make_pair(thisID, gp1dinsegHit));
+      }
     }
   }
 
@@ -272,28 +339,28 @@ MuonShowerInformationFiller::hitsFromSegments(const GeomDet* geomDet,
 //
 // Find cluster
 //
-MuonTransientTrackingRecHit::MuonRecHitContainer 
-MuonShowerInformationFiller::findPhiCluster(MuonTransientTrackingRecHit::MuonRecHitContainer& muonRecHits, 
-                              const GlobalPoint& refpoint) const {
+vector<MuonShowerInformationFiller::ShowerHit>
+MuonShowerInformationFiller::findPhiCluster(vector<ShowerHit>& muonRecHits, 
+                              const ShowerHit& refpoint) const {
 
   if ( muonRecHits.empty() ) return muonRecHits;
 
   //clustering step by phi
   float step = 0.05;
-  MuonTransientTrackingRecHit::MuonRecHitContainer result;
+  vector<ShowerHit> result;
 
-  stable_sort(muonRecHits.begin(), muonRecHits.end(), AbsLessDPhi(refpoint));
+  sortByKey(muonRecHits, AbsDPhiKey(refpoint));
 
-  for (MuonTransientTrackingRecHit::MuonRecHitContainer::const_iterator ihit = muonRecHits.begin(); ihit != muonRecHits.end() - 1; ++ihit) {
-      if (fabs(deltaPhi((*(ihit+1))->globalPosition().phi(), (*ihit)->globalPosition().phi() )) < step) {
+  for (vector<ShowerHit>::const_iterator ihit = muonRecHits.begin(); ihit != muonRecHits.end() - 1; ++ihit) {
+      if (fabs(deltaPhi((float)(ihit+1)->phi, (float)ihit->phi )) < step) {
           result.push_back(*ihit);  
         } else {
            break;
        }
   } 
 
-  LogTrace(category_) <<  "phi front: " << muonRecHits.front()->globalPosition().phi() << endl;    
-  LogTrace(category_) <<  "phi back: " << muonRecHits.back()->globalPosition().phi() << endl;
+  LogTrace(category_) <<  "phi front: " << muonRecHits.front().position.phi() << endl;    
+  LogTrace(category_) <<  "phi back: " << muonRecHits.back().position.phi() << endl;
 
   return result;
 
@@ -302,20 +369,20 @@ MuonShowerInformationFiller::findPhiCluster(MuonTransientTrackingRecHit::MuonRec
 //
 //
 //
-TransientTrackingRecHit::ConstRecHitContainer
-MuonShowerInformationFiller::findThetaCluster(TransientTrackingRecHit::ConstRecHitContainer& muonRecHits,
-                              const GlobalPoint& refpoint) const {
+vector<MuonShowerInformationFiller::ShowerHit>
+MuonShowerInformationFiller::findThetaCluster(vector<ShowerHit>& muonRecHits,
+                              const ShowerHit& refpoint) const {
 
   if ( muonRecHits.empty() ) return muonRecHits;
 
   //clustering step by theta
   float step = 0.05;
-  TransientTrackingRecHit::ConstRecHitContainer result;
+  vector<ShowerHit> result;
 
-  stable_sort(muonRecHits.begin(), muonRecHits.end(), AbsLessDTheta(refpoint));
+  sortByKey(muonRecHits, AbsDThetaKey(refpoint));
 
-  for (TransientTrackingRecHit::ConstRecHitContainer::const_iterator ihit = muonRecHits.begin(); ihit != muonRecHits.end() - 1; ++ihit) {
-      if (fabs((*(ihit+1))->globalPosition().theta() - (*ihit)->globalPosition().theta() ) < step) {
+  for (vector<ShowerHit>::const_iterator ihit = muonRecHits.begin(); ihit != muonRecHits.end() - 1; ++ihit) {
+      if (fabs((ihit+1)->theta - ihit->theta ) < step) {
           result.push_back(*ihit);
         } else {
            break;
@@ -329,28 +396,82 @@ MuonShowerInformationFiller::findThetaCluster(TransientTrackingRecHit::ConstRecH
 //
 //Used to treat overlap region
 //
-MuonTransientTrackingRecHit::MuonRecHitContainer
-MuonShowerInformationFiller::findPerpCluster(MuonTransientTrackingRecHit::MuonRecHitContainer& muonRecHits) const {
+vector<MuonShowerInformationFiller::ShowerHit>
+MuonShowerInformationFiller::findPerpCluster(vector<ShowerHit>& muonRecHits) const {
 
   if ( muonRecHits.empty() ) return muonRecHits;
 
-  stable_sort(muonRecHits.begin(), muonRecHits.end(), LessPerp());
+  sortByKey(muonRecHits, PerpKey());
 
-  MuonTransientTrackingRecHit::MuonRecHitContainer::const_iterator
-  seedhit = min_element(muonRecHits.begin(), muonRecHits.end(), LessPerp());
+  // the first hit with the smallest perp after the sort
+  vector<ShowerHit>::const_iterator seedhit = muonRecHits.begin();
 
-  MuonTransientTrackingRecHit::MuonRecHitContainer::const_iterator ihigh = seedhit;
-  MuonTransientTrackingRecHit::MuonRecHitContainer::const_iterator ilow = seedhit;
+  vector<ShowerHit>::const_iterator ihigh = seedhit;
+  vector<ShowerHit>::const_iterator ilow = seedhit;
 
   float step = 0.1;
-  while (ihigh != muonRecHits.end()-1 && ( fabs((*(ihigh+1))->globalPosition().perp() - (*ihigh)->globalPosition().perp() ) < step)  ) {
+  while (ihigh != muonRecHits.end()-1 && ( fabs((ihigh+1)->perp - ihigh->perp ) < step)  ) {
     ihigh++;
   }
-  while (ilow != muonRecHits.begin() && ( fabs((*ilow)->globalPosition().perp() - (*(ilow -1))->globalPosition().perp()) < step ) ) {
+  while (ilow != muonRecHits.begin() && ( fabs(ilow->perp - (ilow -1)->perp) < step ) ) {
     ilow--;
   }
 
-  MuonTransientTrackingRecHit::MuonRecHitContainer result(ilow, ihigh);
+  vector<ShowerHit> result(ilow, ihigh);
+
+  return result;
+
+}
+
+//
+// Hits of a GeomDet in this event, built on the first request
+//
+const MuonShowerInformationFiller::DetHits&
+MuonShowerInformationFiller::detHits(const GeomDet* geomDet) {
+
+  DetId geoId = geomDet->geographicalId();
+
+  map<uint32_t, DetHits>::const_iterator found = theDetHits.find(geoId.rawId());
+  if (found != theDetHits.end()) return found->second;
+
+  DetHits& result = theDetHits[geoId.rawId()];
+
+  // rechits from segments
+  TransientTrackingRecHit::ConstRecHitContainer correlatedHits = hitsFromSegments(geomDet, theDT4DRecSegments, theCSCSegments);
+  result.correlatedHits.reserve(correlatedHits.size());
+  for (TransientTrackingRecHit::ConstRecHitContainer::const_iterator ihit = correlatedHits.begin(); 
+       ihit != correlatedHits.end(); ++ihit) {
+    result.correlatedHits.push_back(ShowerHit(**ihit));
+  }
+
+  if ( geoId.subdetId() == MuonSubdetId::DT ) {
+
+    DTChamberId detid(geoId.rawId());
+
+    // loop over all superlayers of a DT chamber
+    for (int isuperlayer = DTChamberId::minSuperLayerId; isuperlayer != DTChamberId::maxSuperLayerId + 1; ++isuperlayer) {
+      // loop over all layers inside the superlayer
+      for (int ilayer = DTChamberId::minLayerId; ilayer != DTChamberId::maxLayerId+1; ++ilayer) {
+        DTLayerId lid(detid, isuperlayer, ilayer);
+        DTRecHitCollection::range dRecHits = theDTRecHits->get(lid);
+        for (DTRecHitCollection::const_iterator rechit = dRecHits.first; rechit != dRecHits.second;++rechit) {
+          vector<const TrackingRecHit*> subrechits = (*rechit).recHits();
+          for (vector<const TrackingRecHit*>::iterator irechit = subrechits.begin(); irechit != subrechits.end(); ++irechit) {
+            result.hits.push_back(ShowerHit(*MuonTransientTrackingRecHit::specificBuild(geomDet,&**irechit)));
+          }
+        }
+      }
+    }
+  }
+  else if ( geoId.subdetId() == MuonSubdetId::CSC ) {
+
+    CSCDetId did(geoId.rawId());
+
+    CSCRecHit2DCollection::range dRecHits = theCSCRecHits->get(did);
+    for (CSCRecHit2DCollection::const_iterator rechit = dRecHits.first; rechit != dRecHits.second; ++rechit) {
+      result.hits.push_back(ShowerHit(*MuonTransientTrackingRecHit::specificBuild(geomDet,&*rechit)));
+    }
+  }
 
   return result;
 
@@ -359,10 +480,9 @@ MuonShowerInformationFiller::findPerpCluster(MuonTransientTrackingRecHit::MuonRe
 //
 // Get compatible dets
 //
-vector<const GeomDet*> MuonShowerInformationFiller::getCompatibleDets(const reco::Track& track) const {
+void MuonShowerInformationFiller::getCompatibleDets(const reco::Track& track, vector<const GeomDet*>& total) const {
 
-  vector<const GeomDet*> total;
-  total.reserve(1000);
+  total.clear();
 
   LogTrace(category_)  << "Consider a track " << track.p() << " eta: " << track.eta() << " phi " << track.phi() << endl;
 
@@ -373,14 +493,13 @@ vector<const GeomDet*> MuonShowerInformationFiller::getCompatibleDets(const reco
   GlobalPoint innerPos = innerTsos.globalPosition();
   GlobalPoint outerPos = outerTsos.globalPosition();
 
-  vector<GlobalPoint> allCrossingPoints;
+  vector<GlobalPoint>& allCrossingPoints = theCrossingPoints;
+  allCrossingPoints.clear();
 
-  const vector<DetLayer*>& dtlayers = theService->detLayerGeometry()->allDTLayers();
-
-  for (vector<DetLayer*>::const_iterator iLayer = dtlayers.begin(); iLayer != dtlayers.end(); ++iLayer) {
+  for (vector<float>::const_iterator iRadius = theDTLayerRadii.begin(); iRadius != theDTLayerRadii.end(); ++iRadius) {
 
     // crossing points of track with cylinder
-    GlobalPoint xPoint = crossingPoint(innerPos, outerPos, dynamic_cast<const BarrelDetLayer*>(*iLayer));
+    GlobalPoint xPoint = barrelCrossingPoint(innerPos, outerPos, *iRadius);
       
     // check if point is inside the detector
     if ((fabs(xPoint.y()) < 1000.0) && (fabs(xPoint.z()) < 1500 ) && 
@@ -389,25 +508,14 @@ vector<const GeomDet*> MuonShowerInformationFiller::getCompatibleDets(const reco
 
   stable_sort(allCrossingPoints.begin(), allCrossingPoints.end(), LessMag(innerPos) );
 
-  vector<const GeomDet*> tempDT;
-
   for (vector<GlobalPoint>::const_iterator ipos = allCrossingPoints.begin(); ipos != allCrossingPoints.end(); ++ipos) {
-
-    tempDT = dtPositionToDets(*ipos);
-    vector<const GeomDet*>::const_iterator begin = tempDT.begin();
-    vector<const GeomDet*>::const_iterator end = tempDT.end();
-     
-    for (; begin!=end;++begin) {
-      total.push_back(*begin);
-    } 
-
+    dtPositionToDets(*ipos, total);
   }
   allCrossingPoints.clear();
 
-  const vector<DetLayer*>& csclayers = theService->detLayerGeometry()->allCSCLayers();
-  for (vector<DetLayer*>::const_iterator iLayer = csclayers.begin(); iLayer != csclayers.end(); ++iLayer) {
+  for (vector<float>::const_iterator iZ = theCSCLayerZ.begin(); iZ != theCSCLayerZ.end(); ++iZ) {
 
-    GlobalPoint xPoint = crossingPoint(innerPos, outerPos, dynamic_cast<const ForwardDetLayer*>(*iLayer));
+    GlobalPoint xPoint = diskCrossingPoint(innerPos, outerPos, *iZ);
 
     // check if point is inside the detector
     if ((fabs(xPoint.y()) < 1000.0) && (fabs(xPoint.z()) < 1500.0) 
@@ -415,21 +523,10 @@ vector<const GeomDet*> MuonShowerInformationFiller::getCompatibleDets(const reco
    }
    stable_sort(allCrossingPoints.begin(), allCrossingPoints.end(), LessMag(innerPos) );
 
-   vector<const GeomDet*> tempCSC;
    for (vector<GlobalPoint>::const_iterator ipos = allCrossingPoints.begin(); ipos != allCrossingPoints.end(); ++ipos) {
-
-     tempCSC = cscPositionToDets(*ipos);
-     vector<const GeomDet*>::const_iterator begin = tempCSC.begin();
-     vector<const GeomDet*>::const_iterator end = tempCSC.end();
-
-     for (; begin!=end;++begin) {
-       total.push_back(*begin);
-     }
-
+     cscPositionToDets(*ipos, total);
   }
 
-  return total;
-
 }
 
 
@@ -449,7 +546,13 @@ GlobalPoint MuonShowerInformationFiller::crossingPoint(const GlobalPoint& p1,
                                             const GlobalPoint& p2, 
                                             const Cylinder& cyl) const {
 
-  float radius = cyl.radius();
+  return barrelCrossingPoint(p1, p2, cyl.radius());
+
+}
+
+GlobalPoint MuonShowerInformationFiller::barrelCrossingPoint(const GlobalPoint& p1,
+                                            const GlobalPoint& p2, 
+                                            float radius) const {
 
   GlobalVector dp = p1 - p2;
   float slope = dp.x()/dp.y();
@@ -500,9 +603,22 @@ GlobalPoint MuonShowerInformationFiller::crossingPoint(const GlobalPoint& p1,
                                             const GlobalPoint& p2, 
                                             const BoundDisk& disk) const {
 
+  return diskCrossingPoint(p1, p2, diskCrossingZ(disk));
+
+}
+
+float MuonShowerInformationFiller::diskCrossingZ(const BoundDisk& disk) {
+
   float diskZ = disk.position().z();
   int endcap =  diskZ > 0 ? 1 : (diskZ < 0 ? -1 : 0);
   diskZ = diskZ + endcap*dynamic_cast<const SimpleDiskBounds&>(disk.bounds()).thickness()/2.;
+  return diskZ;
+
+}
+
+GlobalPoint MuonShowerInformationFiller::diskCrossingPoint(const GlobalPoint& p1, 
+                                            const GlobalPoint& p2, 
+                                            float diskZ) const {
 
   GlobalVector dp = p1 - p2;
 
@@ -526,7 +642,7 @@ GlobalPoint MuonShowerInformationFiller::crossingPoint(const GlobalPoint& p1,
 //
 // GeomDets along the track in DT
 //
-vector<const GeomDet*> MuonShowerInformationFiller::dtPositionToDets(const GlobalPoint& gp) const {
+void MuonShowerInformationFiller::dtPositionToDets(const GlobalPoint& gp, vector<const GeomDet*>& result) const {
 
    int minwheel = -3;
    int maxwheel = -3;
@@ -545,7 +661,8 @@ vector<const GeomDet*> MuonShowerInformationFiller::dtPositionToDets(const Globa
    else if ( gp.perp() > 380.0 ) station = 1;
    else station = 0;
 
-   vector<int> sectors;
+   vector<int>& sectors = theSectors;
+   sectors.clear();
 
    float phistep = M_PI/6;
 
@@ -574,20 +691,18 @@ vector<const GeomDet*> MuonShowerInformationFiller::dtPositionToDets(const Globa
    LogTrace(category_) << "number of sectors to consider: " << sectors.size() << endl;   
    LogTrace(category_) << "station: " << station << " wheels: " << minwheel << " " << maxwheel << endl;
 
-   vector<const GeomDet*> result;
-   if (station > 4 || station < 1) return result;
-   if (minwheel > 2 || maxwheel < -2) return result;
+   if (station > 4 || station < 1) return;
+   if (minwheel > 2 || maxwheel < -2) return;
+
+   unsigned int nBefore = result.size();
 
    for (vector<int>::const_iterator isector = sectors.begin(); isector != sectors.end(); ++isector ) {
      for (int iwheel = minwheel; iwheel != maxwheel + 1; ++iwheel) {
-       DTChamberId chamberid(iwheel, station, (*isector));
-       result.push_back(theService->trackingGeometry()->idToDet(chamberid));
+       result.push_back(theDTChambers[dtChamberIndex(iwheel, station, (*isector))]);
      }
    }
 
-   LogTrace(category_) << "number of GeomDets for this track: " << result.size() << endl;
-
-   return result;
+   LogTrace(category_) << "number of GeomDets for this track: " << result.size() - nBefore << endl;
 
 }
 
@@ -595,7 +710,7 @@ vector<const GeomDet*> MuonShowerInformationFiller::dtPositionToDets(const Globa
 //
 // GeomDets along the track in CSC
 //
-vector<const GeomDet*> MuonShowerInformationFiller::cscPositionToDets(const GlobalPoint& gp) const {
+void MuonShowerInformationFiller::cscPositionToDets(const GlobalPoint& gp, vector<const GeomDet*>& result) const {
 
   // determine the endcap side
   int endcap = 0;
@@ -618,7 +733,8 @@ vector<const GeomDet*> MuonShowerInformationFiller::cscPositionToDets(const Glob
     station = 1;
   }
 
-  vector<int> sectors;
+  vector<int>& sectors = theSectors;
+  sectors.clear();
 
   float phistep1 = M_PI/18.; //for all the rings except first rings for stations > 1
   float phistep2 = M_PI/9.;
@@ -678,29 +794,35 @@ vector<const GeomDet*> MuonShowerInformationFiller::cscPositionToDets(const Glob
 
 
  // check exceptional cases
-   vector<const GeomDet*> result;
-   if (station > 4 || station < 1) return result;
-   if (endcap == 0) return result;
-   if (ring == -1) return result;
+   if (station > 4 || station < 1) return;
+   if (endcap == 0) return;
+   if (ring == -1) return;
 
    int minlayer = 1;
    int maxlayer = 6;
 
    for (vector<int>::const_iterator isector = sectors.begin(); isector != sectors.end(); ++isector) {
      for (int ilayer = minlayer; ilayer != maxlayer + 1; ++ ilayer) {
-       CSCDetId cscid(endcap, station, ring, (*isector), ilayer);
-       result.push_back(theService->trackingGeometry()->idToDet(cscid));
+       result.push_back(theCSCLayers[cscLayerIndex(endcap, station, ring, (*isector), ilayer)]);
      }
    }
 
-  return result;
-
 }
 
 //
-//Set class members
+//Fill the station variables of the shower
 //
-void MuonShowerInformationFiller::fillHitsByStation(const reco::Muon& muon) {
+void MuonShowerInformationFiller::fillHitsByStation(const reco::Muon& muon, reco::MuonShower& shower) {
+
+  // the results are kept in the shower only, nothing of the muon is left in the filler
+  vector<float>& stationShowerDeltaR = shower.stationShowerDeltaR;
+  vector<float>& stationShowerTSize = shower.stationShowerSizeT;
+  vector<int>& allStationHits = shower.nStationHits;
+  vector<int>& correlatedStationHits = shower.nStationCorrelatedHits;
+  stationShowerDeltaR.assign(4, 0.);
+  stationShowerTSize.assign(4, 0.);
+  allStationHits.assign(4, 0);
+  correlatedStationHits.assign(4, 0);
 
   reco::TrackRef track;
   if ( muon.isGlobalMuon() )            track = muon.globalTrack();
@@ -708,16 +830,17 @@ void MuonShowerInformationFiller::fillHitsByStation(const reco::Muon& muon) {
   else return;
 
   // split 1D rechits by station
-  vector<MuonRecHitContainer> muonRecHits(4);
+  vector<vector<ShowerHit> > muonRecHits(4);
 
   // split rechits from segs by station
-  vector<TransientTrackingRecHit::ConstRecHitContainer> muonCorrelatedHits(4);  
+  vector<vector<ShowerHit> > muonCorrelatedHits(4);  
 
   // get vector of GeomDets compatible with a track
-  vector<const GeomDet*> compatibleLayers = getCompatibleDets(*track);
+  vector<const GeomDet*>& compatibleLayers = theCompatibleDets;
+  getCompatibleDets(*track, compatibleLayers);
 
   // for special cases: CSC station 1
-  MuonRecHitContainer tmpCSC1;
+  vector<ShowerHit> tmpCSC1;
   bool dtOverlapToCheck = false;
   bool cscOverlapToCheck = false;
 
@@ -737,32 +860,18 @@ void MuonShowerInformationFiller::fillHitsByStation(const reco::Muon& muon) {
       int station = detid.station();
       int wheel = detid.wheel();
 
-      // get rechits from segments per station
-      TransientTrackingRecHit::ConstRecHitContainer muonCorrelatedHitsTmp = hitsFromSegments(*igd, theDT4DRecSegments, theCSCSegments);     
-      TransientTrackingRecHit::ConstRecHitContainer::const_iterator hits_begin = muonCorrelatedHitsTmp.begin();
-      TransientTrackingRecHit::ConstRecHitContainer::const_iterator hits_end = muonCorrelatedHitsTmp.end();
+      const DetHits& chamberHits = detHits(*igd);
 
-      for (; hits_begin!= hits_end;++hits_begin) {
-        muonCorrelatedHits.at(station-1).push_back(*hits_begin);
-      }
+      // get rechits from segments per station
+      muonCorrelatedHits.at(station-1).insert(muonCorrelatedHits.at(station-1).end(),
+                                              chamberHits.correlatedHits.begin(), chamberHits.correlatedHits.end());
 
       //check overlap certain wheels and stations
       if (abs(wheel) == 2 && station != 4 &&  station != 1) dtOverlapToCheck = true;
 
-      // loop over all superlayers of a DT chamber
-      for (int isuperlayer = DTChamberId::minSuperLayerId; isuperlayer != DTChamberId::maxSuperLayerId + 1; ++isuperlayer) {
-        // loop over all layers inside the superlayer
-        for (int ilayer = DTChamberId::minLayerId; ilayer != DTChamberId::maxLayerId+1; ++ilayer) {
-          DTLayerId lid(detid, isuperlayer, ilayer);
-          DTRecHitCollection::range dRecHits = theDTRecHits->get(lid);
-          for (DTRecHitCollection::const_iterator rechit = dRecHits.first; rechit != dRecHits.second;++rechit) {
-            vector<const TrackingRecHit*> subrechits = (*rechit).recHits();
-            for (vector<const TrackingRecHit*>::iterator irechit = subrechits.begin(); irechit != subrechits.end(); ++irechit) {
-                     muonRecHits.at(station-1).push_back(MuonTransientTrackingRecHit::specificBuild((&**igd),&**irechit));
-                }
-             }
-          }
-       }
+      // all rechits of the superlayers of the DT chamber
+      muonRecHits.at(station-1).insert(muonRecHits.at(station-1).end(),
+                                       chamberHits.hits.begin(), chamberHits.hits.end());
     }
     else if (geoId.subdetId() == MuonSubdetId::CSC) {
 
@@ -771,35 +880,31 @@ void MuonShowerInformationFiller::fillHitsByStation(const reco::Muon& muon) {
       int station = did.station();
       int ring = did.ring();
 
-      //get rechits from segments by station      
-      TransientTrackingRecHit::ConstRecHitContainer muonCorrelatedHitsTmp = hitsFromSegments(*igd, theDT4DRecSegments, theCSCSegments);
-      TransientTrackingRecHit::ConstRecHitContainer::const_iterator hits_begin = muonCorrelatedHitsTmp.begin();
-      TransientTrackingRecHit::ConstRecHitContainer::const_iterator hits_end = muonCorrelatedHitsTmp.end();
+      const DetHits& layerHits = detHits(*igd);
 
-      for (; hits_begin!= hits_end;++hits_begin) {
-        muonCorrelatedHits.at(station-1).push_back(*hits_begin);
-      }
+      //get rechits from segments by station      
+      muonCorrelatedHits.at(station-1).insert(muonCorrelatedHits.at(station-1).end(),
+                                              layerHits.correlatedHits.begin(), layerHits.correlatedHits.end());
 
       if ((station == 1 && ring == 3) && dtOverlapToCheck) cscOverlapToCheck = true;
 
       // split 1D rechits by station
-      CSCRecHit2DCollection::range dRecHits = theCSCRecHits->get(did);
-      for (CSCRecHit2DCollection::const_iterator rechit = dRecHits.first; rechit != dRecHits.second; ++rechit) {
+      for (vector<ShowerHit>::const_iterator rechit = layerHits.hits.begin(); rechit != layerHits.hits.end(); ++rechit) {
 
         if (!cscOverlapToCheck) {
-           muonRecHits.at(station-1).push_back(MuonTransientTrackingRecHit::specificBuild((&**igd),&*rechit));
+           muonRecHits.at(station-1).push_back(*rechit);
            } else {
-             tmpCSC1.push_back(MuonTransientTrackingRecHit::specificBuild((&**igd),&*rechit));
+             tmpCSC1.push_back(*rechit);
 
              //sort by perp, then insert to appropriate container
-             MuonRecHitContainer temp = findPerpCluster(tmpCSC1);
+             vector<ShowerHit> temp = findPerpCluster(tmpCSC1);
              if (temp.empty()) continue;
 
              float center;
              if (temp.size() > 1) {
-               center = (temp.front()->globalPosition().perp() + temp.back()->globalPosition().perp())/2.;
+               center = (temp.front().perp + temp.back().perp)/2.;
              } else {
-               center = temp.front()->globalPosition().perp();
+               center = temp.front().perp;
              }
              temp.clear();
              
@@ -818,38 +923,38 @@ void MuonShowerInformationFiller::fillHitsByStation(const reco::Muon& muon) {
 
   // calculate number of all and correlated hits    
   for (int stat = 0; stat < 4; stat++) {
-    theCorrelatedStationHits[stat] = muonCorrelatedHits.at(stat).size();     
-    theAllStationHits[stat] = muonRecHits[stat].size();
+    correlatedStationHits[stat] = muonCorrelatedHits.at(stat).size();     
+    allStationHits[stat] = muonRecHits[stat].size();
   }
   LogTrace(category_) << "Hits used by the segments, by station "
-       << theCorrelatedStationHits.at(0) << " "
-       << theCorrelatedStationHits.at(1) << " "
-       << theCorrelatedStationHits.at(2) << " "
-       << theCorrelatedStationHits.at(3) << endl;
+       << correlatedStationHits.at(0) << " "
+       << correlatedStationHits.at(1) << " "
+       << correlatedStationHits.at(2) << " "
+       << correlatedStationHits.at(3) << endl;
 
   LogTrace(category_) << "All DT 1D/CSC 2D  hits, by station "
-       << theAllStationHits.at(0) << " "
-       << theAllStationHits.at(1) << " "
-       << theAllStationHits.at(2) << " "
-       << theAllStationHits.at(3) << endl;
+       << allStationHits.at(0) << " "
+       << allStationHits.at(1) << " "
+       << allStationHits.at(2) << " "
+       << allStationHits.at(3) << endl;
 
   //station shower sizes
-  MuonTransientTrackingRecHit::MuonRecHitContainer muonRecHitsPhiTemp, muonRecHitsPhiBest;
-  TransientTrackingRecHit::ConstRecHitContainer muonRecHitsThetaTemp, muonRecHitsThetaBest;
+  vector<ShowerHit> muonRecHitsPhiTemp, muonRecHitsPhiBest;
+  vector<ShowerHit> muonRecHitsThetaTemp, muonRecHitsThetaBest;
 
   // send station hits to the clustering algorithm
   for ( int stat = 0; stat != 4; stat++ ) {
     if (!muonRecHits[stat].empty()) {
-      stable_sort(muonRecHits[stat].begin(), muonRecHits[stat].end(), LessPhi());
+      sortByKey(muonRecHits[stat], PhiKey());
 
       float dphimax = 0;
-      for (MuonTransientTrackingRecHit::MuonRecHitContainer::const_iterator iseed = muonRecHits[stat].begin(); iseed != muonRecHits[stat].end(); ++iseed) {
-          if (!(*iseed)->isValid()) continue;
-          GlobalPoint refpoint = (*iseed)->globalPosition(); //starting from the one with smallest value of phi
+      for (vector<ShowerHit>::const_iterator iseed = muonRecHits[stat].begin(); iseed != muonRecHits[stat].end(); ++iseed) {
+          if (!iseed->valid) continue;
+          ShowerHit refpoint = *iseed; //starting from the one with smallest value of phi
           muonRecHitsPhiTemp.clear();
           muonRecHitsPhiTemp = findPhiCluster(muonRecHits[stat], refpoint); //get clustered hits for this iseed
       if (muonRecHitsPhiTemp.size() > 1) {
-         float dphi = fabs(deltaPhi((float)muonRecHitsPhiTemp.back()->globalPosition().phi(), (float)muonRecHitsPhiTemp.front()->globalPosition().phi()));
+         float dphi = fabs(deltaPhi((float)muonRecHitsPhiTemp.back().phi, (float)muonRecHitsPhiTemp.front().phi));
          if (dphi > dphimax) {
             dphimax = dphi;
             muonRecHitsPhiBest = muonRecHitsPhiTemp;
@@ -860,24 +965,22 @@ void MuonShowerInformationFiller::fillHitsByStation(const reco::Muon& muon) {
      //fill showerTs
       if (!muonRecHitsPhiBest.empty()) {
         muonRecHits[stat] = muonRecHitsPhiBest;
-        stable_sort(muonRecHits[stat].begin(), muonRecHits[stat].end(), LessAbsMag());
-        muonRecHits[stat].front();
-        GlobalPoint refpoint = muonRecHits[stat].front()->globalPosition();
-        theStationShowerTSize.at(stat) = refpoint.mag() * dphimax;
+        sortByKey(muonRecHits[stat], MagKey());
+        stationShowerTSize.at(stat) = muonRecHits[stat].front().mag * dphimax;
       }
 
      //for theta
      if (!muonCorrelatedHits.at(stat).empty()) {
 
        float dthetamax = 0;
-       for (TransientTrackingRecHit::ConstRecHitContainer::const_iterator iseed = muonCorrelatedHits.at(stat).begin(); iseed != muonCorrelatedHits.at(stat).end(); ++iseed) {
-           if (!(*iseed)->isValid()) continue;
-           GlobalPoint refpoint = (*iseed)->globalPosition(); //starting from the one with smallest value of phi
+       for (vector<ShowerHit>::const_iterator iseed = muonCorrelatedHits.at(stat).begin(); iseed != muonCorrelatedHits.at(stat).end(); ++iseed) {
+           if (!iseed->valid) continue;
+           ShowerHit refpoint = *iseed; //starting from the one with smallest value of phi
            muonRecHitsThetaTemp.clear();
            muonRecHitsThetaTemp = findThetaCluster(muonCorrelatedHits.at(stat), refpoint);
        }//loop over seeds 
        if (muonRecHitsThetaTemp.size() > 1) {
-         float dtheta = fabs((float)muonRecHitsThetaTemp.back()->globalPosition().theta() - (float)muonRecHitsThetaTemp.front()->globalPosition().theta());
+         float dtheta = fabs((float)muonRecHitsThetaTemp.back().theta - (float)muonRecHitsThetaTemp.front().theta);
          if (dtheta > dthetamax) {
            dthetamax = dtheta;
            muonRecHitsThetaBest = muonRecHitsThetaTemp;
@@ -887,23 +990,23 @@ void MuonShowerInformationFiller::fillHitsByStation(const reco::Muon& muon) {
 
      //fill deltaRs
      if (muonRecHitsThetaBest.size() > 1 && muonRecHitsPhiBest.size() > 1)
-       theStationShowerDeltaR.at(stat) = sqrt(pow(muonRecHitsPhiBest.front()->globalPosition().phi()-muonRecHitsPhiBest.back()->globalPosition().phi(),2)+pow(muonRecHitsThetaBest.front()->globalPosition().theta()-muonRecHitsThetaBest.back()->globalPosition().theta(),2));
+       stationShowerDeltaR.at(stat) = sqrt(pow(muonRecHitsPhiBest.front().phi-muonRecHitsPhiBest.back().phi,2)+pow(muonRecHitsThetaBest.front().theta-muonRecHitsThetaBest.back().theta,2));
 
         }//not empty container
       }//loop over station
 
        LogTrace(category_) << "deltaR around a track containing all the station hits, by station "
-       << theStationShowerDeltaR.at(0) << " "
-       << theStationShowerDeltaR.at(1) << " "
-       << theStationShowerDeltaR.at(2) << " "
-       << theStationShowerDeltaR.at(3) << endl;
+       << stationShowerDeltaR.at(0) << " "
+       << stationShowerDeltaR.at(1) << " "
+       << stationShowerDeltaR.at(2) << " "
+       << stationShowerDeltaR.at(3) << endl;
 
 
        LogTrace(category_) << "Transverse cluster size, by station "
-       << theStationShowerTSize.at(0) << " "
-       << theStationShowerTSize.at(1) << " "
-       << theStationShowerTSize.at(2) << " "
-       << theStationShowerTSize.at(3) << endl;
+       << stationShowerTSize.at(0) << " "
+       << stationShowerTSize.at(1) << " "
+       << stationShowerTSize.at(2) << " "
+       << stationShowerTSize.at(3) << endl;
 
   return;
 
@@ -0,0 +1,139 @@
+#include "RecoMuon/MuonIdentification/interface/MuonStationCrossings.h"
+#include "DataFormats/MuonDetId/interface/MuonSubdetId.h"
+#include <cmath>
+
+const double MuonStationCrossings::barrelRadius[MuonStationCrossings::nStations] = { 402., 490., 597., 700. };
+const double MuonStationCrossings::barrelHalfLength = 661.;
+const double MuonStationCrossings::endcapZ[MuonStationCrossings::nStations] = { 580., 790., 910., 1000. };
+const double MuonStationCrossings::endcapInnerRadius[MuonStationCrossings::nStations] = { 100., 140., 160., 180. };
+const double MuonStationCrossings::endcapOuterRadius = 700.;
+
+namespace {
+   // GeV/(T cm)
+   const double curvatureConstant = 0.299792458e-2;
+   // T, the solenoid and the return field of the barrel yoke
+   const double solenoidField = 3.8;
+   const double solenoidRadius = 295.;
+   const double solenoidHalfLength = 600.;
+   const double yokeField = -1.6;
+   const double yokeRadius = 745.;
+   const double yokeHalfLength = 661.;
+   // GeV/cm, below the minimum ionizing loss of the calorimeters
+   const double calorimeterEnergyLoss = 0.006;
+   // the tracks leaving this volume are done
+   const double worldRadius = 800.;
+   const double worldHalfLength = 1100.;
+
+   double fieldZ( double r, double absZ )
+   {
+      if ( r < solenoidRadius && absZ < solenoidHalfLength ) return solenoidField;
+      if ( r < yokeRadius && absZ < yokeHalfLength ) return yokeField;
+      return 0.;
+   }
+
+   // barrel (EB, HB) and endcap (EE, HE) calorimeters
+   double energyLoss( double r, double absZ )
+   {
+      if ( r > 129. && r < 285. && absZ < 290. ) return calorimeterEnergyLoss;
+      if ( absZ > 317. && absZ < 560. && r > 40. && r < 285. ) return calorimeterEnergyLoss;
+      return 0.;
+   }
+}
+
+MuonStationCrossings::Parameters::Parameters():
+  stepSize(5.), maxPathLength(3000.), margin(30.), minMomentum(0.2)
+{}
+
+MuonStationCrossings::Parameters::Parameters(const edm::ParameterSet& iConfig):
+  stepSize(iConfig.getParameter<double>("stepSize")),
+  maxPathLength(iConfig.getParameter<double>("maxPathLength")),
+  margin(iConfig.getParameter<double>("margin")),
+  minMomentum(iConfig.getParameter<double>("minMomentum"))
+{}
+
+unsigned int MuonStationCrossings::stationBit( int detector, int station )
+{
+   if ( station < 1 || station > int(nStations) ) return 0;
+   if ( detector == MuonSubdetId::DT ) return 1 << (station-1);
+   if ( detector == MuonSubdetId::CSC ) return 1 << (nStations+station-1);
+   return 0;
+}
+
+void MuonStationCrossings::propagate( const std::vector<const reco::Track*>& tracks )
+{
+   const unsigned int n = tracks.size();
+   x_.resize(n); y_.resize(n); z_.resize(n);
+   px_.resize(n); py_.resize(n); pz_.resize(n); p_.resize(n); charge_.resize(n);
+   active_.assign(n, 1);
+   maxR_.assign(n, 0.);
+   maxAbsZ_.assign(n, 0.);
+   stations_.assign(n, 0);
+   uncertain_.assign(n, 0);
+
+   for ( unsigned int i = 0; i < n; ++i ) {
+      const reco::Track& track = *tracks[i];
+      x_[i] = track.vx(); y_[i] = track.vy(); z_[i] = track.vz();
+      px_[i] = track.px(); py_[i] = track.py(); pz_[i] = track.pz();
+      p_[i] = track.p();
+      charge_[i] = track.charge();
+      if ( !(p_[i] > parameters_.minMomentum) ) active_[i] = 0;
+   }
+
+   const double ds = parameters_.stepSize;
+   const unsigned int nSteps = ds > 0 ? (unsigned int)(parameters_.maxPathLength/ds) : 0;
+   for ( unsigned int step = 0; step < nSteps; ++step ) {
+      bool moving = false;
+      for ( unsigned int i = 0; i < n; ++i ) {
+	 if ( ! active_[i] ) continue;
+	 moving = true;
+	 const double rBefore = sqrt(x_[i]*x_[i] + y_[i]*y_[i]);
+	 const double absZBefore = fabs(z_[i]);
+
+	 // helix step: half of the rotation of the transverse momentum, the
+	 // straight step, the other half, with the small angle expansion
+	 const double h = -0.5*charge_[i]*curvatureConstant*fieldZ(rBefore, absZBefore)*ds/p_[i];
+	 const double c = 1 - h*h/2;
+	 const double s = h - h*h*h/6;
+	 double px = c*px_[i] - s*py_[i];
+	 double py = s*px_[i] + c*py_[i];
+	 x_[i] += px/p_[i]*ds;
+	 y_[i] += py/p_[i]*ds;
+	 z_[i] += pz_[i]/p_[i]*ds;
+	 px_[i] = c*px - s*py;
+	 py_[i] = s*px + c*py;
+
+	 const double dE = energyLoss(rBefore, absZBefore)*ds;
+	 if ( dE > 0 ) {
+	    const double p = p_[i] - dE;
+	    const double scale = p > 0 ? p/p_[i] : 0;
+	    px_[i] *= scale; py_[i] *= scale; pz_[i] *= scale;
+	    p_[i] = p;
+	 }
+
+	 const double r = sqrt(x_[i]*x_[i] + y_[i]*y_[i]);
+	 const double absZ = fabs(z_[i]);
+	 for ( unsigned int station = 0; station < nStations; ++station ) {
+	    if ( (rBefore-barrelRadius[station])*(r-barrelRadius[station]) <= 0 && absZ < barrelHalfLength )
+	      stations_[i] |= stationBit(MuonSubdetId::DT, station+1);
+	    if ( (absZBefore-endcapZ[station])*(absZ-endcapZ[station]) <= 0 &&
+		 r > endcapInnerRadius[station] && r < endcapOuterRadius )
+	      stations_[i] |= stationBit(MuonSubdetId::CSC, station+1);
+	 }
+	 if ( r > maxR_[i] ) maxR_[i] = r;
+	 if ( absZ > maxAbsZ_[i] ) maxAbsZ_[i] = absZ;
+
+	 // ranged out or out of the detector
+	 if ( p_[i] < parameters_.minMomentum || r > worldRadius || absZ > worldHalfLength ) active_[i] = 0;
+      }
+      if ( ! moving ) break;
+   }
+
+   // the tracks without stations which got close to the first ones or are
+   // still on their way are left to the general propagator
+   for ( unsigned int i = 0; i < n; ++i ) {
+      if ( stations_[i] != 0 ) continue;
+      if ( active_[i] ||
+	   maxR_[i] > barrelRadius[0] - parameters_.margin ||
+	   maxAbsZ_[i] > endcapZ[0] - parameters_.margin ) uncertain_[i] = 1;
+   }
+}
@@ -0,0 +1,88 @@
+#include "RecoMuon/MuonIdentification/interface/MuonSystemOccupancy.h"
+#include "FWCore/Framework/interface/ESHandle.h"
+#include "FWCore/MessageLogger/interface/MessageLogger.h"
+#include "DataFormats/DTRecHit/interface/DTRecSegment4DCollection.h"
+#include "DataFormats/CSCRecHit/interface/CSCSegmentCollection.h"
+#include "Geometry/CommonDetUnit/interface/GlobalTrackingGeometry.h"
+#include "Geometry/CommonDetUnit/interface/GeomDet.h"
+#include "Geometry/Records/interface/GlobalTrackingGeometryRecord.h"
+#include <algorithm>
+#include <cmath>
+
+const double MuonSystemOccupancy::maxEta = 3.0;
+
+MuonSystemOccupancy::MuonSystemOccupancy():
+  etaRoad_(0.3), phiRoad_(0.2), phiRoadPt_(2.0), acceptAll_(true)
+{}
+
+MuonSystemOccupancy::MuonSystemOccupancy(const edm::ParameterSet& iConfig):
+  etaRoad_(iConfig.getParameter<double>("etaRoad")),
+  phiRoad_(iConfig.getParameter<double>("phiRoad")),
+  phiRoadPt_(iConfig.getParameter<double>("phiRoadPt")),
+  acceptAll_(true)
+{}
+
+int MuonSystemOccupancy::etaBin( double eta )
+{
+   int bin = int( floor( (eta+maxEta)/(2*maxEta)*nEtaBins ) );
+   return std::max(0, std::min(nEtaBins-1, bin));
+}
+
+int MuonSystemOccupancy::phiBin( double phi )
+{
+   int bin = int( floor( (phi+M_PI)/(2*M_PI)*nPhiBins ) ) % nPhiBins;
+   if ( bin < 0 ) bin += nPhiBins;
+   return bin;
+}
+
+void MuonSystemOccupancy::fill( const edm::Event& iEvent, const edm::EventSetup& iSetup,
+				const edm::InputTag& dtSegmentsLabel, const edm::InputTag& cscSegmentsLabel,
+				const edm::Handle<RPCRecHitCollection>& rpcHits )
+{
+   occupied_.assign(nEtaBins*nPhiBins, false);
+   acceptAll_ = true;
+
+   edm::Handle<DTRecSegment4DCollection> dtSegments;
+   iEvent.getByLabel(dtSegmentsLabel, dtSegments);
+   edm::Handle<CSCSegmentCollection> cscSegments;
+   iEvent.getByLabel(cscSegmentsLabel, cscSegments);
+   if ( ! dtSegments.isValid() || ! cscSegments.isValid() || ! rpcHits.isValid() ) {
+      LogTrace("MuonIdentification") << "Muon system collections are missing, the occupancy filter accepts all tracks";
+      return;
+   }
+   
+   edm::ESHandle<GlobalTrackingGeometry> geometry;
+   iSetup.get<GlobalTrackingGeometryRecord>().get(geometry);
+
+   for ( DTRecSegment4DCollection::const_iterator segment = dtSegments->begin(); segment != dtSegments->end(); ++segment ) {
+      GlobalPoint position = geometry->idToDet(segment->geographicalId())->toGlobal(segment->localPosition());
+      add( position.eta(), position.phi() );
+   }
+   for ( CSCSegmentCollection::const_iterator segment = cscSegments->begin(); segment != cscSegments->end(); ++segment ) {
+      GlobalPoint position = geometry->idToDet(segment->geographicalId())->toGlobal(segment->localPosition());
+      add( position.eta(), position.phi() );
+   }
+   for ( RPCRecHitCollection::const_iterator hit = rpcHits->begin(); hit != rpcHits->end(); ++hit ) {
+      GlobalPoint position = geometry->idToDet(hit->geographicalId())->toGlobal(hit->localPosition());
+      add( position.eta(), position.phi() );
+   }
+   acceptAll_ = false;
+}
+
+bool MuonSystemOccupancy::inRoad( const reco::Track& track ) const
+{
+   if ( acceptAll_ ) return true;
+   double dPhi = track.pt() > 0 ? phiRoadPt_/track.pt() + phiRoad_ : M_PI;
+   int firstEtaBin = etaBin( track.eta() - etaRoad_ );
+   int lastEtaBin  = etaBin( track.eta() + etaRoad_ );
+   int firstPhiBin = 0;
+   int nPhi = nPhiBins;
+   if ( dPhi < M_PI - 2*M_PI/nPhiBins ) {
+      firstPhiBin = phiBin( track.phi() - dPhi );
+      nPhi = ( phiBin( track.phi() + dPhi ) + nPhiBins - firstPhiBin ) % nPhiBins + 1;
+   }
+   for ( int eta = firstEtaBin; eta <= lastEtaBin; ++eta )
+     for ( int k = 0; k < nPhi; ++k )
+       if ( occupied_[eta*nPhiBins + (firstPhiBin+k)%nPhiBins] ) return true;
+   return false;
+}
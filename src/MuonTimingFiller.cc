@@ -36,7 +36,10 @@
 
 #include "RecoMuon/MuonIdentification/interface/MuonTimingFiller.h"
 #include "RecoMuon/MuonIdentification/interface/TimeMeasurementSequence.h"
+#include "RecoMuon/MuonIdentification/interface/TimeMeasurementFit.h"
 #include "DataFormats/EcalDetId/interface/EcalSubdetector.h"
+#include "DataFormats/DTRecHit/interface/DTRecSegment4DCollection.h"
+#include "DataFormats/CSCRecHit/interface/CSCSegmentCollection.h"
 
 //
 // constructors and destructor
@@ -58,6 +61,7 @@ MuonTimingFiller::MuonTimingFiller(const edm::ParameterSet& iConfig)
    useDT_ = iConfig.getParameter<bool>("UseDT");
    useCSC_ = iConfig.getParameter<bool>("UseCSC");
    useECAL_ = iConfig.getParameter<bool>("UseECAL");
+  useSegmentsFromMatches_ = iConfig.existsAs<bool>("UseSegmentsFromMatches") ? iConfig.getParameter<bool>("UseSegmentsFromMatches") : false;
    
 }
 
@@ -73,19 +77,56 @@ MuonTimingFiller::~MuonTimingFiller()
 // member functions
 //
 
+void 
+MuonTimingFiller::beginEvent( const edm::Event& iEvent, const edm::EventSetup& iSetup )
+{
+  theDTTimingExtractor_->beginEvent(iEvent, iSetup);
+  theCSCTimingExtractor_->beginEvent(iEvent, iSetup);
+}
+
+void 
+MuonTimingFiller::fillTiming( const reco::MuonCollection& muons, 
+                              std::vector<reco::MuonTimeExtra>& dtTimes, 
+                              std::vector<reco::MuonTimeExtra>& cscTimes, 
+                              std::vector<reco::MuonTimeExtra>& combinedTimes, 
+                              edm::Event& iEvent, const edm::EventSetup& iSetup )
+{
+  dtTimes.assign(muons.size(), reco::MuonTimeExtra());
+  cscTimes.assign(muons.size(), reco::MuonTimeExtra());
+  combinedTimes.assign(muons.size(), reco::MuonTimeExtra());
+  if (muons.empty()) return;
+
+  beginEvent(iEvent, iSetup);
+  for (unsigned int i=0; i<muons.size(); ++i)
+    fillTiming(muons[i], dtTimes[i], cscTimes[i], combinedTimes[i], iEvent, iSetup);
+}
+
 void 
 MuonTimingFiller::fillTiming( const reco::Muon& muon, reco::MuonTimeExtra& dtTime, reco::MuonTimeExtra& cscTime, reco::MuonTimeExtra& combinedTime, edm::Event& iEvent, const edm::EventSetup& iSetup )
 {
-  TimeMeasurementSequence dtTmSeq,cscTmSeq;
+  // the sequences are members to reuse their storage across muons
+  TimeMeasurementSequence& dtTmSeq = dtTmSeq_;
+  TimeMeasurementSequence& cscTmSeq = cscTmSeq_;
+  dtTmSeq.clear();
+  cscTmSeq.clear();
      
-  if ( !(muon.combinedMuon().isNull()) ) {
-    theDTTimingExtractor_->fillTiming(dtTmSeq, muon.combinedMuon(), iEvent, iSetup);
-    theCSCTimingExtractor_->fillTiming(cscTmSeq, muon.combinedMuon(), iEvent, iSetup);
-  } else
-    if ( !(muon.standAloneMuon().isNull()) ) {
-      theDTTimingExtractor_->fillTiming(dtTmSeq, muon.standAloneMuon(), iEvent, iSetup);
-      theCSCTimingExtractor_->fillTiming(cscTmSeq, muon.standAloneMuon(), iEvent, iSetup);
+  reco::TrackRef muonTrack;
+  if ( !(muon.combinedMuon().isNull()) ) muonTrack = muon.combinedMuon();
+  else if ( !(muon.standAloneMuon().isNull()) ) muonTrack = muon.standAloneMuon();
+
+  if ( muonTrack.isNonnull() ) {
+    if ( useSegmentsFromMatches_ && muon.isMatchesValid() ) {
+      // take the segments already associated to the muon instead of matching them again,
+      // the extractors only fetch the setup again if it changed since beginEvent
+      beginEvent(iEvent, iSetup);
+      matchedSegments(muon, dtSegments_, cscSegments_);
+      theDTTimingExtractor_->fillTiming(dtTmSeq, muonTrack, dtSegments_);
+      theCSCTimingExtractor_->fillTiming(cscTmSeq, muonTrack, cscSegments_);
+    } else {
+      theDTTimingExtractor_->fillTiming(dtTmSeq, muonTrack, iEvent, iSetup);
+      theCSCTimingExtractor_->fillTiming(cscTmSeq, muonTrack, iEvent, iSetup);
     }
+  }
   
   // Fill DT-specific timing information block     
   fillTimeFromMeasurements(dtTmSeq, dtTime);
@@ -94,7 +135,8 @@ MuonTimingFiller::fillTiming( const reco::Muon& muon, reco::MuonTimeExtra& dtTim
   fillTimeFromMeasurements(cscTmSeq, cscTime);
        
   // Combine the TimeMeasurementSequences from all subdetectors
-  TimeMeasurementSequence combinedTmSeq;
+  TimeMeasurementSequence& combinedTmSeq = combinedTmSeq_;
+  combinedTmSeq.clear();
   combineTMSequences(muon,dtTmSeq,cscTmSeq,combinedTmSeq);
   // add ECAL info
   if (useECAL_) addEcalTime(muon,combinedTmSeq);
@@ -112,10 +154,43 @@ MuonTimingFiller::fillTiming( const reco::Muon& muon, reco::MuonTimeExtra& dtTim
 }
 
 
+void 
+MuonTimingFiller::matchedSegments( const reco::Muon& muon, 
+                                   std::vector<const DTRecSegment4D*>& dtSegments, 
+                                   std::vector<const CSCSegment*>& cscSegments ) {
+
+  dtSegments.clear();
+  cscSegments.clear();
+  for ( std::vector<reco::MuonChamberMatch>::const_iterator chamber = muon.matches().begin();
+        chamber != muon.matches().end(); ++chamber ) {
+    // the best segment in the chamber by dR, by dX if one has no y measurement
+    const reco::MuonSegmentMatch* best = 0;
+    for ( std::vector<reco::MuonSegmentMatch>::const_iterator segment = chamber->segmentMatches.begin();
+          segment != chamber->segmentMatches.end(); ++segment ) {
+      if ( segment->dtSegmentRef.isNull() && segment->cscSegmentRef.isNull() ) continue;
+      if ( ! best ) { 
+        best = &*segment;
+        continue;
+      }
+      double dx = fabs(segment->x-chamber->x);
+      double bestDx = fabs(best->x-chamber->x);
+      bool closer;
+      if ( (! segment->hasZed()) || (! best->hasZed()) ) closer = dx < bestDx;
+      else closer = sqrt(dx*dx+pow(segment->y-chamber->y,2)) < sqrt(bestDx*bestDx+pow(best->y-chamber->y,2));
+      if ( closer ) best = &*segment;
+    }
+    if ( ! best ) continue;
+    if ( best->dtSegmentRef.isNonnull() ) dtSegments.push_back( best->dtSegmentRef.get() );
+    if ( best->cscSegmentRef.isNonnull() ) cscSegments.push_back( best->cscSegmentRef.get() );
+  }
+}
+
+
 void 
 MuonTimingFiller::fillTimeFromMeasurements( const TimeMeasurementSequence& tmSeq, reco::MuonTimeExtra &muTime ) {
 
-  std::vector <double> x,y;
+  // straight line fit of the hit times for the free 1/beta
+  LinearFitSums freeFit;
   double invbeta=0, invbetaerr=0;
   double vertexTime=0, vertexTimeErr=0, vertexTimeR=0, vertexTimeRErr=0;    
   double freeBeta, freeBetaErr, freeTime, freeTimeErr;
@@ -124,8 +199,7 @@ MuonTimingFiller::fillTimeFromMeasurements( const TimeMeasurementSequence& tmSeq
 
   for (unsigned int i=0;i<tmSeq.dstnc.size();i++) {
     invbeta+=(1.+tmSeq.local_t0.at(i)/tmSeq.dstnc.at(i)*30.)*tmSeq.weightInvbeta.at(i)/tmSeq.totalWeightInvbeta;
-    x.push_back(tmSeq.dstnc.at(i)/30.);
-    y.push_back(tmSeq.local_t0.at(i)+tmSeq.dstnc.at(i)/30.);
+    freeFit.add(tmSeq.dstnc.at(i)/30., tmSeq.local_t0.at(i)+tmSeq.dstnc.at(i)/30.);
     vertexTime+=tmSeq.local_t0.at(i)*tmSeq.weightVertex.at(i)/tmSeq.totalWeightVertex;
     vertexTimeR+=(tmSeq.local_t0.at(i)+2*tmSeq.dstnc.at(i)/30.)*tmSeq.weightVertex.at(i)/tmSeq.totalWeightVertex;
   }
@@ -152,7 +226,7 @@ MuonTimingFiller::fillTimeFromMeasurements( const TimeMeasurementSequence& tmSeq
   muTime.setTimeAtIpOutIn(vertexTimeR);
   muTime.setTimeAtIpOutInErr(vertexTimeRErr);
       
-  rawFit(freeBeta, freeBetaErr, freeTime, freeTimeErr, x, y);
+  freeFit.fit(freeBeta, freeBetaErr, freeTime, freeTimeErr);
 
   muTime.setFreeInverseBeta(freeBeta);
   muTime.setFreeInverseBetaErr(freeBetaErr);
@@ -167,20 +241,14 @@ MuonTimingFiller::combineTMSequences( const reco::Muon& muon,
                                       TimeMeasurementSequence &cmbSeq ) {
                                         
   if (useDT_) for (unsigned int i=0;i<dtSeq.dstnc.size();i++) {
-    cmbSeq.dstnc.push_back(dtSeq.dstnc.at(i));
-    cmbSeq.local_t0.push_back(dtSeq.local_t0.at(i));
-    cmbSeq.weightVertex.push_back(dtSeq.weightVertex.at(i));
-    cmbSeq.weightInvbeta.push_back(dtSeq.weightInvbeta.at(i));
+    cmbSeq.push_back(dtSeq.dstnc.at(i),dtSeq.local_t0.at(i),dtSeq.weightVertex.at(i),dtSeq.weightInvbeta.at(i));
 
     cmbSeq.totalWeightVertex+=dtSeq.weightVertex.at(i);
     cmbSeq.totalWeightInvbeta+=dtSeq.weightInvbeta.at(i);
   }
 
   if (useCSC_) for (unsigned int i=0;i<cscSeq.dstnc.size();i++) {
-    cmbSeq.dstnc.push_back(cscSeq.dstnc.at(i));
-    cmbSeq.local_t0.push_back(cscSeq.local_t0.at(i));
-    cmbSeq.weightVertex.push_back(cscSeq.weightVertex.at(i));
-    cmbSeq.weightInvbeta.push_back(cscSeq.weightInvbeta.at(i));
+    cmbSeq.push_back(cscSeq.dstnc.at(i),cscSeq.local_t0.at(i),cscSeq.weightVertex.at(i),cscSeq.weightInvbeta.at(i));
 
     cmbSeq.totalWeightVertex+=cscSeq.weightVertex.at(i);
     cmbSeq.totalWeightInvbeta+=cscSeq.weightInvbeta.at(i);
@@ -207,11 +275,7 @@ MuonTimingFiller::addEcalTime( const reco::Muon& muon,
   double hitWeight = 1/(emErr*emErr);
   double hitDist=muonE.ecal_position.r();
         
-  cmbSeq.local_t0.push_back(muonE.ecal_time);
-  cmbSeq.weightVertex.push_back(hitWeight);
-  cmbSeq.weightInvbeta.push_back(hitDist*hitDist*hitWeight/(30.*30.));
-
-  cmbSeq.dstnc.push_back(hitDist);
+  cmbSeq.push_back(hitDist, muonE.ecal_time, hitWeight, hitDist*hitDist*hitWeight/(30.*30.));
   
   cmbSeq.totalWeightVertex+=hitWeight;
   cmbSeq.totalWeightInvbeta+=hitDist*hitDist*hitWeight/(30.*30.);
@@ -219,33 +283,3 @@ MuonTimingFiller::addEcalTime( const reco::Muon& muon,
 }
 
 
-
-void 
-MuonTimingFiller::rawFit(double &a, double &da, double &b, double &db, const std::vector<double>& hitsx, const std::vector<double>& hitsy) {
-
-  double s=0,sx=0,sy=0,x,y;
-  double sxx=0,sxy=0;
-
-  a=b=0;
-  if (hitsx.size()==0) return;
-  if (hitsx.size()==1) {
-    b=hitsy[0];
-  } else {
-    for (unsigned int i = 0; i != hitsx.size(); i++) {
-      x=hitsx[i];
-      y=hitsy[i];
-      sy += y;
-      sxy+= x*y;
-      s += 1.;
-      sx += x;
-      sxx += x*x;
-    }
-
-    double d = s*sxx - sx*sx;
-    b = (sxx*sy- sx*sxy)/ d;
-    a = (s*sxy - sx*sy) / d;
-    da = sqrt(sxx/d);
-    db = sqrt(s/d);
-  }
-}
-
@@ -0,0 +1,36 @@
+/** \class MuonCaloTemplateConverter
+ *  Writes the calo compatibility templates of the ROOT files into the
+ *  binary format that MuonCaloCompatibility maps with BinaryTemplateFileName.
+ *  The conversion is done at the beginning of the job, no event is needed.
+ */
+
+#include <string>
+
+#include "FWCore/Framework/interface/Frameworkfwd.h"
+#include "FWCore/Framework/interface/EDAnalyzer.h"
+#include "FWCore/Framework/interface/MakerMacros.h"
+#include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "FWCore/MessageLogger/interface/MessageLogger.h"
+
+#include "RecoMuon/MuonIdentification/interface/MuonCaloCompatibility.h"
+
+class MuonCaloTemplateConverter : public edm::EDAnalyzer {
+ public:
+   explicit MuonCaloTemplateConverter(const edm::ParameterSet& iConfig):
+     templates_(iConfig.getParameter<edm::ParameterSet>("MuonCaloCompatibility")),
+     outputFileName_(iConfig.getParameter<std::string>("outputFileName")) {}
+   virtual ~MuonCaloTemplateConverter() {}
+
+   virtual void beginJob() {
+      MuonCaloCompatibility::writeBinaryTemplates(templates_, outputFileName_);
+      edm::LogInfo("MuonCaloTemplateConverter") << "calo compatibility templates written to " << outputFileName_;
+   }
+   virtual void analyze(const edm::Event&, const edm::EventSetup&) {}
+
+ private:
+   edm::ParameterSet templates_;
+   std::string outputFileName_;
+};
+
+//define this as a plug-in
+DEFINE_FWK_MODULE(MuonCaloTemplateConverter);
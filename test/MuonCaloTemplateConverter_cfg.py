@@ -0,0 +1,18 @@
+import FWCore.ParameterSet.Config as cms
+process = cms.Process("CONVERT")
+
+from RecoMuon.MuonIdentification.caloCompatibility_cff import MuonCaloCompatibilityBlock
+
+process.maxEvents = cms.untracked.PSet(
+    input = cms.untracked.int32(1)
+)
+process.source = cms.Source("EmptySource")
+
+# writes the templates given in the ROOT files, the output can be used as
+# MuonCaloCompatibility.BinaryTemplateFileName
+process.muonCaloTemplateConverter = cms.EDAnalyzer("MuonCaloTemplateConverter",
+    MuonCaloCompatibilityBlock,
+    outputFileName = cms.string('MuID_templates_lowPt_3_1_norm.bin')
+)
+
+process.p = cms.Path(process.muonCaloTemplateConverter)
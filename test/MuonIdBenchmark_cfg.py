@@ -0,0 +1,89 @@
+import FWCore.ParameterSet.Config as cms
+import FWCore.ParameterSet.VarParsing as VarParsing
+
+# Throughput benchmark of the muon identification producers on RECO input.
+# Run with the job report, the summary is made by muonIdBenchmarkSummary.py:
+#
+#   cmsRun -j bench_pileup.xml MuonIdBenchmark_cfg.py sample=pileup \
+#          inputFiles=file:reference_pileup.root >& bench_pileup.log
+#   python muonIdBenchmarkSummary.py bench_pileup.log bench_pileup.xml
+#
+# The samples are the fixed reference files of each release comparison:
+# high pileup collisions, cosmics in collision reconstruction and heavy ions.
+
+options = VarParsing.VarParsing('analysis')
+options.register('sample', 'pileup', VarParsing.VarParsing.multiplicity.singleton,
+                 VarParsing.VarParsing.varType.string, "pileup, cosmics or heavyIon")
+options.register('globalTag', 'START62_V1::All', VarParsing.VarParsing.multiplicity.singleton,
+                 VarParsing.VarParsing.varType.string, "global tag of the sample")
+options.maxEvents = 500
+options.parseArguments()
+
+if options.sample not in ('pileup', 'cosmics', 'heavyIon'):
+    raise ValueError("unknown benchmark sample " + options.sample)
+
+process = cms.Process("MUONIDBENCH")
+
+process.load("Configuration.StandardSequences.MagneticField_cff")
+process.load("Configuration.StandardSequences.Geometry_cff")
+process.load("Configuration.StandardSequences.FrontierConditions_GlobalTag_cff")
+process.load("Configuration.StandardSequences.Reconstruction_cff")
+process.GlobalTag.globaltag = options.globalTag
+
+process.maxEvents = cms.untracked.PSet(
+    input = cms.untracked.int32(options.maxEvents)
+)
+
+process.source = cms.Source("PoolSource",
+    fileNames = cms.untracked.vstring(options.inputFiles)
+)
+
+# per-module time report, job timing and peak memory in the job report
+process.options = cms.untracked.PSet(
+    wantSummary = cms.untracked.bool(True)
+)
+process.Timing = cms.Service("Timing",
+    summaryOnly = cms.untracked.bool(True)
+)
+process.SimpleMemoryCheck = cms.Service("SimpleMemoryCheck",
+    ignoreTotal = cms.untracked.int32(1)
+)
+process.load("FWCore.MessageService.MessageLogger_cfi")
+process.MessageLogger.cerr.FwkReport.reportEvery = 100
+
+# the producers under test
+process.load("RecoMuon.MuonIdentification.muonIdProducerSequence_cff")
+process.muons1stStep.reportStageTiming = True
+
+import RecoMuon.MuonIdentification.cosmics_id
+# the partner search in the collision tracks only, the cosmic veto tracking
+# is not part of the muon identification
+process.cosmicsVeto = RecoMuon.MuonIdentification.cosmics_id.cosmicsVeto.clone(
+    trackCollections = cms.VInputTag(cms.InputTag("generalTracks"))
+)
+
+import RecoMuon.MuonIdentification.muons_cfi
+process.muons = RecoMuon.MuonIdentification.muons_cfi.muons.clone(
+    PFCandidates = cms.InputTag("particleFlow"),
+    EcalIsoDeposits  = cms.InputTag("muons1stStep","ecal"),
+    HcalIsoDeposits  = cms.InputTag("muons1stStep","hcal"),
+    HoIsoDeposits    = cms.InputTag("muons1stStep","ho"),
+    TrackIsoDeposits = cms.InputTag("muons1stStep","tracker"),
+    JetIsoDeposits   = cms.InputTag("muons1stStep","jets"),
+    # the PF isolation and the selectors are produced outside this package
+    FillPFIsolation = cms.bool(False),
+    FillSelectorMaps = cms.bool(False)
+)
+
+if options.sample == 'heavyIon':
+    # heavy ion tracking, there is no particle flow
+    process.muons1stStep.inputCollectionLabels[0] = cms.InputTag("hiGeneralTracks")
+    process.muons1stStep.TrackExtractorPSet.inputTrackCollection = cms.InputTag("hiGeneralTracks")
+    process.muonShowerInformation.trackCollection = cms.InputTag("hiGeneralTracks")
+    process.cosmicsVeto.trackCollections = cms.VInputTag(cms.InputTag("hiGeneralTracks"))
+    process.muons.FillPFMomentumAndAssociation = False
+
+process.p = cms.Path(process.muonIdProducerSequence*
+                     process.muontiming*
+                     process.cosmicsVeto*
+                     process.muons)
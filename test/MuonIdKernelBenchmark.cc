@@ -0,0 +1,163 @@
+/** \class MuonIdKernelBenchmark
+ *  Analyzer timing the algorithms of the muon identification on recorded
+ *  muons. Each kernel is run nRepeat times on the muons of the event, the
+ *  cpu and real time per call are printed at the end of the job. The
+ *  arbitration of MuonIdProducer is covered by its reportStageTiming option.
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "FWCore/Framework/interface/Frameworkfwd.h"
+#include "FWCore/Framework/interface/EDAnalyzer.h"
+#include "FWCore/Framework/interface/Event.h"
+#include "FWCore/Framework/interface/EventSetup.h"
+#include "FWCore/Framework/interface/ESHandle.h"
+#include "FWCore/Framework/interface/MakerMacros.h"
+#include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "FWCore/Utilities/interface/CPUTimer.h"
+#include "DataFormats/Common/interface/Handle.h"
+
+#include "DataFormats/MuonReco/interface/Muon.h"
+#include "DataFormats/MuonReco/interface/MuonFwd.h"
+#include "DataFormats/MuonReco/interface/MuonQuality.h"
+#include "DataFormats/MuonReco/interface/MuonTimeExtra.h"
+#include "DataFormats/TrackReco/interface/Track.h"
+
+#include "Geometry/CSCGeometry/interface/CSCGeometry.h"
+#include "Geometry/Records/interface/MuonGeometryRecord.h"
+
+#include "RecoMuon/MuonIdentification/interface/MuonCaloCompatibility.h"
+#include "RecoMuon/MuonIdentification/interface/MuonHOAcceptance.h"
+#include "RecoMuon/MuonIdentification/interface/MuonKinkFinder.h"
+#include "RecoMuon/MuonIdentification/interface/MuonMesh.h"
+#include "RecoMuon/MuonIdentification/interface/MuonTimingFiller.h"
+
+class MuonIdKernelBenchmark : public edm::EDAnalyzer {
+ public:
+   explicit MuonIdKernelBenchmark(const edm::ParameterSet&);
+   virtual ~MuonIdKernelBenchmark() {}
+
+   virtual void analyze(const edm::Event&, const edm::EventSetup&);
+   virtual void endJob();
+
+ private:
+   enum Kernel { CaloCompatibility, Mesh, Timing, HOAcceptance, TrackerKink, NumberOfKernels };
+   static const char* name(Kernel);
+
+   edm::InputTag inputMuons_;
+   unsigned int nRepeat_;
+
+   MuonCaloCompatibility caloCompatibility_;
+   std::auto_ptr<MuonMesh> mesh_;
+   std::auto_ptr<MuonTimingFiller> timingFiller_;
+   std::auto_ptr<MuonKinkFinder> kinkFinder_;
+
+   // the timers are not copyable
+   edm::CPUTimer timers_[NumberOfKernels];
+   unsigned long long calls_[NumberOfKernels];
+   // keeps the results of the HO queries used
+   unsigned long long nHOAccepted_;
+};
+
+MuonIdKernelBenchmark::MuonIdKernelBenchmark(const edm::ParameterSet& iConfig):
+  inputMuons_(iConfig.getParameter<edm::InputTag>("inputMuons")),
+  nRepeat_(iConfig.getParameter<unsigned int>("nRepeat")),
+  mesh_(new MuonMesh(iConfig.getParameter<edm::ParameterSet>("arbitrationCleanerOptions"))),
+  timingFiller_(new MuonTimingFiller(iConfig.getParameter<edm::ParameterSet>("TimingFillerParameters"))),
+  kinkFinder_(new MuonKinkFinder(iConfig.getParameter<edm::ParameterSet>("TrackerKinkFinderParameters")))
+{
+   caloCompatibility_.configure(iConfig.getParameter<edm::ParameterSet>("MuonCaloCompatibility"));
+   for ( unsigned int i = 0; i < NumberOfKernels; ++i ) calls_[i] = 0;
+   nHOAccepted_ = 0;
+}
+
+void MuonIdKernelBenchmark::analyze(const edm::Event& iEvent, const edm::EventSetup& iSetup)
+{
+   edm::Handle<reco::MuonCollection> muons;
+   iEvent.getByLabel(inputMuons_, muons);
+   if ( muons->empty() ) return;
+
+   // the timing filler needs a non-const event, it only reads from it
+   edm::Event& event = const_cast<edm::Event&>(iEvent);
+
+   edm::ESHandle<CSCGeometry> cscGeometry;
+   iSetup.get<MuonGeometryRecord>().get(cscGeometry);
+   mesh_->setCSCGeometry(cscGeometry.product());
+   kinkFinder_->init(iSetup);
+   MuonHOAcceptanceMap hoAcceptance(iSetup);
+
+   std::vector<MuonCaloCompatibility::Input> caloInputs;
+   for ( reco::MuonCollection::const_iterator muon = muons->begin(); muon != muons->end(); ++muon )
+     caloInputs.push_back( MuonCaloCompatibility::input(*muon) );
+   std::vector<double> caloCompatibilities;
+
+   for ( unsigned int i = 0; i < nRepeat_; ++i ) {
+      timers_[CaloCompatibility].start();
+      caloCompatibility_.evaluate( caloInputs, caloCompatibilities );
+      timers_[CaloCompatibility].stop();
+      ++calls_[CaloCompatibility];
+
+      // the mesh modifies the muons, so it runs on a fresh copy each time
+      reco::MuonCollection meshMuons(*muons);
+      timers_[Mesh].start();
+      mesh_->clearMesh();
+      mesh_->runMesh(&meshMuons);
+      timers_[Mesh].stop();
+      ++calls_[Mesh];
+
+      std::vector<reco::MuonTimeExtra> dtTimes, cscTimes, combinedTimes;
+      timers_[Timing].start();
+      timingFiller_->fillTiming(*muons, dtTimes, cscTimes, combinedTimes, event, iSetup);
+      timers_[Timing].stop();
+      ++calls_[Timing];
+
+      unsigned int nAccepted = 0;
+      timers_[HOAcceptance].start();
+      for ( reco::MuonCollection::const_iterator muon = muons->begin(); muon != muons->end(); ++muon )
+	if ( hoAcceptance.inNotDeadGeom(muon->eta(), muon->phi(), 0.04, 0.04) ) ++nAccepted;
+      timers_[HOAcceptance].stop();
+      ++calls_[HOAcceptance];
+      nHOAccepted_ += nAccepted;
+
+      timers_[TrackerKink].start();
+      for ( reco::MuonCollection::const_iterator muon = muons->begin(); muon != muons->end(); ++muon ) {
+	 if ( muon->innerTrack().isNull() ) continue;
+	 reco::MuonQuality quality;
+	 kinkFinder_->fillTrkKink(quality, *muon->innerTrack());
+      }
+      timers_[TrackerKink].stop();
+      ++calls_[TrackerKink];
+   }
+}
+
+void MuonIdKernelBenchmark::endJob()
+{
+   std::cout << "Time per call of the kernels, " << nRepeat_ << " calls per event (cpu/real in ms, calls):" << std::endl;
+   for ( unsigned int i = 0; i < NumberOfKernels; ++i ) {
+      double n = calls_[i] > 0 ? calls_[i] : 1;
+      std::cout << "  " << std::setw(20) << std::left << name(Kernel(i)) << std::right
+		<< " " << std::setw(12) << 1000.*timers_[i].cpuTime()/n
+		<< " " << std::setw(12) << 1000.*timers_[i].realTime()/n
+		<< " " << std::setw(10) << calls_[i] << std::endl;
+   }
+   std::cout << "  muons in the HO acceptance: " << nHOAccepted_ << std::endl;
+}
+
+const char* MuonIdKernelBenchmark::name(Kernel kernel)
+{
+   switch ( kernel ) {
+    case CaloCompatibility: return "calo compatibility";
+    case Mesh:              return "muon mesh";
+    case Timing:            return "timing fits";
+    case HOAcceptance:      return "HO acceptance";
+    case TrackerKink:       return "tracker kink";
+    default:                return "unknown";
+   }
+}
+
+//define this as a plug-in
+DEFINE_FWK_MODULE(MuonIdKernelBenchmark);
@@ -0,0 +1,43 @@
+import FWCore.ParameterSet.Config as cms
+import FWCore.ParameterSet.VarParsing as VarParsing
+
+# Time per call of the muon identification kernels on a RECO file with the
+# muons and the muon segments and rechits:
+#
+#   cmsRun MuonIdKernelBenchmark_cfg.py inputFiles=file:reco.root globalTag=START62_V1::All
+
+options = VarParsing.VarParsing('analysis')
+options.register('globalTag', 'START62_V1::All', VarParsing.VarParsing.multiplicity.singleton,
+                 VarParsing.VarParsing.varType.string, "global tag of the input file")
+options.maxEvents = 100
+options.parseArguments()
+
+process = cms.Process("BENCH")
+
+process.load("Configuration.StandardSequences.MagneticField_cff")
+process.load("Configuration.StandardSequences.Geometry_cff")
+process.load("Configuration.StandardSequences.FrontierConditions_GlobalTag_cff")
+process.load("Configuration.StandardSequences.Reconstruction_cff")
+process.GlobalTag.globaltag = options.globalTag
+
+process.maxEvents = cms.untracked.PSet(
+    input = cms.untracked.int32(options.maxEvents)
+)
+
+process.source = cms.Source("PoolSource",
+    fileNames = cms.untracked.vstring(options.inputFiles)
+)
+
+process.muonIdKernelBenchmark = cms.EDAnalyzer("MuonIdKernelBenchmark",
+    inputMuons = cms.InputTag("muons"),
+    nRepeat = cms.uint32(10),
+    MuonCaloCompatibility = process.muons1stStep.MuonCaloCompatibility,
+    TimingFillerParameters = process.muons1stStep.TimingFillerParameters,
+    TrackerKinkFinderParameters = process.muons1stStep.TrackerKinkFinderParameters,
+    arbitrationCleanerOptions = process.muons1stStep.arbitrationCleanerOptions
+)
+
+# time the stages of the producer on the same events
+process.muons1stStep.reportStageTiming = True
+
+process.p = cms.Path(process.muonIdKernelBenchmark*process.muons1stStep)
@@ -86,6 +86,7 @@ MuonTimingValidator::MuonTimingValidator(const edm::ParameterSet& iConfig)
   TKtrackTags_(iConfig.getUntrackedParameter<edm::InputTag>("TKtracks")),
   MuonTags_(iConfig.getUntrackedParameter<edm::InputTag>("Muons")),
   TimeTags_(iConfig.getUntrackedParameter<edm::InputTag>("Timing")),
+  FastTimeTags_(iConfig.getUntrackedParameter<edm::InputTag>("FastTiming",edm::InputTag())),
   out(iConfig.getParameter<std::string>("out")),
   open(iConfig.getParameter<std::string>("open")),
   theMinEta(iConfig.getParameter<double>("etaMin")),
@@ -141,6 +142,14 @@ MuonTimingValidator::analyze(const edm::Event& iEvent, const edm::EventSetup& iS
   iEvent.getByLabel(TimeTags_.label(),"csc",timeMap3);
   const reco::MuonTimeExtraMap & timeMapCSC = *timeMap3;
 
+  // optional timing of the same muons with the fast distance mode
+  bool compareFast = FastTimeTags_.label().size();
+  if (compareFast) {
+    iEvent.getByLabel(FastTimeTags_.label(),"combined",fastTimeMap1);
+    iEvent.getByLabel(FastTimeTags_.label(),"dt",fastTimeMap2);
+    iEvent.getByLabel(FastTimeTags_.label(),"csc",fastTimeMap3);
+  }
+
   edm::ESHandle<GlobalTrackingGeometry> theTrackingGeometry;
   iSetup.get<GlobalTrackingGeometryRecord>().get(theTrackingGeometry);
 
@@ -235,6 +244,28 @@ MuonTimingValidator::analyze(const edm::Event& iEvent, const edm::EventSetup& iS
     reco::MuonTimeExtra timedt = timeMapDT[muonR];
     reco::MuonTimeExtra timecsc = timeMapCSC[muonR];
 
+    if (compareFast) {
+      reco::MuonTimeExtra fastc = (*fastTimeMap1)[muonR];
+      reco::MuonTimeExtra fastdt = (*fastTimeMap2)[muonR];
+      reco::MuonTimeExtra fastcsc = (*fastTimeMap3)[muonR];
+
+      hi_fast_cmb_ndof->Fill(fastc.nDof()-timec.nDof());
+      hi_fast_dt_ndof->Fill(fastdt.nDof()-timedt.nDof());
+      hi_fast_csc_ndof->Fill(fastcsc.nDof()-timecsc.nDof());
+      if (timec.nDof()>0 && fastc.nDof()>0) {
+        hi_fast_cmb_ibt->Fill(fastc.inverseBeta()-timec.inverseBeta());
+        hi_fast_cmb_vtx->Fill(fastc.timeAtIpInOut()-timec.timeAtIpInOut());
+      }
+      if (timedt.nDof()>theDtCut && fastdt.nDof()>theDtCut) {
+        hi_fast_dt_ibt->Fill(fastdt.inverseBeta()-timedt.inverseBeta());
+        hi_fast_dt_vtx->Fill(fastdt.timeAtIpInOut()-timedt.timeAtIpInOut());
+      }
+      if (timecsc.nDof()>theCscCut && fastcsc.nDof()>theCscCut) {
+        hi_fast_csc_ibt->Fill(fastcsc.inverseBeta()-timecsc.inverseBeta());
+        hi_fast_csc_vtx->Fill(fastcsc.timeAtIpInOut()-timecsc.timeAtIpInOut());
+      }
+    }
+
     hi_cmbtime_ndof->Fill(timec.nDof());
     hi_dttime_ndof->Fill(timedt.nDof());
     hi_csctime_ndof->Fill(timecsc.nDof());
@@ -438,6 +469,16 @@ MuonTimingValidator::beginJob()
    hi_hcal_time_ecut = new TH1F("hi_hcal_time_ecut","HCAL Time at Vertex (inout) after energy cut",theNBins,-20.*theScale,20.*theScale);
    hi_hcal_energy = new TH1F("hi_hcal_energy","HCAL max energy in 5x5 crystals",theNBins,.0,5.0);
 
+   hi_fast_cmb_ibt = new TH1F("hi_fast_cmb_ibt","Inverse Beta (straight-line minus propagated flight distance)",theNBins,-0.05,0.05);
+   hi_fast_cmb_vtx = new TH1F("hi_fast_cmb_vtx","Time at Vertex (straight-line minus propagated flight distance)",theNBins,-1.,1.);
+   hi_fast_cmb_ndof = new TH1F("hi_fast_cmb_ndof","Number of timing measurements (straight-line minus propagated flight distance)",21,-10.5,10.5);
+   hi_fast_dt_ibt = new TH1F("hi_fast_dt_ibt","DT Inverse Beta (straight-line minus propagated flight distance)",theNBins,-0.05,0.05);
+   hi_fast_dt_vtx = new TH1F("hi_fast_dt_vtx","DT Time at Vertex (straight-line minus propagated flight distance)",theNBins,-1.,1.);
+   hi_fast_dt_ndof = new TH1F("hi_fast_dt_ndof","Number of DT timing measurements (straight-line minus propagated flight distance)",21,-10.5,10.5);
+   hi_fast_csc_ibt = new TH1F("hi_fast_csc_ibt","CSC Inverse Beta (straight-line minus propagated flight distance)",theNBins,-0.05,0.05);
+   hi_fast_csc_vtx = new TH1F("hi_fast_csc_vtx","CSC Time at Vertex (straight-line minus propagated flight distance)",theNBins,-1.,1.);
+   hi_fast_csc_ndof = new TH1F("hi_fast_csc_ndof","Number of CSC timing measurements (straight-line minus propagated flight distance)",21,-10.5,10.5);
+
    hi_sta_eta = new TH1F("hi_sta_eta","#eta^{STA}",theNBins/2,theMinEta,theMaxEta);
    hi_tk_eta  = new TH1F("hi_tk_eta","#eta^{TK}",theNBins/2,theMinEta,theMaxEta);
    hi_glb_eta = new TH1F("hi_glb_eta","#eta^{GLB}",theNBins/2,theMinEta,theMaxEta);
@@ -555,6 +596,22 @@ MuonTimingValidator::endJob() {
   hi_hcal_time_pull->Write();
   hi_hcal_energy->Write();
 
+  if (FastTimeTags_.label().size()) {
+    hFile->cd();
+    hFile->mkdir("fast");
+    hFile->cd("fast");
+
+    hi_fast_cmb_ibt->Write();
+    hi_fast_cmb_vtx->Write();
+    hi_fast_cmb_ndof->Write();
+    hi_fast_dt_ibt->Write();
+    hi_fast_dt_vtx->Write();
+    hi_fast_dt_ndof->Write();
+    hi_fast_csc_ibt->Write();
+    hi_fast_csc_vtx->Write();
+    hi_fast_csc_ndof->Write();
+  }
+
   hFile->Write();
 }
 
@@ -70,6 +70,7 @@ private:
   edm::InputTag TKtrackTags_; 
   edm::InputTag MuonTags_; 
   edm::InputTag TimeTags_; 
+  edm::InputTag FastTimeTags_; 
   edm::InputTag SIMtrackTags_; 
 
   std::string out, open;
@@ -91,6 +92,9 @@ private:
   edm::Handle<reco::MuonTimeExtraMap> timeMap1;
   edm::Handle<reco::MuonTimeExtraMap> timeMap2;
   edm::Handle<reco::MuonTimeExtraMap> timeMap3;
+  edm::Handle<reco::MuonTimeExtraMap> fastTimeMap1;
+  edm::Handle<reco::MuonTimeExtraMap> fastTimeMap2;
+  edm::Handle<reco::MuonTimeExtraMap> fastTimeMap3;
   
   //ROOT Pointers
   TFile* hFile;
@@ -171,6 +175,17 @@ private:
   TH1F* hi_hcal_time_ecut;
   TH1F* hi_hcal_energy;
 
+  // differences between the fast distance mode and the propagation
+  TH1F* hi_fast_cmb_ibt;
+  TH1F* hi_fast_cmb_vtx;
+  TH1F* hi_fast_cmb_ndof;
+  TH1F* hi_fast_dt_ibt;
+  TH1F* hi_fast_dt_vtx;
+  TH1F* hi_fast_dt_ndof;
+  TH1F* hi_fast_csc_ibt;
+  TH1F* hi_fast_csc_vtx;
+  TH1F* hi_fast_csc_ndof;
+
   TH1F* hi_tk_eta  ;
   TH1F* hi_sta_eta  ;
   TH1F* hi_glb_eta  ;
@@ -0,0 +1,126 @@
+/** \class OppositeTrackFinderCheck
+ *  Analyzer comparing muonid::OppositeTrackFinder to the linear search of
+ *  muonid::findOppositeTrack on recorded tracks. Every track of the
+ *  collection and every inner track of the muons is searched for with
+ *  nRandom random pairs of thresholds: half of them uniform up to
+ *  maxAngle and maxMomentum, the other half within a relative epsilon of
+ *  the match of the probe to a random track of the collection, so that the
+ *  thresholds fall on the edges of the pt window and of the angle band of
+ *  the finder. The number of queries and of different results are printed
+ *  at the end of the job, a difference throws if failOnMismatch is set.
+ */
+
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+#include "FWCore/Framework/interface/Frameworkfwd.h"
+#include "FWCore/Framework/interface/EDAnalyzer.h"
+#include "FWCore/Framework/interface/Event.h"
+#include "FWCore/Framework/interface/MakerMacros.h"
+#include "FWCore/ParameterSet/interface/ParameterSet.h"
+#include "FWCore/Utilities/interface/Exception.h"
+#include "DataFormats/Common/interface/Handle.h"
+
+#include "DataFormats/MuonReco/interface/Muon.h"
+#include "DataFormats/MuonReco/interface/MuonFwd.h"
+#include "DataFormats/TrackReco/interface/Track.h"
+
+#include "RecoMuon/MuonIdentification/interface/MuonCosmicsId.h"
+
+class OppositeTrackFinderCheck : public edm::EDAnalyzer {
+ public:
+   explicit OppositeTrackFinderCheck(const edm::ParameterSet&);
+   virtual ~OppositeTrackFinderCheck() {}
+
+   virtual void analyze(const edm::Event&, const edm::EventSetup&);
+   virtual void endJob();
+
+ private:
+   /// uniform in [0,1)
+   static double uniform() { return std::rand()/(RAND_MAX+1.); }
+   void check(const edm::Handle<reco::TrackCollection>& tracks, const muonid::OppositeTrackFinder& finder,
+	      const reco::Track& probe);
+
+   edm::InputTag inputTracks_;
+   edm::InputTag inputMuons_;
+   unsigned int nRandom_;
+   double maxAngle_;
+   double maxMomentum_;
+   double epsilon_;
+   bool failOnMismatch_;
+
+   unsigned long long nQueries_;
+   unsigned long long nFound_;
+   unsigned long long nMismatches_;
+};
+
+OppositeTrackFinderCheck::OppositeTrackFinderCheck(const edm::ParameterSet& iConfig):
+  inputTracks_(iConfig.getParameter<edm::InputTag>("inputTracks")),
+  inputMuons_(iConfig.getParameter<edm::InputTag>("inputMuons")),
+  nRandom_(iConfig.getParameter<unsigned int>("nRandom")),
+  maxAngle_(iConfig.getParameter<double>("maxAngle")),
+  maxMomentum_(iConfig.getParameter<double>("maxMomentum")),
+  epsilon_(iConfig.getParameter<double>("epsilon")),
+  failOnMismatch_(iConfig.getParameter<bool>("failOnMismatch")),
+  nQueries_(0), nFound_(0), nMismatches_(0)
+{
+   std::srand(iConfig.getParameter<unsigned int>("seed"));
+}
+
+void OppositeTrackFinderCheck::check(const edm::Handle<reco::TrackCollection>& tracks,
+				     const muonid::OppositeTrackFinder& finder, const reco::Track& probe)
+{
+   // the default thresholds of the producers first
+   std::vector<std::pair<double,double> > thresholds(1, std::make_pair(0.01, 0.05));
+   for ( unsigned int i = 0; i < nRandom_; ++i ) {
+      if ( i%2 == 0 || tracks->empty() ) {
+	 thresholds.push_back( std::make_pair(maxAngle_*uniform(), maxMomentum_*uniform()) );
+      } else {
+	 const reco::Track& other = tracks->at( (unsigned int)(uniform()*tracks->size()) );
+	 const std::pair<double,double> match = muonid::matchTracks(probe, other);
+	 thresholds.push_back( std::make_pair(match.first*(1+epsilon_*(2*uniform()-1)),
+					      match.second*(1+epsilon_*(2*uniform()-1))) );
+      }
+   }
+
+   for ( unsigned int i = 0; i < thresholds.size(); ++i ) {
+      const reco::TrackRef expected = muonid::findOppositeTrack(tracks, probe, thresholds[i].first, thresholds[i].second);
+      const reco::TrackRef found = finder.find(probe, thresholds[i].first, thresholds[i].second);
+      ++nQueries_;
+      if ( expected.isNonnull() ) ++nFound_;
+      if ( expected.isNonnull() == found.isNonnull() && ( expected.isNull() || expected.key() == found.key() ) ) continue;
+      ++nMismatches_;
+      std::cout << "OppositeTrackFinderCheck: different partner for the track with pt " << probe.pt()
+		<< " eta " << probe.eta() << " phi " << probe.phi()
+		<< ", angle " << thresholds[i].first << " momentum " << thresholds[i].second << ": "
+		<< ( expected.isNonnull() ? int(expected.key()) : -1 ) << " (linear search) "
+		<< ( found.isNonnull() ? int(found.key()) : -1 ) << " (finder)" << std::endl;
+      if ( failOnMismatch_ )
+	throw cms::Exception("OppositeTrackFinderCheck") << "The opposite track finder differs from findOppositeTrack";
+   }
+}
+
+void OppositeTrackFinderCheck::analyze(const edm::Event& iEvent, const edm::EventSetup& iSetup)
+{
+   edm::Handle<reco::TrackCollection> tracks;
+   iEvent.getByLabel(inputTracks_, tracks);
+   muonid::OppositeTrackFinder finder(tracks);
+
+   for ( reco::TrackCollection::const_iterator track = tracks->begin(); track != tracks->end(); ++track )
+     check(tracks, finder, *track);
+
+   edm::Handle<reco::MuonCollection> muons;
+   iEvent.getByLabel(inputMuons_, muons);
+   for ( reco::MuonCollection::const_iterator muon = muons->begin(); muon != muons->end(); ++muon )
+     if ( muon->innerTrack().isNonnull() ) check(tracks, finder, *muon->innerTrack());
+}
+
+void OppositeTrackFinderCheck::endJob()
+{
+   std::cout << "OppositeTrackFinderCheck: " << nQueries_ << " queries, " << nFound_ << " with a partner, "
+	     << nMismatches_ << " different from findOppositeTrack" << std::endl;
+}
+
+//define this as a plug-in
+DEFINE_FWK_MODULE(OppositeTrackFinderCheck);
@@ -0,0 +1,38 @@
+import FWCore.ParameterSet.Config as cms
+import FWCore.ParameterSet.VarParsing as VarParsing
+
+# Randomized comparison of the opposite track finder of the cosmic veto to
+# the linear search, on the tracks and muons of a RECO file:
+#
+#   cmsRun OppositeTrackFinderCheck_cfg.py inputFiles=file:reco.root
+
+options = VarParsing.VarParsing('analysis')
+options.register('tracks', 'generalTracks', VarParsing.VarParsing.multiplicity.singleton,
+                 VarParsing.VarParsing.varType.string, "track collection searched")
+options.maxEvents = 100
+options.parseArguments()
+
+process = cms.Process("FINDERCHECK")
+
+process.maxEvents = cms.untracked.PSet(
+    input = cms.untracked.int32(options.maxEvents)
+)
+
+process.source = cms.Source("PoolSource",
+    fileNames = cms.untracked.vstring(options.inputFiles)
+)
+
+process.oppositeTrackFinderCheck = cms.EDAnalyzer("OppositeTrackFinderCheck",
+    inputTracks = cms.InputTag(options.tracks),
+    inputMuons = cms.InputTag("muons"),
+    # random threshold pairs per probe track, on top of the default ones
+    nRandom = cms.uint32(20),
+    maxAngle = cms.double(0.2),
+    maxMomentum = cms.double(0.2),
+    # relative distance of the thresholds to the match of a random track
+    epsilon = cms.double(1e-9),
+    seed = cms.uint32(12345),
+    failOnMismatch = cms.bool(True)
+)
+
+process.p = cms.Path(process.oppositeTrackFinderCheck)
@@ -0,0 +1,68 @@
+#!/usr/bin/env python
+# Machine-readable summary of a MuonIdBenchmark_cfg.py job: events per
+# second, peak memory and the cpu and real time per event of each module,
+# from the log (TimeReport of wantSummary) and the job report (Timing and
+# SimpleMemoryCheck services). One JSON object is written to stdout.
+#
+#   python muonIdBenchmarkSummary.py bench.log bench.xml > bench.json
+
+import json
+import sys
+import xml.dom.minidom
+
+def moduleTimes(logFile):
+    """cpu and real time per event of the modules from the TimeReport"""
+    modules = {}
+    inModules = False
+    for line in open(logFile):
+        if not line.startswith("TimeReport"):
+            continue
+        if "Module Summary" in line:
+            inModules = True
+            continue
+        if inModules and "---" in line:
+            inModules = False
+            continue
+        fields = line.split()[1:]
+        if not inModules or len(fields) != 7:
+            continue
+        try:
+            times = [float(field) for field in fields[:6]]
+        except ValueError:
+            continue
+        modules[fields[6]] = { 'cpuPerEvent': times[0], 'realPerEvent': times[1] }
+    return modules
+
+def performanceMetrics(reportFile):
+    """the metrics of the performance report, by summary name"""
+    metrics = {}
+    document = xml.dom.minidom.parse(reportFile)
+    for summary in document.getElementsByTagName("PerformanceSummary"):
+        values = metrics.setdefault(summary.getAttribute("Metric"), {})
+        for metric in summary.getElementsByTagName("Metric"):
+            try:
+                values[metric.getAttribute("Name")] = float(metric.getAttribute("Value"))
+            except ValueError:
+                values[metric.getAttribute("Name")] = metric.getAttribute("Value")
+    events = 0
+    for node in document.getElementsByTagName("EventsRead"):
+        events += int(node.firstChild.data)
+    return metrics, events
+
+if __name__ == "__main__":
+    if len(sys.argv) != 3:
+        sys.exit("usage: muonIdBenchmarkSummary.py <log> <job report>")
+    metrics, events = performanceMetrics(sys.argv[2])
+    timing = metrics.get("Timing", {})
+    memory = metrics.get("ApplicationMemory", {})
+    summary = { 'events': events, 'modules': moduleTimes(sys.argv[1]) }
+    if timing.get("TotalJobTime"):
+        summary['eventsPerSecond'] = events/timing["TotalJobTime"]
+    for name in ("TotalJobTime", "TotalJobCPU", "AvgEventTime", "AvgEventCPU"):
+        if name in timing:
+            summary[name] = timing[name]
+    for name in ("PeakValueRss", "PeakValueVsize"):
+        if name in memory:
+            summary[name] = memory[name]
+    json.dump(summary, sys.stdout, indent=1, sort_keys=True)
+    sys.stdout.write("\n")
@@ -27,6 +27,12 @@ process.load("Configuration.StandardSequences.FrontierConditions_GlobalTag_cff")
 process.load("Configuration.StandardSequences.Reconstruction_cff")
 from Configuration.StandardSequences.Reconstruction_cff import *
 
+# the same timing with the straight line distances, compared in the validator
+import RecoMuon.MuonIdentification.muonTiming_cfi
+process.muontimingFast = RecoMuon.MuonIdentification.muonTiming_cfi.muontiming.clone()
+process.muontimingFast.TimingFillerParameters.DTTimingParameters.UseFastDistance = True
+process.muontimingFast.TimingFillerParameters.CSCTimingParameters.UseFastDistance = True
+
 process.muonAnalyzer = cms.EDFilter("MuonTimingValidator",
   TKtracks = cms.untracked.InputTag("generalTracks"),
   STAtracks = cms.untracked.InputTag("standAloneMuons"),
@@ -34,6 +40,7 @@ process.muonAnalyzer = cms.EDFilter("MuonTimingValidator",
   nbins = cms.int32(60),
   PtresMax = cms.double(2000.0),
   Timing = cms.untracked.InputTag("muontiming"),
+  FastTiming = cms.untracked.InputTag("muontimingFast"),
   simPtMin = cms.double(5.0),
   PtresMin = cms.double(-1000.0),
   PtCut = cms.double(1.0),
@@ -51,7 +58,7 @@ process.prefer("GlobalTag")
 process.GlobalTag.globaltag = 'MC_3XY_V14::All'
 #process.GlobalTag.globaltag = 'STARTUP_V7::All'
 
-process.p = cms.Path(muontiming)
+process.p = cms.Path(muontiming*process.muontimingFast)
 
 process.mutest = cms.Path(process.muonAnalyzer)
 